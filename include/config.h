@@ -1,6 +1,8 @@
 #ifndef __CONFIG_H__
 #define __CONFIG_H__
 
+#include <stdint.h>
+
 #define SKYBOX_TEXTURE_DIR "resources/skybox_texture_sea"
 
 #define CENTER_MESH_OBJ_PATH "resources/teapot.obj"
@@ -15,15 +17,203 @@
 #define CENTER_MESH_TYPE 1
 #define ORBITING_MESH_TYPE 0
 
+// Number of orbiting mesh instances; all of them share one BLAS
+#define ORBITING_MESH_INSTANCE_COUNT 1
+
 const float CAMERA_MOUSE_SENSITIVITY = 0.0005;
 const float CAMERA_SPEED = 50.0;
 
-// Define TEST_FPS to disable frame-rate locking and print FPS
+// Define TEST_FPS to print FPS, trace time (broken down into primary,
+// secondary and shadow rays) and latency; it also overrides the present
+// mode policy with the uncapped one
 // #define TEST_FPS
 
+/*
+    Present mode policies (the first mode the surface supports, FIFO as the
+    fallback):
+    0 - low latency: mailbox, immediate
+    1 - vsync: fifo
+    2 - uncapped: immediate, mailbox
+*/
+#define PRESENT_MODE_POLICY 0
+
+// Frames the CPU may queue ahead of the GPU (at most the swapchain image
+// count); the CPU waits for a free frame before it polls the input, so
+// fewer frames lower the input latency at the cost of GPU idle time.
+// TARGET_FPS caps the frame rate (0 - uncapped) by delaying the start of
+// the frame, which saves power when the GPU could render faster.
+#define MAX_FRAMES_IN_FLIGHT 2
+const float TARGET_FPS = 0;
+
 // #define VALIDATION_LAYERS_ENABLED
 
+// Lights (include/light.h): the key point light, RANDOM_POINT_LIGHT_COUNT
+// point lights scattered around the scene and the emissive triangles of
+// the center mesh. Every diffuse hit picks one light in proportion to its
+// power (alias table) and traces a single shadow ray to it, so the cost of
+// a hit does not grow with the light count. Point light intensity falls
+// off with the squared distance.
+const float KEY_LIGHT_INTENSITY = 75.0;
+const uint32_t RANDOM_POINT_LIGHT_COUNT = 0;
+const float RANDOM_POINT_LIGHT_INTENSITY = 5.0;
+
+// Define ENVIRONMENT_SAMPLING_ENABLED to light diffuse hits with the skybox
+// through the shadow ray instead of the constant ambient term. The skybox
+// is importance sampled by luminance (ENVIRONMENT_SAMPLING_RESOLUTION cells
+// per cubemap face edge) and combined with cosine-weighted sampling by
+// MIS. A hit samples the skybox with ENVIRONMENT_SELECTION_PROBABILITY and
+// the lights otherwise.
+// #define ENVIRONMENT_SAMPLING_ENABLED
+#define ENVIRONMENT_SAMPLING_RESOLUTION 64
+const float ENVIRONMENT_SELECTION_PROBABILITY = 0.5;
+
+// Define COMPACT_VERTEX_FORMAT to upload quantized positions, octahedral
+// normals and half-precision texture coordinates (16 instead of 32 bytes)
+// #define COMPACT_VERTEX_FORMAT
+
+// Define COMPACT_PAYLOAD_ENABLED to return only the instance, primitive and
+// barycentrics from the closest hit shader (16 instead of 36 bytes); the ray
+// generation shaders fetch and interpolate the hit vertex themselves. Uses the
+// compact_payload_* shader variants built by 'make shader'.
+// #define COMPACT_PAYLOAD_ENABLED
+
+// Define MESH_OPTIMIZATION_ENABLED to reorder triangles (Morton order) and
+// vertices (first use) at load time and to use 16-bit indices where possible.
+// The BLAS sizes printed at startup and the trace time printed with TEST_FPS
+// can be compared with and without it.
+// #define MESH_OPTIMIZATION_ENABLED
+
+// Define MESH_DEFORMATION_ENABLED to twist the orbiting mesh with a compute
+// shader every frame and refit its BLAS in place (float vertex format only).
+// The BLAS is rebuilt from scratch once the vertices have moved further than
+// BLAS_REBUILD_DEFORMATION_THRESHOLD (relative to the mesh height) since its
+// last full build, as refitting keeps the old tree and its bounds loosen.
+// #define MESH_DEFORMATION_ENABLED
+const float MESH_DEFORMATION_TWIST_ANGLE = 0.8;
+const float BLAS_REBUILD_DEFORMATION_THRESHOLD = 0.25;
+
+// Define MESH_LOD_ENABLED to simplify every mesh but the deformed and the
+// emissive ones at load time (quadric error metric,
+// src/mesh_simplification.cpp) into MESH_LOD_COUNT levels of detail (at
+// most 4), each with about MESH_LOD_REDUCTION times the triangles of the
+// one before and a BLAS of its own. Every frame an instance uses the
+// first simplified level once its bounding sphere covers less than
+// MESH_LOD_SCREEN_SIZE of the screen height, and one more level every time
+// that size halves. The rays after the first bounce trace levels
+// MESH_LOD_SECONDARY_BIAS coarser.
+// #define MESH_LOD_ENABLED
+#define MESH_LOD_COUNT 4
+const float MESH_LOD_REDUCTION = 0.25;
+const float MESH_LOD_SCREEN_SIZE = 0.5;
+#define MESH_LOD_SECONDARY_BIAS 1
+
+// Meshes that are not deformed use the static BLAS build policy (fast
+// trace, compacted). Define BLAS_BUILD_POLICY_OVERRIDE to build them with
+// another policy instead and compare the trace time printed with TEST_FPS:
+//   0 - static, 1 - rarely changing, 2 - deforming
+// #define BLAS_BUILD_POLICY_OVERRIDE 1
+
+// Define BLAS_BUILD_POLICY_BENCHMARK to print the GPU build time, size and
+// compacted size of every mesh's BLAS under each build policy at startup
+// #define BLAS_BUILD_POLICY_BENCHMARK
+
+// Define SAMPLER_SELF_TEST to check at startup that the host sampler
+// (include/sampler.h) draws the same bits as src/sampler.glsl on the GPU
+// #define SAMPLER_SELF_TEST
+
+// Size of the bindless material texture array
+#define MAX_TEXTURE_COUNT 256
+
+/*
+    Tonemap operators (linear HDR radiance -> display):
+    0 - none (clamp)
+    1 - Reinhard
+    2 - ACES filmic
+*/
+#define TONEMAP_OPERATOR 2
+const float TONEMAP_EXPOSURE = 1.0;
+
+// Internal render resolution as a fraction of the swapchain extent: rays
+// are traced, accumulated and denoised at this resolution and the tonemap
+// pass upscales (Catmull-Rom) to the swapchain. The per-frame sample jitter
+// is accumulated by the temporal pass, so a reduced scale recovers detail
+// over a few frames.
+const float RENDER_SCALE = 1.0;
+
+// Steps the render scale between RENDER_SCALE_MIN and 1.0 in
+// RENDER_SCALE_LEVEL_COUNT levels to keep the GPU frame time within the
+// budget (in ms): the scale is lowered above the budget and raised below
+// the given fraction of it, at most once every settle frame count frames
+// (needs timestamp queries)
+// #define DYNAMIC_RESOLUTION_ENABLED
+#define RENDER_SCALE_LEVEL_COUNT 6
+const float RENDER_SCALE_MIN = 0.5;
+const float DYNAMIC_RESOLUTION_FRAME_TIME_BUDGET = 16.0;
+const float DYNAMIC_RESOLUTION_RAISE_FRACTION = 0.75;
+#define DYNAMIC_RESOLUTION_SETTLE_FRAME_COUNT 30
+
+// Temporal accumulation ahead of the denoiser: the new samples are blended
+// into the reprojected history with weight 1 / history length (capped at
+// the max length, 1 disables accumulation). History is clamped to the
+// current 3x3 neighborhood mean +- gamma standard deviations and rejected
+// where the relative hit distance differs by more than the depth threshold
+// or the normals' cosine falls under the normal threshold.
+const float TEMPORAL_MAX_HISTORY_LENGTH = 32.0;
+const float TEMPORAL_CLAMP_GAMMA = 1.5;
+const float TEMPORAL_DEPTH_THRESHOLD = 0.1;
+const float TEMPORAL_NORMAL_THRESHOLD = 0.9;
+
+// Iterations of the edge-aware a-trous denoiser run before tonemapping
+// (0 disables it); the filter footprint doubles with every iteration.
+// The edge-stopping weights fall off with the normal angle (higher phi is
+// stricter), the relative hit distance and the illumination difference
+// (lower phi is stricter).
+#define DENOISER_ITERATION_COUNT 4
+const float DENOISER_NORMAL_PHI = 128.0;
+const float DENOISER_DEPTH_PHI = 0.05;
+const float DENOISER_LUMINANCE_PHI = 4.0;
+
+/*
+    Render backends, the default is overridden at startup with
+    --backend <name>:
+    0 - megakernel: shader.rgen traces and shades every path in a loop
+    1 - wavefront: separate generate, extend (trace), shade and shadow
+        kernels pass the paths through queues in storage buffers, one
+        sample and one bounce per wave
+    2 - rayquery: the megakernel loop in a compute shader traced inline
+        with VK_KHR_ray_query, no shader binding table; falls back to the
+        megakernel when the extension is missing
+*/
+#define RENDER_BACKEND 0
+
+// Define RENDER_BACKEND_BENCHMARK to print the GPU time per frame of the
+// megakernel and ray query backends at startup, averaged over
+// RENDER_BACKEND_BENCHMARK_FRAME_COUNT frames of the same scene
+// #define RENDER_BACKEND_BENCHMARK
+#define RENDER_BACKEND_BENCHMARK_FRAME_COUNT 16
+
+// Wavefront backend: paths still continuing after WAVEFRONT_WAVE_COUNT
+// bounces are cut (MAX_BOUNCE_COUNT caps both backends). The rays of every
+// wave are binned by direction octant and material (counting sort,
+// src/shader_bin.comp) before they are traced; compare the trace time
+// printed with TEST_FPS with WAVEFRONT_SORTING_ENABLED undefined for the
+// unsorted queue, and against the megakernel.
+// #define WAVEFRONT_SORTING_ENABLED
+#define WAVEFRONT_WAVE_COUNT 8
+
+// Define SHADOW_RAY_BATCHING_ENABLED to have the megakernel write its shadow
+// rays to a buffer and trace them all in a second launch of a pipeline
+// without closest hit shaders (src/shader_shadow_batch.rgen). Shadow rays to
+// point and spot lights also go through the shadow cache: the visibility
+// against the static instances is kept per light and receiver cell of
+// SHADOW_CACHE_CELL_SIZE (0 - no cache) and only the moving instances are
+// traced again. Larger cells hit the cache more often but blur shadow edges.
+// #define SHADOW_RAY_BATCHING_ENABLED
+const float SHADOW_CACHE_CELL_SIZE = 0.05;
+
 #define MAX_BOUNCE_COUNT 63
+// Pixel samples are drawn from an Owen-scrambled Sobol sequence
+// (src/sampler.glsl); powers of two keep every frame's samples stratified
 #define SAMPLES_PER_PIXEL 4
 
 #endif
\ No newline at end of file
@@ -0,0 +1,22 @@
+#ifndef __ENVIRONMENT_MAP_H__
+#define __ENVIRONMENT_MAP_H__
+
+#include <stdint.h>
+#include <vector>
+
+/*
+    Importance sampling distribution of the skybox cubemap, read by
+    src/environment.glsl. Every face is box filtered down to resolution x
+    resolution cells, weighted by their linear luminance and solid angle,
+    and stored as a 2D marginal/conditional CDF (floats, each CDF ends at 1):
+      [0, 6 * resolution)  marginal CDF over the rows of all faces
+                           (row = face * resolution + y)
+      then, per row        conditional CDF over the row's cells
+    The faces are RGBA8 sRGB in the order of the cubemap layers
+    (+X, -X, +Y, -Y, +Z, -Z).
+*/
+std::vector<float> buildEnvironmentDistribution(
+    const std::vector<unsigned char *> &faceData, int width, int height,
+    uint32_t resolution);
+
+#endif
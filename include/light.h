@@ -0,0 +1,74 @@
+#ifndef __LIGHT_H__
+#define __LIGHT_H__
+
+#include <stdint.h>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "mesh_registry.h"
+
+/*
+    Light types:
+    0 - point
+    1 - spot
+    2 - area (one-sided parallelogram)
+    3 - emissive triangle (one-sided)
+*/
+
+// Matches the std430 layout of Light in the shaders (80 bytes). Area and
+// triangle lights span position + direction * u + edge * v and emit to the
+// side of cross(direction, edge).
+struct Light
+{
+    float position[3];
+    uint32_t type;
+    // spot axis, first edge of area and triangle lights
+    float direction[3];
+    float cosOuterAngle;
+    float edge[3];
+    float cosInnerAngle;
+    // intensity of point and spot lights, radiance of the others
+    float emission[3];
+    float selectionPdf;
+    // alias table bucket of the same index
+    float aliasProbability;
+    uint32_t aliasIndex;
+    uint32_t padding[2];
+};
+
+/*
+    Owns every light in the scene. The alias table stored alongside picks
+    one light per shading point with probability proportional to its
+    power in constant time, so a single shadow ray per hit serves any
+    number of lights.
+*/
+class LightLibrary
+{
+private:
+    std::vector<Light> lights;
+    std::vector<float> powers;
+
+    uint32_t addLight(const Light &light, float power);
+
+public:
+    uint32_t addPointLight(const glm::vec3 &position, const glm::vec3 &intensity);
+    uint32_t addSpotLight(const glm::vec3 &position, const glm::vec3 &direction,
+                          const glm::vec3 &intensity, float innerAngle,
+                          float outerAngle);
+    uint32_t addAreaLight(const glm::vec3 &corner, const glm::vec3 &edge0,
+                          const glm::vec3 &edge1, const glm::vec3 &radiance);
+
+    // one triangle light per face of the transformed mesh, returns the
+    // number of lights added
+    uint32_t addEmissiveMesh(const Mesh &mesh, const glm::mat4 &transform,
+                             const glm::vec3 &radiance);
+
+    // fills the selection pdfs and the alias table, call after the last
+    // light has been added
+    void buildAliasTable();
+
+    const std::vector<Light> &getLights() const { return lights; }
+};
+
+#endif
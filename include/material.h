@@ -0,0 +1,56 @@
+#ifndef __MATERIAL_H__
+#define __MATERIAL_H__
+
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "mesh_registry.h"
+
+/*
+    Material types:
+    0 - diffuse
+    1 - mirror
+    2 - refractive
+*/
+
+// Matches the std430 layout of Material in the shaders (64 bytes)
+struct Material
+{
+    float albedo[3];
+    float roughness;
+    float specular[3];
+    float indexOfRefraction;
+    float emission[3];
+    uint32_t type;
+    uint32_t albedoTextureIndex;
+    uint32_t padding[3];
+};
+
+/*
+    Owns every material in the scene and the list of textures they
+    reference. Texture 0 is always a 1x1 white texture so that untextured
+    materials can sample unconditionally.
+*/
+class MaterialLibrary
+{
+private:
+    std::vector<Material> materials;
+    std::vector<std::string> texturePaths;
+    std::unordered_map<std::string, uint32_t> texturePathToIndex;
+
+public:
+    MaterialLibrary();
+
+    static Material getDefaultMaterial(uint32_t type);
+
+    uint32_t addMaterial(const Material &material);
+    uint32_t addMeshMaterial(const Mesh &mesh, uint32_t type);
+    uint32_t addTexture(const std::string &path);
+
+    const std::vector<Material> &getMaterials() const { return materials; }
+    const std::vector<std::string> &getTexturePaths() const { return texturePaths; }
+};
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef __MESH_PROCESSING_H__
+#define __MESH_PROCESSING_H__
+
+#include <stdint.h>
+#include <vector>
+
+#include "mesh_registry.h"
+
+/*
+    Load-time passes over the interleaved geometry of a Mesh. They only
+    touch mesh.vertices and mesh.indices; the OBJ attributes and shapes are
+    left as parsed.
+*/
+
+// Builds mesh.vertices and mesh.indices from the OBJ attributes, one vertex
+// per unique (position, normal, texture coordinate) tuple. Shapes are
+// welded in parallel and then merged.
+void weldVertices(Mesh &mesh);
+
+// Sorts triangles by the Morton code of their centroid within the mesh AABB
+void reorderTrianglesMorton(Mesh &mesh);
+
+// Renumbers vertices in the order they are first referenced by the indices
+void reorderVerticesFirstUse(Mesh &mesh);
+
+bool fitsShortIndices(const Mesh &mesh);
+std::vector<uint16_t> getShortIndices(const Mesh &mesh);
+
+#endif
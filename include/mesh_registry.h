@@ -0,0 +1,109 @@
+#ifndef __MESH_REGISTRY_H__
+#define __MESH_REGISTRY_H__
+
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "tiny_obj_loader.h"
+
+#define MESH_VERTEX_STRIDE 8
+
+/*
+    Compact vertex layout (4 words):
+    0 - position x, y (snorm16, relative to the mesh AABB)
+    1 - position z, unused w (snorm16)
+    2 - octahedral-encoded normal (snorm16 x 2)
+    3 - texture coordinate (half x 2)
+*/
+#define MESH_COMPACT_VERTEX_STRIDE 4
+
+/*
+    Geometry of one unique OBJ file. Vertices are interleaved as
+    position (3 floats), normal (3 floats) and texture coordinate (2 floats).
+    When the registry is created with the compact vertex format, the packed
+    copy in compactVertices is filled as well; positions are recovered as
+    positionOffset + position * positionScale.
+*/
+struct Mesh
+{
+    std::string path;
+    uint64_t contentHash;
+
+    tinyobj::attrib_t attrib;
+    std::vector<tinyobj::shape_t> shapes;
+    std::vector<tinyobj::material_t> materials;
+
+    std::vector<float> vertices;
+    std::vector<uint32_t> compactVertices;
+    std::vector<uint32_t> indices;
+
+    // AABB center and half extent
+    float positionOffset[3];
+    float positionScale[3];
+
+    uint32_t vertexCount;
+    uint32_t primitiveCount;
+
+    // largest distance the surface moved while it was simplified (an upper
+    // bound from the collapse quadrics), 0 for loaded meshes
+    float simplificationError;
+};
+
+/*
+    A placement of a registered mesh in the scene. Any number of instances
+    may reference the same mesh; they share its BLAS and geometry slice.
+*/
+struct MeshInstance
+{
+    uint32_t meshIndex;
+    uint32_t materialIndex;
+    glm::mat4 transform;
+};
+
+class MeshRegistry
+{
+private:
+    std::vector<Mesh> meshes;
+    std::unordered_map<std::string, uint32_t> pathToMeshIndex;
+    std::unordered_map<uint64_t, uint32_t> hashToMeshIndex;
+    bool compactVertexFormat;
+    bool optimizeMeshLayout;
+
+    // mesh index of every level of detail of a mesh, the mesh itself first
+    std::vector<std::vector<uint32_t>> lodMeshIndices;
+
+    void buildGeometry(Mesh &mesh);
+    void buildCompactGeometry(Mesh &mesh);
+    void processMesh(Mesh &mesh);
+    static bool isSameGeometry(const Mesh &mesh, const Mesh &otherMesh);
+    uint32_t addMesh(Mesh &mesh);
+    uint32_t pushMesh(Mesh &mesh);
+
+public:
+    MeshRegistry(bool compactVertexFormat = false,
+                 bool optimizeMeshLayout = false);
+
+    uint32_t load(const char *fileName);
+    const Mesh &getMesh(uint32_t meshIndex) const { return meshes[meshIndex]; }
+    uint32_t getMeshCount() const { return (uint32_t)meshes.size(); }
+
+    // Registers simplified copies of a loaded mesh as meshes of their own,
+    // each with about reduction times the triangles of the one before, up
+    // to lodCount levels in all. Levels the simplifier cannot reach are
+    // left out.
+    void buildLevelsOfDetail(uint32_t meshIndex, uint32_t lodCount,
+                             float reduction);
+
+    // the mesh of the level, the coarsest one for levels past the last
+    uint32_t getLodMeshIndex(uint32_t meshIndex, uint32_t lod) const;
+    uint32_t getLodCount(uint32_t meshIndex) const
+    {
+        return (uint32_t)lodMeshIndices[meshIndex].size();
+    }
+};
+
+#endif
@@ -0,0 +1,27 @@
+#ifndef __MESH_SIMPLIFICATION_H__
+#define __MESH_SIMPLIFICATION_H__
+
+#include <stdint.h>
+#include <vector>
+
+#include "mesh_registry.h"
+
+/*
+    Quadric error metric simplification (Garland and Heckbert) by half-edge
+    collapses: a vertex is merged into a neighbor and takes over its
+    position and attributes, so every simplified mesh is made of vertices
+    of the original. The quadrics join vertices by position; a vertex that
+    is split by its normal or texture coordinate only collapses along the
+    seam, and mesh borders are held in place by extra planes.
+*/
+
+// Collapses the cheapest edges of the mesh until it has at most each of the
+// primitive counts in turn (largest first) and appends a copy of the
+// geometry at every one of them. When no valid collapse is left the
+// remaining copies repeat the last geometry. The copies only fill
+// vertices, indices, vertexCount, primitiveCount and simplificationError.
+void simplifyMesh(const Mesh &mesh,
+                  const std::vector<uint32_t> &targetPrimitiveCounts,
+                  std::vector<Mesh> &simplifiedMeshes);
+
+#endif
@@ -0,0 +1,24 @@
+#ifndef __SAMPLER_H__
+#define __SAMPLER_H__
+
+#include <stdint.h>
+
+/*
+    Owen-scrambled Sobol sampler, the CPU twin of src/sampler.glsl. Both
+    produce the same bits for the same index and seed, so sample patterns
+    can be generated or checked on the host; SAMPLER_SELF_TEST in config.h
+    compares the two at startup.
+*/
+
+uint32_t hashSampler(uint32_t x);
+uint32_t nestedUniformScramble(uint32_t x, uint32_t seed);
+
+// First two Sobol dimensions as 32-bit fixed point
+void sobol2D(uint32_t index, uint32_t result[2]);
+
+// index-th point of the sequence scrambled by seed, in [0, 1)^2
+void sampleOwenSobol2D(uint32_t index, uint32_t seed, float sample[2]);
+
+uint32_t getPixelSeed(uint32_t x, uint32_t y);
+
+#endif
@@ -0,0 +1,146 @@
+// Importance sampling of the skybox for next-event estimation. The
+// distribution is built on the host from the cubemap faces
+// (include/environment_map.h), one sample combines it with cosine-weighted
+// hemisphere sampling (one-sample MIS, balance heuristic) so that neither a
+// small bright sun nor a dull overcast sky is sampled poorly. Included by
+// path_tracing.glsl after the uniforms.
+//
+// Included by the shaders, the name must not start with "shader" so the
+// Makefile does not compile it on its own.
+
+// marginal CDF over the rows of all faces, then the conditional CDF of every
+// row (see include/environment_map.h)
+layout(binding = 21, set = 0) buffer EnvironmentDistribution { float data[]; }
+environmentDistribution;
+
+// the cubemap is looked up with z flipped
+vec3 getSkyRadiance(vec3 direction) {
+  return texture(skyboxSampler, vec3(direction.xy, -direction.z)).xyz;
+}
+
+// face and [0, 1]^2 face coordinates a cubemap lookup vector lands on
+uint getCubeFace(vec3 lookup, out vec2 faceCoordinate) {
+  vec3 magnitude = abs(lookup);
+  uint face;
+  float majorAxis;
+  vec2 minorAxes;
+  if (magnitude.x >= magnitude.y && magnitude.x >= magnitude.z) {
+    face = lookup.x > 0.0 ? 0 : 1;
+    majorAxis = magnitude.x;
+    minorAxes = lookup.x > 0.0 ? vec2(-lookup.z, -lookup.y) : vec2(lookup.z, -lookup.y);
+  } else if (magnitude.y >= magnitude.z) {
+    face = lookup.y > 0.0 ? 2 : 3;
+    majorAxis = magnitude.y;
+    minorAxes = lookup.y > 0.0 ? vec2(lookup.x, lookup.z) : vec2(lookup.x, -lookup.z);
+  } else {
+    face = lookup.z > 0.0 ? 4 : 5;
+    majorAxis = magnitude.z;
+    minorAxes = lookup.z > 0.0 ? vec2(lookup.x, -lookup.y) : vec2(-lookup.x, -lookup.y);
+  }
+
+  faceCoordinate = (minorAxes / majorAxis + 1.0) * 0.5;
+  return face;
+}
+
+// inverse of getCubeFace(), on the cube of half size 1
+vec3 getCubeLookup(uint face, vec2 faceCoordinate) {
+  vec2 uv = faceCoordinate * 2.0 - 1.0;
+  switch (face) {
+  case 0: return vec3(1.0, -uv.y, -uv.x);
+  case 1: return vec3(-1.0, -uv.y, uv.x);
+  case 2: return vec3(uv.x, 1.0, uv.y);
+  case 3: return vec3(uv.x, -1.0, -uv.y);
+  case 4: return vec3(uv.x, -uv.y, 1.0);
+  default: return vec3(-uv.x, -uv.y, -1.0);
+  }
+}
+
+// first entry of the CDF at offset that is above u
+uint findCdfInterval(uint offset, uint count, float u) {
+  uint low = 0;
+  uint high = count - 1;
+  while (low < high) {
+    uint middle = (low + high) / 2;
+    if (environmentDistribution.data[offset + middle] > u)
+      high = middle;
+    else
+      low = middle + 1;
+  }
+  return low;
+}
+
+// bounds of the CDF interval, x below and y at the entry
+vec2 getCdfInterval(uint offset, uint index) {
+  float below = index == 0 ? 0.0 : environmentDistribution.data[offset + index - 1];
+  return vec2(below, environmentDistribution.data[offset + index]);
+}
+
+// solid angle density of the distribution in the direction
+float getEnvironmentPdf(vec3 direction) {
+  uint resolution = uniforms.environmentResolution;
+  uint rowCount = 6 * resolution;
+
+  vec3 lookup = vec3(direction.xy, -direction.z);
+  vec2 faceCoordinate;
+  uint face = getCubeFace(lookup, faceCoordinate);
+  uvec2 cell = min(uvec2(faceCoordinate * float(resolution)), uvec2(resolution - 1));
+  uint row = face * resolution + cell.y;
+
+  vec2 rowInterval = getCdfInterval(0, row);
+  vec2 cellInterval = getCdfInterval(rowCount + row * resolution, cell.x);
+  float cellProbability = (rowInterval.y - rowInterval.x) * (cellInterval.y - cellInterval.x);
+
+  // cells are uniform in face area, (2 / resolution)^2 each, and the solid
+  // angle per area falls with the cube of the distance to the face point
+  float faceDistance = length(lookup / max(max(abs(lookup.x), abs(lookup.y)), abs(lookup.z)));
+  return cellProbability * float(resolution * resolution) * 0.25 *
+         faceDistance * faceDistance * faceDistance;
+}
+
+// direction drawn from the distribution, u.x picks the row and u.y the cell,
+// the remainders place the direction within the cell
+vec3 sampleEnvironmentDirection(vec2 u) {
+  uint resolution = uniforms.environmentResolution;
+  uint rowCount = 6 * resolution;
+
+  uint row = findCdfInterval(0, rowCount, u.x);
+  vec2 rowInterval = getCdfInterval(0, row);
+  uint cellOffset = rowCount + row * resolution;
+  uint cellIndex = findCdfInterval(cellOffset, resolution, u.y);
+  vec2 cellInterval = getCdfInterval(cellOffset, cellIndex);
+
+  vec2 remainder = vec2(
+      (u.y - cellInterval.x) / max(cellInterval.y - cellInterval.x, 1e-20),
+      (u.x - rowInterval.x) / max(rowInterval.y - rowInterval.x, 1e-20));
+  vec2 faceCoordinate = (vec2(cellIndex, row % resolution) + clamp(remainder, 0.0, 1.0)) /
+                        float(resolution);
+
+  vec3 lookup = getCubeLookup(row / resolution, faceCoordinate);
+  return normalize(vec3(lookup.xy, -lookup.z));
+}
+
+vec3 sampleCosineDirection(vec3 normal, vec2 u) {
+  vec3 tangent = normalize(abs(normal.x) > 0.5 ? cross(normal, vec3(0.0, 1.0, 0.0))
+                                                : cross(normal, vec3(1.0, 0.0, 0.0)));
+  vec3 bitangent = cross(normal, tangent);
+
+  float radius = sqrt(u.x);
+  float angle = 2.0 * M_PI * u.y;
+  return normalize(radius * cos(angle) * tangent + radius * sin(angle) * bitangent +
+                   sqrt(max(1.0 - u.x, 0.0)) * normal);
+}
+
+// Sky light arriving at a surface with the normal from direction L, by the
+// same convention as sampleLight() in path_tracing.glsl. The 1/pi of the
+// Lambertian BRDF is folded in so that a white sky reflects the albedo.
+vec3 sampleEnvironment(vec3 normal, vec2 u, float strategySample, out vec3 L) {
+  L = strategySample < 0.5 ? sampleEnvironmentDirection(u)
+                           : sampleCosineDirection(normal, u);
+
+  float cosTheta = dot(normal, L);
+  if (cosTheta <= 0.0)
+    return vec3(0.0);
+
+  float pdf = 0.5 * getEnvironmentPdf(L) + 0.5 * cosTheta / M_PI;
+  return getSkyRadiance(L) / (M_PI * pdf);
+}
@@ -0,0 +1,93 @@
+#include <math.h>
+#include <algorithm>
+
+#include "environment_map.h"
+
+// prefix sums of count weights starting at offset, normalized to end at 1;
+// a row without weight gets a uniform CDF. Returns the sum.
+static double normalizeCdf(std::vector<float> &cdf, uint32_t offset,
+                           uint32_t count, const std::vector<double> &weights)
+{
+    double sum = 0.0;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        sum += weights[i];
+    }
+
+    double prefixSum = 0.0;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        prefixSum += weights[i];
+        cdf[offset + i] = sum > 0.0 ? (float)(prefixSum / sum)
+                                    : (float)(i + 1) / count;
+    }
+
+    // no rounding may leave u in [0, 1) past the last entry
+    cdf[offset + count - 1] = 1.0f;
+    return sum;
+}
+
+std::vector<float> buildEnvironmentDistribution(
+    const std::vector<unsigned char *> &faceData, int width, int height,
+    uint32_t resolution)
+{
+    // the cubemap is sampled as sRGB
+    float linearTable[256];
+    for (int i = 0; i < 256; i++)
+    {
+        float value = i / 255.0f;
+        linearTable[i] = value <= 0.04045f
+                             ? value / 12.92f
+                             : powf((value + 0.055f) / 1.055f, 2.4f);
+    }
+
+    uint32_t rowCount = 6 * resolution;
+    std::vector<float> distribution(rowCount + rowCount * resolution);
+    std::vector<double> rowWeights(rowCount);
+    std::vector<double> cellWeights(resolution);
+
+    for (uint32_t row = 0; row < rowCount; row++)
+    {
+        const unsigned char *face = faceData[row / resolution];
+        uint32_t y = row % resolution;
+
+        int firstTexelY = y * height / resolution;
+        int lastTexelY = std::max((int)((y + 1) * height / resolution),
+                                  firstTexelY + 1);
+
+        for (uint32_t x = 0; x < resolution; x++)
+        {
+            int firstTexelX = x * width / resolution;
+            int lastTexelX = std::max((int)((x + 1) * width / resolution),
+                                      firstTexelX + 1);
+
+            double luminance = 0.0;
+            for (int texelY = firstTexelY; texelY < lastTexelY; texelY++)
+            {
+                for (int texelX = firstTexelX; texelX < lastTexelX; texelX++)
+                {
+                    const unsigned char *texel =
+                        &face[4 * (texelY * width + texelX)];
+                    luminance += 0.2126f * linearTable[texel[0]] +
+                                 0.7152f * linearTable[texel[1]] +
+                                 0.0722f * linearTable[texel[2]];
+                }
+            }
+            luminance /= (lastTexelY - firstTexelY) * (lastTexelX - firstTexelX);
+
+            // solid angle of the cell on the face at distance 1
+            double u = 2.0 * (x + 0.5) / resolution - 1.0;
+            double v = 2.0 * (y + 0.5) / resolution - 1.0;
+            double cellArea = 4.0 / ((double)resolution * resolution);
+            double solidAngle = cellArea / pow(1.0 + u * u + v * v, 1.5);
+
+            cellWeights[x] = luminance * solidAngle;
+        }
+
+        rowWeights[row] = normalizeCdf(distribution, rowCount + row * resolution,
+                                       resolution, cellWeights);
+    }
+
+    normalizeCdf(distribution, 0, rowCount, rowWeights);
+    return distribution;
+}
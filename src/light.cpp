@@ -0,0 +1,160 @@
+#include <math.h>
+
+#include "light.h"
+
+static float getLuminance(const glm::vec3 &color)
+{
+    return 0.2126f * color.x + 0.7152f * color.y + 0.0722f * color.z;
+}
+
+static void copyVector(float destination[3], const glm::vec3 &source)
+{
+    destination[0] = source.x;
+    destination[1] = source.y;
+    destination[2] = source.z;
+}
+
+uint32_t LightLibrary::addLight(const Light &light, float power)
+{
+    lights.push_back(light);
+    powers.push_back(power);
+    return (uint32_t)lights.size() - 1;
+}
+
+uint32_t LightLibrary::addPointLight(const glm::vec3 &position,
+                                     const glm::vec3 &intensity)
+{
+    Light light = {};
+    light.type = 0;
+    copyVector(light.position, position);
+    copyVector(light.emission, intensity);
+
+    return addLight(light, 4.0f * M_PI * getLuminance(intensity));
+}
+
+uint32_t LightLibrary::addSpotLight(const glm::vec3 &position,
+                                    const glm::vec3 &direction,
+                                    const glm::vec3 &intensity,
+                                    float innerAngle, float outerAngle)
+{
+    Light light = {};
+    light.type = 1;
+    copyVector(light.position, position);
+    copyVector(light.direction, glm::normalize(direction));
+    copyVector(light.emission, intensity);
+    light.cosInnerAngle = cosf(innerAngle);
+    light.cosOuterAngle = cosf(outerAngle);
+
+    // solid angle of the cone halfway through the falloff
+    float cosMiddleAngle = 0.5f * (light.cosInnerAngle + light.cosOuterAngle);
+    return addLight(light, 2.0f * M_PI * (1.0f - cosMiddleAngle) *
+                               getLuminance(intensity));
+}
+
+uint32_t LightLibrary::addAreaLight(const glm::vec3 &corner,
+                                    const glm::vec3 &edge0,
+                                    const glm::vec3 &edge1,
+                                    const glm::vec3 &radiance)
+{
+    Light light = {};
+    light.type = 2;
+    copyVector(light.position, corner);
+    copyVector(light.direction, edge0);
+    copyVector(light.edge, edge1);
+    copyVector(light.emission, radiance);
+
+    float area = glm::length(glm::cross(edge0, edge1));
+    return addLight(light, M_PI * area * getLuminance(radiance));
+}
+
+uint32_t LightLibrary::addEmissiveMesh(const Mesh &mesh,
+                                       const glm::mat4 &transform,
+                                       const glm::vec3 &radiance)
+{
+    uint32_t lightCount = 0;
+
+    for (uint32_t i = 0; i < mesh.primitiveCount; i++)
+    {
+        glm::vec3 vertexPositions[3];
+        for (uint32_t j = 0; j < 3; j++)
+        {
+            const float *vertex =
+                &mesh.vertices[MESH_VERTEX_STRIDE * mesh.indices[3 * i + j]];
+            vertexPositions[j] = glm::vec3(
+                transform * glm::vec4(vertex[0], vertex[1], vertex[2], 1.0f));
+        }
+
+        glm::vec3 edge0 = vertexPositions[1] - vertexPositions[0];
+        glm::vec3 edge1 = vertexPositions[2] - vertexPositions[0];
+        float area = 0.5f * glm::length(glm::cross(edge0, edge1));
+        if (area == 0.0f)
+        {
+            continue;
+        }
+
+        Light light = {};
+        light.type = 3;
+        copyVector(light.position, vertexPositions[0]);
+        copyVector(light.direction, edge0);
+        copyVector(light.edge, edge1);
+        copyVector(light.emission, radiance);
+
+        addLight(light, M_PI * area * getLuminance(radiance));
+        lightCount++;
+    }
+
+    return lightCount;
+}
+
+// Vose's alias method: every bucket holds the remainder of one light below
+// the average power and the index of a light above it that fills it up
+void LightLibrary::buildAliasTable()
+{
+    uint32_t lightCount = (uint32_t)lights.size();
+
+    float totalPower = 0.0f;
+    for (uint32_t i = 0; i < lightCount; i++)
+    {
+        totalPower += powers[i];
+    }
+
+    std::vector<float> scaledPdfs(lightCount);
+    std::vector<uint32_t> smallIndices;
+    std::vector<uint32_t> largeIndices;
+    for (uint32_t i = 0; i < lightCount; i++)
+    {
+        lights[i].selectionPdf = totalPower > 0.0f ? powers[i] / totalPower
+                                                   : 1.0f / lightCount;
+        lights[i].aliasProbability = 1.0f;
+        lights[i].aliasIndex = i;
+
+        scaledPdfs[i] = lights[i].selectionPdf * lightCount;
+        if (scaledPdfs[i] < 1.0f)
+        {
+            smallIndices.push_back(i);
+        }
+        else
+        {
+            largeIndices.push_back(i);
+        }
+    }
+
+    while (!smallIndices.empty() && !largeIndices.empty())
+    {
+        uint32_t smallIndex = smallIndices.back();
+        smallIndices.pop_back();
+        uint32_t largeIndex = largeIndices.back();
+
+        lights[smallIndex].aliasProbability = scaledPdfs[smallIndex];
+        lights[smallIndex].aliasIndex = largeIndex;
+
+        scaledPdfs[largeIndex] -= 1.0f - scaledPdfs[smallIndex];
+        if (scaledPdfs[largeIndex] < 1.0f)
+        {
+            largeIndices.pop_back();
+            smallIndices.push_back(largeIndex);
+        }
+    }
+
+    // the buckets left over are full up to rounding
+}
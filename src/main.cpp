@@ -1,6 +1,3 @@
-#define TINYOBJLOADER_IMPLEMENTATION
-#include "tiny_obj_loader.h"
-
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
@@ -14,6 +11,9 @@
 #include <iostream>
 #include <vector>
 #include <chrono>
+#include <thread>
+#include <algorithm>
+#include <random>
 
 #define STRING_RESET "\033[0m"
 #define STRING_INFO "\033[37m"
@@ -24,12 +24,19 @@
 
 #include "config.h"
 #include "camera.h"
+#include "mesh_registry.h"
+#include "material.h"
+#include "light.h"
+#include "environment_map.h"
+#include "mesh_processing.h"
+#include "sampler.h"
 
 static char keyDownIndex[500];
 
 static double previousMousePositionX;
 static double previousMousePositionY;
 static bool cameraMoving = false;
+static bool isFramebufferResized = false;
 
 Camera camera;
 
@@ -43,39 +50,167 @@ PFN_vkGetAccelerationStructureDeviceAddressKHR pvkGetAccelerationStructureDevice
 PFN_vkCmdBuildAccelerationStructuresKHR pvkCmdBuildAccelerationStructuresKHR;
 PFN_vkGetRayTracingShaderGroupHandlesKHR pvkGetRayTracingShaderGroupHandlesKHR;
 PFN_vkCmdTraceRaysKHR pvkCmdTraceRaysKHR;
+PFN_vkCmdTraceRaysIndirectKHR pvkCmdTraceRaysIndirectKHR;
+PFN_vkCmdWriteAccelerationStructuresPropertiesKHR pvkCmdWriteAccelerationStructuresPropertiesKHR;
+PFN_vkCmdCopyAccelerationStructureKHR pvkCmdCopyAccelerationStructureKHR;
 
 //globals
 VkPhysicalDeviceMemoryProperties physicalDeviceMemoryProperties;
 VkDevice deviceHandle;
 
-void parseFile( tinyobj::ObjReaderConfig& reader_config, tinyobj::ObjReader& reader, const char * fileName){
-  
-  if (!reader.ParseFromFile(fileName, reader_config)) {
-    if (!reader.Error().empty()) {
-      std::cerr << "TinyObjReader: " << reader.Error();
-    }
-    exit(1);
+// stage of the trace shaders in barriers, the compute stage on a device
+// that only traces with ray queries
+VkPipelineStageFlags rayTracingShaderStageMask =
+    VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR;
+
+/*
+    BLAS build policies:
+    0 - static: never updated, built for fast tracing and compacted
+    1 - rarely changing: built for fast tracing, can be updated or rebuilt
+    2 - deforming: built fast, updated every frame
+*/
+enum BLASBuildPolicy
+{
+  BLAS_BUILD_POLICY_STATIC,
+  BLAS_BUILD_POLICY_RARELY_CHANGING,
+  BLAS_BUILD_POLICY_DEFORMING,
+  BLAS_BUILD_POLICY_COUNT
+};
+
+const char *getBLASBuildPolicyName(uint32_t policy)
+{
+  switch (policy) {
+    case BLAS_BUILD_POLICY_STATIC: return "static";
+    case BLAS_BUILD_POLICY_RARELY_CHANGING: return "rarely changing";
+    case BLAS_BUILD_POLICY_DEFORMING: return "deforming";
+  }
+  return "unknown";
+}
+
+VkBuildAccelerationStructureFlagsKHR getBLASBuildFlags(uint32_t policy)
+{
+  switch (policy) {
+    case BLAS_BUILD_POLICY_STATIC:
+      return VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR |
+             VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_COMPACTION_BIT_KHR;
+    case BLAS_BUILD_POLICY_RARELY_CHANGING:
+      return VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR |
+             VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR;
+    default:
+      return VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_BUILD_BIT_KHR |
+             VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR;
+  }
+}
+
+// TLAS instance masks (staticInstanceMask, movingInstanceMask and the LOD
+// masks in src/path_tracing.glsl); the shadow cache only traces the moving
+// instances again, the camera rays trace the primary LOD of every instance
+// and the rays after the first bounce the secondary one
+const uint32_t STATIC_INSTANCE_MASK = 0x05;
+const uint32_t MOVING_INSTANCE_MASK = 0x0A;
+const uint32_t PRIMARY_LOD_INSTANCE_MASK = 0x03;
+const uint32_t SECONDARY_LOD_INSTANCE_MASK = 0x0C;
+
+// low bits of the TLAS instance custom index that hold the LOD, above them
+// is the scene instance index (lodIndexBits in src/path_tracing.glsl)
+const uint32_t MESH_LOD_INDEX_BITS = 2;
+
+/*
+    Trace time breakdown categories, one per trace launch:
+    primary   - camera rays (first wavefront wave)
+    secondary - continued paths (later wavefront waves)
+    shadow    - shadow rays (wavefront shadow kernel, megakernel shadow batch)
+    paths     - megakernel, primary and secondary rays traced together
+*/
+enum TraceCategory
+{
+  TRACE_CATEGORY_PRIMARY,
+  TRACE_CATEGORY_SECONDARY,
+  TRACE_CATEGORY_SHADOW,
+  TRACE_CATEGORY_PATHS,
+  TRACE_CATEGORY_COUNT
+};
+
+const char *getTraceCategoryName(uint32_t category)
+{
+  switch (category) {
+    case TRACE_CATEGORY_PRIMARY: return "primary";
+    case TRACE_CATEGORY_SECONDARY: return "secondary";
+    case TRACE_CATEGORY_SHADOW: return "shadow";
+    case TRACE_CATEGORY_PATHS: return "paths";
   }
+  return "unknown";
+}
 
-  if (!reader.Warning().empty()) {
-    std::cout << "TinyObjReader: " << reader.Warning();
+// Brackets one trace launch with a pair of timestamps after the previous
+// launch of the command buffer; the launches are separated by barriers, so
+// the difference is the time spent in the launch. Pairs start at the fourth
+// query of the command buffer.
+void writeTraceLaunchTimestamp(VkCommandBuffer commandBufferHandle,
+                               VkQueryPool queryPoolHandle, uint32_t firstQuery,
+                               std::vector<uint32_t> &traceLaunchCategoryList,
+                               uint32_t category, bool isLaunchEnd) {
+  if (!isLaunchEnd) {
+    traceLaunchCategoryList.push_back(category);
   }
+
+  uint32_t launchIndex = (uint32_t)traceLaunchCategoryList.size() - 1;
+  vkCmdWriteTimestamp(commandBufferHandle, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                      queryPoolHandle,
+                      firstQuery + 3 + 2 * launchIndex + (isLaunchEnd ? 1 : 0));
+}
+
+glm::mat4 getOrbitingTransform(float timeParam, uint32_t instanceIndex)
+{
+  // instances share the orbit, evenly spaced in phase
+  float phase = 2.0f * M_PI * instanceIndex / ORBITING_MESH_INSTANCE_COUNT;
+
+  return glm::translate(
+    glm::rotate(
+        glm::translate(glm::mat4(1), glm::vec3(0, 0, -5)), 
+        float(timeParam *M_PI) + phase, 
+        glm::vec3(0, 1.0f, 0)), 
+    glm::vec3(0.0f, 0.0f, 10.0f));
 }
 
-void printFps()
+void printFps(double traceTime, const std::vector<double>& traceTimeBreakdown,
+              double frameLatency)
 {
     static double lastFpsMeasureTime = 0;
     static int nbFrames = 0;
+    static double totalTraceTime = 0;
+    static std::vector<double> totalTraceTimeBreakdown(TRACE_CATEGORY_COUNT, 0);
+    static double totalFrameLatency = 0;
 
     double currentTime = glfwGetTime();
     double delta = currentTime - lastFpsMeasureTime;
     nbFrames++;
+    totalTraceTime += traceTime;
+    for (uint32_t i = 0; i < TRACE_CATEGORY_COUNT; i++) {
+      totalTraceTimeBreakdown[i] += traceTimeBreakdown[i];
+    }
+    totalFrameLatency += frameLatency;
     if (delta >= 1.0)
     {
       double fps = ((double)(nbFrames)) / delta;
-      std::cout << "FPS: " << fps << std::endl;
+      std::cout << "FPS: " << fps << ", trace time: "
+                << totalTraceTime / nbFrames << " ms";
+
+      // only the categories the backend traces
+      for (uint32_t i = 0; i < TRACE_CATEGORY_COUNT; i++) {
+        if (totalTraceTimeBreakdown[i] > 0) {
+          std::cout << ", " << getTraceCategoryName(i) << ": "
+                    << totalTraceTimeBreakdown[i] / nbFrames << " ms";
+        }
+      }
+
+      std::cout << ", latency: " << totalFrameLatency / nbFrames << " ms"
+                << std::endl;
 
       nbFrames = 0;
+      totalTraceTime = 0;
+      std::fill(totalTraceTimeBreakdown.begin(), totalTraceTimeBreakdown.end(), 0);
+      totalFrameLatency = 0;
       lastFpsMeasureTime = currentTime;
     }
 }
@@ -109,6 +244,11 @@ void mouseButtonCallback(GLFWwindow *window, int button, int action, int mods)
       }
 }
 
+void framebufferSizeCallback(GLFWwindow *window, int width, int height)
+{
+  isFramebufferResized = true;
+}
+
 VkBool32
 debugCallback(VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity,
               VkDebugUtilsMessageTypeFlagsEXT messageTypes,
@@ -218,6 +358,11 @@ void copyData(VkDeviceMemory &deviceMemoryHandle,
   vkUnmapMemory(deviceHandle, deviceMemoryHandle);
 }
 
+VkDeviceSize alignUp(VkDeviceSize size, VkDeviceSize alignment)
+{
+  return (size + alignment - 1) / alignment * alignment;
+}
+
 void createBuffer(VkBuffer& bufferHandle,
   VkDeviceSize bufferSize,
   VkBufferUsageFlags usageFlags,
@@ -305,7 +450,11 @@ void buildBuffer(VkBuffer& bufferHandle,
 void createBLASGeometry(VkAccelerationStructureGeometryKHR& bottomLevelAccelerationStructureGeometry,
   VkDeviceAddress vertexBufferDeviceAddress,
   VkDeviceAddress indexBufferDeviceAddress,
-  const tinyobj::attrib_t& attrib)
+  uint32_t vertexCount,
+  VkFormat vertexFormat = VK_FORMAT_R32G32B32_SFLOAT,
+  VkDeviceSize vertexStride = sizeof(float) * MESH_VERTEX_STRIDE,
+  VkDeviceAddress transformDeviceAddress = 0,
+  VkIndexType indexType = VK_INDEX_TYPE_UINT32)
 {
 
   VkAccelerationStructureGeometryDataKHR
@@ -314,13 +463,13 @@ void createBLASGeometry(VkAccelerationStructureGeometryKHR& bottomLevelAccelerat
               .sType =
                   VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_TRIANGLES_DATA_KHR,
               .pNext = NULL,
-              .vertexFormat = VK_FORMAT_R32G32B32_SFLOAT,
+              .vertexFormat = vertexFormat,
               .vertexData = {.deviceAddress = vertexBufferDeviceAddress},
-              .vertexStride = sizeof(float) * 6,
-              .maxVertex = (uint32_t)attrib.vertices.size(),
-              .indexType = VK_INDEX_TYPE_UINT32,
+              .vertexStride = vertexStride,
+              .maxVertex = vertexCount,
+              .indexType = indexType,
               .indexData = {.deviceAddress = indexBufferDeviceAddress},
-              .transformData = {.deviceAddress = 0}}};
+              .transformData = {.deviceAddress = transformDeviceAddress}}};
 
   bottomLevelAccelerationStructureGeometry =
       {.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_KHR,
@@ -337,7 +486,8 @@ void createBLAS(VkAccelerationStructureKHR& bottomLevelAccelerationStructureHand
   VkBuffer& bottomLevelAccelerationStructureBufferHandle,
   VkDeviceMemory& bottomLevelAccelerationStructureDeviceMemoryHandle,
   VkAccelerationStructureBuildSizesInfoKHR& bottomLevelAccelerationStructureBuildSizesInfo,
-  VkAccelerationStructureBuildGeometryInfoKHR& bottomLevelAccelerationStructureBuildGeometryInfo
+  VkAccelerationStructureBuildGeometryInfoKHR& bottomLevelAccelerationStructureBuildGeometryInfo,
+  VkBuildAccelerationStructureFlagsKHR buildFlags
   )
 {
   VkResult result;
@@ -347,7 +497,7 @@ void createBLAS(VkAccelerationStructureKHR& bottomLevelAccelerationStructureHand
         VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR,
     .pNext = NULL,
     .type = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR,
-    .flags = VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR,
+    .flags = buildFlags,
     .mode = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR,
     .srcAccelerationStructure = VK_NULL_HANDLE,
     .dstAccelerationStructure = VK_NULL_HANDLE,
@@ -429,9 +579,11 @@ void createBLASScratchBuffer(VkBuffer& bottomLevelAccelerationStructureScratchBu
       pvkGetAccelerationStructureDeviceAddressKHR(
           deviceHandle, &bottomLevelAccelerationStructureDeviceAddressInfo);
 
+  // kept after the initial build for in-place updates and rebuilds
   bottomLevelAccelerationStructureScratchBufferHandle = VK_NULL_HANDLE;
   createBuffer(bottomLevelAccelerationStructureScratchBufferHandle,
-    bottomLevelAccelerationStructureBuildSizesInfo.buildScratchSize,
+    std::max(bottomLevelAccelerationStructureBuildSizesInfo.buildScratchSize,
+             bottomLevelAccelerationStructureBuildSizesInfo.updateScratchSize),
       VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
       VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
     queueFamilyIndex);
@@ -535,1017 +687,2846 @@ void buildBLAS(VkCommandBuffer& commandBufferHandle,
 
 }
 
-void createInstance(VkAccelerationStructureInstanceKHR& bottomLevelAccelerationStructureInstance,
-   VkDeviceAddress& bottomLevelAccelerationStructureDeviceAddress,
-  VkTransformMatrixKHR& transformMatrix,
-  uint32_t objIndex)
-{
-  bottomLevelAccelerationStructureInstance =
-  {.transform = transformMatrix,
-    .instanceCustomIndex = objIndex,
-    .mask = 0xFF,
-    .instanceShaderBindingTableRecordOffset = 0, 
-    .flags = VK_GEOMETRY_INSTANCE_TRIANGLE_FACING_CULL_DISABLE_BIT_KHR,
-    .accelerationStructureReference =
-        bottomLevelAccelerationStructureDeviceAddress};
-}
-
-  
-
-void createTLAS(VkAccelerationStructureKHR& topLevelAccelerationStructureHandle,
-  std::vector<VkAccelerationStructureInstanceKHR>& bottomLevelAccelerationStructureInstance,
-  uint32_t& queueFamilyIndex,
-  VkMemoryAllocateFlagsInfo memoryAllocateFlagsInfo,
-  VkBuffer& topLevelAccelerationStructureBufferHandle,
-  VkDeviceMemory& topLevelAccelerationStructureDeviceMemoryHandle,
-  VkCommandBuffer& commandBufferHandle,
-  VkQueue& queueHandle,
+// Records a BLAS build (or in-place update) into a command buffer in the
+// recording state, reusing the scratch buffer of the initial build.
+void recordBLASBuild(VkCommandBuffer& commandBufferHandle,
+  VkAccelerationStructureBuildRangeInfoKHR& bottomLevelAccelerationStructureBuildRangeInfo,
+  VkAccelerationStructureBuildGeometryInfoKHR bottomLevelAccelerationStructureBuildGeometryInfo,
   bool update)
 {
-  VkResult result;
+  bottomLevelAccelerationStructureBuildGeometryInfo.mode = update ?
+    VK_BUILD_ACCELERATION_STRUCTURE_MODE_UPDATE_KHR :
+    VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR;
 
-  // create a buffer including all instances
-  VkBuffer bottomLevelGeometryInstanceBufferHandle = VK_NULL_HANDLE;
-  VkDeviceMemory bottomLevelGeometryInstanceDeviceMemoryHandle = VK_NULL_HANDLE;
-  VkDeviceAddress bottomLevelGeometryInstanceDeviceAddress;
+  bottomLevelAccelerationStructureBuildGeometryInfo.srcAccelerationStructure =
+    update ? bottomLevelAccelerationStructureBuildGeometryInfo.dstAccelerationStructure
+           : VK_NULL_HANDLE;
 
-  buildBuffer(bottomLevelGeometryInstanceBufferHandle, 
-    sizeof(VkAccelerationStructureInstanceKHR) * bottomLevelAccelerationStructureInstance.size(),
-    queueFamilyIndex,
-    (void*) bottomLevelAccelerationStructureInstance.data(),
-      VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR |
-      VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
-    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
-    &memoryAllocateFlagsInfo,
-    bottomLevelGeometryInstanceDeviceMemoryHandle,
-    bottomLevelGeometryInstanceDeviceAddress);
+  const VkAccelerationStructureBuildRangeInfoKHR
+    *bottomLevelAccelerationStructureBuildRangeInfos =
+        &bottomLevelAccelerationStructureBuildRangeInfo;
 
-  VkAccelerationStructureGeometryDataKHR topLevelAccelerationStructureGeometryData =
-    {.instances = {
-          .sType =
-              VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_INSTANCES_DATA_KHR,
-          .pNext = NULL,
-          .arrayOfPointers = VK_FALSE,
-          .data = {.deviceAddress =
-                      bottomLevelGeometryInstanceDeviceAddress}}};
+  pvkCmdBuildAccelerationStructuresKHR(
+    commandBufferHandle, 1,
+    &bottomLevelAccelerationStructureBuildGeometryInfo,
+    &bottomLevelAccelerationStructureBuildRangeInfos);
+}
 
-  VkAccelerationStructureGeometryKHR topLevelAccelerationStructureGeometry = {
-    .sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_KHR,
-    .pNext = NULL,
-    .geometryType = VK_GEOMETRY_TYPE_INSTANCES_KHR,
-    .geometry = topLevelAccelerationStructureGeometryData,
-    .flags = VK_GEOMETRY_OPAQUE_BIT_KHR};
-  
-  VkAccelerationStructureBuildGeometryInfoKHR
-    topLevelAccelerationStructureBuildGeometryInfo = {
-        .sType =
-            VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR,
-        .pNext = NULL,
-        .type = VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR,
-        .flags =  VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR,
-        .mode = update ? 
-          VK_BUILD_ACCELERATION_STRUCTURE_MODE_UPDATE_KHR : 
-          VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR,
-        .srcAccelerationStructure = VK_NULL_HANDLE,
-        .dstAccelerationStructure = VK_NULL_HANDLE,
-        .geometryCount = 1,
-        .pGeometries = &topLevelAccelerationStructureGeometry,
-        .ppGeometries = NULL,
-          .scratchData = {.deviceAddress = 0}};
+void queryCompactedBLASSize(std::vector<VkDeviceSize>& compactedSizeList,
+  std::vector<VkAccelerationStructureKHR>& bottomLevelAccelerationStructureHandleList,
+  VkCommandBuffer& commandBufferHandle,
+  VkQueue& queueHandle)
+{
+  uint32_t accelerationStructureCount =
+    bottomLevelAccelerationStructureHandleList.size();
 
-  VkAccelerationStructureBuildSizesInfoKHR
-  topLevelAccelerationStructureBuildSizesInfo = {
-      .sType =
-          VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_SIZES_INFO_KHR,
+  VkQueryPoolCreateInfo compactedSizeQueryPoolCreateInfo = {
+      .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
       .pNext = NULL,
-      .accelerationStructureSize = 0,
-      .updateScratchSize = 0,
-      .buildScratchSize = 0};
-  
-  uint32_t instanceCount =  (uint32_t) bottomLevelAccelerationStructureInstance.size();
-  std::vector<uint32_t> topLevelMaxPrimitiveCountList = { instanceCount };
+      .flags = 0,
+      .queryType = VK_QUERY_TYPE_ACCELERATION_STRUCTURE_COMPACTED_SIZE_KHR,
+      .queryCount = accelerationStructureCount,
+      .pipelineStatistics = 0};
 
-  pvkGetAccelerationStructureBuildSizesKHR(
-      deviceHandle, VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR,
-      &topLevelAccelerationStructureBuildGeometryInfo,
-      topLevelMaxPrimitiveCountList.data(),
-      &topLevelAccelerationStructureBuildSizesInfo);
-  
-  if(update == false){
-    topLevelAccelerationStructureBufferHandle = VK_NULL_HANDLE;
-    createBuffer(topLevelAccelerationStructureBufferHandle,
-      topLevelAccelerationStructureBuildSizesInfo.accelerationStructureSize,
-      VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_STORAGE_BIT_KHR, 
-      queueFamilyIndex);
+  VkQueryPool compactedSizeQueryPoolHandle = VK_NULL_HANDLE;
+  VkResult result = vkCreateQueryPool(deviceHandle,
+                                      &compactedSizeQueryPoolCreateInfo, NULL,
+                                      &compactedSizeQueryPoolHandle);
 
-    topLevelAccelerationStructureDeviceMemoryHandle = VK_NULL_HANDLE;
-    allocAndBind(topLevelAccelerationStructureDeviceMemoryHandle,
-      NULL,
-      topLevelAccelerationStructureBufferHandle,
-      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-    
-    VkAccelerationStructureCreateInfoKHR topLevelAccelerationStructureCreateInfo =
-        {.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_CREATE_INFO_KHR,
-        .pNext = NULL,
-        .createFlags = 0,
-        .buffer = topLevelAccelerationStructureBufferHandle,
-        .offset = 0,
-        .size = topLevelAccelerationStructureBuildSizesInfo
-                    .accelerationStructureSize,
-        .type = VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR,
-        .deviceAddress = 0};
-    
-    topLevelAccelerationStructureHandle = VK_NULL_HANDLE;
+  if (result != VK_SUCCESS) {
+    throwExceptionVulkanAPI(result, "vkCreateQueryPool");
+  }
 
-    result = pvkCreateAccelerationStructureKHR(
-        deviceHandle, &topLevelAccelerationStructureCreateInfo, NULL,
-        &topLevelAccelerationStructureHandle);
+  VkCommandBufferBeginInfo compactedSizeCommandBufferBeginInfo = {
+    .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+    .pNext = NULL,
+    .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+    .pInheritanceInfo = NULL};
 
-    if (result != VK_SUCCESS) {
-      throwExceptionVulkanAPI(result, "vkCreateAccelerationStructureKHR");
-    }
+  result = vkBeginCommandBuffer(commandBufferHandle,
+                                &compactedSizeCommandBufferBeginInfo);
 
+  if (result != VK_SUCCESS) {
+    throwExceptionVulkanAPI(result, "vkBeginCommandBuffer");
   }
-  
-  //----------------------build----------------------
-  
-  VkBuffer topLevelAccelerationStructureScratchBufferHandle = VK_NULL_HANDLE;
-  createBuffer(topLevelAccelerationStructureScratchBufferHandle,
-    topLevelAccelerationStructureBuildSizesInfo.buildScratchSize,
-      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
-      VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
-    queueFamilyIndex);
 
-  VkDeviceMemory topLevelAccelerationStructureDeviceScratchMemoryHandle =
-    VK_NULL_HANDLE;
+  vkCmdResetQueryPool(commandBufferHandle, compactedSizeQueryPoolHandle, 0,
+                      accelerationStructureCount);
 
-  allocAndBind(topLevelAccelerationStructureDeviceScratchMemoryHandle,
-    &memoryAllocateFlagsInfo,
-    topLevelAccelerationStructureScratchBufferHandle,
-    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-  
-  VkBufferDeviceAddressInfo
-    topLevelAccelerationStructureScratchBufferDeviceAddressInfo = {
-        .sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO,
-        .pNext = NULL,
-        .buffer = topLevelAccelerationStructureScratchBufferHandle};
+  VkMemoryBarrier accelerationStructureBuildMemoryBarrier = {
+      .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+      .pNext = NULL,
+      .srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR,
+      .dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR};
 
-  VkDeviceAddress topLevelAccelerationStructureScratchBufferDeviceAddress =
-      pvkGetBufferDeviceAddressKHR(
-          deviceHandle,
-          &topLevelAccelerationStructureScratchBufferDeviceAddressInfo);
+  vkCmdPipelineBarrier(commandBufferHandle,
+                       VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+                       VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+                       0, 1, &accelerationStructureBuildMemoryBarrier, 0,
+                       NULL, 0, NULL);
 
-  topLevelAccelerationStructureBuildGeometryInfo.dstAccelerationStructure =
-      topLevelAccelerationStructureHandle;
+  pvkCmdWriteAccelerationStructuresPropertiesKHR(
+      commandBufferHandle, accelerationStructureCount,
+      bottomLevelAccelerationStructureHandleList.data(),
+      VK_QUERY_TYPE_ACCELERATION_STRUCTURE_COMPACTED_SIZE_KHR,
+      compactedSizeQueryPoolHandle, 0);
 
-  topLevelAccelerationStructureBuildGeometryInfo.srcAccelerationStructure =
-    update ? topLevelAccelerationStructureHandle : VK_NULL_HANDLE;
+  result = vkEndCommandBuffer(commandBufferHandle);
 
-  topLevelAccelerationStructureBuildGeometryInfo.scratchData = {
-      .deviceAddress = topLevelAccelerationStructureScratchBufferDeviceAddress};
-  
-  VkAccelerationStructureBuildRangeInfoKHR
-    topLevelAccelerationStructureBuildRangeInfo = {.primitiveCount = instanceCount,
-                                                    .primitiveOffset = 0,
-                                                    .firstVertex = 0,
-                                                    .transformOffset = 0};
+  if (result != VK_SUCCESS) {
+    throwExceptionVulkanAPI(result, "vkEndCommandBuffer");
+  }
 
-  const VkAccelerationStructureBuildRangeInfoKHR
-      *topLevelAccelerationStructureBuildRangeInfos =
-          &topLevelAccelerationStructureBuildRangeInfo;
+  VkFenceCreateInfo compactedSizeFenceCreateInfo = {
+  .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO, .pNext = NULL, .flags = 0};
 
-  VkCommandBufferBeginInfo topLevelCommandBufferBeginInfo = {
-      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+  VkFence compactedSizeFenceHandle = VK_NULL_HANDLE;
+  result = vkCreateFence(deviceHandle, &compactedSizeFenceCreateInfo, NULL,
+                         &compactedSizeFenceHandle);
+
+  if (result != VK_SUCCESS) {
+    throwExceptionVulkanAPI(result, "vkCreateFence");
+  }
+
+  VkSubmitInfo compactedSizeSubmitInfo = {
+      .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
       .pNext = NULL,
-      .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
-      .pInheritanceInfo = NULL};
+      .waitSemaphoreCount = 0,
+      .pWaitSemaphores = NULL,
+      .pWaitDstStageMask = NULL,
+      .commandBufferCount = 1,
+      .pCommandBuffers = &commandBufferHandle,
+      .signalSemaphoreCount = 0,
+      .pSignalSemaphores = NULL};
 
-  result = vkBeginCommandBuffer(commandBufferHandle,
-                              &topLevelCommandBufferBeginInfo);
+  result = vkQueueSubmit(queueHandle, 1, &compactedSizeSubmitInfo,
+                         compactedSizeFenceHandle);
 
   if (result != VK_SUCCESS) {
-    throwExceptionVulkanAPI(result, "vkBeginCommandBuffer");
+    throwExceptionVulkanAPI(result, "vkQueueSubmit");
   }
 
-  pvkCmdBuildAccelerationStructuresKHR(
-    commandBufferHandle, 1,
-    &topLevelAccelerationStructureBuildGeometryInfo,
-    &topLevelAccelerationStructureBuildRangeInfos);
+  result = vkWaitForFences(deviceHandle, 1, &compactedSizeFenceHandle, true,
+                           UINT32_MAX);
 
-  result = vkEndCommandBuffer(commandBufferHandle);
+  if (result != VK_SUCCESS && result != VK_TIMEOUT) {
+    throwExceptionVulkanAPI(result, "vkWaitForFences");
+  }
+
+  compactedSizeList.resize(accelerationStructureCount);
+  result = vkGetQueryPoolResults(
+      deviceHandle, compactedSizeQueryPoolHandle, 0, accelerationStructureCount,
+      sizeof(VkDeviceSize) * accelerationStructureCount,
+      compactedSizeList.data(), sizeof(VkDeviceSize),
+      VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
 
   if (result != VK_SUCCESS) {
-    throwExceptionVulkanAPI(result, "vkEndCommandBuffer");
+    throwExceptionVulkanAPI(result, "vkGetQueryPoolResults");
   }
 
-  VkSubmitInfo topLevelAccelerationStructureBuildSubmitInfo = {
-    .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-    .pNext = NULL,
-    .waitSemaphoreCount = 0,
-    .pWaitSemaphores = NULL,
-    .pWaitDstStageMask = NULL,
-    .commandBufferCount = 1,
-    .pCommandBuffers = &commandBufferHandle,
-    .signalSemaphoreCount = 0,
-    .pSignalSemaphores = NULL};
-  
-  VkFenceCreateInfo topLevelAccelerationStructureBuildFenceCreateInfo = {
+  vkDestroyFence(deviceHandle, compactedSizeFenceHandle, NULL);
+  vkDestroyQueryPool(deviceHandle, compactedSizeQueryPoolHandle, NULL);
+}
+
+void submitAndWait(VkCommandBuffer& commandBufferHandle,
+  VkQueue& queueHandle,
+  VkSemaphore waitSemaphoreHandle = VK_NULL_HANDLE,
+  VkPipelineStageFlags waitStageFlags = 0,
+  VkSemaphore signalSemaphoreHandle = VK_NULL_HANDLE)
+{
+  VkSubmitInfo submitInfo = {
+      .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+      .pNext = NULL,
+      .waitSemaphoreCount = waitSemaphoreHandle != VK_NULL_HANDLE ? 1u : 0u,
+      .pWaitSemaphores = &waitSemaphoreHandle,
+      .pWaitDstStageMask = &waitStageFlags,
+      .commandBufferCount = 1,
+      .pCommandBuffers = &commandBufferHandle,
+      .signalSemaphoreCount = signalSemaphoreHandle != VK_NULL_HANDLE ? 1u : 0u,
+      .pSignalSemaphores = &signalSemaphoreHandle};
+
+  VkFenceCreateInfo fenceCreateInfo = {
     .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO, .pNext = NULL, .flags = 0};
-  
-  VkFence topLevelAccelerationStructureBuildFenceHandle = VK_NULL_HANDLE;
-    result = vkCreateFence(deviceHandle,
-                          &topLevelAccelerationStructureBuildFenceCreateInfo,
-                          NULL, &topLevelAccelerationStructureBuildFenceHandle);
+
+  VkFence fenceHandle = VK_NULL_HANDLE;
+  VkResult result = vkCreateFence(deviceHandle, &fenceCreateInfo, NULL,
+                                  &fenceHandle);
 
   if (result != VK_SUCCESS) {
     throwExceptionVulkanAPI(result, "vkCreateFence");
   }
 
-  result = vkQueueSubmit(queueHandle, 1,
-                         &topLevelAccelerationStructureBuildSubmitInfo,
-                         topLevelAccelerationStructureBuildFenceHandle);
+  result = vkQueueSubmit(queueHandle, 1, &submitInfo, fenceHandle);
 
   if (result != VK_SUCCESS) {
     throwExceptionVulkanAPI(result, "vkQueueSubmit");
   }
 
-  result = vkWaitForFences(deviceHandle, 1,
-                           &topLevelAccelerationStructureBuildFenceHandle, true,
-                           UINT32_MAX);
+  result = vkWaitForFences(deviceHandle, 1, &fenceHandle, true, UINT32_MAX);
 
   if (result != VK_SUCCESS && result != VK_TIMEOUT) {
     throwExceptionVulkanAPI(result, "vkWaitForFences");
   }
 
-  //free resources
-  vkDestroyFence(deviceHandle, topLevelAccelerationStructureBuildFenceHandle,
-                NULL);
+  vkDestroyFence(deviceHandle, fenceHandle, NULL);
+}
 
-  vkDestroyBuffer(deviceHandle, topLevelAccelerationStructureScratchBufferHandle, NULL);
+// Replaces a BLAS built with ALLOW_COMPACTION by a copy of its compacted
+// size and frees the original.
+void compactBLAS(VkAccelerationStructureKHR& bottomLevelAccelerationStructureHandle,
+  VkBuffer& bottomLevelAccelerationStructureBufferHandle,
+  VkDeviceMemory& bottomLevelAccelerationStructureDeviceMemoryHandle,
+  VkDeviceAddress& bottomLevelAccelerationStructureDeviceAddress,
+  VkDeviceSize compactedSize,
+  uint32_t& queueFamilyIndex,
+  VkCommandBuffer& commandBufferHandle,
+  VkQueue& queueHandle)
+{
+  VkBuffer compactedBufferHandle = VK_NULL_HANDLE;
+  createBuffer(compactedBufferHandle,
+    compactedSize,
+    VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_STORAGE_BIT_KHR,
+    queueFamilyIndex);
 
-  vkFreeMemory(deviceHandle, topLevelAccelerationStructureDeviceScratchMemoryHandle,
-               NULL);
+  VkDeviceMemory compactedDeviceMemoryHandle = VK_NULL_HANDLE;
+  allocAndBind(compactedDeviceMemoryHandle,
+    NULL,
+    compactedBufferHandle,
+    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
-  vkDestroyBuffer(deviceHandle, bottomLevelGeometryInstanceBufferHandle, NULL);
+  VkAccelerationStructureCreateInfoKHR compactedAccelerationStructureCreateInfo = {
+      .sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_CREATE_INFO_KHR,
+      .pNext = NULL,
+      .createFlags = 0,
+      .buffer = compactedBufferHandle,
+      .offset = 0,
+      .size = compactedSize,
+      .type = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR,
+      .deviceAddress = 0};
+
+  VkAccelerationStructureKHR compactedAccelerationStructureHandle = VK_NULL_HANDLE;
+  VkResult result = pvkCreateAccelerationStructureKHR(
+      deviceHandle, &compactedAccelerationStructureCreateInfo, NULL,
+      &compactedAccelerationStructureHandle);
 
-  vkFreeMemory(deviceHandle, bottomLevelGeometryInstanceDeviceMemoryHandle,
-               NULL);
-}
+  if (result != VK_SUCCESS) {
+    throwExceptionVulkanAPI(result, "vkCreateAccelerationStructureKHR");
+  }
 
+  VkCommandBufferBeginInfo compactionCommandBufferBeginInfo = {
+    .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+    .pNext = NULL,
+    .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+    .pInheritanceInfo = NULL};
 
-int main() {
-  VkResult result;
+  result = vkBeginCommandBuffer(commandBufferHandle,
+                                &compactionCommandBufferBeginInfo);
 
-  // =========================================================================
-  // GLFW, Window
+  if (result != VK_SUCCESS) {
+    throwExceptionVulkanAPI(result, "vkBeginCommandBuffer");
+  }
 
-  glfwInit();
-  glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-  glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
-  GLFWwindow *windowPtr = glfwCreateWindow(800, 600, "Vulkan", NULL, NULL);
-  glfwSetInputMode(windowPtr, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
-  glfwSetKeyCallback(windowPtr, keyCallback);
-  glfwSetMouseButtonCallback(windowPtr, mouseButtonCallback);
+  VkCopyAccelerationStructureInfoKHR copyAccelerationStructureInfo = {
+      .sType = VK_STRUCTURE_TYPE_COPY_ACCELERATION_STRUCTURE_INFO_KHR,
+      .pNext = NULL,
+      .src = bottomLevelAccelerationStructureHandle,
+      .dst = compactedAccelerationStructureHandle,
+      .mode = VK_COPY_ACCELERATION_STRUCTURE_MODE_COMPACT_KHR};
 
-  // =========================================================================
-  // Vulkan Instance
+  pvkCmdCopyAccelerationStructureKHR(commandBufferHandle,
+                                     &copyAccelerationStructureInfo);
 
-#ifdef VALIDATION_LAYERS_ENABLED
-  std::vector<VkValidationFeatureEnableEXT> validationFeatureEnableList = {
-      VK_VALIDATION_FEATURE_ENABLE_BEST_PRACTICES_EXT,
-      VK_VALIDATION_FEATURE_ENABLE_DEBUG_PRINTF_EXT,
-      VK_VALIDATION_FEATURE_ENABLE_SYNCHRONIZATION_VALIDATION_EXT};
+  result = vkEndCommandBuffer(commandBufferHandle);
 
-  VkDebugUtilsMessageSeverityFlagBitsEXT debugUtilsMessageSeverityFlagBits =
-      (VkDebugUtilsMessageSeverityFlagBitsEXT)(
-          VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT |
-          VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT |
-          VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT |
-          VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT);
+  if (result != VK_SUCCESS) {
+    throwExceptionVulkanAPI(result, "vkEndCommandBuffer");
+  }
 
-  VkDebugUtilsMessageTypeFlagBitsEXT debugUtilsMessageTypeFlagBits =
-      (VkDebugUtilsMessageTypeFlagBitsEXT)(
-          VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT |
-          VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT |
-          VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT);
+  submitAndWait(commandBufferHandle, queueHandle);
 
-  VkValidationFeaturesEXT validationFeatures = {
-      .sType = VK_STRUCTURE_TYPE_VALIDATION_FEATURES_EXT,
-      .pNext = NULL,
-      .enabledValidationFeatureCount =
-          (uint32_t)validationFeatureEnableList.size(),
-      .pEnabledValidationFeatures = validationFeatureEnableList.data(),
-      .disabledValidationFeatureCount = 0,
-      .pDisabledValidationFeatures = NULL};
+  pvkDestroyAccelerationStructureKHR(deviceHandle,
+                                     bottomLevelAccelerationStructureHandle, NULL);
+  vkFreeMemory(deviceHandle, bottomLevelAccelerationStructureDeviceMemoryHandle,
+               NULL);
+  vkDestroyBuffer(deviceHandle, bottomLevelAccelerationStructureBufferHandle,
+                  NULL);
 
-  VkDebugUtilsMessengerCreateInfoEXT debugUtilsMessengerCreateInfo = {
-      .sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT,
-      .pNext = &validationFeatures,
-      .flags = 0,
-      .messageSeverity = debugUtilsMessageSeverityFlagBits,
-      .messageType = debugUtilsMessageTypeFlagBits,
-      .pfnUserCallback = &debugCallback,
-      .pUserData = NULL};
-#endif
+  bottomLevelAccelerationStructureHandle = compactedAccelerationStructureHandle;
+  bottomLevelAccelerationStructureBufferHandle = compactedBufferHandle;
+  bottomLevelAccelerationStructureDeviceMemoryHandle = compactedDeviceMemoryHandle;
 
-  VkApplicationInfo applicationInfo = {
-      .sType = VK_STRUCTURE_TYPE_APPLICATION_INFO,
+  VkAccelerationStructureDeviceAddressInfoKHR compactedDeviceAddressInfo = {
+      .sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_DEVICE_ADDRESS_INFO_KHR,
       .pNext = NULL,
-      .pApplicationName = "Ray Tracing Pipeline Example",
-      .applicationVersion = VK_MAKE_VERSION(1, 0, 0),
-      .pEngineName = "",
-      .engineVersion = VK_MAKE_VERSION(1, 0, 0),
-      .apiVersion = VK_API_VERSION_1_3};
+      .accelerationStructure = bottomLevelAccelerationStructureHandle};
 
-  std::vector<const char *> instanceLayerList = {
-#ifdef VALIDATION_LAYERS_ENABLED
-    "VK_LAYER_KHRONOS_validation"
-#endif
-  };
+  bottomLevelAccelerationStructureDeviceAddress =
+      pvkGetAccelerationStructureDeviceAddressKHR(deviceHandle,
+                                                  &compactedDeviceAddressInfo);
+}
 
-  uint32_t glfwExtensionCount = 0;
-  const char **glfwExtensions =
-      glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+// Builds a throwaway BLAS from the geometry with the flags of every build
+// policy and prints its GPU build time, size and compacted size.
+void benchmarkBLASBuildPolicies(VkAccelerationStructureGeometryKHR& bottomLevelAccelerationStructureGeometry,
+  VkAccelerationStructureBuildRangeInfoKHR& bottomLevelAccelerationStructureBuildRangeInfo,
+  uint32_t& queueFamilyIndex,
+  VkMemoryAllocateFlagsInfo& memoryAllocateFlagsInfo,
+  double timestampPeriod,
+  VkCommandBuffer& commandBufferHandle,
+  VkQueue& queueHandle)
+{
+  for (uint32_t policy = 0; policy < BLAS_BUILD_POLICY_COUNT; policy++) {
+    VkBuildAccelerationStructureFlagsKHR buildFlags = getBLASBuildFlags(policy);
+    bool allowCompaction =
+      buildFlags & VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_COMPACTION_BIT_KHR;
+
+    VkAccelerationStructureKHR accelerationStructureHandle;
+    VkBuffer bufferHandle;
+    VkDeviceMemory deviceMemoryHandle;
+    VkAccelerationStructureBuildSizesInfoKHR buildSizesInfo;
+    VkAccelerationStructureBuildGeometryInfoKHR buildGeometryInfo;
+    VkBuffer scratchBufferHandle;
+    VkDeviceMemory scratchDeviceMemoryHandle;
+    VkDeviceAddress deviceAddress;
+
+    createBLAS(accelerationStructureHandle,
+      bottomLevelAccelerationStructureGeometry,
+      bottomLevelAccelerationStructureBuildRangeInfo.primitiveCount,
+      queueFamilyIndex,
+      bufferHandle,
+      deviceMemoryHandle,
+      buildSizesInfo,
+      buildGeometryInfo,
+      buildFlags);
+
+    createBLASScratchBuffer(scratchBufferHandle,
+      accelerationStructureHandle,
+      deviceAddress,
+      buildSizesInfo,
+      queueFamilyIndex,
+      memoryAllocateFlagsInfo,
+      scratchDeviceMemoryHandle,
+      buildGeometryInfo);
 
-  std::vector<const char *> instanceExtensionList(
-      glfwExtensions, glfwExtensions + glfwExtensionCount);
+    VkQueryPoolCreateInfo timestampQueryPoolCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .queryType = VK_QUERY_TYPE_TIMESTAMP,
+        .queryCount = 2,
+        .pipelineStatistics = 0};
 
-  instanceExtensionList.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
-  instanceExtensionList.push_back("VK_KHR_surface");
+    VkQueryPool timestampQueryPoolHandle = VK_NULL_HANDLE;
+    VkResult result = vkCreateQueryPool(deviceHandle,
+                                        &timestampQueryPoolCreateInfo, NULL,
+                                        &timestampQueryPoolHandle);
 
-  VkInstanceCreateInfo instanceCreateInfo = {
-      .sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO,
-#ifdef VALIDATION_LAYERS_ENABLED
-      .pNext = &debugUtilsMessengerCreateInfo,
-#else
-      .pNext = NULL,
-#endif
-      .flags = 0,
-      .pApplicationInfo = &applicationInfo,
-      .enabledLayerCount = (uint32_t)instanceLayerList.size(),
-      .ppEnabledLayerNames = instanceLayerList.data(),
-      .enabledExtensionCount = (uint32_t)instanceExtensionList.size(),
-      .ppEnabledExtensionNames = instanceExtensionList.data(),
-  };
+    if (result != VK_SUCCESS) {
+      throwExceptionVulkanAPI(result, "vkCreateQueryPool");
+    }
 
-  VkInstance instanceHandle = VK_NULL_HANDLE;
-  result = vkCreateInstance(&instanceCreateInfo, NULL, &instanceHandle);
+    VkCommandBufferBeginInfo benchmarkCommandBufferBeginInfo = {
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+      .pNext = NULL,
+      .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+      .pInheritanceInfo = NULL};
 
-  if (result != VK_SUCCESS) {
-    throwExceptionVulkanAPI(result, "vkCreateInstance");
-  }
+    result = vkBeginCommandBuffer(commandBufferHandle,
+                                  &benchmarkCommandBufferBeginInfo);
 
-  // =========================================================================
-  // Window Surface
+    if (result != VK_SUCCESS) {
+      throwExceptionVulkanAPI(result, "vkBeginCommandBuffer");
+    }
 
-  VkSurfaceKHR surfaceHandle = VK_NULL_HANDLE;
-  result =
-      glfwCreateWindowSurface(instanceHandle, windowPtr, NULL, &surfaceHandle);
+    vkCmdResetQueryPool(commandBufferHandle, timestampQueryPoolHandle, 0, 2);
 
-  if (result != VK_SUCCESS) {
-    throwExceptionVulkanAPI(result, "glfwCreateWindowSurface");
-  }
+    vkCmdWriteTimestamp(commandBufferHandle,
+                        VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                        timestampQueryPoolHandle, 0);
 
-  // =========================================================================
-  // Physical Device
+    recordBLASBuild(commandBufferHandle,
+      bottomLevelAccelerationStructureBuildRangeInfo,
+      buildGeometryInfo,
+      false);
 
-  uint32_t physicalDeviceCount = 0;
-  result =
-      vkEnumeratePhysicalDevices(instanceHandle, &physicalDeviceCount, NULL);
+    vkCmdWriteTimestamp(commandBufferHandle,
+                        VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+                        timestampQueryPoolHandle, 1);
 
-  if (result != VK_SUCCESS) {
-    throwExceptionVulkanAPI(result, "vkEnumeratePhysicalDevices");
-  }
+    result = vkEndCommandBuffer(commandBufferHandle);
 
-  std::vector<VkPhysicalDevice> physicalDeviceHandleList(physicalDeviceCount);
-  result = vkEnumeratePhysicalDevices(instanceHandle, &physicalDeviceCount,
-                                      physicalDeviceHandleList.data());
+    if (result != VK_SUCCESS) {
+      throwExceptionVulkanAPI(result, "vkEndCommandBuffer");
+    }
 
-  if (result != VK_SUCCESS) {
-    throwExceptionVulkanAPI(result, "vkEnumeratePhysicalDevices");
-  }
+    submitAndWait(commandBufferHandle, queueHandle);
 
-  VkPhysicalDevice activePhysicalDeviceHandle = physicalDeviceHandleList[0];
+    uint64_t timestampList[2];
+    result = vkGetQueryPoolResults(
+        deviceHandle, timestampQueryPoolHandle, 0, 2, sizeof(timestampList),
+        timestampList, sizeof(uint64_t),
+        VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
 
-  VkPhysicalDeviceRayTracingPipelinePropertiesKHR
-      physicalDeviceRayTracingPipelineProperties = {
-          .sType =
-              VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_TRACING_PIPELINE_PROPERTIES_KHR,
-          .pNext = NULL};
+    if (result != VK_SUCCESS) {
+      throwExceptionVulkanAPI(result, "vkGetQueryPoolResults");
+    }
 
-  VkPhysicalDeviceProperties2 physicalDeviceProperties2 = {
-      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
-      .pNext = &physicalDeviceRayTracingPipelineProperties};
+    double buildTime =
+      (timestampList[1] - timestampList[0]) * timestampPeriod * 1e-6;
 
-  vkGetPhysicalDeviceProperties2(activePhysicalDeviceHandle,
-                                 &physicalDeviceProperties2);
+    std::cout << "  " << getBLASBuildPolicyName(policy) << ": build "
+              << buildTime << " ms, size "
+              << buildSizesInfo.accelerationStructureSize / 1024 << " KiB";
 
-  //init VkPhysicalDeviceMemoryProperties physicalDeviceMemoryProperties
-  vkGetPhysicalDeviceMemoryProperties(activePhysicalDeviceHandle,
-                                      &physicalDeviceMemoryProperties);
+    if (allowCompaction) {
+      std::vector<VkAccelerationStructureKHR> accelerationStructureHandleList = {
+        accelerationStructureHandle};
+      std::vector<VkDeviceSize> compactedSizeList;
+      queryCompactedBLASSize(compactedSizeList,
+        accelerationStructureHandleList,
+        commandBufferHandle,
+        queueHandle);
 
-  std::cout << physicalDeviceProperties2.properties.deviceName << std::endl;
+      std::cout << ", compacted " << compactedSizeList[0] / 1024 << " KiB";
+    }
+    std::cout << std::endl;
+
+    vkDestroyQueryPool(deviceHandle, timestampQueryPoolHandle, NULL);
+    vkFreeMemory(deviceHandle, scratchDeviceMemoryHandle, NULL);
+    vkDestroyBuffer(deviceHandle, scratchBufferHandle, NULL);
+    pvkDestroyAccelerationStructureKHR(deviceHandle, accelerationStructureHandle,
+                                       NULL);
+    vkFreeMemory(deviceHandle, deviceMemoryHandle, NULL);
+    vkDestroyBuffer(deviceHandle, bufferHandle, NULL);
+  }
+}
 
-  // =========================================================================
-  // Physical Device Features
+// Copies a staging buffer into all layers of an image on the transfer queue
+// and hands the image over to the graphics queue family in
+// SHADER_READ_ONLY_OPTIMAL layout.
+void uploadImage(VkImage& imageHandle,
+  VkBuffer& stagingBufferHandle,
+  uint32_t width,
+  uint32_t height,
+  uint32_t layerCount,
+  uint32_t transferQueueFamilyIndex,
+  VkCommandBuffer& transferCommandBufferHandle,
+  VkQueue& transferQueueHandle,
+  uint32_t queueFamilyIndex,
+  VkCommandBuffer& commandBufferHandle,
+  VkQueue& queueHandle)
+{
+  VkResult result;
+  bool isOwnershipTransferred = transferQueueFamilyIndex != queueFamilyIndex;
 
-  VkPhysicalDeviceBufferDeviceAddressFeatures
-      physicalDeviceBufferDeviceAddressFeatures = {
-          .sType =
-              VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_BUFFER_DEVICE_ADDRESS_FEATURES,
-          .pNext = NULL,
-          .bufferDeviceAddress = VK_TRUE,
-          .bufferDeviceAddressCaptureReplay = VK_FALSE,
-          .bufferDeviceAddressMultiDevice = VK_FALSE};
+  VkCommandBufferBeginInfo commandBufferBeginInfo = {
+    .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+    .pNext = NULL,
+    .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+    .pInheritanceInfo = NULL};
 
-  VkPhysicalDeviceAccelerationStructureFeaturesKHR
-      physicalDeviceAccelerationStructureFeatures = {
-          .sType =
-              VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ACCELERATION_STRUCTURE_FEATURES_KHR,
-          .pNext = &physicalDeviceBufferDeviceAddressFeatures,
-          .accelerationStructure = VK_TRUE,
-          .accelerationStructureCaptureReplay = VK_FALSE,
-          .accelerationStructureIndirectBuild = VK_FALSE,
-          .accelerationStructureHostCommands = VK_FALSE,
-          .descriptorBindingAccelerationStructureUpdateAfterBind = VK_FALSE};
+  result = vkBeginCommandBuffer(transferCommandBufferHandle,
+                                &commandBufferBeginInfo);
 
-  VkPhysicalDeviceRayTracingPipelineFeaturesKHR
-      physicalDeviceRayTracingPipelineFeatures = {
-          .sType =
-              VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_TRACING_PIPELINE_FEATURES_KHR,
-          .pNext = &physicalDeviceAccelerationStructureFeatures,
-          .rayTracingPipeline = VK_TRUE,
-          .rayTracingPipelineShaderGroupHandleCaptureReplay = VK_FALSE,
-          .rayTracingPipelineShaderGroupHandleCaptureReplayMixed = VK_FALSE,
-          .rayTracingPipelineTraceRaysIndirect = VK_FALSE,
-          .rayTraversalPrimitiveCulling = VK_FALSE};
-  VkPhysicalDeviceFeatures deviceFeatures = {.geometryShader = VK_TRUE};
+  if (result != VK_SUCCESS) {
+    throwExceptionVulkanAPI(result, "vkBeginCommandBuffer");
+  }
 
-  // =========================================================================
-  // Physical Device Submission Queue Families
+  VkImageMemoryBarrier transferDstMemoryBarrier = {
+      .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+      .pNext = NULL,
+      .srcAccessMask = 0,
+      .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+      .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+      .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+      .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+      .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+      .image = imageHandle,
+      .subresourceRange = {.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                           .baseMipLevel = 0,
+                           .levelCount = 1,
+                           .baseArrayLayer = 0,
+                           .layerCount = layerCount}};
+
+  vkCmdPipelineBarrier(transferCommandBufferHandle,
+                       VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL,
+                       1, &transferDstMemoryBarrier);
+
+  VkBufferImageCopy bufferImageCopy = {
+      .bufferOffset = 0,
+      .bufferRowLength = 0,
+      .bufferImageHeight = 0,
+      .imageSubresource = {.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                           .mipLevel = 0,
+                           .baseArrayLayer = 0,
+                           .layerCount = layerCount},
+      .imageOffset = {0, 0, 0},
+      .imageExtent = {width, height, 1}};
+
+  vkCmdCopyBufferToImage(transferCommandBufferHandle, stagingBufferHandle,
+                         imageHandle, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1,
+                         &bufferImageCopy);
+
+  // release from the transfer family (or a plain transition if the
+  // families are the same)
+  VkImageMemoryBarrier releaseMemoryBarrier = transferDstMemoryBarrier;
+  releaseMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  releaseMemoryBarrier.dstAccessMask =
+      isOwnershipTransferred ? 0 : VK_ACCESS_SHADER_READ_BIT;
+  releaseMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  releaseMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  if (isOwnershipTransferred) {
+    releaseMemoryBarrier.srcQueueFamilyIndex = transferQueueFamilyIndex;
+    releaseMemoryBarrier.dstQueueFamilyIndex = queueFamilyIndex;
+  }
 
-  uint32_t queueFamilyPropertyCount = 0;
-  vkGetPhysicalDeviceQueueFamilyProperties(activePhysicalDeviceHandle,
-                                           &queueFamilyPropertyCount, NULL);
+  vkCmdPipelineBarrier(transferCommandBufferHandle,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       isOwnershipTransferred
+                           ? (VkPipelineStageFlags)
+                                 VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT
+                           : rayTracingShaderStageMask |
+                                 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       0, 0, NULL, 0, NULL, 1, &releaseMemoryBarrier);
 
-  std::vector<VkQueueFamilyProperties> queueFamilyPropertiesList(
-      queueFamilyPropertyCount);
+  result = vkEndCommandBuffer(transferCommandBufferHandle);
 
-  vkGetPhysicalDeviceQueueFamilyProperties(activePhysicalDeviceHandle,
-                                           &queueFamilyPropertyCount,
-                                           queueFamilyPropertiesList.data());
+  if (result != VK_SUCCESS) {
+    throwExceptionVulkanAPI(result, "vkEndCommandBuffer");
+  }
 
-  uint32_t queueFamilyIndex = -1;
-  for (uint32_t x = 0; x < queueFamilyPropertiesList.size(); x++) {
-    if (queueFamilyPropertiesList[x].queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+  if (!isOwnershipTransferred) {
+    submitAndWait(transferCommandBufferHandle, transferQueueHandle);
+    return;
+  }
 
-      VkBool32 isPresentSupported = false;
-      result = vkGetPhysicalDeviceSurfaceSupportKHR(
-          activePhysicalDeviceHandle, x, surfaceHandle, &isPresentSupported);
+  VkSemaphoreCreateInfo releaseSemaphoreCreateInfo = {
+      .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+      .pNext = NULL,
+      .flags = 0};
 
-      if (result != VK_SUCCESS) {
-        throwExceptionVulkanAPI(result, "vkGetPhysicalDeviceSurfaceSupportKHR");
-      }
+  VkSemaphore releaseSemaphoreHandle = VK_NULL_HANDLE;
+  result = vkCreateSemaphore(deviceHandle, &releaseSemaphoreCreateInfo, NULL,
+                             &releaseSemaphoreHandle);
 
-      if (isPresentSupported) {
-        queueFamilyIndex = x;
-        break;
-      }
-    }
+  if (result != VK_SUCCESS) {
+    throwExceptionVulkanAPI(result, "vkCreateSemaphore");
   }
 
-  std::vector<float> queuePrioritiesList = {1.0f};
-  VkDeviceQueueCreateInfo deviceQueueCreateInfo = {
-      .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+  VkSubmitInfo releaseSubmitInfo = {
+      .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
       .pNext = NULL,
-      .flags = 0,
-      .queueFamilyIndex = queueFamilyIndex,
-      .queueCount = 1,
-      .pQueuePriorities = queuePrioritiesList.data()};
+      .waitSemaphoreCount = 0,
+      .pWaitSemaphores = NULL,
+      .pWaitDstStageMask = NULL,
+      .commandBufferCount = 1,
+      .pCommandBuffers = &transferCommandBufferHandle,
+      .signalSemaphoreCount = 1,
+      .pSignalSemaphores = &releaseSemaphoreHandle};
 
-  // =========================================================================
-  // Logical Device
-
-  std::vector<const char *> deviceExtensionList = {
-      "VK_KHR_ray_tracing_pipeline",
-      "VK_KHR_acceleration_structure",
-      "VK_EXT_descriptor_indexing",
-      "VK_KHR_maintenance3",
-      "VK_KHR_buffer_device_address",
-      "VK_KHR_deferred_host_operations",
-      "VK_KHR_swapchain"};
-
-  VkDeviceCreateInfo deviceCreateInfo = {
-      .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
-      .pNext = &physicalDeviceRayTracingPipelineFeatures,
-      .flags = 0,
-      .queueCreateInfoCount = 1,
-      .pQueueCreateInfos = &deviceQueueCreateInfo,
-      .enabledLayerCount = (uint32_t)instanceLayerList.size(),
-      .ppEnabledLayerNames = instanceLayerList.data(),
-      .enabledExtensionCount = (uint32_t)deviceExtensionList.size(),
-      .ppEnabledExtensionNames = deviceExtensionList.data(),
-      .pEnabledFeatures = &deviceFeatures};
-
-  deviceHandle = VK_NULL_HANDLE;
-  result = vkCreateDevice(activePhysicalDeviceHandle, &deviceCreateInfo, NULL,
-                          &deviceHandle);
+  result = vkQueueSubmit(transferQueueHandle, 1, &releaseSubmitInfo,
+                         VK_NULL_HANDLE);
 
   if (result != VK_SUCCESS) {
-    throwExceptionVulkanAPI(result, "vkCreateDevice");
+    throwExceptionVulkanAPI(result, "vkQueueSubmit");
   }
 
-  // =========================================================================
-  // Submission Queue
-
-  VkQueue queueHandle = VK_NULL_HANDLE;
-  vkGetDeviceQueue(deviceHandle, queueFamilyIndex, 0, &queueHandle);
-
-  // =========================================================================
-  // Device Pointer Functions
+  // acquire on the graphics family, same layouts as the release
+  result = vkBeginCommandBuffer(commandBufferHandle, &commandBufferBeginInfo);
 
-  pvkGetBufferDeviceAddressKHR =
-      (PFN_vkGetBufferDeviceAddressKHR)vkGetDeviceProcAddr(
-          deviceHandle, "vkGetBufferDeviceAddressKHR");
+  if (result != VK_SUCCESS) {
+    throwExceptionVulkanAPI(result, "vkBeginCommandBuffer");
+  }
 
-  pvkCreateRayTracingPipelinesKHR =
-      (PFN_vkCreateRayTracingPipelinesKHR)vkGetDeviceProcAddr(
-          deviceHandle, "vkCreateRayTracingPipelinesKHR");
+  VkImageMemoryBarrier acquireMemoryBarrier = releaseMemoryBarrier;
+  acquireMemoryBarrier.srcAccessMask = 0;
+  acquireMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
 
-  
-  pvkGetAccelerationStructureBuildSizesKHR =
-      (PFN_vkGetAccelerationStructureBuildSizesKHR)vkGetDeviceProcAddr(
-          deviceHandle, "vkGetAccelerationStructureBuildSizesKHR");
+  vkCmdPipelineBarrier(commandBufferHandle, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                       rayTracingShaderStageMask |
+                           VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       0, 0, NULL, 0, NULL, 1, &acquireMemoryBarrier);
 
-  pvkCreateAccelerationStructureKHR =
-      (PFN_vkCreateAccelerationStructureKHR)vkGetDeviceProcAddr(
-          deviceHandle, "vkCreateAccelerationStructureKHR");
+  result = vkEndCommandBuffer(commandBufferHandle);
 
-  pvkDestroyAccelerationStructureKHR =
-      (PFN_vkDestroyAccelerationStructureKHR)vkGetDeviceProcAddr(
-          deviceHandle, "vkDestroyAccelerationStructureKHR");
+  if (result != VK_SUCCESS) {
+    throwExceptionVulkanAPI(result, "vkEndCommandBuffer");
+  }
 
-  pvkGetAccelerationStructureDeviceAddressKHR =
-      (PFN_vkGetAccelerationStructureDeviceAddressKHR)vkGetDeviceProcAddr(
-          deviceHandle, "vkGetAccelerationStructureDeviceAddressKHR");
+  submitAndWait(commandBufferHandle, queueHandle, releaseSemaphoreHandle,
+                VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
 
-  pvkCmdBuildAccelerationStructuresKHR =
-      (PFN_vkCmdBuildAccelerationStructuresKHR)vkGetDeviceProcAddr(
-          deviceHandle, "vkCmdBuildAccelerationStructuresKHR");
+  vkDestroySemaphore(deviceHandle, releaseSemaphoreHandle, NULL);
+}
 
-  pvkGetRayTracingShaderGroupHandlesKHR =
-      (PFN_vkGetRayTracingShaderGroupHandlesKHR)vkGetDeviceProcAddr(
-          deviceHandle, "vkGetRayTracingShaderGroupHandlesKHR");
+void createTexture(VkImage& imageHandle,
+  VkDeviceMemory& imageDeviceMemoryHandle,
+  VkImageView& imageViewHandle,
+  const unsigned char* pixels,
+  uint32_t width,
+  uint32_t height,
+  uint32_t transferQueueFamilyIndex,
+  VkCommandBuffer& transferCommandBufferHandle,
+  VkQueue& transferQueueHandle,
+  uint32_t& queueFamilyIndex,
+  VkCommandBuffer& commandBufferHandle,
+  VkQueue& queueHandle)
+{
+  VkResult result;
+  VkDeviceSize imageSize = (VkDeviceSize)width * height * 4;
 
-  pvkCmdTraceRaysKHR =
-      (PFN_vkCmdTraceRaysKHR)vkGetDeviceProcAddr(deviceHandle,
-                                                 "vkCmdTraceRaysKHR");
+  // staging buffer
+  VkBuffer stagingBufferHandle = VK_NULL_HANDLE;
+  createBuffer(stagingBufferHandle, imageSize,
+      VK_BUFFER_USAGE_TRANSFER_SRC_BIT, queueFamilyIndex);
 
-  VkMemoryAllocateFlagsInfo memoryAllocateFlagsInfo = {
-      .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO,
-      .pNext = NULL,
-      .flags = VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT,
-      .deviceMask = 0};
+  VkDeviceMemory stagingDeviceMemoryHandle = VK_NULL_HANDLE;
+  allocAndBind(stagingDeviceMemoryHandle, NULL, stagingBufferHandle,
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
 
-  // =========================================================================
-  // Command Pool
+  copyData(stagingDeviceMemoryHandle, (void *) pixels, imageSize);
 
-  VkCommandPoolCreateInfo commandPoolCreateInfo = {
-      .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+  VkImageCreateInfo imageCreateInfo = {
+      .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
       .pNext = NULL,
-      .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
-      .queueFamilyIndex = queueFamilyIndex};
+      .flags = 0,
+      .imageType = VK_IMAGE_TYPE_2D,
+      .format = VK_FORMAT_R8G8B8A8_SRGB,
+      .extent = {.width = width, .height = height, .depth = 1},
+      .mipLevels = 1,
+      .arrayLayers = 1,
+      .samples = VK_SAMPLE_COUNT_1_BIT,
+      .tiling = VK_IMAGE_TILING_OPTIMAL,
+      .usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+      .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+      .queueFamilyIndexCount = 1,
+      .pQueueFamilyIndices = &queueFamilyIndex,
+      .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED};
 
-  VkCommandPool commandPoolHandle = VK_NULL_HANDLE;
-  result = vkCreateCommandPool(deviceHandle, &commandPoolCreateInfo, NULL,
-                               &commandPoolHandle);
+  imageHandle = VK_NULL_HANDLE;
+  result = vkCreateImage(deviceHandle, &imageCreateInfo, NULL, &imageHandle);
 
   if (result != VK_SUCCESS) {
-    throwExceptionVulkanAPI(result, "vkCreateCommandPool");
+    throwExceptionVulkanAPI(result, "vkCreateImage");
   }
 
-  // =========================================================================
-  // Command Buffers
+  VkMemoryRequirements memoryRequirements;
+  vkGetImageMemoryRequirements(deviceHandle, imageHandle, &memoryRequirements);
 
-  VkCommandBufferAllocateInfo commandBufferAllocateInfo = {
-      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+  VkMemoryAllocateInfo memoryAllocateInfo = {
+      .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
       .pNext = NULL,
-      .commandPool = commandPoolHandle,
-      .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
-      .commandBufferCount = 16};
-
-  std::vector<VkCommandBuffer> commandBufferHandleList =
-      std::vector<VkCommandBuffer>(16, VK_NULL_HANDLE);
+      .allocationSize = memoryRequirements.size,
+      .memoryTypeIndex = getMemoryIndex(memoryRequirements,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)};
 
-  result = vkAllocateCommandBuffers(deviceHandle, &commandBufferAllocateInfo,
-                                    commandBufferHandleList.data());
+  imageDeviceMemoryHandle = VK_NULL_HANDLE;
+  result = vkAllocateMemory(deviceHandle, &memoryAllocateInfo, NULL,
+                            &imageDeviceMemoryHandle);
+  if (result != VK_SUCCESS) {
+    throwExceptionVulkanAPI(result, "vkAllocateMemory");
+  }
 
+  result = vkBindImageMemory(deviceHandle, imageHandle,
+                             imageDeviceMemoryHandle, 0);
   if (result != VK_SUCCESS) {
-    throwExceptionVulkanAPI(result, "vkAllocateCommandBuffers");
+    throwExceptionVulkanAPI(result, "vkBindImageMemory");
   }
 
-  // =========================================================================
-  // Surface Features
+  uploadImage(imageHandle,
+    stagingBufferHandle,
+    width,
+    height,
+    1,
+    transferQueueFamilyIndex,
+    transferCommandBufferHandle,
+    transferQueueHandle,
+    queueFamilyIndex,
+    commandBufferHandle,
+    queueHandle);
 
-  VkSurfaceCapabilitiesKHR surfaceCapabilities;
-  result = vkGetPhysicalDeviceSurfaceCapabilitiesKHR(
-      activePhysicalDeviceHandle, surfaceHandle, &surfaceCapabilities);
+  vkDestroyBuffer(deviceHandle, stagingBufferHandle, NULL);
+  vkFreeMemory(deviceHandle, stagingDeviceMemoryHandle, NULL);
 
-  if (result != VK_SUCCESS) {
-    throwExceptionVulkanAPI(result,
-                            "vkGetPhysicalDeviceSurfaceCapabilitiesKHR");
-  }
+  VkImageViewCreateInfo imageViewCreateInfo = {
+      .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+      .pNext = NULL,
+      .flags = 0,
+      .image = imageHandle,
+      .viewType = VK_IMAGE_VIEW_TYPE_2D,
+      .format = VK_FORMAT_R8G8B8A8_SRGB,
+      .components = {.r = VK_COMPONENT_SWIZZLE_IDENTITY,
+                     .g = VK_COMPONENT_SWIZZLE_IDENTITY,
+                     .b = VK_COMPONENT_SWIZZLE_IDENTITY,
+                     .a = VK_COMPONENT_SWIZZLE_IDENTITY},
+      .subresourceRange = {.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                           .baseMipLevel = 0,
+                           .levelCount = 1,
+                           .baseArrayLayer = 0,
+                           .layerCount = 1}};
 
-  uint32_t surfaceFormatCount = 0;
-  result = vkGetPhysicalDeviceSurfaceFormatsKHR(
-      activePhysicalDeviceHandle, surfaceHandle, &surfaceFormatCount, NULL);
+  imageViewHandle = VK_NULL_HANDLE;
+  result = vkCreateImageView(deviceHandle, &imageViewCreateInfo, NULL,
+                             &imageViewHandle);
 
   if (result != VK_SUCCESS) {
-    throwExceptionVulkanAPI(result, "vkGetPhysicalDeviceSurfaceFormatsKHR");
+    throwExceptionVulkanAPI(result, "vkCreateImageView");
   }
+}
 
-  std::vector<VkSurfaceFormatKHR> surfaceFormatList(surfaceFormatCount);
-  result = vkGetPhysicalDeviceSurfaceFormatsKHR(
-      activePhysicalDeviceHandle, surfaceHandle, &surfaceFormatCount,
-      surfaceFormatList.data());
+// Creates a device local 2D image with a view for use as a storage image
+// (and as a copy source or destination); the image is left in
+// VK_IMAGE_LAYOUT_UNDEFINED.
+void createStorageImage(VkImage& imageHandle,
+  VkDeviceMemory& imageDeviceMemoryHandle,
+  VkImageView& imageViewHandle,
+  VkFormat format,
+  uint32_t width,
+  uint32_t height,
+  uint32_t& queueFamilyIndex)
+{
+  VkImageCreateInfo imageCreateInfo = {
+      .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+      .pNext = NULL,
+      .flags = 0,
+      .imageType = VK_IMAGE_TYPE_2D,
+      .format = format,
+      .extent = {.width = width, .height = height, .depth = 1},
+      .mipLevels = 1,
+      .arrayLayers = 1,
+      .samples = VK_SAMPLE_COUNT_1_BIT,
+      .tiling = VK_IMAGE_TILING_OPTIMAL,
+      .usage = VK_IMAGE_USAGE_STORAGE_BIT |
+               VK_IMAGE_USAGE_TRANSFER_SRC_BIT |
+               VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+      .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+      .queueFamilyIndexCount = 1,
+      .pQueueFamilyIndices = &queueFamilyIndex,
+      .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED};
+
+  imageHandle = VK_NULL_HANDLE;
+  VkResult result = vkCreateImage(deviceHandle, &imageCreateInfo, NULL,
+                                  &imageHandle);
 
   if (result != VK_SUCCESS) {
-    throwExceptionVulkanAPI(result, "vkGetPhysicalDeviceSurfaceFormatsKHR");
+    throwExceptionVulkanAPI(result, "vkCreateImage");
   }
 
-  uint32_t presentModeCount = 0;
-  result = vkGetPhysicalDeviceSurfacePresentModesKHR(
-      activePhysicalDeviceHandle, surfaceHandle, &presentModeCount, NULL);
+  VkMemoryRequirements memoryRequirements;
+  vkGetImageMemoryRequirements(deviceHandle, imageHandle, &memoryRequirements);
+
+  VkMemoryAllocateInfo memoryAllocateInfo = {
+      .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+      .pNext = NULL,
+      .allocationSize = memoryRequirements.size,
+      .memoryTypeIndex = getMemoryIndex(memoryRequirements,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)};
 
+  imageDeviceMemoryHandle = VK_NULL_HANDLE;
+  result = vkAllocateMemory(deviceHandle, &memoryAllocateInfo, NULL,
+                            &imageDeviceMemoryHandle);
   if (result != VK_SUCCESS) {
-    throwExceptionVulkanAPI(result,
-                            "vkGetPhysicalDeviceSurfacePresentModesKHR");
+    throwExceptionVulkanAPI(result, "vkAllocateMemory");
   }
 
-  std::vector<VkPresentModeKHR> presentModeList(presentModeCount);
-  result = vkGetPhysicalDeviceSurfacePresentModesKHR(
-      activePhysicalDeviceHandle, surfaceHandle, &presentModeCount,
-      presentModeList.data());
-
+  result = vkBindImageMemory(deviceHandle, imageHandle,
+                             imageDeviceMemoryHandle, 0);
   if (result != VK_SUCCESS) {
-    throwExceptionVulkanAPI(result,
-                            "vkGetPhysicalDeviceSurfacePresentModesKHR");
+    throwExceptionVulkanAPI(result, "vkBindImageMemory");
   }
 
-  // =========================================================================
-  // Swapchain
-
-  VkSwapchainCreateInfoKHR swapchainCreateInfo = {
-      .sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR,
+  VkImageViewCreateInfo imageViewCreateInfo = {
+      .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
       .pNext = NULL,
       .flags = 0,
-      .surface = surfaceHandle,
-      .minImageCount = surfaceCapabilities.minImageCount + 1,
-      .imageFormat = surfaceFormatList[0].format,
-      .imageColorSpace = surfaceFormatList[0].colorSpace,
-      .imageExtent = surfaceCapabilities.currentExtent,
-      .imageArrayLayers = 1,
-      .imageUsage = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-      .imageSharingMode = VK_SHARING_MODE_EXCLUSIVE,
-      .queueFamilyIndexCount = 1,
-      .pQueueFamilyIndices = &queueFamilyIndex,
-      .preTransform = surfaceCapabilities.currentTransform,
-      .compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR,
-#ifndef TEST_FPS
-      .presentMode = presentModeList[0],
-#else
-      .presentMode = VK_PRESENT_MODE_IMMEDIATE_KHR,
-#endif
-      .clipped = VK_TRUE,
-      .oldSwapchain = VK_NULL_HANDLE};
+      .image = imageHandle,
+      .viewType = VK_IMAGE_VIEW_TYPE_2D,
+      .format = format,
+      .components = {.r = VK_COMPONENT_SWIZZLE_IDENTITY,
+                     .g = VK_COMPONENT_SWIZZLE_IDENTITY,
+                     .b = VK_COMPONENT_SWIZZLE_IDENTITY,
+                     .a = VK_COMPONENT_SWIZZLE_IDENTITY},
+      .subresourceRange = {.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                           .baseMipLevel = 0,
+                           .levelCount = 1,
+                           .baseArrayLayer = 0,
+                           .layerCount = 1}};
 
-  VkSwapchainKHR swapchainHandle = VK_NULL_HANDLE;
-  result = vkCreateSwapchainKHR(deviceHandle, &swapchainCreateInfo, NULL,
-                                &swapchainHandle);
+  imageViewHandle = VK_NULL_HANDLE;
+  result = vkCreateImageView(deviceHandle, &imageViewCreateInfo, NULL,
+                             &imageViewHandle);
 
   if (result != VK_SUCCESS) {
-    throwExceptionVulkanAPI(result, "vkCreateSwapchainKHR");
+    throwExceptionVulkanAPI(result, "vkCreateImageView");
   }
+}
 
-  // =========================================================================
-  // Swapchain Images
-
-  uint32_t swapchainImageCount = 0;
-  result = vkGetSwapchainImagesKHR(deviceHandle, swapchainHandle,
-                                   &swapchainImageCount, NULL);
+void destroyStorageImage(VkImage& imageHandle,
+  VkDeviceMemory& imageDeviceMemoryHandle,
+  VkImageView& imageViewHandle)
+{
+  vkDestroyImageView(deviceHandle, imageViewHandle, NULL);
+  vkFreeMemory(deviceHandle, imageDeviceMemoryHandle, NULL);
+  vkDestroyImage(deviceHandle, imageHandle, NULL);
+}
 
-  if (result != VK_SUCCESS) {
-    throwExceptionVulkanAPI(result, "vkGetSwapchainImagesKHR");
+// Picks the first present mode of the policy (PRESENT_MODE_POLICY in
+// config.h) that the surface supports; FIFO is always supported.
+VkPresentModeKHR selectPresentMode(std::vector<VkPresentModeKHR>& presentModeList,
+  uint32_t presentModePolicy)
+{
+  std::vector<std::vector<VkPresentModeKHR>> policyPresentModeList = {
+      {VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR},
+      {VK_PRESENT_MODE_FIFO_KHR},
+      {VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_MAILBOX_KHR}};
+
+  for (VkPresentModeKHR presentMode :
+       policyPresentModeList[presentModePolicy]) {
+    if (std::find(presentModeList.begin(), presentModeList.end(),
+                  presentMode) != presentModeList.end()) {
+      return presentMode;
+    }
   }
 
-  std::vector<VkImage> swapchainImageHandleList(swapchainImageCount);
-  result = vkGetSwapchainImagesKHR(deviceHandle, swapchainHandle,
-                                   &swapchainImageCount,
-                                   swapchainImageHandleList.data());
+  return VK_PRESENT_MODE_FIFO_KHR;
+}
 
-  if (result != VK_SUCCESS) {
-    throwExceptionVulkanAPI(result, "vkGetSwapchainImagesKHR");
+const char *getPresentModeName(VkPresentModeKHR presentMode)
+{
+  switch (presentMode) {
+    case VK_PRESENT_MODE_IMMEDIATE_KHR: return "immediate";
+    case VK_PRESENT_MODE_MAILBOX_KHR: return "mailbox";
+    case VK_PRESENT_MODE_FIFO_KHR: return "fifo";
+    case VK_PRESENT_MODE_FIFO_RELAXED_KHR: return "fifo relaxed";
   }
+  return "unknown";
+}
 
-  std::vector<VkImageView> swapchainImageViewHandleList(swapchainImageCount,
-                                                        VK_NULL_HANDLE);
+void createSwapchainImageViews(std::vector<VkImageView>& imageViewHandleList,
+  std::vector<VkImage>& imageHandleList,
+  VkFormat format)
+{
+  imageViewHandleList.assign(imageHandleList.size(), VK_NULL_HANDLE);
 
-  for (uint32_t x = 0; x < swapchainImageCount; x++) {
+  for (uint32_t x = 0; x < imageHandleList.size(); x++) {
     VkImageViewCreateInfo imageViewCreateInfo = {
         .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
         .pNext = NULL,
         .flags = 0,
-        .image = swapchainImageHandleList[x],
+        .image = imageHandleList[x],
         .viewType = VK_IMAGE_VIEW_TYPE_2D,
-        .format = surfaceFormatList[0].format,
+        .format = format,
         .components = {VK_COMPONENT_SWIZZLE_IDENTITY,
                        VK_COMPONENT_SWIZZLE_IDENTITY,
                        VK_COMPONENT_SWIZZLE_IDENTITY,
                        VK_COMPONENT_SWIZZLE_IDENTITY},
         .subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1}};
 
-    result = vkCreateImageView(deviceHandle, &imageViewCreateInfo, NULL,
-                               &swapchainImageViewHandleList[x]);
+    VkResult result = vkCreateImageView(deviceHandle, &imageViewCreateInfo,
+                                        NULL, &imageViewHandleList[x]);
 
     if (result != VK_SUCCESS) {
       throwExceptionVulkanAPI(result, "vkCreateImageView");
     }
   }
+}
 
-  // =========================================================================
-  // Descriptor Pool
+// Points bindings 0 to n - 1 of the set at the storage images, in order.
+void writeStorageImageDescriptorSet(VkDescriptorSet& descriptorSetHandle,
+  std::vector<VkImageView>& imageViewHandleList)
+{
+  std::vector<VkDescriptorImageInfo> descriptorImageInfoList(
+      imageViewHandleList.size());
+  std::vector<VkWriteDescriptorSet> writeDescriptorSetList;
+  for (uint32_t i = 0; i < imageViewHandleList.size(); i++) {
+    descriptorImageInfoList[i] = {
+        .sampler = VK_NULL_HANDLE,
+        .imageView = imageViewHandleList[i],
+        .imageLayout = VK_IMAGE_LAYOUT_GENERAL};
+
+    writeDescriptorSetList.push_back(
+        {.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+         .pNext = NULL,
+         .dstSet = descriptorSetHandle,
+         .dstBinding = i,
+         .dstArrayElement = 0,
+         .descriptorCount = 1,
+         .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+         .pImageInfo = &descriptorImageInfoList[i],
+         .pBufferInfo = NULL,
+         .pTexelBufferView = NULL});
+  }
 
-  std::vector<VkDescriptorPoolSize> descriptorPoolSizeList = {
-      {.type = VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR,
-       .descriptorCount = 1},
-      {.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, .descriptorCount = 1},
-      {.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = 2},
-      {.type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, .descriptorCount = 1},
-      {.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, .descriptorCount = 1}};
+  vkUpdateDescriptorSets(deviceHandle, (uint32_t)writeDescriptorSetList.size(),
+                         writeDescriptorSetList.data(), 0, NULL);
+}
+
+// Clears the history images (in VK_IMAGE_LAYOUT_GENERAL) to an empty
+// history (length 0), which the next frame replaces entirely, once the
+// shader and transfer accesses submitted before have finished. Transfer
+// writes recorded before are visible to the ray tracing and compute shaders
+// afterwards.
+void recordHistoryClear(VkCommandBuffer& commandBufferHandle,
+  std::vector<VkImage>& historyImageHandleList)
+{
+  VkMemoryBarrier historyAccessMemoryBarrier = {
+      .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+      .pNext = NULL,
+      .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT,
+      .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT};
+
+  vkCmdPipelineBarrier(commandBufferHandle,
+                       rayTracingShaderStageMask |
+                           VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT |
+                           VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       0, 1, &historyAccessMemoryBarrier, 0, NULL, 0, NULL);
+
+  VkClearColorValue historyClearColorValue = {.uint32 = {0, 0, 0, 0}};
+  VkImageSubresourceRange historySubresourceRange = {
+      .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+      .baseMipLevel = 0,
+      .levelCount = 1,
+      .baseArrayLayer = 0,
+      .layerCount = 1};
+
+  for (VkImage historyImageHandle : historyImageHandleList) {
+    vkCmdClearColorImage(commandBufferHandle, historyImageHandle,
+                         VK_IMAGE_LAYOUT_GENERAL, &historyClearColorValue, 1,
+                         &historySubresourceRange);
+  }
+
+  VkMemoryBarrier historyClearMemoryBarrier = {
+      .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+      .pNext = NULL,
+      .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+      .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT};
+
+  vkCmdPipelineBarrier(commandBufferHandle,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       rayTracingShaderStageMask |
+                           VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       0, 1, &historyClearMemoryBarrier, 0, NULL, 0, NULL);
+}
+
+// Moves the storage images to VK_IMAGE_LAYOUT_GENERAL, discarding their
+// contents, and clears the history images (recordHistoryClear).
+void recordStorageImageInitialization(VkCommandBuffer& commandBufferHandle,
+  std::vector<VkImage>& storageImageHandleList,
+  std::vector<VkImage>& historyImageHandleList,
+  uint32_t queueFamilyIndex)
+{
+  std::vector<VkImageMemoryBarrier> storageImageGeneralMemoryBarrierList;
+  for (VkImage storageImageHandle : storageImageHandleList) {
+    storageImageGeneralMemoryBarrierList.push_back({
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .pNext = NULL,
+        .srcAccessMask = 0,
+        .dstAccessMask = 0,
+        .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        .newLayout = VK_IMAGE_LAYOUT_GENERAL,
+        .srcQueueFamilyIndex = queueFamilyIndex,
+        .dstQueueFamilyIndex = queueFamilyIndex,
+        .image = storageImageHandle,
+        .subresourceRange = {.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                             .baseMipLevel = 0,
+                             .levelCount = 1,
+                             .baseArrayLayer = 0,
+                             .layerCount = 1}});
+  }
+
+  vkCmdPipelineBarrier(commandBufferHandle,
+                       VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                       VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, NULL, 0, NULL,
+                       (uint32_t)storageImageGeneralMemoryBarrierList.size(),
+                       storageImageGeneralMemoryBarrierList.data());
+
+  recordHistoryClear(commandBufferHandle, historyImageHandleList);
+}
+
+// Creates a compute pipeline with a single descriptor set and an optional
+// push constant range from a SPIR-V file in shaders/.
+void createComputePipeline(VkPipeline& pipelineHandle,
+  VkPipelineLayout& pipelineLayoutHandle,
+  VkShaderModule& shaderModuleHandle,
+  const char *shaderPath,
+  VkDescriptorSetLayout& descriptorSetLayoutHandle,
+  uint32_t pushConstantSize,
+  const VkSpecializationInfo* specializationInfo = NULL)
+{
+  VkPushConstantRange pushConstantRange = {
+      .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+      .offset = 0,
+      .size = pushConstantSize};
+
+  VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+      .pNext = NULL,
+      .flags = 0,
+      .setLayoutCount = 1,
+      .pSetLayouts = &descriptorSetLayoutHandle,
+      .pushConstantRangeCount = pushConstantSize > 0 ? 1u : 0u,
+      .pPushConstantRanges = &pushConstantRange};
+
+  VkResult result = vkCreatePipelineLayout(deviceHandle,
+                                           &pipelineLayoutCreateInfo, NULL,
+                                           &pipelineLayoutHandle);
+
+  if (result != VK_SUCCESS) {
+    throwExceptionVulkanAPI(result, "vkCreatePipelineLayout");
+  }
+
+  std::ifstream shaderFile(shaderPath, std::ios::binary | std::ios::ate);
+  std::streamsize shaderFileSize = shaderFile.tellg();
+  shaderFile.seekg(0, std::ios::beg);
+  std::vector<uint32_t> shaderSource(shaderFileSize / sizeof(uint32_t));
+  shaderFile.read((char *)shaderSource.data(), shaderFileSize);
+  shaderFile.close();
+
+  VkShaderModuleCreateInfo shaderModuleCreateInfo = {
+      .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+      .pNext = NULL,
+      .flags = 0,
+      .codeSize = (uint32_t)shaderSource.size() * sizeof(uint32_t),
+      .pCode = shaderSource.data()};
+
+  result = vkCreateShaderModule(deviceHandle, &shaderModuleCreateInfo, NULL,
+                                &shaderModuleHandle);
+
+  if (result != VK_SUCCESS) {
+    throwExceptionVulkanAPI(result, "vkCreateShaderModule");
+  }
+
+  VkComputePipelineCreateInfo computePipelineCreateInfo = {
+      .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+      .pNext = NULL,
+      .flags = 0,
+      .stage = {.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                .pNext = NULL,
+                .flags = 0,
+                .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+                .module = shaderModuleHandle,
+                .pName = "main",
+                .pSpecializationInfo = specializationInfo},
+      .layout = pipelineLayoutHandle,
+      .basePipelineHandle = VK_NULL_HANDLE,
+      .basePipelineIndex = -1};
+
+  result = vkCreateComputePipelines(deviceHandle, VK_NULL_HANDLE, 1,
+                                    &computePipelineCreateInfo, NULL,
+                                    &pipelineHandle);
+
+  if (result != VK_SUCCESS) {
+    throwExceptionVulkanAPI(result, "vkCreateComputePipelines");
+  }
+}
+
+// Draws samples for a fixed set of indices and seeds with src/sampler.glsl
+// on the GPU and prints how many of them match include/sampler.h bit for
+// bit.
+void checkSampler(uint32_t& queueFamilyIndex,
+  VkMemoryAllocateFlagsInfo& memoryAllocateFlagsInfo,
+  VkCommandBuffer& commandBufferHandle,
+  VkQueue& queueHandle)
+{
+  // consecutive indices of the pixels of a 16x16 tile, then hashed ones
+  const uint32_t sampleCount = 512;
+  std::vector<uint32_t> sampleData(4 * sampleCount, 0);
+  for (uint32_t i = 0; i < sampleCount; i++) {
+    uint32_t pixel = i % 256;
+    sampleData[4 * i + 0] = i < 256 ? i / 16 : hashSampler(i);
+    sampleData[4 * i + 1] = getPixelSeed(pixel % 16, pixel / 16);
+  }
+
+  VkBuffer sampleBufferHandle = VK_NULL_HANDLE;
+  VkDeviceMemory sampleDeviceMemoryHandle = VK_NULL_HANDLE;
+  VkDeviceAddress sampleBufferDeviceAddress;
+  VkDeviceSize sampleBufferSize = sizeof(uint32_t) * sampleData.size();
+
+  buildBuffer(sampleBufferHandle,
+    sampleBufferSize,
+    queueFamilyIndex,
+    sampleData.data(),
+    VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT |
+    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+    &memoryAllocateFlagsInfo,
+    sampleDeviceMemoryHandle,
+    sampleBufferDeviceAddress);
+
+  VkDescriptorPoolSize descriptorPoolSize = {
+      .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = 1};
 
   VkDescriptorPoolCreateInfo descriptorPoolCreateInfo = {
       .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
       .pNext = NULL,
-      .flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT,
+      .flags = 0,
       .maxSets = 1,
-      .poolSizeCount = (uint32_t)descriptorPoolSizeList.size(),
-      .pPoolSizes = descriptorPoolSizeList.data()};
+      .poolSizeCount = 1,
+      .pPoolSizes = &descriptorPoolSize};
 
   VkDescriptorPool descriptorPoolHandle = VK_NULL_HANDLE;
-  result = vkCreateDescriptorPool(deviceHandle, &descriptorPoolCreateInfo, NULL,
-                                  &descriptorPoolHandle);
+  VkResult result = vkCreateDescriptorPool(deviceHandle,
+                                           &descriptorPoolCreateInfo, NULL,
+                                           &descriptorPoolHandle);
 
   if (result != VK_SUCCESS) {
     throwExceptionVulkanAPI(result, "vkCreateDescriptorPool");
   }
 
-  // =========================================================================
-  // Descriptor Set Layout
-
-  std::vector<VkDescriptorSetLayoutBinding> descriptorSetLayoutBindingList = {
-      {.binding = 0,
-       .descriptorType = VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR,
-       .descriptorCount = 1,
-       .stageFlags = VK_SHADER_STAGE_RAYGEN_BIT_KHR,
-       .pImmutableSamplers = NULL},
-      {.binding = 1,
-       .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-       .descriptorCount = 1,
-       .stageFlags = VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR,
-       .pImmutableSamplers = NULL},
-      {.binding = 2,
-       .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
-       .descriptorCount = 1,
-       .stageFlags = VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR,
-       .pImmutableSamplers = NULL},
-      {.binding = 3,
-       .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
-       .descriptorCount = 1,
-       .stageFlags = VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR,
-       .pImmutableSamplers = NULL},
-      {.binding = 4,
-       .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
-       .descriptorCount = 1,
-       .stageFlags = VK_SHADER_STAGE_RAYGEN_BIT_KHR,
-       .pImmutableSamplers = NULL},
-      {.binding = 5,
-       .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-       .descriptorCount = 1,
-       .stageFlags = VK_SHADER_STAGE_RAYGEN_BIT_KHR,
-       .pImmutableSamplers = NULL}};
+  VkDescriptorSetLayoutBinding descriptorSetLayoutBinding = {
+      .binding = 0,
+      .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+      .descriptorCount = 1,
+      .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+      .pImmutableSamplers = NULL};
 
   VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo = {
       .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
       .pNext = NULL,
       .flags = 0,
-      .bindingCount = (uint32_t)descriptorSetLayoutBindingList.size(),
-      .pBindings = descriptorSetLayoutBindingList.data()};
+      .bindingCount = 1,
+      .pBindings = &descriptorSetLayoutBinding};
 
   VkDescriptorSetLayout descriptorSetLayoutHandle = VK_NULL_HANDLE;
-  result =
-      vkCreateDescriptorSetLayout(deviceHandle, &descriptorSetLayoutCreateInfo,
-                                  NULL, &descriptorSetLayoutHandle);
+  result = vkCreateDescriptorSetLayout(deviceHandle,
+                                       &descriptorSetLayoutCreateInfo, NULL,
+                                       &descriptorSetLayoutHandle);
 
   if (result != VK_SUCCESS) {
     throwExceptionVulkanAPI(result, "vkCreateDescriptorSetLayout");
   }
 
-  // =========================================================================
-  // Allocate Descriptor Sets
-
-  std::vector<VkDescriptorSetLayout> descriptorSetLayoutHandleList = {
-      descriptorSetLayoutHandle};
-
   VkDescriptorSetAllocateInfo descriptorSetAllocateInfo = {
       .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
       .pNext = NULL,
       .descriptorPool = descriptorPoolHandle,
-      .descriptorSetCount = (uint32_t)descriptorSetLayoutHandleList.size(),
-      .pSetLayouts = descriptorSetLayoutHandleList.data()};
-
-  std::vector<VkDescriptorSet> descriptorSetHandleList =
-      std::vector<VkDescriptorSet>(1, VK_NULL_HANDLE);
+      .descriptorSetCount = 1,
+      .pSetLayouts = &descriptorSetLayoutHandle};
 
+  VkDescriptorSet descriptorSetHandle = VK_NULL_HANDLE;
   result = vkAllocateDescriptorSets(deviceHandle, &descriptorSetAllocateInfo,
-                                    descriptorSetHandleList.data());
+                                    &descriptorSetHandle);
 
   if (result != VK_SUCCESS) {
     throwExceptionVulkanAPI(result, "vkAllocateDescriptorSets");
   }
 
-  // =========================================================================
-  // Pipeline Layout
+  VkDescriptorBufferInfo descriptorBufferInfo = {
+      .buffer = sampleBufferHandle, .offset = 0, .range = VK_WHOLE_SIZE};
 
-  VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {
-      .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+  VkWriteDescriptorSet writeDescriptorSet = {
+      .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
       .pNext = NULL,
-      .flags = 0,
-      .setLayoutCount = (uint32_t)descriptorSetLayoutHandleList.size(),
-      .pSetLayouts = descriptorSetLayoutHandleList.data(),
-      .pushConstantRangeCount = 0,
-      .pPushConstantRanges = NULL};
-
+      .dstSet = descriptorSetHandle,
+      .dstBinding = 0,
+      .dstArrayElement = 0,
+      .descriptorCount = 1,
+      .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+      .pImageInfo = NULL,
+      .pBufferInfo = &descriptorBufferInfo,
+      .pTexelBufferView = NULL};
+
+  vkUpdateDescriptorSets(deviceHandle, 1, &writeDescriptorSet, 0, NULL);
+
+  VkPipeline pipelineHandle = VK_NULL_HANDLE;
   VkPipelineLayout pipelineLayoutHandle = VK_NULL_HANDLE;
-  result = vkCreatePipelineLayout(deviceHandle, &pipelineLayoutCreateInfo, NULL,
-                                  &pipelineLayoutHandle);
+  VkShaderModule shaderModuleHandle = VK_NULL_HANDLE;
+  createComputePipeline(pipelineHandle,
+    pipelineLayoutHandle,
+    shaderModuleHandle,
+    "shaders/shader_sampler_test.comp.spv",
+    descriptorSetLayoutHandle,
+    sizeof(uint32_t));
+
+  VkCommandBufferBeginInfo commandBufferBeginInfo = {
+    .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+    .pNext = NULL,
+    .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+    .pInheritanceInfo = NULL};
+
+  result = vkBeginCommandBuffer(commandBufferHandle, &commandBufferBeginInfo);
 
   if (result != VK_SUCCESS) {
-    throwExceptionVulkanAPI(result, "vkCreatePipelineLayout");
+    throwExceptionVulkanAPI(result, "vkBeginCommandBuffer");
   }
 
-  // =========================================================================
-  // Ray Closest Hit Shader Module
+  vkCmdBindPipeline(commandBufferHandle, VK_PIPELINE_BIND_POINT_COMPUTE,
+                    pipelineHandle);
 
-  std::ifstream rayClosestHitFile("shaders/shader.rchit.spv",
-                                  std::ios::binary | std::ios::ate);
-  std::streamsize rayClosestHitFileSize = rayClosestHitFile.tellg();
-  rayClosestHitFile.seekg(0, std::ios::beg);
-  std::vector<uint32_t> rayClosestHitShaderSource(rayClosestHitFileSize /
-                                                  sizeof(uint32_t));
-  rayClosestHitFile.read((char *)rayClosestHitShaderSource.data(),
-                         rayClosestHitFileSize);
-  rayClosestHitFile.close();
+  vkCmdBindDescriptorSets(commandBufferHandle, VK_PIPELINE_BIND_POINT_COMPUTE,
+                          pipelineLayoutHandle, 0, 1, &descriptorSetHandle, 0,
+                          NULL);
 
-  VkShaderModuleCreateInfo rayClosestHitShaderModuleCreateInfo = {
-      .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+  vkCmdPushConstants(commandBufferHandle, pipelineLayoutHandle,
+                     VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(uint32_t),
+                     &sampleCount);
+
+  vkCmdDispatch(commandBufferHandle, (sampleCount + 63) / 64, 1, 1);
+
+  VkMemoryBarrier hostReadMemoryBarrier = {
+      .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
       .pNext = NULL,
-      .flags = 0,
-      .codeSize = (uint32_t)rayClosestHitShaderSource.size() * sizeof(uint32_t),
-      .pCode = rayClosestHitShaderSource.data()};
+      .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+      .dstAccessMask = VK_ACCESS_HOST_READ_BIT};
 
-  VkShaderModule rayClosestHitShaderModuleHandle = VK_NULL_HANDLE;
-  result =
-      vkCreateShaderModule(deviceHandle, &rayClosestHitShaderModuleCreateInfo,
-                           NULL, &rayClosestHitShaderModuleHandle);
+  vkCmdPipelineBarrier(commandBufferHandle,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       VK_PIPELINE_STAGE_HOST_BIT, 0, 1,
+                       &hostReadMemoryBarrier, 0, NULL, 0, NULL);
+
+  result = vkEndCommandBuffer(commandBufferHandle);
 
   if (result != VK_SUCCESS) {
-    throwExceptionVulkanAPI(result, "vkCreateShaderModule");
+    throwExceptionVulkanAPI(result, "vkEndCommandBuffer");
   }
 
-  // =========================================================================
-  // Ray Generate Shader Module
+  submitAndWait(commandBufferHandle, queueHandle);
 
-  std::ifstream rayGenerateFile("shaders/shader.rgen.spv",
-                                std::ios::binary | std::ios::ate);
-  std::streamsize rayGenerateFileSize = rayGenerateFile.tellg();
-  rayGenerateFile.seekg(0, std::ios::beg);
-  std::vector<uint32_t> rayGenerateShaderSource(rayGenerateFileSize /
-                                                sizeof(uint32_t));
-  rayGenerateFile.read((char *)rayGenerateShaderSource.data(),
-                       rayGenerateFileSize);
-  rayGenerateFile.close();
+  void *hostSampleMemoryBuffer;
+  result = vkMapMemory(deviceHandle, sampleDeviceMemoryHandle, 0,
+                       sampleBufferSize, 0, &hostSampleMemoryBuffer);
 
-  VkShaderModuleCreateInfo rayGenerateShaderModuleCreateInfo = {
-      .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+  if (result != VK_SUCCESS) {
+    throwExceptionVulkanAPI(result, "vkMapMemory");
+  }
+
+  // the memory is not necessarily host coherent
+  VkMappedMemoryRange mappedMemoryRange = {
+      .sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,
       .pNext = NULL,
-      .flags = 0,
-      .codeSize = (uint32_t)rayGenerateShaderSource.size() * sizeof(uint32_t),
-      .pCode = rayGenerateShaderSource.data()};
+      .memory = sampleDeviceMemoryHandle,
+      .offset = 0,
+      .size = VK_WHOLE_SIZE};
 
-  VkShaderModule rayGenerateShaderModuleHandle = VK_NULL_HANDLE;
-  result =
-      vkCreateShaderModule(deviceHandle, &rayGenerateShaderModuleCreateInfo,
-                           NULL, &rayGenerateShaderModuleHandle);
+  result = vkInvalidateMappedMemoryRanges(deviceHandle, 1, &mappedMemoryRange);
 
   if (result != VK_SUCCESS) {
-    throwExceptionVulkanAPI(result, "vkCreateShaderModule");
+    throwExceptionVulkanAPI(result, "vkInvalidateMappedMemoryRanges");
   }
 
-  // =========================================================================
-  // Ray Miss Shader Module
-
-  std::ifstream rayMissFile("shaders/shader.rmiss.spv",
-                            std::ios::binary | std::ios::ate);
-  std::streamsize rayMissFileSize = rayMissFile.tellg();
-  rayMissFile.seekg(0, std::ios::beg);
-  std::vector<uint32_t> rayMissShaderSource(rayMissFileSize / sizeof(uint32_t));
-  rayMissFile.read((char *)rayMissShaderSource.data(), rayMissFileSize);
-  rayMissFile.close();
+  memcpy(sampleData.data(), hostSampleMemoryBuffer, sampleBufferSize);
+  vkUnmapMemory(deviceHandle, sampleDeviceMemoryHandle);
 
-  VkShaderModuleCreateInfo rayMissShaderModuleCreateInfo = {
-      .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
-      .pNext = NULL,
-      .flags = 0,
-      .codeSize = (uint32_t)rayMissShaderSource.size() * sizeof(uint32_t),
-      .pCode = rayMissShaderSource.data()};
+  uint32_t matchCount = 0;
+  for (uint32_t i = 0; i < sampleCount; i++) {
+    float sample[2];
+    sampleOwenSobol2D(sampleData[4 * i + 0], sampleData[4 * i + 1], sample);
 
-  VkShaderModule rayMissShaderModuleHandle = VK_NULL_HANDLE;
-  result = vkCreateShaderModule(deviceHandle, &rayMissShaderModuleCreateInfo,
-                                NULL, &rayMissShaderModuleHandle);
+    uint32_t sampleBits[2];
+    memcpy(sampleBits, sample, sizeof(sampleBits));
 
-  if (result != VK_SUCCESS) {
-    throwExceptionVulkanAPI(result, "vkCreateShaderModule");
+    if (sampleBits[0] == sampleData[4 * i + 2] &&
+        sampleBits[1] == sampleData[4 * i + 3]) {
+      matchCount += 1;
+    }
+    else if (matchCount == i) {
+      // only the first mismatch is printed
+      float deviceSample[2];
+      memcpy(deviceSample, &sampleData[4 * i + 2], sizeof(deviceSample));
+      std::cout << "Sampler self-test: index " << sampleData[4 * i + 0]
+                << ", seed " << sampleData[4 * i + 1] << " draws ("
+                << sample[0] << ", " << sample[1] << ") on the host and ("
+                << deviceSample[0] << ", " << deviceSample[1]
+                << ") on the GPU" << std::endl;
+    }
   }
 
-  // =========================================================================
-  // Ray Miss Shader Module (Shadow)
+  std::cout << "Sampler self-test: " << matchCount << " of " << sampleCount
+            << " samples match" << std::endl;
 
-  std::ifstream rayMissShadowFile("shaders/shader_shadow.rmiss.spv",
-                                  std::ios::binary | std::ios::ate);
-  std::streamsize rayMissShadowFileSize = rayMissShadowFile.tellg();
-  rayMissShadowFile.seekg(0, std::ios::beg);
-  std::vector<uint32_t> rayMissShadowShaderSource(rayMissShadowFileSize /
-                                                  sizeof(uint32_t));
-  rayMissShadowFile.read((char *)rayMissShadowShaderSource.data(),
-                         rayMissShadowFileSize);
-  rayMissShadowFile.close();
+  vkDestroyPipeline(deviceHandle, pipelineHandle, NULL);
+  vkDestroyShaderModule(deviceHandle, shaderModuleHandle, NULL);
+  vkDestroyPipelineLayout(deviceHandle, pipelineLayoutHandle, NULL);
+  vkDestroyDescriptorSetLayout(deviceHandle, descriptorSetLayoutHandle, NULL);
+  vkDestroyDescriptorPool(deviceHandle, descriptorPoolHandle, NULL);
+  vkFreeMemory(deviceHandle, sampleDeviceMemoryHandle, NULL);
+  vkDestroyBuffer(deviceHandle, sampleBufferHandle, NULL);
+}
 
-  VkShaderModuleCreateInfo rayMissShadowShaderModuleCreateInfo = {
-      .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
-      .pNext = NULL,
-      .flags = 0,
-      .codeSize = (uint32_t)rayMissShadowShaderSource.size() * sizeof(uint32_t),
-      .pCode = rayMissShadowShaderSource.data()};
+void createInstance(VkAccelerationStructureInstanceKHR& bottomLevelAccelerationStructureInstance,
+   VkDeviceAddress& bottomLevelAccelerationStructureDeviceAddress,
+  VkTransformMatrixKHR& transformMatrix,
+  uint32_t objIndex,
+  uint32_t mask)
+{
+  bottomLevelAccelerationStructureInstance =
+  {.transform = transformMatrix,
+    .instanceCustomIndex = objIndex,
+    .mask = mask,
+    .instanceShaderBindingTableRecordOffset = 0, 
+    .flags = VK_GEOMETRY_INSTANCE_TRIANGLE_FACING_CULL_DISABLE_BIT_KHR,
+    .accelerationStructureReference =
+        bottomLevelAccelerationStructureDeviceAddress};
+}
 
-  VkShaderModule rayMissShadowShaderModuleHandle = VK_NULL_HANDLE;
-  result =
-      vkCreateShaderModule(deviceHandle, &rayMissShadowShaderModuleCreateInfo,
-                           NULL, &rayMissShadowShaderModuleHandle);
+// largest factor the transform scales object space lengths by
+float getTransformScale(const glm::mat4& transform)
+{
+  return std::max(glm::length(glm::vec3(transform[0])),
+                  std::max(glm::length(glm::vec3(transform[1])),
+                           glm::length(glm::vec3(transform[2]))));
+}
 
-  if (result != VK_SUCCESS) {
-    throwExceptionVulkanAPI(result, "vkCreateShaderModule");
+// bounding sphere of the mesh around its AABB center: center (xyz) and
+// radius (w)
+glm::vec4 getMeshBoundingSphere(const Mesh& mesh)
+{
+  float minimum[3] = {INFINITY, INFINITY, INFINITY};
+  float maximum[3] = {-INFINITY, -INFINITY, -INFINITY};
+  for (uint32_t i = 0; i < mesh.vertexCount; i++) {
+    for (int j = 0; j < 3; j++) {
+      minimum[j] = std::min(minimum[j], mesh.vertices[MESH_VERTEX_STRIDE * i + j]);
+      maximum[j] = std::max(maximum[j], mesh.vertices[MESH_VERTEX_STRIDE * i + j]);
+    }
   }
 
-  // =========================================================================
-  // Ray Tracing Pipeline
+  if (mesh.vertexCount == 0) {
+    return glm::vec4(0.0f);
+  }
 
-  std::vector<VkPipelineShaderStageCreateInfo>
-      pipelineShaderStageCreateInfoList = {
-          {.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
-           .pNext = NULL,
-           .flags = 0,
-           .stage = VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR,
-           .module = rayClosestHitShaderModuleHandle,
-           .pName = "main",
-           .pSpecializationInfo = NULL},
-          {.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
-           .pNext = NULL,
-           .flags = 0,
-           .stage = VK_SHADER_STAGE_RAYGEN_BIT_KHR,
-           .module = rayGenerateShaderModuleHandle,
-           .pName = "main",
-           .pSpecializationInfo = NULL},
-          {.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
-           .pNext = NULL,
-           .flags = 0,
-           .stage = VK_SHADER_STAGE_MISS_BIT_KHR,
-           .module = rayMissShaderModuleHandle,
-           .pName = "main",
-           .pSpecializationInfo = NULL},
-          {.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
-           .pNext = NULL,
-           .flags = 0,
-           .stage = VK_SHADER_STAGE_MISS_BIT_KHR,
-           .module = rayMissShadowShaderModuleHandle,
-           .pName = "main",
-           .pSpecializationInfo = NULL}};
+  glm::vec3 center(0.5f * (minimum[0] + maximum[0]),
+                   0.5f * (minimum[1] + maximum[1]),
+                   0.5f * (minimum[2] + maximum[2]));
 
-  std::vector<VkRayTracingShaderGroupCreateInfoKHR>
-      rayTracingShaderGroupCreateInfoList = {
-          {.sType = VK_STRUCTURE_TYPE_RAY_TRACING_SHADER_GROUP_CREATE_INFO_KHR,
-           .pNext = NULL,
-           .type = VK_RAY_TRACING_SHADER_GROUP_TYPE_TRIANGLES_HIT_GROUP_KHR,
-           .generalShader = VK_SHADER_UNUSED_KHR,
+  float radius = 0.0f;
+  for (uint32_t i = 0; i < mesh.vertexCount; i++) {
+    const float *vertex = &mesh.vertices[MESH_VERTEX_STRIDE * i];
+    radius = std::max(radius,
+      glm::length(glm::vec3(vertex[0], vertex[1], vertex[2]) - center));
+  }
+
+  return glm::vec4(center, radius);
+}
+
+// LOD of an instance by the share of the screen height its bounding sphere
+// covers: 0 down to MESH_LOD_SCREEN_SIZE, one more every time the share
+// halves. Camera rays leave at 2.5 times the forward vector over the screen
+// plane (src/path_tracing.glsl), so the screen height at a distance is 0.8
+// times that distance.
+uint32_t getMeshLod(const glm::mat4& transform, glm::vec4 boundingSphere,
+                    glm::vec3 cameraPosition, uint32_t lodCount)
+{
+  glm::vec3 center = glm::vec3(transform *
+    glm::vec4(boundingSphere.x, boundingSphere.y, boundingSphere.z, 1.0f));
+  float radius = getTransformScale(transform) * boundingSphere.w;
+
+  float distance = glm::length(center - cameraPosition);
+  if (distance <= radius) {
+    return 0;
+  }
+
+  float screenSize = 2.5f * radius / distance;
+  if (screenSize >= MESH_LOD_SCREEN_SIZE) {
+    return 0;
+  }
+
+  float lod = 1.0f + floorf(log2f(MESH_LOD_SCREEN_SIZE / screenSize));
+  return (uint32_t)std::min(lod, (float)(lodCount - 1));
+}
+
+// LOD traced by the rays after the first bounce
+uint32_t getSecondaryMeshLod(uint32_t lod, uint32_t lodCount)
+{
+  return std::min<uint32_t>(lod + MESH_LOD_SECONDARY_BIAS, lodCount - 1);
+}
+
+// Points both TLAS instances of a scene instance at its LOD: the primary
+// instance (at the instance index) holds the LOD of the camera rays, the
+// secondary one (after all primary instances) the coarser LOD of the rays
+// after the first bounce. When both are the same LOD the primary instance
+// is traced by every ray and the secondary one by none.
+void setTopLevelInstanceLod(
+  std::vector<VkAccelerationStructureInstanceKHR>& bottomLevelAccelerationStructureInstance,
+  uint32_t instanceIndex,
+  uint32_t meshIndex,
+  uint32_t lod,
+  const MeshRegistry& meshRegistry,
+  std::vector<VkDeviceAddress>& bottomLevelAccelerationStructureDeviceAddress,
+  uint32_t mask)
+{
+  uint32_t instanceCount = bottomLevelAccelerationStructureInstance.size() / 2;
+  uint32_t secondaryLod =
+      getSecondaryMeshLod(lod, meshRegistry.getLodCount(meshIndex));
+
+  VkAccelerationStructureInstanceKHR& primaryInstance =
+      bottomLevelAccelerationStructureInstance[instanceIndex];
+  VkAccelerationStructureInstanceKHR& secondaryInstance =
+      bottomLevelAccelerationStructureInstance[instanceCount + instanceIndex];
+
+  primaryInstance.instanceCustomIndex =
+      (instanceIndex << MESH_LOD_INDEX_BITS) | lod;
+  primaryInstance.accelerationStructureReference =
+      bottomLevelAccelerationStructureDeviceAddress[
+          meshRegistry.getLodMeshIndex(meshIndex, lod)];
+
+  secondaryInstance.instanceCustomIndex =
+      (instanceIndex << MESH_LOD_INDEX_BITS) | secondaryLod;
+  secondaryInstance.accelerationStructureReference =
+      bottomLevelAccelerationStructureDeviceAddress[
+          meshRegistry.getLodMeshIndex(meshIndex, secondaryLod)];
+
+  if (secondaryLod == lod) {
+    primaryInstance.mask = mask;
+    secondaryInstance.mask = 0;
+  } else {
+    primaryInstance.mask = mask & PRIMARY_LOD_INSTANCE_MASK;
+    secondaryInstance.mask = mask & SECONDARY_LOD_INSTANCE_MASK;
+  }
+}
+
+  
+
+void getTLASBuildGeometryInfo(VkAccelerationStructureGeometryKHR& topLevelAccelerationStructureGeometry,
+  VkAccelerationStructureBuildGeometryInfoKHR& topLevelAccelerationStructureBuildGeometryInfo,
+  VkDeviceAddress instanceDeviceAddress,
+  bool update)
+{
+  VkAccelerationStructureGeometryDataKHR topLevelAccelerationStructureGeometryData =
+    {.instances = {
+          .sType =
+              VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_INSTANCES_DATA_KHR,
+          .pNext = NULL,
+          .arrayOfPointers = VK_FALSE,
+          .data = {.deviceAddress = instanceDeviceAddress}}};
+
+  topLevelAccelerationStructureGeometry = {
+    .sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_KHR,
+    .pNext = NULL,
+    .geometryType = VK_GEOMETRY_TYPE_INSTANCES_KHR,
+    .geometry = topLevelAccelerationStructureGeometryData,
+    .flags = VK_GEOMETRY_OPAQUE_BIT_KHR};
+
+  topLevelAccelerationStructureBuildGeometryInfo = {
+        .sType =
+            VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR,
+        .pNext = NULL,
+        .type = VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR,
+        .flags =  VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR,
+        .mode = update ? 
+          VK_BUILD_ACCELERATION_STRUCTURE_MODE_UPDATE_KHR : 
+          VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR,
+        .srcAccelerationStructure = VK_NULL_HANDLE,
+        .dstAccelerationStructure = VK_NULL_HANDLE,
+        .geometryCount = 1,
+        .pGeometries = &topLevelAccelerationStructureGeometry,
+        .ppGeometries = NULL,
+        .scratchData = {.deviceAddress = 0}};
+}
+
+// Records a TLAS build (or in-place update) from the instances in the
+// instance buffer; the command buffer must be in the recording state.
+void recordTLASBuild(VkCommandBuffer& commandBufferHandle,
+  VkAccelerationStructureKHR& topLevelAccelerationStructureHandle,
+  VkDeviceAddress instanceDeviceAddress,
+  VkDeviceAddress scratchDeviceAddress,
+  uint32_t instanceCount,
+  bool update)
+{
+  VkAccelerationStructureGeometryKHR topLevelAccelerationStructureGeometry;
+  VkAccelerationStructureBuildGeometryInfoKHR
+    topLevelAccelerationStructureBuildGeometryInfo;
+
+  getTLASBuildGeometryInfo(topLevelAccelerationStructureGeometry,
+    topLevelAccelerationStructureBuildGeometryInfo,
+    instanceDeviceAddress,
+    update);
+
+  topLevelAccelerationStructureBuildGeometryInfo.dstAccelerationStructure =
+      topLevelAccelerationStructureHandle;
+
+  topLevelAccelerationStructureBuildGeometryInfo.srcAccelerationStructure =
+    update ? topLevelAccelerationStructureHandle : VK_NULL_HANDLE;
+
+  topLevelAccelerationStructureBuildGeometryInfo.scratchData = {
+      .deviceAddress = scratchDeviceAddress};
+  
+  VkAccelerationStructureBuildRangeInfoKHR
+    topLevelAccelerationStructureBuildRangeInfo = {.primitiveCount = instanceCount,
+                                                    .primitiveOffset = 0,
+                                                    .firstVertex = 0,
+                                                    .transformOffset = 0};
+
+  const VkAccelerationStructureBuildRangeInfoKHR
+      *topLevelAccelerationStructureBuildRangeInfos =
+          &topLevelAccelerationStructureBuildRangeInfo;
+
+  pvkCmdBuildAccelerationStructuresKHR(
+    commandBufferHandle, 1,
+    &topLevelAccelerationStructureBuildGeometryInfo,
+    &topLevelAccelerationStructureBuildRangeInfos);
+}
+
+// Creates the TLAS with its instance and scratch buffers, which are kept for
+// later updates, and builds it once on the given queue.
+void createTLAS(VkAccelerationStructureKHR& topLevelAccelerationStructureHandle,
+  std::vector<VkAccelerationStructureInstanceKHR>& bottomLevelAccelerationStructureInstance,
+  uint32_t& queueFamilyIndex,
+  VkMemoryAllocateFlagsInfo memoryAllocateFlagsInfo,
+  VkBuffer& topLevelAccelerationStructureBufferHandle,
+  VkDeviceMemory& topLevelAccelerationStructureDeviceMemoryHandle,
+  VkBuffer& bottomLevelGeometryInstanceBufferHandle,
+  VkDeviceMemory& bottomLevelGeometryInstanceDeviceMemoryHandle,
+  VkDeviceAddress& bottomLevelGeometryInstanceDeviceAddress,
+  VkBuffer& topLevelAccelerationStructureScratchBufferHandle,
+  VkDeviceMemory& topLevelAccelerationStructureDeviceScratchMemoryHandle,
+  VkDeviceAddress& topLevelAccelerationStructureScratchBufferDeviceAddress,
+  VkCommandBuffer& commandBufferHandle,
+  VkQueue& queueHandle)
+{
+  VkResult result;
+
+  // create a buffer including all instances
+  bottomLevelGeometryInstanceBufferHandle = VK_NULL_HANDLE;
+  bottomLevelGeometryInstanceDeviceMemoryHandle = VK_NULL_HANDLE;
+
+  buildBuffer(bottomLevelGeometryInstanceBufferHandle, 
+    sizeof(VkAccelerationStructureInstanceKHR) * bottomLevelAccelerationStructureInstance.size(),
+    queueFamilyIndex,
+    (void*) bottomLevelAccelerationStructureInstance.data(),
+      VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR |
+      VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT |
+      VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+    &memoryAllocateFlagsInfo,
+    bottomLevelGeometryInstanceDeviceMemoryHandle,
+    bottomLevelGeometryInstanceDeviceAddress);
+
+  VkAccelerationStructureGeometryKHR topLevelAccelerationStructureGeometry;
+  VkAccelerationStructureBuildGeometryInfoKHR
+    topLevelAccelerationStructureBuildGeometryInfo;
+
+  getTLASBuildGeometryInfo(topLevelAccelerationStructureGeometry,
+    topLevelAccelerationStructureBuildGeometryInfo,
+    bottomLevelGeometryInstanceDeviceAddress,
+    false);
+
+  VkAccelerationStructureBuildSizesInfoKHR
+  topLevelAccelerationStructureBuildSizesInfo = {
+      .sType =
+          VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_SIZES_INFO_KHR,
+      .pNext = NULL,
+      .accelerationStructureSize = 0,
+      .updateScratchSize = 0,
+      .buildScratchSize = 0};
+  
+  uint32_t instanceCount =  (uint32_t) bottomLevelAccelerationStructureInstance.size();
+  std::vector<uint32_t> topLevelMaxPrimitiveCountList = { instanceCount };
+
+  pvkGetAccelerationStructureBuildSizesKHR(
+      deviceHandle, VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR,
+      &topLevelAccelerationStructureBuildGeometryInfo,
+      topLevelMaxPrimitiveCountList.data(),
+      &topLevelAccelerationStructureBuildSizesInfo);
+  
+  topLevelAccelerationStructureBufferHandle = VK_NULL_HANDLE;
+  createBuffer(topLevelAccelerationStructureBufferHandle,
+    topLevelAccelerationStructureBuildSizesInfo.accelerationStructureSize,
+    VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_STORAGE_BIT_KHR, 
+    queueFamilyIndex);
+
+  topLevelAccelerationStructureDeviceMemoryHandle = VK_NULL_HANDLE;
+  allocAndBind(topLevelAccelerationStructureDeviceMemoryHandle,
+    NULL,
+    topLevelAccelerationStructureBufferHandle,
+    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  
+  VkAccelerationStructureCreateInfoKHR topLevelAccelerationStructureCreateInfo =
+      {.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_CREATE_INFO_KHR,
+      .pNext = NULL,
+      .createFlags = 0,
+      .buffer = topLevelAccelerationStructureBufferHandle,
+      .offset = 0,
+      .size = topLevelAccelerationStructureBuildSizesInfo
+                  .accelerationStructureSize,
+      .type = VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR,
+      .deviceAddress = 0};
+  
+  topLevelAccelerationStructureHandle = VK_NULL_HANDLE;
+
+  result = pvkCreateAccelerationStructureKHR(
+      deviceHandle, &topLevelAccelerationStructureCreateInfo, NULL,
+      &topLevelAccelerationStructureHandle);
+
+  if (result != VK_SUCCESS) {
+    throwExceptionVulkanAPI(result, "vkCreateAccelerationStructureKHR");
+  }
+  
+  //----------------------build----------------------
+  
+  // large enough for both the initial build and the per-frame updates
+  topLevelAccelerationStructureScratchBufferHandle = VK_NULL_HANDLE;
+  createBuffer(topLevelAccelerationStructureScratchBufferHandle,
+    std::max(topLevelAccelerationStructureBuildSizesInfo.buildScratchSize,
+             topLevelAccelerationStructureBuildSizesInfo.updateScratchSize),
+      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+      VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+    queueFamilyIndex);
+
+  topLevelAccelerationStructureDeviceScratchMemoryHandle = VK_NULL_HANDLE;
+
+  allocAndBind(topLevelAccelerationStructureDeviceScratchMemoryHandle,
+    &memoryAllocateFlagsInfo,
+    topLevelAccelerationStructureScratchBufferHandle,
+    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  
+  VkBufferDeviceAddressInfo
+    topLevelAccelerationStructureScratchBufferDeviceAddressInfo = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO,
+        .pNext = NULL,
+        .buffer = topLevelAccelerationStructureScratchBufferHandle};
+
+  topLevelAccelerationStructureScratchBufferDeviceAddress =
+      pvkGetBufferDeviceAddressKHR(
+          deviceHandle,
+          &topLevelAccelerationStructureScratchBufferDeviceAddressInfo);
+
+  VkCommandBufferBeginInfo topLevelCommandBufferBeginInfo = {
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+      .pNext = NULL,
+      .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+      .pInheritanceInfo = NULL};
+
+  result = vkBeginCommandBuffer(commandBufferHandle,
+                              &topLevelCommandBufferBeginInfo);
+
+  if (result != VK_SUCCESS) {
+    throwExceptionVulkanAPI(result, "vkBeginCommandBuffer");
+  }
+
+  recordTLASBuild(commandBufferHandle,
+    topLevelAccelerationStructureHandle,
+    bottomLevelGeometryInstanceDeviceAddress,
+    topLevelAccelerationStructureScratchBufferDeviceAddress,
+    instanceCount,
+    false);
+
+  result = vkEndCommandBuffer(commandBufferHandle);
+
+  if (result != VK_SUCCESS) {
+    throwExceptionVulkanAPI(result, "vkEndCommandBuffer");
+  }
+
+  submitAndWait(commandBufferHandle, queueHandle);
+}
+
+
+int main(int argc, char **argv) {
+  VkResult result;
+
+  // =========================================================================
+  // Render Backend
+  // (RENDER_BACKEND in config.h, overridden with --backend <name>)
+
+  std::vector<std::string> renderBackendNameList = {"megakernel", "wavefront",
+                                                   "rayquery"};
+  uint32_t renderBackend = RENDER_BACKEND;
+
+  for (int i = 1; i < argc; i++) {
+    std::string argument = argv[i];
+    if (argument != "--backend" || i + 1 == argc) {
+      throwExceptionMessage(
+          "Usage: main [--backend megakernel|wavefront|rayquery]");
+    }
+
+    std::vector<std::string>::iterator renderBackendName = std::find(
+        renderBackendNameList.begin(), renderBackendNameList.end(), argv[++i]);
+    if (renderBackendName == renderBackendNameList.end()) {
+      throwExceptionMessage("Unknown render backend " + std::string(argv[i]));
+    }
+    renderBackend = renderBackendName - renderBackendNameList.begin();
+  }
+
+  std::cout << "Render backend: " << renderBackendNameList[renderBackend]
+            << std::endl;
+
+  // =========================================================================
+  // GLFW, Window
+
+  glfwInit();
+  glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+  glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
+  GLFWwindow *windowPtr = glfwCreateWindow(800, 600, "Vulkan", NULL, NULL);
+  glfwSetInputMode(windowPtr, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
+  glfwSetKeyCallback(windowPtr, keyCallback);
+  glfwSetMouseButtonCallback(windowPtr, mouseButtonCallback);
+  glfwSetFramebufferSizeCallback(windowPtr, framebufferSizeCallback);
+
+  // =========================================================================
+  // Vulkan Instance
+
+#ifdef VALIDATION_LAYERS_ENABLED
+  std::vector<VkValidationFeatureEnableEXT> validationFeatureEnableList = {
+      VK_VALIDATION_FEATURE_ENABLE_BEST_PRACTICES_EXT,
+      VK_VALIDATION_FEATURE_ENABLE_DEBUG_PRINTF_EXT,
+      VK_VALIDATION_FEATURE_ENABLE_SYNCHRONIZATION_VALIDATION_EXT};
+
+  VkDebugUtilsMessageSeverityFlagBitsEXT debugUtilsMessageSeverityFlagBits =
+      (VkDebugUtilsMessageSeverityFlagBitsEXT)(
+          VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT |
+          VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT |
+          VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT |
+          VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT);
+
+  VkDebugUtilsMessageTypeFlagBitsEXT debugUtilsMessageTypeFlagBits =
+      (VkDebugUtilsMessageTypeFlagBitsEXT)(
+          VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT |
+          VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT |
+          VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT);
+
+  VkValidationFeaturesEXT validationFeatures = {
+      .sType = VK_STRUCTURE_TYPE_VALIDATION_FEATURES_EXT,
+      .pNext = NULL,
+      .enabledValidationFeatureCount =
+          (uint32_t)validationFeatureEnableList.size(),
+      .pEnabledValidationFeatures = validationFeatureEnableList.data(),
+      .disabledValidationFeatureCount = 0,
+      .pDisabledValidationFeatures = NULL};
+
+  VkDebugUtilsMessengerCreateInfoEXT debugUtilsMessengerCreateInfo = {
+      .sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT,
+      .pNext = &validationFeatures,
+      .flags = 0,
+      .messageSeverity = debugUtilsMessageSeverityFlagBits,
+      .messageType = debugUtilsMessageTypeFlagBits,
+      .pfnUserCallback = &debugCallback,
+      .pUserData = NULL};
+#endif
+
+  VkApplicationInfo applicationInfo = {
+      .sType = VK_STRUCTURE_TYPE_APPLICATION_INFO,
+      .pNext = NULL,
+      .pApplicationName = "Ray Tracing Pipeline Example",
+      .applicationVersion = VK_MAKE_VERSION(1, 0, 0),
+      .pEngineName = "",
+      .engineVersion = VK_MAKE_VERSION(1, 0, 0),
+      .apiVersion = VK_API_VERSION_1_3};
+
+  std::vector<const char *> instanceLayerList = {
+#ifdef VALIDATION_LAYERS_ENABLED
+    "VK_LAYER_KHRONOS_validation"
+#endif
+  };
+
+  uint32_t glfwExtensionCount = 0;
+  const char **glfwExtensions =
+      glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+
+  std::vector<const char *> instanceExtensionList(
+      glfwExtensions, glfwExtensions + glfwExtensionCount);
+
+  instanceExtensionList.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
+  instanceExtensionList.push_back("VK_KHR_surface");
+
+  VkInstanceCreateInfo instanceCreateInfo = {
+      .sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO,
+#ifdef VALIDATION_LAYERS_ENABLED
+      .pNext = &debugUtilsMessengerCreateInfo,
+#else
+      .pNext = NULL,
+#endif
+      .flags = 0,
+      .pApplicationInfo = &applicationInfo,
+      .enabledLayerCount = (uint32_t)instanceLayerList.size(),
+      .ppEnabledLayerNames = instanceLayerList.data(),
+      .enabledExtensionCount = (uint32_t)instanceExtensionList.size(),
+      .ppEnabledExtensionNames = instanceExtensionList.data(),
+  };
+
+  VkInstance instanceHandle = VK_NULL_HANDLE;
+  result = vkCreateInstance(&instanceCreateInfo, NULL, &instanceHandle);
+
+  if (result != VK_SUCCESS) {
+    throwExceptionVulkanAPI(result, "vkCreateInstance");
+  }
+
+  // =========================================================================
+  // Window Surface
+
+  VkSurfaceKHR surfaceHandle = VK_NULL_HANDLE;
+  result =
+      glfwCreateWindowSurface(instanceHandle, windowPtr, NULL, &surfaceHandle);
+
+  if (result != VK_SUCCESS) {
+    throwExceptionVulkanAPI(result, "glfwCreateWindowSurface");
+  }
+
+  // =========================================================================
+  // Physical Device
+
+  uint32_t physicalDeviceCount = 0;
+  result =
+      vkEnumeratePhysicalDevices(instanceHandle, &physicalDeviceCount, NULL);
+
+  if (result != VK_SUCCESS) {
+    throwExceptionVulkanAPI(result, "vkEnumeratePhysicalDevices");
+  }
+
+  std::vector<VkPhysicalDevice> physicalDeviceHandleList(physicalDeviceCount);
+  result = vkEnumeratePhysicalDevices(instanceHandle, &physicalDeviceCount,
+                                      physicalDeviceHandleList.data());
+
+  if (result != VK_SUCCESS) {
+    throwExceptionVulkanAPI(result, "vkEnumeratePhysicalDevices");
+  }
+
+  VkPhysicalDevice activePhysicalDeviceHandle = physicalDeviceHandleList[0];
+
+  VkPhysicalDeviceRayTracingPipelinePropertiesKHR
+      physicalDeviceRayTracingPipelineProperties = {
+          .sType =
+              VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_TRACING_PIPELINE_PROPERTIES_KHR,
+          .pNext = NULL};
+
+  VkPhysicalDeviceProperties2 physicalDeviceProperties2 = {
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+      .pNext = &physicalDeviceRayTracingPipelineProperties};
+
+  vkGetPhysicalDeviceProperties2(activePhysicalDeviceHandle,
+                                 &physicalDeviceProperties2);
+
+  //init VkPhysicalDeviceMemoryProperties physicalDeviceMemoryProperties
+  vkGetPhysicalDeviceMemoryProperties(activePhysicalDeviceHandle,
+                                      &physicalDeviceMemoryProperties);
+
+  std::cout << physicalDeviceProperties2.properties.deviceName << std::endl;
+
+  // =========================================================================
+  // Ray Tracing Pipeline and Ray Query Support
+  // (the ray query backend falls back to the megakernel without
+  //  VK_KHR_ray_query, the other backends to the ray query one without
+  //  VK_KHR_ray_tracing_pipeline)
+
+  uint32_t deviceExtensionPropertyCount = 0;
+  result = vkEnumerateDeviceExtensionProperties(
+      activePhysicalDeviceHandle, NULL, &deviceExtensionPropertyCount, NULL);
+
+  if (result != VK_SUCCESS) {
+    throwExceptionVulkanAPI(result, "vkEnumerateDeviceExtensionProperties");
+  }
+
+  std::vector<VkExtensionProperties> deviceExtensionPropertiesList(
+      deviceExtensionPropertyCount);
+  result = vkEnumerateDeviceExtensionProperties(
+      activePhysicalDeviceHandle, NULL, &deviceExtensionPropertyCount,
+      deviceExtensionPropertiesList.data());
+
+  if (result != VK_SUCCESS) {
+    throwExceptionVulkanAPI(result, "vkEnumerateDeviceExtensionProperties");
+  }
+
+  bool isRayTracingPipelineSupported = false;
+  bool isRayQuerySupported = false;
+  for (uint32_t x = 0; x < deviceExtensionPropertiesList.size(); x++) {
+    std::string extensionName = deviceExtensionPropertiesList[x].extensionName;
+    if (extensionName == "VK_KHR_ray_tracing_pipeline") {
+      isRayTracingPipelineSupported = true;
+    }
+    if (extensionName == "VK_KHR_ray_query") {
+      isRayQuerySupported = true;
+    }
+  }
+
+  if (renderBackend == 2 && !isRayQuerySupported) {
+    std::cout << "VK_KHR_ray_query is not supported, using the megakernel"
+              << std::endl;
+    renderBackend = 0;
+  }
+
+  if (renderBackend != 2 && !isRayTracingPipelineSupported &&
+      isRayQuerySupported) {
+    std::cout << "VK_KHR_ray_tracing_pipeline is not supported, using "
+              << "rayquery" << std::endl;
+    renderBackend = 2;
+  }
+
+  const bool isWavefrontEnabled = renderBackend == 1;
+  const bool isRayQueryEnabled = renderBackend == 2;
+
+  // the benchmark times both backends whatever the selected one is, as far
+  // as the device supports them
+#ifdef RENDER_BACKEND_BENCHMARK
+  const bool isRayTracingPipelineNeeded =
+      !isRayQueryEnabled || isRayTracingPipelineSupported;
+  const bool isRayQueryPipelineNeeded = isRayQuerySupported;
+#else
+  const bool isRayTracingPipelineNeeded = !isRayQueryEnabled;
+  const bool isRayQueryPipelineNeeded = isRayQueryEnabled;
+#endif
+
+  if (!isRayTracingPipelineNeeded) {
+    rayTracingShaderStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+  }
+
+  // the wavefront backend queues its shadow rays anyway, the ray query
+  // backend has no second trace
+#ifdef SHADOW_RAY_BATCHING_ENABLED
+  const bool isShadowRayBatchingEnabled = !isWavefrontEnabled && !isRayQueryEnabled;
+#else
+  const bool isShadowRayBatchingEnabled = false;
+#endif
+
+  // =========================================================================
+  // Physical Device Features
+
+  VkPhysicalDeviceDescriptorIndexingFeatures
+      physicalDeviceDescriptorIndexingFeatures = {
+          .sType =
+              VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES,
+          .pNext = NULL,
+          .shaderSampledImageArrayNonUniformIndexing = VK_TRUE,
+          .descriptorBindingPartiallyBound = VK_TRUE,
+          .runtimeDescriptorArray = VK_TRUE};
+
+  VkPhysicalDeviceBufferDeviceAddressFeatures
+      physicalDeviceBufferDeviceAddressFeatures = {
+          .sType =
+              VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_BUFFER_DEVICE_ADDRESS_FEATURES,
+          .pNext = &physicalDeviceDescriptorIndexingFeatures,
+          .bufferDeviceAddress = VK_TRUE,
+          .bufferDeviceAddressCaptureReplay = VK_FALSE,
+          .bufferDeviceAddressMultiDevice = VK_FALSE};
+
+  VkPhysicalDeviceAccelerationStructureFeaturesKHR
+      physicalDeviceAccelerationStructureFeatures = {
+          .sType =
+              VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ACCELERATION_STRUCTURE_FEATURES_KHR,
+          .pNext = &physicalDeviceBufferDeviceAddressFeatures,
+          .accelerationStructure = VK_TRUE,
+          .accelerationStructureCaptureReplay = VK_FALSE,
+          .accelerationStructureIndirectBuild = VK_FALSE,
+          .accelerationStructureHostCommands = VK_FALSE,
+          .descriptorBindingAccelerationStructureUpdateAfterBind = VK_FALSE};
+
+  // the wavefront kernels are traced with sizes written by shader_bin.comp
+  VkPhysicalDeviceRayTracingPipelineFeaturesKHR
+      physicalDeviceRayTracingPipelineFeatures = {
+          .sType =
+              VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_TRACING_PIPELINE_FEATURES_KHR,
+          .pNext = &physicalDeviceAccelerationStructureFeatures,
+          .rayTracingPipeline = VK_TRUE,
+          .rayTracingPipelineShaderGroupHandleCaptureReplay = VK_FALSE,
+          .rayTracingPipelineShaderGroupHandleCaptureReplayMixed = VK_FALSE,
+          .rayTracingPipelineTraceRaysIndirect = isWavefrontEnabled,
+          .rayTraversalPrimitiveCulling = VK_FALSE};
+
+  // the ray tracing pipeline features are chained only when the device
+  // creates ray tracing pipelines
+  void *rayTracingFeaturesHead =
+      isRayTracingPipelineNeeded
+          ? (void *)&physicalDeviceRayTracingPipelineFeatures
+          : (void *)&physicalDeviceAccelerationStructureFeatures;
+
+  VkPhysicalDeviceRayQueryFeaturesKHR physicalDeviceRayQueryFeatures = {
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_QUERY_FEATURES_KHR,
+      .pNext = rayTracingFeaturesHead,
+      .rayQuery = VK_TRUE};
+  // the tonemap pass stores to BGRA swapchain images, which have no
+  // matching SPIR-V image format
+  VkPhysicalDeviceFeatures deviceFeatures = {
+      .geometryShader = VK_TRUE,
+      .shaderStorageImageWriteWithoutFormat = VK_TRUE};
+
+  // =========================================================================
+  // Physical Device Submission Queue Families
+
+  uint32_t queueFamilyPropertyCount = 0;
+  vkGetPhysicalDeviceQueueFamilyProperties(activePhysicalDeviceHandle,
+                                           &queueFamilyPropertyCount, NULL);
+
+  std::vector<VkQueueFamilyProperties> queueFamilyPropertiesList(
+      queueFamilyPropertyCount);
+
+  vkGetPhysicalDeviceQueueFamilyProperties(activePhysicalDeviceHandle,
+                                           &queueFamilyPropertyCount,
+                                           queueFamilyPropertiesList.data());
+
+  uint32_t queueFamilyIndex = -1;
+  for (uint32_t x = 0; x < queueFamilyPropertiesList.size(); x++) {
+    if (queueFamilyPropertiesList[x].queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+
+      VkBool32 isPresentSupported = false;
+      result = vkGetPhysicalDeviceSurfaceSupportKHR(
+          activePhysicalDeviceHandle, x, surfaceHandle, &isPresentSupported);
+
+      if (result != VK_SUCCESS) {
+        throwExceptionVulkanAPI(result, "vkGetPhysicalDeviceSurfaceSupportKHR");
+      }
+
+      if (isPresentSupported) {
+        queueFamilyIndex = x;
+        break;
+      }
+    }
+  }
+
+  // dedicated transfer family for the texture uploads, falling back to the
+  // graphics family
+  uint32_t transferQueueFamilyIndex = queueFamilyIndex;
+  for (uint32_t x = 0; x < queueFamilyPropertiesList.size(); x++) {
+    VkQueueFlags queueFlags = queueFamilyPropertiesList[x].queueFlags;
+    if ((queueFlags & VK_QUEUE_TRANSFER_BIT) &&
+        !(queueFlags & VK_QUEUE_GRAPHICS_BIT) &&
+        !(queueFlags & VK_QUEUE_COMPUTE_BIT)) {
+      transferQueueFamilyIndex = x;
+      break;
+    }
+  }
+
+  std::cout << "Queue families: graphics " << queueFamilyIndex
+            << ", transfer " << transferQueueFamilyIndex << std::endl;
+
+  std::vector<uint32_t> uniqueQueueFamilyIndexList = {queueFamilyIndex};
+  if (transferQueueFamilyIndex != queueFamilyIndex) {
+    uniqueQueueFamilyIndexList.push_back(transferQueueFamilyIndex);
+  }
+
+  std::vector<float> queuePrioritiesList = {1.0f};
+  std::vector<VkDeviceQueueCreateInfo> deviceQueueCreateInfoList;
+  for (uint32_t familyIndex : uniqueQueueFamilyIndexList) {
+    deviceQueueCreateInfoList.push_back(
+        {.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+         .pNext = NULL,
+         .flags = 0,
+         .queueFamilyIndex = familyIndex,
+         .queueCount = 1,
+         .pQueuePriorities = queuePrioritiesList.data()});
+  }
+
+  // =========================================================================
+  // Logical Device
+
+  std::vector<const char *> deviceExtensionList = {
+      "VK_KHR_acceleration_structure",
+      "VK_EXT_descriptor_indexing",
+      "VK_KHR_maintenance3",
+      "VK_KHR_buffer_device_address",
+      "VK_KHR_deferred_host_operations",
+      "VK_KHR_swapchain"};
+
+  if (isRayTracingPipelineNeeded) {
+    deviceExtensionList.push_back("VK_KHR_ray_tracing_pipeline");
+  }
+  if (isRayQueryPipelineNeeded) {
+    deviceExtensionList.push_back("VK_KHR_ray_query");
+  }
+
+  VkDeviceCreateInfo deviceCreateInfo = {
+      .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
+      .pNext = isRayQueryPipelineNeeded
+                   ? (void *)&physicalDeviceRayQueryFeatures
+                   : rayTracingFeaturesHead,
+      .flags = 0,
+      .queueCreateInfoCount = (uint32_t)deviceQueueCreateInfoList.size(),
+      .pQueueCreateInfos = deviceQueueCreateInfoList.data(),
+      .enabledLayerCount = (uint32_t)instanceLayerList.size(),
+      .ppEnabledLayerNames = instanceLayerList.data(),
+      .enabledExtensionCount = (uint32_t)deviceExtensionList.size(),
+      .ppEnabledExtensionNames = deviceExtensionList.data(),
+      .pEnabledFeatures = &deviceFeatures};
+
+  deviceHandle = VK_NULL_HANDLE;
+  result = vkCreateDevice(activePhysicalDeviceHandle, &deviceCreateInfo, NULL,
+                          &deviceHandle);
+
+  if (result != VK_SUCCESS) {
+    throwExceptionVulkanAPI(result, "vkCreateDevice");
+  }
+
+  // =========================================================================
+  // Submission Queue
+
+  VkQueue queueHandle = VK_NULL_HANDLE;
+  vkGetDeviceQueue(deviceHandle, queueFamilyIndex, 0, &queueHandle);
+
+  VkQueue transferQueueHandle = VK_NULL_HANDLE;
+  vkGetDeviceQueue(deviceHandle, transferQueueFamilyIndex, 0,
+                   &transferQueueHandle);
+
+  // =========================================================================
+  // Device Pointer Functions
+
+  pvkGetBufferDeviceAddressKHR =
+      (PFN_vkGetBufferDeviceAddressKHR)vkGetDeviceProcAddr(
+          deviceHandle, "vkGetBufferDeviceAddressKHR");
+
+  pvkCreateRayTracingPipelinesKHR =
+      (PFN_vkCreateRayTracingPipelinesKHR)vkGetDeviceProcAddr(
+          deviceHandle, "vkCreateRayTracingPipelinesKHR");
+
+  
+  pvkGetAccelerationStructureBuildSizesKHR =
+      (PFN_vkGetAccelerationStructureBuildSizesKHR)vkGetDeviceProcAddr(
+          deviceHandle, "vkGetAccelerationStructureBuildSizesKHR");
+
+  pvkCreateAccelerationStructureKHR =
+      (PFN_vkCreateAccelerationStructureKHR)vkGetDeviceProcAddr(
+          deviceHandle, "vkCreateAccelerationStructureKHR");
+
+  pvkDestroyAccelerationStructureKHR =
+      (PFN_vkDestroyAccelerationStructureKHR)vkGetDeviceProcAddr(
+          deviceHandle, "vkDestroyAccelerationStructureKHR");
+
+  pvkGetAccelerationStructureDeviceAddressKHR =
+      (PFN_vkGetAccelerationStructureDeviceAddressKHR)vkGetDeviceProcAddr(
+          deviceHandle, "vkGetAccelerationStructureDeviceAddressKHR");
+
+  pvkCmdBuildAccelerationStructuresKHR =
+      (PFN_vkCmdBuildAccelerationStructuresKHR)vkGetDeviceProcAddr(
+          deviceHandle, "vkCmdBuildAccelerationStructuresKHR");
+
+  pvkGetRayTracingShaderGroupHandlesKHR =
+      (PFN_vkGetRayTracingShaderGroupHandlesKHR)vkGetDeviceProcAddr(
+          deviceHandle, "vkGetRayTracingShaderGroupHandlesKHR");
+
+  pvkCmdTraceRaysKHR =
+      (PFN_vkCmdTraceRaysKHR)vkGetDeviceProcAddr(deviceHandle,
+                                                 "vkCmdTraceRaysKHR");
+
+  pvkCmdTraceRaysIndirectKHR =
+      (PFN_vkCmdTraceRaysIndirectKHR)vkGetDeviceProcAddr(
+          deviceHandle, "vkCmdTraceRaysIndirectKHR");
+
+  pvkCmdWriteAccelerationStructuresPropertiesKHR =
+      (PFN_vkCmdWriteAccelerationStructuresPropertiesKHR)vkGetDeviceProcAddr(
+          deviceHandle, "vkCmdWriteAccelerationStructuresPropertiesKHR");
+
+  pvkCmdCopyAccelerationStructureKHR =
+      (PFN_vkCmdCopyAccelerationStructureKHR)vkGetDeviceProcAddr(
+          deviceHandle, "vkCmdCopyAccelerationStructureKHR");
+
+  VkMemoryAllocateFlagsInfo memoryAllocateFlagsInfo = {
+      .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO,
+      .pNext = NULL,
+      .flags = VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT,
+      .deviceMask = 0};
+
+  // =========================================================================
+  // Command Pool
+
+  VkCommandPoolCreateInfo commandPoolCreateInfo = {
+      .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+      .pNext = NULL,
+      .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+      .queueFamilyIndex = queueFamilyIndex};
+
+  VkCommandPool commandPoolHandle = VK_NULL_HANDLE;
+  result = vkCreateCommandPool(deviceHandle, &commandPoolCreateInfo, NULL,
+                               &commandPoolHandle);
+
+  if (result != VK_SUCCESS) {
+    throwExceptionVulkanAPI(result, "vkCreateCommandPool");
+  }
+
+  // =========================================================================
+  // Command Buffers
+
+  VkCommandBufferAllocateInfo commandBufferAllocateInfo = {
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+      .pNext = NULL,
+      .commandPool = commandPoolHandle,
+      .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+      .commandBufferCount = 16};
+
+  std::vector<VkCommandBuffer> commandBufferHandleList =
+      std::vector<VkCommandBuffer>(16, VK_NULL_HANDLE);
+
+  result = vkAllocateCommandBuffers(deviceHandle, &commandBufferAllocateInfo,
+                                    commandBufferHandleList.data());
+
+  if (result != VK_SUCCESS) {
+    throwExceptionVulkanAPI(result, "vkAllocateCommandBuffers");
+  }
+
+  // =========================================================================
+  // Transfer Command Pool, Command Buffer
+
+  VkCommandPoolCreateInfo transferCommandPoolCreateInfo = {
+      .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+      .pNext = NULL,
+      .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+      .queueFamilyIndex = transferQueueFamilyIndex};
+
+  VkCommandPool transferCommandPoolHandle = VK_NULL_HANDLE;
+  result = vkCreateCommandPool(deviceHandle, &transferCommandPoolCreateInfo,
+                               NULL, &transferCommandPoolHandle);
+
+  if (result != VK_SUCCESS) {
+    throwExceptionVulkanAPI(result, "vkCreateCommandPool");
+  }
+
+  VkCommandBufferAllocateInfo transferCommandBufferAllocateInfo = {
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+      .pNext = NULL,
+      .commandPool = transferCommandPoolHandle,
+      .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+      .commandBufferCount = 1};
+
+  VkCommandBuffer transferCommandBufferHandle = VK_NULL_HANDLE;
+  result = vkAllocateCommandBuffers(deviceHandle,
+                                    &transferCommandBufferAllocateInfo,
+                                    &transferCommandBufferHandle);
+
+  if (result != VK_SUCCESS) {
+    throwExceptionVulkanAPI(result, "vkAllocateCommandBuffers");
+  }
+
+  // =========================================================================
+  // Surface Features
+
+  VkSurfaceCapabilitiesKHR surfaceCapabilities;
+  result = vkGetPhysicalDeviceSurfaceCapabilitiesKHR(
+      activePhysicalDeviceHandle, surfaceHandle, &surfaceCapabilities);
+
+  if (result != VK_SUCCESS) {
+    throwExceptionVulkanAPI(result,
+                            "vkGetPhysicalDeviceSurfaceCapabilitiesKHR");
+  }
+
+  uint32_t surfaceFormatCount = 0;
+  result = vkGetPhysicalDeviceSurfaceFormatsKHR(
+      activePhysicalDeviceHandle, surfaceHandle, &surfaceFormatCount, NULL);
+
+  if (result != VK_SUCCESS) {
+    throwExceptionVulkanAPI(result, "vkGetPhysicalDeviceSurfaceFormatsKHR");
+  }
+
+  std::vector<VkSurfaceFormatKHR> surfaceFormatList(surfaceFormatCount);
+  result = vkGetPhysicalDeviceSurfaceFormatsKHR(
+      activePhysicalDeviceHandle, surfaceHandle, &surfaceFormatCount,
+      surfaceFormatList.data());
+
+  if (result != VK_SUCCESS) {
+    throwExceptionVulkanAPI(result, "vkGetPhysicalDeviceSurfaceFormatsKHR");
+  }
+
+  uint32_t presentModeCount = 0;
+  result = vkGetPhysicalDeviceSurfacePresentModesKHR(
+      activePhysicalDeviceHandle, surfaceHandle, &presentModeCount, NULL);
+
+  if (result != VK_SUCCESS) {
+    throwExceptionVulkanAPI(result,
+                            "vkGetPhysicalDeviceSurfacePresentModesKHR");
+  }
+
+  std::vector<VkPresentModeKHR> presentModeList(presentModeCount);
+  result = vkGetPhysicalDeviceSurfacePresentModesKHR(
+      activePhysicalDeviceHandle, surfaceHandle, &presentModeCount,
+      presentModeList.data());
+
+  if (result != VK_SUCCESS) {
+    throwExceptionVulkanAPI(result,
+                            "vkGetPhysicalDeviceSurfacePresentModesKHR");
+  }
+
+  // =========================================================================
+  // Swapchain
+
+  // the tonemap pass writes the swapchain images as storage images and does
+  // the sRGB encoding itself, so a UNORM format with storage support is used
+  VkSurfaceFormatKHR swapchainSurfaceFormat = {
+      .format = VK_FORMAT_UNDEFINED,
+      .colorSpace = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR};
+
+  for (VkSurfaceFormatKHR surfaceFormat : surfaceFormatList) {
+    if (surfaceFormat.format != VK_FORMAT_B8G8R8A8_UNORM &&
+        surfaceFormat.format != VK_FORMAT_R8G8B8A8_UNORM) {
+      continue;
+    }
+
+    VkFormatProperties formatProperties;
+    vkGetPhysicalDeviceFormatProperties(activePhysicalDeviceHandle,
+                                        surfaceFormat.format,
+                                        &formatProperties);
+
+    if (formatProperties.optimalTilingFeatures &
+        VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT) {
+      swapchainSurfaceFormat = surfaceFormat;
+      break;
+    }
+  }
+
+  if (swapchainSurfaceFormat.format == VK_FORMAT_UNDEFINED ||
+      !(surfaceCapabilities.supportedUsageFlags & VK_IMAGE_USAGE_STORAGE_BIT)) {
+    throwExceptionMessage("No swapchain format supports storage image writes");
+  }
+
+#ifndef TEST_FPS
+  VkPresentModeKHR swapchainPresentMode =
+      selectPresentMode(presentModeList, PRESENT_MODE_POLICY);
+#else
+  VkPresentModeKHR swapchainPresentMode =
+      selectPresentMode(presentModeList, 2);
+#endif
+
+  VkSwapchainCreateInfoKHR swapchainCreateInfo = {
+      .sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR,
+      .pNext = NULL,
+      .flags = 0,
+      .surface = surfaceHandle,
+      .minImageCount = surfaceCapabilities.minImageCount + 1,
+      .imageFormat = swapchainSurfaceFormat.format,
+      .imageColorSpace = swapchainSurfaceFormat.colorSpace,
+      .imageExtent = surfaceCapabilities.currentExtent,
+      .imageArrayLayers = 1,
+      .imageUsage = VK_IMAGE_USAGE_STORAGE_BIT,
+      .imageSharingMode = VK_SHARING_MODE_EXCLUSIVE,
+      .queueFamilyIndexCount = 1,
+      .pQueueFamilyIndices = &queueFamilyIndex,
+      .preTransform = surfaceCapabilities.currentTransform,
+      .compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR,
+      .presentMode = swapchainPresentMode,
+      .clipped = VK_TRUE,
+      .oldSwapchain = VK_NULL_HANDLE};
+
+  VkSwapchainKHR swapchainHandle = VK_NULL_HANDLE;
+  result = vkCreateSwapchainKHR(deviceHandle, &swapchainCreateInfo, NULL,
+                                &swapchainHandle);
+
+  if (result != VK_SUCCESS) {
+    throwExceptionVulkanAPI(result, "vkCreateSwapchainKHR");
+  }
+
+  // =========================================================================
+  // Swapchain Images
+
+  uint32_t swapchainImageCount = 0;
+  result = vkGetSwapchainImagesKHR(deviceHandle, swapchainHandle,
+                                   &swapchainImageCount, NULL);
+
+  if (result != VK_SUCCESS) {
+    throwExceptionVulkanAPI(result, "vkGetSwapchainImagesKHR");
+  }
+
+  std::vector<VkImage> swapchainImageHandleList(swapchainImageCount);
+  result = vkGetSwapchainImagesKHR(deviceHandle, swapchainHandle,
+                                   &swapchainImageCount,
+                                   swapchainImageHandleList.data());
+
+  if (result != VK_SUCCESS) {
+    throwExceptionVulkanAPI(result, "vkGetSwapchainImagesKHR");
+  }
+
+  std::vector<VkImageView> swapchainImageViewHandleList;
+  createSwapchainImageViews(swapchainImageViewHandleList,
+    swapchainImageHandleList,
+    swapchainSurfaceFormat.format);
+
+  // frames the CPU may queue ahead of the GPU, each one adds up to a frame
+  // of latency
+  uint32_t framesInFlightCount =
+      std::min((uint32_t)MAX_FRAMES_IN_FLIGHT, swapchainImageCount);
+
+  // =========================================================================
+  // Descriptor Pool
+
+  std::vector<VkDescriptorPoolSize> descriptorPoolSizeList = {
+      {.type = VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR,
+       .descriptorCount = 1},
+      {.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, .descriptorCount = 1},
+      {.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = 14},
+      {.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, .descriptorCount = 1},
+      {.type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, .descriptorCount = 5},
+      {.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+       .descriptorCount = 1 + MAX_TEXTURE_COUNT}};
+
+  VkDescriptorPoolCreateInfo descriptorPoolCreateInfo = {
+      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+      .pNext = NULL,
+      .flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT,
+      .maxSets = 1,
+      .poolSizeCount = (uint32_t)descriptorPoolSizeList.size(),
+      .pPoolSizes = descriptorPoolSizeList.data()};
+
+  VkDescriptorPool descriptorPoolHandle = VK_NULL_HANDLE;
+  result = vkCreateDescriptorPool(deviceHandle, &descriptorPoolCreateInfo, NULL,
+                                  &descriptorPoolHandle);
+
+  if (result != VK_SUCCESS) {
+    throwExceptionVulkanAPI(result, "vkCreateDescriptorPool");
+  }
+
+  // =========================================================================
+  // Descriptor Set Layout
+
+  // the wavefront generate and shade kernels and the ray query backend
+  // (compute) share the set with the ray tracing shaders
+  std::vector<VkDescriptorSetLayoutBinding> descriptorSetLayoutBindingList = {
+      {.binding = 0,
+       .descriptorType = VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR,
+       .descriptorCount = 1,
+       .stageFlags = VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_COMPUTE_BIT,
+       .pImmutableSamplers = NULL},
+      {.binding = 1,
+       .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+       .descriptorCount = 1,
+       .stageFlags = VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR |
+                     VK_SHADER_STAGE_COMPUTE_BIT,
+       .pImmutableSamplers = NULL},
+      {.binding = 2,
+       .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+       .descriptorCount = 1,
+       .stageFlags = VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR |
+                     VK_SHADER_STAGE_COMPUTE_BIT,
+       .pImmutableSamplers = NULL},
+      {.binding = 3,
+       .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+       .descriptorCount = 1,
+       .stageFlags = VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR |
+                     VK_SHADER_STAGE_COMPUTE_BIT,
+       .pImmutableSamplers = NULL},
+      {.binding = 4,
+       .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+       .descriptorCount = 1,
+       .stageFlags = VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_COMPUTE_BIT,
+       .pImmutableSamplers = NULL},
+      {.binding = 5,
+       .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+       .descriptorCount = 1,
+       .stageFlags = VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_COMPUTE_BIT,
+       .pImmutableSamplers = NULL},
+      {.binding = 6,
+       .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+       .descriptorCount = 1,
+       .stageFlags = VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR |
+                     VK_SHADER_STAGE_COMPUTE_BIT,
+       .pImmutableSamplers = NULL},
+      {.binding = 7,
+       .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+       .descriptorCount = 1,
+       .stageFlags = VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_COMPUTE_BIT,
+       .pImmutableSamplers = NULL},
+      {.binding = 8,
+       .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+       .descriptorCount = MAX_TEXTURE_COUNT,
+       .stageFlags = VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_COMPUTE_BIT,
+       .pImmutableSamplers = NULL},
+      {.binding = 9,
+       .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+       .descriptorCount = 1,
+       .stageFlags = VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_COMPUTE_BIT,
+       .pImmutableSamplers = NULL},
+      {.binding = 10,
+       .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+       .descriptorCount = 1,
+       .stageFlags = VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_COMPUTE_BIT,
+       .pImmutableSamplers = NULL},
+      {.binding = 11,
+       .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+       .descriptorCount = 1,
+       .stageFlags = VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_COMPUTE_BIT,
+       .pImmutableSamplers = NULL},
+      {.binding = 12,
+       .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+       .descriptorCount = 1,
+       .stageFlags = VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_COMPUTE_BIT,
+       .pImmutableSamplers = NULL},
+      {.binding = 13,
+       .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC,
+       .descriptorCount = 1,
+       .stageFlags = VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_COMPUTE_BIT,
+       .pImmutableSamplers = NULL},
+      {.binding = 14,
+       .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+       .descriptorCount = 1,
+       .stageFlags = VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_COMPUTE_BIT,
+       .pImmutableSamplers = NULL},
+      {.binding = 15,
+       .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+       .descriptorCount = 1,
+       .stageFlags = VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_COMPUTE_BIT,
+       .pImmutableSamplers = NULL},
+      {.binding = 16,
+       .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+       .descriptorCount = 1,
+       .stageFlags = VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_COMPUTE_BIT,
+       .pImmutableSamplers = NULL},
+      {.binding = 17,
+       .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+       .descriptorCount = 1,
+       .stageFlags = VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_COMPUTE_BIT,
+       .pImmutableSamplers = NULL},
+      {.binding = 18,
+       .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+       .descriptorCount = 1,
+       .stageFlags = VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_COMPUTE_BIT,
+       .pImmutableSamplers = NULL},
+      {.binding = 19,
+       .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+       .descriptorCount = 1,
+       .stageFlags = VK_SHADER_STAGE_RAYGEN_BIT_KHR,
+       .pImmutableSamplers = NULL},
+      {.binding = 20,
+       .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+       .descriptorCount = 1,
+       .stageFlags = VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_COMPUTE_BIT,
+       .pImmutableSamplers = NULL},
+      {.binding = 21,
+       .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+       .descriptorCount = 1,
+       .stageFlags = VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_COMPUTE_BIT,
+       .pImmutableSamplers = NULL},
+      {.binding = 22,
+       .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+       .descriptorCount = 1,
+       .stageFlags = VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_COMPUTE_BIT,
+       .pImmutableSamplers = NULL},
+      {.binding = 23,
+       .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+       .descriptorCount = 1,
+       .stageFlags = VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_COMPUTE_BIT,
+       .pImmutableSamplers = NULL}};
+
+  // the texture array is only filled up to the number of loaded textures
+  std::vector<VkDescriptorBindingFlags> descriptorBindingFlagsList(
+      descriptorSetLayoutBindingList.size(), 0);
+  descriptorBindingFlagsList[8] = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT;
+
+  VkDescriptorSetLayoutBindingFlagsCreateInfo descriptorSetLayoutBindingFlagsCreateInfo = {
+      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO,
+      .pNext = NULL,
+      .bindingCount = (uint32_t)descriptorBindingFlagsList.size(),
+      .pBindingFlags = descriptorBindingFlagsList.data()};
+
+  VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo = {
+      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+      .pNext = &descriptorSetLayoutBindingFlagsCreateInfo,
+      .flags = 0,
+      .bindingCount = (uint32_t)descriptorSetLayoutBindingList.size(),
+      .pBindings = descriptorSetLayoutBindingList.data()};
+
+  VkDescriptorSetLayout descriptorSetLayoutHandle = VK_NULL_HANDLE;
+  result =
+      vkCreateDescriptorSetLayout(deviceHandle, &descriptorSetLayoutCreateInfo,
+                                  NULL, &descriptorSetLayoutHandle);
+
+  if (result != VK_SUCCESS) {
+    throwExceptionVulkanAPI(result, "vkCreateDescriptorSetLayout");
+  }
+
+  // =========================================================================
+  // Allocate Descriptor Sets
+
+  std::vector<VkDescriptorSetLayout> descriptorSetLayoutHandleList = {
+      descriptorSetLayoutHandle};
+
+  VkDescriptorSetAllocateInfo descriptorSetAllocateInfo = {
+      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+      .pNext = NULL,
+      .descriptorPool = descriptorPoolHandle,
+      .descriptorSetCount = (uint32_t)descriptorSetLayoutHandleList.size(),
+      .pSetLayouts = descriptorSetLayoutHandleList.data()};
+
+  std::vector<VkDescriptorSet> descriptorSetHandleList =
+      std::vector<VkDescriptorSet>(1, VK_NULL_HANDLE);
+
+  result = vkAllocateDescriptorSets(deviceHandle, &descriptorSetAllocateInfo,
+                                    descriptorSetHandleList.data());
+
+  if (result != VK_SUCCESS) {
+    throwExceptionVulkanAPI(result, "vkAllocateDescriptorSets");
+  }
+
+  // =========================================================================
+  // Pipeline Layout
+
+  // TraceConstants in src/path_tracing.glsl
+  struct TracePushConstants {
+    uint32_t firstSampleIndex;
+    uint32_t sampleCount;
+    uint32_t renderWidth;
+    uint32_t renderHeight;
+    uint32_t isShadowRayBatched;
+  };
+
+  VkPushConstantRange tracePushConstantRange = {
+      .stageFlags = VK_SHADER_STAGE_RAYGEN_BIT_KHR,
+      .offset = 0,
+      .size = sizeof(TracePushConstants)};
+
+  VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+      .pNext = NULL,
+      .flags = 0,
+      .setLayoutCount = (uint32_t)descriptorSetLayoutHandleList.size(),
+      .pSetLayouts = descriptorSetLayoutHandleList.data(),
+      .pushConstantRangeCount = 1,
+      .pPushConstantRanges = &tracePushConstantRange};
+
+  VkPipelineLayout pipelineLayoutHandle = VK_NULL_HANDLE;
+  result = vkCreatePipelineLayout(deviceHandle, &pipelineLayoutCreateInfo, NULL,
+                                  &pipelineLayoutHandle);
+
+  if (result != VK_SUCCESS) {
+    throwExceptionVulkanAPI(result, "vkCreatePipelineLayout");
+  }
+
+  // =========================================================================
+  // Ray Closest Hit Shader Module
+
+#ifdef COMPACT_VERTEX_FORMAT
+  const bool compactVertexFormat = true;
+#else
+  const bool compactVertexFormat = false;
+#endif
+
+#ifdef COMPACT_PAYLOAD_ENABLED
+  // hit vertices are fetched in the ray generation shaders instead
+  const std::string payloadShaderPrefix = "shaders/compact_payload_";
+#else
+  const std::string payloadShaderPrefix = "shaders/";
+#endif
+
+  // constant_id 0 in src/vertex_fetch.glsl (closest hit and, with the compact
+  // payload, the ray generation shaders)
+  VkBool32 rayClosestHitSpecializationData = compactVertexFormat;
+
+  VkSpecializationMapEntry rayClosestHitSpecializationMapEntry = {
+      .constantID = 0, .offset = 0, .size = sizeof(VkBool32)};
+
+  VkSpecializationInfo rayClosestHitSpecializationInfo = {
+      .mapEntryCount = 1,
+      .pMapEntries = &rayClosestHitSpecializationMapEntry,
+      .dataSize = sizeof(VkBool32),
+      .pData = &rayClosestHitSpecializationData};
+
+  VkShaderModule rayClosestHitShaderModuleHandle = VK_NULL_HANDLE;
+
+  if (isRayTracingPipelineNeeded) {
+    std::ifstream rayClosestHitFile(payloadShaderPrefix + "shader.rchit.spv",
+                                    std::ios::binary | std::ios::ate);
+    std::streamsize rayClosestHitFileSize = rayClosestHitFile.tellg();
+    rayClosestHitFile.seekg(0, std::ios::beg);
+    std::vector<uint32_t> rayClosestHitShaderSource(rayClosestHitFileSize /
+                                                    sizeof(uint32_t));
+    rayClosestHitFile.read((char *)rayClosestHitShaderSource.data(),
+                           rayClosestHitFileSize);
+    rayClosestHitFile.close();
+
+    VkShaderModuleCreateInfo rayClosestHitShaderModuleCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .codeSize = (uint32_t)rayClosestHitShaderSource.size() * sizeof(uint32_t),
+        .pCode = rayClosestHitShaderSource.data()};
+
+    result =
+        vkCreateShaderModule(deviceHandle, &rayClosestHitShaderModuleCreateInfo,
+                             NULL, &rayClosestHitShaderModuleHandle);
+
+    if (result != VK_SUCCESS) {
+      throwExceptionVulkanAPI(result, "vkCreateShaderModule");
+    }
+  }
+
+  // =========================================================================
+  // Ray Generate Shader Module
+
+  VkShaderModule rayGenerateShaderModuleHandle = VK_NULL_HANDLE;
+
+  if (isRayTracingPipelineNeeded) {
+    std::ifstream rayGenerateFile(payloadShaderPrefix + "shader.rgen.spv",
+                                  std::ios::binary | std::ios::ate);
+    std::streamsize rayGenerateFileSize = rayGenerateFile.tellg();
+    rayGenerateFile.seekg(0, std::ios::beg);
+    std::vector<uint32_t> rayGenerateShaderSource(rayGenerateFileSize /
+                                                  sizeof(uint32_t));
+    rayGenerateFile.read((char *)rayGenerateShaderSource.data(),
+                         rayGenerateFileSize);
+    rayGenerateFile.close();
+
+    VkShaderModuleCreateInfo rayGenerateShaderModuleCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .codeSize = (uint32_t)rayGenerateShaderSource.size() * sizeof(uint32_t),
+        .pCode = rayGenerateShaderSource.data()};
+
+    result =
+        vkCreateShaderModule(deviceHandle, &rayGenerateShaderModuleCreateInfo,
+                             NULL, &rayGenerateShaderModuleHandle);
+
+    if (result != VK_SUCCESS) {
+      throwExceptionVulkanAPI(result, "vkCreateShaderModule");
+    }
+  }
+
+  // =========================================================================
+  // Ray Generate Shader Module (Extend)
+
+  VkShaderModule rayExtendShaderModuleHandle = VK_NULL_HANDLE;
+
+  if (isRayTracingPipelineNeeded) {
+    std::ifstream rayExtendFile(payloadShaderPrefix + "shader_extend.rgen.spv",
+                                std::ios::binary | std::ios::ate);
+    std::streamsize rayExtendFileSize = rayExtendFile.tellg();
+    rayExtendFile.seekg(0, std::ios::beg);
+    std::vector<uint32_t> rayExtendShaderSource(rayExtendFileSize /
+                                                sizeof(uint32_t));
+    rayExtendFile.read((char *)rayExtendShaderSource.data(), rayExtendFileSize);
+    rayExtendFile.close();
+
+    VkShaderModuleCreateInfo rayExtendShaderModuleCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .codeSize = (uint32_t)rayExtendShaderSource.size() * sizeof(uint32_t),
+        .pCode = rayExtendShaderSource.data()};
+
+    result = vkCreateShaderModule(deviceHandle, &rayExtendShaderModuleCreateInfo,
+                                  NULL, &rayExtendShaderModuleHandle);
+
+    if (result != VK_SUCCESS) {
+      throwExceptionVulkanAPI(result, "vkCreateShaderModule");
+    }
+  }
+
+  // =========================================================================
+  // Ray Generate Shader Module (Shadow)
+
+  VkShaderModule rayShadowShaderModuleHandle = VK_NULL_HANDLE;
+
+  if (isRayTracingPipelineNeeded) {
+    std::ifstream rayShadowFile("shaders/shader_shadow.rgen.spv",
+                                std::ios::binary | std::ios::ate);
+    std::streamsize rayShadowFileSize = rayShadowFile.tellg();
+    rayShadowFile.seekg(0, std::ios::beg);
+    std::vector<uint32_t> rayShadowShaderSource(rayShadowFileSize /
+                                                sizeof(uint32_t));
+    rayShadowFile.read((char *)rayShadowShaderSource.data(), rayShadowFileSize);
+    rayShadowFile.close();
+
+    VkShaderModuleCreateInfo rayShadowShaderModuleCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .codeSize = (uint32_t)rayShadowShaderSource.size() * sizeof(uint32_t),
+        .pCode = rayShadowShaderSource.data()};
+
+    result = vkCreateShaderModule(deviceHandle, &rayShadowShaderModuleCreateInfo,
+                                  NULL, &rayShadowShaderModuleHandle);
+
+    if (result != VK_SUCCESS) {
+      throwExceptionVulkanAPI(result, "vkCreateShaderModule");
+    }
+  }
+
+  // =========================================================================
+  // Ray Miss Shader Module
+
+  VkShaderModule rayMissShaderModuleHandle = VK_NULL_HANDLE;
+
+  if (isRayTracingPipelineNeeded) {
+    std::ifstream rayMissFile(payloadShaderPrefix + "shader.rmiss.spv",
+                              std::ios::binary | std::ios::ate);
+    std::streamsize rayMissFileSize = rayMissFile.tellg();
+    rayMissFile.seekg(0, std::ios::beg);
+    std::vector<uint32_t> rayMissShaderSource(rayMissFileSize / sizeof(uint32_t));
+    rayMissFile.read((char *)rayMissShaderSource.data(), rayMissFileSize);
+    rayMissFile.close();
+
+    VkShaderModuleCreateInfo rayMissShaderModuleCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .codeSize = (uint32_t)rayMissShaderSource.size() * sizeof(uint32_t),
+        .pCode = rayMissShaderSource.data()};
+
+    result = vkCreateShaderModule(deviceHandle, &rayMissShaderModuleCreateInfo,
+                                  NULL, &rayMissShaderModuleHandle);
+
+    if (result != VK_SUCCESS) {
+      throwExceptionVulkanAPI(result, "vkCreateShaderModule");
+    }
+  }
+
+  // =========================================================================
+  // Ray Miss Shader Module (Shadow)
+
+  VkShaderModule rayMissShadowShaderModuleHandle = VK_NULL_HANDLE;
+
+  if (isRayTracingPipelineNeeded) {
+    std::ifstream rayMissShadowFile("shaders/shader_shadow.rmiss.spv",
+                                    std::ios::binary | std::ios::ate);
+    std::streamsize rayMissShadowFileSize = rayMissShadowFile.tellg();
+    rayMissShadowFile.seekg(0, std::ios::beg);
+    std::vector<uint32_t> rayMissShadowShaderSource(rayMissShadowFileSize /
+                                                    sizeof(uint32_t));
+    rayMissShadowFile.read((char *)rayMissShadowShaderSource.data(),
+                           rayMissShadowFileSize);
+    rayMissShadowFile.close();
+
+    VkShaderModuleCreateInfo rayMissShadowShaderModuleCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .codeSize = (uint32_t)rayMissShadowShaderSource.size() * sizeof(uint32_t),
+        .pCode = rayMissShadowShaderSource.data()};
+
+    result =
+        vkCreateShaderModule(deviceHandle, &rayMissShadowShaderModuleCreateInfo,
+                             NULL, &rayMissShadowShaderModuleHandle);
+
+    if (result != VK_SUCCESS) {
+      throwExceptionVulkanAPI(result, "vkCreateShaderModule");
+    }
+  }
+
+  // =========================================================================
+  // Ray Tracing Pipeline
+
+  std::vector<VkPipelineShaderStageCreateInfo>
+      pipelineShaderStageCreateInfoList = {
+          {.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+           .pNext = NULL,
+           .flags = 0,
+           .stage = VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR,
+           .module = rayClosestHitShaderModuleHandle,
+           .pName = "main",
+           .pSpecializationInfo = &rayClosestHitSpecializationInfo},
+          {.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+           .pNext = NULL,
+           .flags = 0,
+           .stage = VK_SHADER_STAGE_RAYGEN_BIT_KHR,
+           .module = rayGenerateShaderModuleHandle,
+           .pName = "main",
+           .pSpecializationInfo = &rayClosestHitSpecializationInfo},
+          {.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+           .pNext = NULL,
+           .flags = 0,
+           .stage = VK_SHADER_STAGE_MISS_BIT_KHR,
+           .module = rayMissShaderModuleHandle,
+           .pName = "main",
+           .pSpecializationInfo = NULL},
+          {.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+           .pNext = NULL,
+           .flags = 0,
+           .stage = VK_SHADER_STAGE_MISS_BIT_KHR,
+           .module = rayMissShadowShaderModuleHandle,
+           .pName = "main",
+           .pSpecializationInfo = NULL},
+          {.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+           .pNext = NULL,
+           .flags = 0,
+           .stage = VK_SHADER_STAGE_RAYGEN_BIT_KHR,
+           .module = rayExtendShaderModuleHandle,
+           .pName = "main",
+           .pSpecializationInfo = &rayClosestHitSpecializationInfo},
+          {.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+           .pNext = NULL,
+           .flags = 0,
+           .stage = VK_SHADER_STAGE_RAYGEN_BIT_KHR,
+           .module = rayShadowShaderModuleHandle,
+           .pName = "main",
+           .pSpecializationInfo = NULL}};
+
+  std::vector<VkRayTracingShaderGroupCreateInfoKHR>
+      rayTracingShaderGroupCreateInfoList = {
+          {.sType = VK_STRUCTURE_TYPE_RAY_TRACING_SHADER_GROUP_CREATE_INFO_KHR,
+           .pNext = NULL,
+           .type = VK_RAY_TRACING_SHADER_GROUP_TYPE_TRIANGLES_HIT_GROUP_KHR,
+           .generalShader = VK_SHADER_UNUSED_KHR,
            .closestHitShader = 0,
            .anyHitShader = VK_SHADER_UNUSED_KHR,
            .intersectionShader = VK_SHADER_UNUSED_KHR,
@@ -1568,1232 +3549,4099 @@ int main() {
            .pShaderGroupCaptureReplayHandle = NULL},
           {.sType = VK_STRUCTURE_TYPE_RAY_TRACING_SHADER_GROUP_CREATE_INFO_KHR,
            .pNext = NULL,
-           .type = VK_RAY_TRACING_SHADER_GROUP_TYPE_GENERAL_KHR,
-           .generalShader = 3,
-           .closestHitShader = VK_SHADER_UNUSED_KHR,
-           .anyHitShader = VK_SHADER_UNUSED_KHR,
-           .intersectionShader = VK_SHADER_UNUSED_KHR,
-           .pShaderGroupCaptureReplayHandle = NULL}};
+           .type = VK_RAY_TRACING_SHADER_GROUP_TYPE_GENERAL_KHR,
+           .generalShader = 3,
+           .closestHitShader = VK_SHADER_UNUSED_KHR,
+           .anyHitShader = VK_SHADER_UNUSED_KHR,
+           .intersectionShader = VK_SHADER_UNUSED_KHR,
+           .pShaderGroupCaptureReplayHandle = NULL},
+          {.sType = VK_STRUCTURE_TYPE_RAY_TRACING_SHADER_GROUP_CREATE_INFO_KHR,
+           .pNext = NULL,
+           .type = VK_RAY_TRACING_SHADER_GROUP_TYPE_GENERAL_KHR,
+           .generalShader = 4,
+           .closestHitShader = VK_SHADER_UNUSED_KHR,
+           .anyHitShader = VK_SHADER_UNUSED_KHR,
+           .intersectionShader = VK_SHADER_UNUSED_KHR,
+           .pShaderGroupCaptureReplayHandle = NULL},
+          {.sType = VK_STRUCTURE_TYPE_RAY_TRACING_SHADER_GROUP_CREATE_INFO_KHR,
+           .pNext = NULL,
+           .type = VK_RAY_TRACING_SHADER_GROUP_TYPE_GENERAL_KHR,
+           .generalShader = 5,
+           .closestHitShader = VK_SHADER_UNUSED_KHR,
+           .anyHitShader = VK_SHADER_UNUSED_KHR,
+           .intersectionShader = VK_SHADER_UNUSED_KHR,
+           .pShaderGroupCaptureReplayHandle = NULL}};
+
+  VkRayTracingPipelineCreateInfoKHR rayTracingPipelineCreateInfo = {
+      .sType = VK_STRUCTURE_TYPE_RAY_TRACING_PIPELINE_CREATE_INFO_KHR,
+      .pNext = NULL,
+      .flags = 0,
+      .stageCount = (uint32_t)pipelineShaderStageCreateInfoList.size(),
+      .pStages = pipelineShaderStageCreateInfoList.data(),
+      .groupCount = (uint32_t)rayTracingShaderGroupCreateInfoList.size(),
+      .pGroups = rayTracingShaderGroupCreateInfoList.data(),
+      .maxPipelineRayRecursionDepth = 1,
+      .pLibraryInfo = NULL,
+      .pLibraryInterface = NULL,
+      .pDynamicState = NULL,
+      .layout = pipelineLayoutHandle,
+      .basePipelineHandle = VK_NULL_HANDLE,
+      .basePipelineIndex = 0};
+
+  VkPipeline rayTracingPipelineHandle = VK_NULL_HANDLE;
+
+  if (isRayTracingPipelineNeeded) {
+    result = pvkCreateRayTracingPipelinesKHR(
+        deviceHandle, VK_NULL_HANDLE, VK_NULL_HANDLE, 1,
+        &rayTracingPipelineCreateInfo, NULL, &rayTracingPipelineHandle);
+
+    if (result != VK_SUCCESS) {
+      throwExceptionVulkanAPI(result, "vkCreateRayTracingPipelinesKHR");
+    }
+  }
+
+  // =========================================================================
+  // OBJ Model
+
+#ifdef MESH_OPTIMIZATION_ENABLED
+  const bool optimizeMeshLayout = true;
+#else
+  const bool optimizeMeshLayout = false;
+#endif
+
+  MeshRegistry meshRegistry(compactVertexFormat, optimizeMeshLayout);
+
+  uint32_t centerMeshIndex = meshRegistry.load(CENTER_MESH_OBJ_PATH);
+  uint32_t orbitingMeshIndex = meshRegistry.load(ORBITING_MESH_OBJ_PATH);
+
+#ifdef MESH_DEFORMATION_ENABLED
+  const bool isMeshDeformationEnabled = !compactVertexFormat;
+#else
+  const bool isMeshDeformationEnabled = false;
+#endif
+
+  uint32_t deformingMeshIndex = orbitingMeshIndex;
+
+#ifdef MESH_LOD_ENABLED
+  const bool isMeshLodEnabled = true;
+#else
+  const bool isMeshLodEnabled = false;
+#endif
+
+  // the simplified levels are registered as meshes of their own, after the
+  // loaded ones; the deformed mesh keeps a single level, its simplified
+  // copies would not follow the deformation, and so do emissive meshes, as
+  // their triangle lights are built from the full-resolution mesh and have
+  // to lie on the surface the rays hit
+  if (isMeshLodEnabled) {
+    uint32_t loadedMeshCount = meshRegistry.getMeshCount();
+    for (uint32_t i = 0; i < loadedMeshCount; i++) {
+      if (isMeshDeformationEnabled && i == deformingMeshIndex) {
+        continue;
+      }
+
+      const Mesh& mesh = meshRegistry.getMesh(i);
+      if (!mesh.materials.empty() &&
+          (mesh.materials[0].emission[0] > 0.0f ||
+           mesh.materials[0].emission[1] > 0.0f ||
+           mesh.materials[0].emission[2] > 0.0f)) {
+        continue;
+      }
+
+      meshRegistry.buildLevelsOfDetail(i,
+        std::min<uint32_t>(MESH_LOD_COUNT, 1 << MESH_LOD_INDEX_BITS),
+        MESH_LOD_REDUCTION);
+    }
+  }
+
+  uint32_t meshCount = meshRegistry.getMeshCount();
+
+  // =========================================================================
+  // Scene Instances
+
+  MaterialLibrary materialLibrary;
+
+  uint32_t centerMaterialIndex = materialLibrary.addMeshMaterial(
+    meshRegistry.getMesh(centerMeshIndex), CENTER_MESH_TYPE);
+  uint32_t orbitingMaterialIndex = materialLibrary.addMeshMaterial(
+    meshRegistry.getMesh(orbitingMeshIndex), ORBITING_MESH_TYPE);
+
+  std::vector<MeshInstance> meshInstanceList = {
+    {.meshIndex = centerMeshIndex,
+     .materialIndex = centerMaterialIndex,
+     .transform = glm::mat4(1)}};
+
+  uint32_t firstOrbitingInstanceIndex = meshInstanceList.size();
+  for (uint32_t i = 0; i < ORBITING_MESH_INSTANCE_COUNT; i++) {
+    meshInstanceList.push_back({.meshIndex = orbitingMeshIndex,
+                                .materialIndex = orbitingMaterialIndex,
+                                .transform = getOrbitingTransform(0, i)});
+  }
+
+  uint32_t instanceCount = meshInstanceList.size();
+
+  size_t totalVertexBufferSize = 0;
+  size_t totalIndexBufferSize = 0;
+  for(int i = 0; i < meshCount; i++){
+    const Mesh& mesh = meshRegistry.getMesh(i);
+    totalVertexBufferSize += compactVertexFormat
+                               ? sizeof(uint32_t) * mesh.compactVertices.size()
+                               : sizeof(float) * mesh.vertices.size();
+  }
+
+  // 16-bit indices where the vertex count allows, each mesh padded to 4 bytes
+  std::vector<VkIndexType> meshIndexType(meshCount);
+  std::vector<std::vector<uint16_t>> meshShortIndices(meshCount);
+  for(int i = 0; i < meshCount; i++){
+    const Mesh& mesh = meshRegistry.getMesh(i);
+    if (optimizeMeshLayout && fitsShortIndices(mesh)) {
+      meshIndexType[i] = VK_INDEX_TYPE_UINT16;
+      meshShortIndices[i] = getShortIndices(mesh);
+      totalIndexBufferSize += (sizeof(uint16_t) * mesh.indices.size() + 3) & ~3;
+    }
+    else {
+      meshIndexType[i] = VK_INDEX_TYPE_UINT32;
+      totalIndexBufferSize += sizeof(uint32_t) * mesh.indices.size();
+    }
+  }
+
+  // =========================================================================
+  // Vertex Buffer
+
+  std::vector<VkDeviceAddress> vertexBufferDeviceAddress(meshCount);
+  std::vector<uint32_t> meshVertexOffset(meshCount);
+  VkBuffer vertexBufferHandle = VK_NULL_HANDLE;
+  VkDeviceMemory vertexDeviceMemoryHandle = VK_NULL_HANDLE;
+  
+  VkDeviceSize currentVertexBufferOffset = 0;
+  for(int i = 0; i < meshCount; i++){
+    const Mesh& mesh = meshRegistry.getMesh(i);
+    size_t vertexBufferSize = compactVertexFormat
+                                ? sizeof(uint32_t) * mesh.compactVertices.size()
+                                : sizeof(float) * mesh.vertices.size();
+    const void *vertexData = compactVertexFormat
+                               ? (const void *) mesh.compactVertices.data()
+                               : (const void *) mesh.vertices.data();
+
+    buildBuffer(vertexBufferHandle,
+      totalVertexBufferSize,
+      queueFamilyIndex,
+      (void *) vertexData,
+        VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT |
+        VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR |
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+      &memoryAllocateFlagsInfo,
+      vertexDeviceMemoryHandle,
+      vertexBufferDeviceAddress[i],
+      currentVertexBufferOffset,
+      vertexBufferSize
+      );
+    
+    // in 32-bit words, the unit of the shader's vertex buffer
+    meshVertexOffset[i] = currentVertexBufferOffset / sizeof(uint32_t);
+    currentVertexBufferOffset += vertexBufferSize;
+  }
+
+
+  // =========================================================================
+  // Index Buffer
+
+  std::vector<VkDeviceAddress> indexBufferDeviceAddress(meshCount);
+  std::vector<uint32_t> meshIndexOffset(meshCount);
+  VkBuffer indexBufferHandle = VK_NULL_HANDLE;
+  VkDeviceMemory indexDeviceMemoryHandle = VK_NULL_HANDLE;
+
+  VkDeviceSize currentIndexBufferOffset = 0;
+  for(int i = 0; i < meshCount; i++){
+    const Mesh& mesh = meshRegistry.getMesh(i);
+    bool isShortIndex = meshIndexType[i] == VK_INDEX_TYPE_UINT16;
+    size_t indexSize = isShortIndex ? sizeof(uint16_t) : sizeof(uint32_t);
+    size_t currentIndexBufferSize = indexSize * mesh.indices.size();
+    const void *indexData = isShortIndex
+                              ? (const void *) meshShortIndices[i].data()
+                              : (const void *) mesh.indices.data();
+
+    buildBuffer(indexBufferHandle,
+      totalIndexBufferSize,
+      queueFamilyIndex,
+      (void *) indexData,
+        VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT |
+        VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR |
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+      &memoryAllocateFlagsInfo,
+      indexDeviceMemoryHandle,
+      indexBufferDeviceAddress[i],
+      currentIndexBufferOffset,
+      currentIndexBufferSize
+      );
+
+      // in elements of the mesh's own index type
+      meshIndexOffset[i] = currentIndexBufferOffset / indexSize;
+      currentIndexBufferOffset += (currentIndexBufferSize + 3) & ~3;
+  }
+
+  // =========================================================================
+  // Vertex Dequantization Transform Buffer
+  // (compact vertex format only, maps snorm positions back to the mesh AABB
+  //  while building the BLAS so that object space is unchanged)
+
+  std::vector<VkDeviceAddress> dequantizationTransformDeviceAddress(meshCount, 0);
+  VkBuffer dequantizationTransformBufferHandle = VK_NULL_HANDLE;
+  VkDeviceMemory dequantizationTransformDeviceMemoryHandle = VK_NULL_HANDLE;
+
+  if (compactVertexFormat) {
+    std::vector<VkTransformMatrixKHR> dequantizationTransformList(meshCount);
+
+    for(int i = 0; i < meshCount; i++){
+      const Mesh& mesh = meshRegistry.getMesh(i);
+      dequantizationTransformList[i] = {.matrix = {
+        {mesh.positionScale[0], 0, 0, mesh.positionOffset[0]},
+        {0, mesh.positionScale[1], 0, mesh.positionOffset[1]},
+        {0, 0, mesh.positionScale[2], mesh.positionOffset[2]}}};
+    }
+
+    for(int i = 0; i < meshCount; i++){
+      buildBuffer(dequantizationTransformBufferHandle,
+        sizeof(VkTransformMatrixKHR) * meshCount,
+        queueFamilyIndex,
+        (void *) &dequantizationTransformList[i],
+          VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT |
+          VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+        &memoryAllocateFlagsInfo,
+        dequantizationTransformDeviceMemoryHandle,
+        dequantizationTransformDeviceAddress[i],
+        sizeof(VkTransformMatrixKHR) * i,
+        sizeof(VkTransformMatrixKHR));
+    }
+  }
+
+  // =========================================================================
+  // Bottom Level Acceleration Structure Build Policies
+
+  // meshes only move rigidly through their instance transforms unless they
+  // are deformed
+  std::vector<uint32_t> meshBuildPolicy(meshCount, BLAS_BUILD_POLICY_STATIC);
+#ifdef BLAS_BUILD_POLICY_OVERRIDE
+  std::fill(meshBuildPolicy.begin(), meshBuildPolicy.end(),
+            BLAS_BUILD_POLICY_OVERRIDE);
+#endif
+
+  if (isMeshDeformationEnabled) {
+    meshBuildPolicy[deformingMeshIndex] = BLAS_BUILD_POLICY_DEFORMING;
+  }
+
+  // =========================================================================
+  // Bottom Level Acceleration Structure (one per unique mesh)
+  
+  std::vector<VkAccelerationStructureGeometryKHR> bottomLevelAccelerationStructureGeometry(meshCount);
+
+  for(int i = 0; i < meshCount; i++){
+    createBLASGeometry(bottomLevelAccelerationStructureGeometry[i],
+      vertexBufferDeviceAddress[i],
+      indexBufferDeviceAddress[i],
+      meshRegistry.getMesh(i).vertexCount,
+      compactVertexFormat ? VK_FORMAT_R16G16B16A16_SNORM
+                          : VK_FORMAT_R32G32B32_SFLOAT,
+      compactVertexFormat ? sizeof(uint32_t) * MESH_COMPACT_VERTEX_STRIDE
+                          : sizeof(float) * MESH_VERTEX_STRIDE,
+      dequantizationTransformDeviceAddress[i],
+      meshIndexType[i]);
+  }
+
+  //Create offset info
+  std::vector<VkAccelerationStructureBuildRangeInfoKHR> bottomLevelAccelerationStructureBuildRangeInfo(meshCount);
+
+  for(int i = 0; i < meshCount; i++){
+    bottomLevelAccelerationStructureBuildRangeInfo[i] =  {.primitiveCount =
+                                                         meshRegistry.getMesh(i).primitiveCount, 
+                                                        .primitiveOffset = 0,
+                                                        .firstVertex = 0,
+                                                        .transformOffset = 0};
+  }
+
+  std::vector<VkAccelerationStructureKHR> bottomLevelAccelerationStructureHandle(meshCount);
+  std::vector<VkBuffer> bottomLevelAccelerationStructureBufferHandle(meshCount);
+  std::vector<VkDeviceMemory> bottomLevelAccelerationStructureDeviceMemoryHandle(meshCount);
+  std::vector<VkAccelerationStructureBuildSizesInfoKHR> bottomLevelAccelerationStructureBuildSizesInfo(meshCount);
+  std::vector<VkAccelerationStructureBuildGeometryInfoKHR>  bottomLevelAccelerationStructureBuildGeometryInfo(meshCount);
+
+
+  for(int i = 0; i < meshCount; i++){
+    createBLAS(bottomLevelAccelerationStructureHandle[i],
+      bottomLevelAccelerationStructureGeometry[i],
+      meshRegistry.getMesh(i).primitiveCount,
+      queueFamilyIndex,
+      bottomLevelAccelerationStructureBufferHandle[i],
+      bottomLevelAccelerationStructureDeviceMemoryHandle[i],
+      bottomLevelAccelerationStructureBuildSizesInfo[i],
+      bottomLevelAccelerationStructureBuildGeometryInfo[i],
+      getBLASBuildFlags(meshBuildPolicy[i]));
+  }
+ 
+  // =========================================================================
+  // Build Bottom Level Acceleration Structure
+  std::vector<VkBuffer> bottomLevelAccelerationStructureScratchBufferHandle(meshCount);
+  std::vector<VkDeviceAddress> bottomLevelAccelerationStructureDeviceAddress(meshCount);
+  std::vector<VkDeviceMemory> bottomLevelAccelerationStructureDeviceScratchMemoryHandle(meshCount);
+
+  for(int i = 0; i < meshCount; i++){
+    createBLASScratchBuffer(bottomLevelAccelerationStructureScratchBufferHandle[i],
+      bottomLevelAccelerationStructureHandle[i],
+      bottomLevelAccelerationStructureDeviceAddress[i],
+      bottomLevelAccelerationStructureBuildSizesInfo[i],
+      queueFamilyIndex,
+      memoryAllocateFlagsInfo,
+      bottomLevelAccelerationStructureDeviceScratchMemoryHandle[i],
+      bottomLevelAccelerationStructureBuildGeometryInfo[i]);
+  }
+  
+  if (result != VK_SUCCESS) {
+    throwExceptionVulkanAPI(result, "vkCreateFence");
+  }
+
+  for(int i = 0; i < meshCount; i++){
+    buildBLAS(commandBufferHandleList.back(),
+      bottomLevelAccelerationStructureBuildRangeInfo[i],
+      bottomLevelAccelerationStructureBuildGeometryInfo[i],
+      deviceHandle,
+      queueHandle);
+  }
+
+  // =========================================================================
+  // Compact Static Bottom Level Acceleration Structures
+  // (they are never updated, so their scratch buffers are freed as well)
+
+  std::vector<uint32_t> compactedMeshIndexList;
+  std::vector<VkAccelerationStructureKHR> compactedBottomLevelAccelerationStructureHandle;
+  for(int i = 0; i < meshCount; i++){
+    if (meshBuildPolicy[i] == BLAS_BUILD_POLICY_STATIC) {
+      compactedMeshIndexList.push_back(i);
+      compactedBottomLevelAccelerationStructureHandle.push_back(
+        bottomLevelAccelerationStructureHandle[i]);
+    }
+  }
+
+  std::vector<VkDeviceSize> bottomLevelAccelerationStructureSize(meshCount);
+  for(int i = 0; i < meshCount; i++){
+    bottomLevelAccelerationStructureSize[i] =
+      bottomLevelAccelerationStructureBuildSizesInfo[i].accelerationStructureSize;
+  }
+
+  if (!compactedMeshIndexList.empty()) {
+    std::vector<VkDeviceSize> bottomLevelAccelerationStructureCompactedSize;
+    queryCompactedBLASSize(bottomLevelAccelerationStructureCompactedSize,
+      compactedBottomLevelAccelerationStructureHandle,
+      commandBufferHandleList.back(),
+      queueHandle);
+
+    for(int j = 0; j < compactedMeshIndexList.size(); j++){
+      uint32_t i = compactedMeshIndexList[j];
+
+      compactBLAS(bottomLevelAccelerationStructureHandle[i],
+        bottomLevelAccelerationStructureBufferHandle[i],
+        bottomLevelAccelerationStructureDeviceMemoryHandle[i],
+        bottomLevelAccelerationStructureDeviceAddress[i],
+        bottomLevelAccelerationStructureCompactedSize[j],
+        queueFamilyIndex,
+        commandBufferHandleList.back(),
+        queueHandle);
+
+      bottomLevelAccelerationStructureBuildGeometryInfo[i].dstAccelerationStructure =
+        bottomLevelAccelerationStructureHandle[i];
+      bottomLevelAccelerationStructureSize[i] =
+        bottomLevelAccelerationStructureCompactedSize[j];
+
+      vkFreeMemory(deviceHandle,
+                   bottomLevelAccelerationStructureDeviceScratchMemoryHandle[i], NULL);
+      vkDestroyBuffer(deviceHandle,
+                      bottomLevelAccelerationStructureScratchBufferHandle[i], NULL);
+      bottomLevelAccelerationStructureDeviceScratchMemoryHandle[i] = VK_NULL_HANDLE;
+      bottomLevelAccelerationStructureScratchBufferHandle[i] = VK_NULL_HANDLE;
+    }
+  }
+
+  for(int i = 0; i < meshCount; i++){
+    const Mesh& mesh = meshRegistry.getMesh(i);
+    std::cout << "BLAS " << i << " (" << mesh.path << "): "
+              << mesh.primitiveCount << " triangles, "
+              << mesh.vertexCount << " vertices, "
+              << (meshIndexType[i] == VK_INDEX_TYPE_UINT16 ? 16 : 32)
+              << "-bit indices, "
+              << getBLASBuildPolicyName(meshBuildPolicy[i]) << ", size "
+              << bottomLevelAccelerationStructureSize[i] / 1024 << " KiB";
+    if (mesh.simplificationError > 0.0f) {
+      std::cout << ", simplification error " << mesh.simplificationError;
+    }
+    std::cout << std::endl;
+  }
+
+#ifdef BLAS_BUILD_POLICY_BENCHMARK
+  for(int i = 0; i < meshCount; i++){
+    std::cout << "BLAS " << i << " build policy benchmark:" << std::endl;
+    benchmarkBLASBuildPolicies(bottomLevelAccelerationStructureGeometry[i],
+      bottomLevelAccelerationStructureBuildRangeInfo[i],
+      queueFamilyIndex,
+      memoryAllocateFlagsInfo,
+      physicalDeviceProperties2.properties.limits.timestampPeriod,
+      commandBufferHandleList.back(),
+      queueHandle);
+  }
+#endif
+
+#ifdef SAMPLER_SELF_TEST
+  checkSampler(queueFamilyIndex,
+    memoryAllocateFlagsInfo,
+    commandBufferHandleList.back(),
+    queueHandle);
+#endif
+
+  // =========================================================================
+  // Mesh Deformation
+  // (a compute shader twists the orbiting mesh from its rest pose into the
+  //  vertex buffer every frame, then its BLAS is refitted in place)
+
+  struct DeformationPushConstants {
+    float twistAngle;
+    float baseHeight;
+    float inverseHeight;
+    uint32_t vertexCount;
+    uint32_t vertexOffset;
+  };
+
+  float deformingMeshBaseHeight = 0;
+  float deformingMeshInverseHeight = 0;
+  float deformingMeshMaxRadius = 0;
+
+  // twist angle the BLAS was last fully built at (the rest pose)
+  float deformingMeshBuildTwistAngle = 0;
+
+  VkBuffer restVertexBufferHandle = VK_NULL_HANDLE;
+  VkDeviceMemory restVertexDeviceMemoryHandle = VK_NULL_HANDLE;
+  VkDescriptorPool deformationDescriptorPoolHandle = VK_NULL_HANDLE;
+  VkDescriptorSetLayout deformationDescriptorSetLayoutHandle = VK_NULL_HANDLE;
+  VkDescriptorSet deformationDescriptorSetHandle = VK_NULL_HANDLE;
+  VkPipelineLayout deformationPipelineLayoutHandle = VK_NULL_HANDLE;
+  VkShaderModule deformationShaderModuleHandle = VK_NULL_HANDLE;
+  VkPipeline deformationPipelineHandle = VK_NULL_HANDLE;
+
+  if (isMeshDeformationEnabled) {
+    const Mesh& mesh = meshRegistry.getMesh(deformingMeshIndex);
+
+    // the twist is around the Y axis, from the bottom to the top of the mesh
+    float minHeight = mesh.vertices[1];
+    float maxHeight = mesh.vertices[1];
+    for (uint32_t i = 0; i < mesh.vertexCount; i++) {
+      const float *position = &mesh.vertices[MESH_VERTEX_STRIDE * i];
+      minHeight = std::min(minHeight, position[1]);
+      maxHeight = std::max(maxHeight, position[1]);
+      deformingMeshMaxRadius = std::max(deformingMeshMaxRadius,
+        sqrtf(position[0] * position[0] + position[2] * position[2]));
+    }
+
+    deformingMeshBaseHeight = minHeight;
+    deformingMeshInverseHeight =
+      maxHeight > minHeight ? 1.0f / (maxHeight - minHeight) : 0.0f;
+
+    VkDeviceAddress restVertexBufferDeviceAddress;
+    buildBuffer(restVertexBufferHandle,
+      sizeof(float) * mesh.vertices.size(),
+      queueFamilyIndex,
+      (void *) mesh.vertices.data(),
+        VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT |
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+      &memoryAllocateFlagsInfo,
+      restVertexDeviceMemoryHandle,
+      restVertexBufferDeviceAddress);
+
+    VkDescriptorPoolSize deformationDescriptorPoolSize = {
+        .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = 2};
+
+    VkDescriptorPoolCreateInfo deformationDescriptorPoolCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .maxSets = 1,
+        .poolSizeCount = 1,
+        .pPoolSizes = &deformationDescriptorPoolSize};
+
+    result = vkCreateDescriptorPool(deviceHandle,
+                                    &deformationDescriptorPoolCreateInfo, NULL,
+                                    &deformationDescriptorPoolHandle);
+
+    if (result != VK_SUCCESS) {
+      throwExceptionVulkanAPI(result, "vkCreateDescriptorPool");
+    }
+
+    std::vector<VkDescriptorSetLayoutBinding> deformationDescriptorSetLayoutBindingList = {
+        {.binding = 0,
+         .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+         .descriptorCount = 1,
+         .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+         .pImmutableSamplers = NULL},
+        {.binding = 1,
+         .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+         .descriptorCount = 1,
+         .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+         .pImmutableSamplers = NULL}};
+
+    VkDescriptorSetLayoutCreateInfo deformationDescriptorSetLayoutCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .bindingCount = (uint32_t)deformationDescriptorSetLayoutBindingList.size(),
+        .pBindings = deformationDescriptorSetLayoutBindingList.data()};
+
+    result = vkCreateDescriptorSetLayout(deviceHandle,
+                                         &deformationDescriptorSetLayoutCreateInfo,
+                                         NULL,
+                                         &deformationDescriptorSetLayoutHandle);
+
+    if (result != VK_SUCCESS) {
+      throwExceptionVulkanAPI(result, "vkCreateDescriptorSetLayout");
+    }
+
+    VkDescriptorSetAllocateInfo deformationDescriptorSetAllocateInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .pNext = NULL,
+        .descriptorPool = deformationDescriptorPoolHandle,
+        .descriptorSetCount = 1,
+        .pSetLayouts = &deformationDescriptorSetLayoutHandle};
+
+    result = vkAllocateDescriptorSets(deviceHandle,
+                                      &deformationDescriptorSetAllocateInfo,
+                                      &deformationDescriptorSetHandle);
+
+    if (result != VK_SUCCESS) {
+      throwExceptionVulkanAPI(result, "vkAllocateDescriptorSets");
+    }
+
+    std::vector<VkDescriptorBufferInfo> deformationDescriptorBufferInfoList = {
+        {.buffer = restVertexBufferHandle, .offset = 0, .range = VK_WHOLE_SIZE},
+        {.buffer = vertexBufferHandle, .offset = 0, .range = VK_WHOLE_SIZE}};
+
+    std::vector<VkWriteDescriptorSet> deformationWriteDescriptorSetList;
+    for (uint32_t i = 0; i < deformationDescriptorBufferInfoList.size(); i++) {
+      deformationWriteDescriptorSetList.push_back(
+          {.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+           .pNext = NULL,
+           .dstSet = deformationDescriptorSetHandle,
+           .dstBinding = i,
+           .dstArrayElement = 0,
+           .descriptorCount = 1,
+           .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+           .pImageInfo = NULL,
+           .pBufferInfo = &deformationDescriptorBufferInfoList[i],
+           .pTexelBufferView = NULL});
+    }
+
+    vkUpdateDescriptorSets(deviceHandle,
+                           (uint32_t)deformationWriteDescriptorSetList.size(),
+                           deformationWriteDescriptorSetList.data(), 0, NULL);
+
+    createComputePipeline(deformationPipelineHandle,
+      deformationPipelineLayoutHandle,
+      deformationShaderModuleHandle,
+      "shaders/shader_deform.comp.spv",
+      deformationDescriptorSetLayoutHandle,
+      sizeof(DeformationPushConstants));
+  }
+
+  // =========================================================================
+  // Top Level Acceleration Structure
+
+  VkTransformMatrixKHR transformMatrix;
+
+  // with LODs every scene instance has a primary and a secondary TLAS
+  // instance (see setTopLevelInstanceLod), both with its transform
+  uint32_t topLevelInstanceCount =
+      isMeshLodEnabled ? 2 * instanceCount : instanceCount;
+
+  // bounding spheres of the instances' meshes and the LOD of every instance,
+  // picked again every frame
+  std::vector<glm::vec4> instanceBoundingSphereList(instanceCount);
+  std::vector<uint32_t> instanceLodList(instanceCount, 0);
+
+  std::vector<VkAccelerationStructureInstanceKHR> bottomLevelAccelerationStructureInstance(topLevelInstanceCount);
+  VkAccelerationStructureKHR topLevelAccelerationStructureHandle;
+  VkBuffer topLevelAccelerationStructureBufferHandle;
+  VkDeviceMemory topLevelAccelerationStructureDeviceMemoryHandle;
+  VkBuffer topLevelAccelerationStructureInstanceBufferHandle;
+  VkDeviceMemory topLevelAccelerationStructureInstanceDeviceMemoryHandle;
+  VkDeviceAddress topLevelAccelerationStructureInstanceDeviceAddress;
+  VkBuffer topLevelAccelerationStructureScratchBufferHandle;
+  VkDeviceMemory topLevelAccelerationStructureScratchDeviceMemoryHandle;
+  VkDeviceAddress topLevelAccelerationStructureScratchDeviceAddress;
+
+  for(int i = 0; i < instanceCount; i++){
+    glmToVulkan(meshInstanceList[i].transform, transformMatrix);
+
+    uint32_t meshIndex = meshInstanceList[i].meshIndex;
+    uint32_t mask = i < firstOrbitingInstanceIndex ? STATIC_INSTANCE_MASK
+                                                   : MOVING_INSTANCE_MASK;
+
+    createInstance(bottomLevelAccelerationStructureInstance[i],
+      bottomLevelAccelerationStructureDeviceAddress[meshIndex],
+      transformMatrix,
+      i << MESH_LOD_INDEX_BITS,
+      mask);
+
+    if (isMeshLodEnabled) {
+      instanceBoundingSphereList[i] =
+          getMeshBoundingSphere(meshRegistry.getMesh(meshIndex));
+      instanceLodList[i] = getMeshLod(meshInstanceList[i].transform,
+        instanceBoundingSphereList[i], camera.getPosition(),
+        meshRegistry.getLodCount(meshIndex));
+
+      bottomLevelAccelerationStructureInstance[instanceCount + i] =
+          bottomLevelAccelerationStructureInstance[i];
+      setTopLevelInstanceLod(bottomLevelAccelerationStructureInstance, i,
+        meshIndex, instanceLodList[i], meshRegistry,
+        bottomLevelAccelerationStructureDeviceAddress, mask);
+    }
+  }
+
+  createTLAS(topLevelAccelerationStructureHandle,
+    bottomLevelAccelerationStructureInstance,
+    queueFamilyIndex,
+    memoryAllocateFlagsInfo,
+    topLevelAccelerationStructureBufferHandle,
+    topLevelAccelerationStructureDeviceMemoryHandle,
+    topLevelAccelerationStructureInstanceBufferHandle,
+    topLevelAccelerationStructureInstanceDeviceMemoryHandle,
+    topLevelAccelerationStructureInstanceDeviceAddress,
+    topLevelAccelerationStructureScratchBufferHandle,
+    topLevelAccelerationStructureScratchDeviceMemoryHandle,
+    topLevelAccelerationStructureScratchDeviceAddress,
+    commandBufferHandleList.back(),
+    queueHandle);
+    
+  // =========================================================================
+  // Build Top Level Acceleration Structure
+
+  // Multiple TLAS (one TLAS multiple instances in NV)
+
+  //create and build in the same function
+
+  // =========================================================================
+  // Instance Buffer
+  // (indexed by gl_InstanceCustomIndexEXT, an entry per scene instance and
+  //  LOD)
+
+  struct InstanceStructure {
+    uint32_t indexOffset;
+    uint32_t vertexOffset;
+    uint32_t materialIndex;
+    uint32_t meshIndex;
+
+    // dequantization of compact vertex positions
+    float positionOffset[3];
+    uint32_t shortIndices;
+    float positionScale[3];
+    // the first bounce rays leave the LOD past the surface of the secondary
+    // LOD, which is at most the error of both away; in world units, with
+    // the scale of the instance's first transform (the animation only moves
+    // and rotates instances)
+    float secondaryRayOffset;
+  };
+
+  uint32_t lodInstanceCount = instanceCount << MESH_LOD_INDEX_BITS;
+
+  std::vector<InstanceStructure> instanceStructureList(lodInstanceCount);
+  for(int i = 0; i < lodInstanceCount; i++){
+    uint32_t instanceIndex = i >> MESH_LOD_INDEX_BITS;
+    uint32_t lod = i & ((1 << MESH_LOD_INDEX_BITS) - 1);
+
+    uint32_t baseMeshIndex = meshInstanceList[instanceIndex].meshIndex;
+    uint32_t lodCount = meshRegistry.getLodCount(baseMeshIndex);
+    uint32_t meshIndex = meshRegistry.getLodMeshIndex(baseMeshIndex, lod);
+    uint32_t secondaryMeshIndex = meshRegistry.getLodMeshIndex(
+        baseMeshIndex, getSecondaryMeshLod(lod, lodCount));
+
+    const Mesh& mesh = meshRegistry.getMesh(meshIndex);
+    const Mesh& secondaryMesh = meshRegistry.getMesh(secondaryMeshIndex);
+    instanceStructureList[i] = {
+      .indexOffset = meshIndexOffset[meshIndex],
+      .vertexOffset = meshVertexOffset[meshIndex],
+      .materialIndex = meshInstanceList[instanceIndex].materialIndex,
+      .meshIndex = meshIndex,
+      .positionOffset = {mesh.positionOffset[0], mesh.positionOffset[1],
+                         mesh.positionOffset[2]},
+      .shortIndices = meshIndexType[meshIndex] == VK_INDEX_TYPE_UINT16,
+      .positionScale = {mesh.positionScale[0], mesh.positionScale[1],
+                        mesh.positionScale[2]},
+      .secondaryRayOffset =
+          secondaryMeshIndex == meshIndex
+              ? 0.0f
+              : getTransformScale(meshInstanceList[instanceIndex].transform) *
+                    (mesh.simplificationError +
+                     secondaryMesh.simplificationError)};
+  }
+
+  VkBuffer instanceBufferHandle = VK_NULL_HANDLE;
+  VkDeviceMemory instanceDeviceMemoryHandle = VK_NULL_HANDLE;
+  VkDeviceAddress instanceBufferDeviceAddress;
+
+  buildBuffer(instanceBufferHandle,
+    sizeof(InstanceStructure) * lodInstanceCount,
+    queueFamilyIndex,
+    (void *) instanceStructureList.data(),
+      VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT |
+      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+    &memoryAllocateFlagsInfo,
+    instanceDeviceMemoryHandle,
+    instanceBufferDeviceAddress);
+
+  // =========================================================================
+  // Instance Motion
+  // (previous transform times the inverse of the current transform of every
+  //  instance, uploaded every frame through the frame upload ring for the
+  //  motion vectors)
+
+  std::vector<glm::mat4> previousInstanceTransformList(instanceCount);
+  std::vector<glm::mat4> instanceMotionList(instanceCount, glm::mat4(1));
+
+  // =========================================================================
+  // Instance Transform Buffer
+  // (device copy of the TLAS instances, made with every TLAS update, from
+  //  which the compact payload hits are transformed to world space)
+
+  VkBuffer instanceTransformBufferHandle = VK_NULL_HANDLE;
+  createBuffer(instanceTransformBufferHandle,
+    sizeof(VkAccelerationStructureInstanceKHR) * instanceCount,
+      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+      VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+    queueFamilyIndex);
+
+  VkDeviceMemory instanceTransformDeviceMemoryHandle = VK_NULL_HANDLE;
+  allocAndBind(instanceTransformDeviceMemoryHandle,
+    NULL,
+    instanceTransformBufferHandle,
+    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+  // =========================================================================
+  // Material Buffer
+
+  const std::vector<Material>& materialList = materialLibrary.getMaterials();
+
+  VkBuffer materialBufferHandle = VK_NULL_HANDLE;
+  VkDeviceMemory materialDeviceMemoryHandle = VK_NULL_HANDLE;
+  VkDeviceAddress materialBufferDeviceAddress;
+
+  buildBuffer(materialBufferHandle,
+    sizeof(Material) * materialList.size(),
+    queueFamilyIndex,
+    (void *) materialList.data(),
+      VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT |
+      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+    &memoryAllocateFlagsInfo,
+    materialDeviceMemoryHandle,
+    materialBufferDeviceAddress);
+
+  // =========================================================================
+  // Light Buffer
+  // (every light of the scene with the alias table that picks one of them
+  //  per shading point)
+
+  LightLibrary lightLibrary;
+
+  lightLibrary.addPointLight(glm::vec3(5, 5, 5), glm::vec3(KEY_LIGHT_INTENSITY));
+
+  std::mt19937 lightRandomEngine(0);
+  std::uniform_real_distribution<float> lightPositionDistribution(-15.0f, 15.0f);
+  for (uint32_t i = 0; i < RANDOM_POINT_LIGHT_COUNT; i++) {
+    glm::vec3 lightPosition(lightPositionDistribution(lightRandomEngine),
+                            lightPositionDistribution(lightRandomEngine),
+                            lightPositionDistribution(lightRandomEngine) - 5.0f);
+    lightLibrary.addPointLight(lightPosition,
+                               glm::vec3(RANDOM_POINT_LIGHT_INTENSITY));
+  }
+
+  // the triangles are placed once, so only instances that do not move
+  // (the ones before the orbiting instances) light the scene with their
+  // emission
+  uint32_t emissiveTriangleCount = 0;
+  for (uint32_t i = 0; i < firstOrbitingInstanceIndex; i++) {
+    const Material& material = materialList[meshInstanceList[i].materialIndex];
+    glm::vec3 emission(material.emission[0], material.emission[1],
+                       material.emission[2]);
+    if (emission == glm::vec3(0)) {
+      continue;
+    }
+
+    emissiveTriangleCount += lightLibrary.addEmissiveMesh(
+        meshRegistry.getMesh(meshInstanceList[i].meshIndex),
+        meshInstanceList[i].transform, emission);
+  }
+
+  lightLibrary.buildAliasTable();
+  const std::vector<Light>& lightList = lightLibrary.getLights();
+
+  std::cout << "Lights: " << lightList.size() << " (" << emissiveTriangleCount
+            << " emissive triangles)" << std::endl;
+
+  VkBuffer lightBufferHandle = VK_NULL_HANDLE;
+  VkDeviceMemory lightDeviceMemoryHandle = VK_NULL_HANDLE;
+  VkDeviceAddress lightBufferDeviceAddress;
+
+  buildBuffer(lightBufferHandle,
+    sizeof(Light) * lightList.size(),
+    queueFamilyIndex,
+    (void *) lightList.data(),
+      VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT |
+      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+    &memoryAllocateFlagsInfo,
+    lightDeviceMemoryHandle,
+    lightBufferDeviceAddress);
+
+  // =========================================================================
+  // Uniform Buffer
+
+  struct UniformStructure {
+    float cameraPosition[4] = {0, 0, 20, 1};
+    float cameraRight[4] = {1, 0, 0, 1};
+    float cameraUp[4] = {0, 1, 0, 1};
+    float cameraForward[4] = {0, 0, -1, 1};
+
+    uint32_t lightCount = 0;
+    uint32_t maxBounceCount = MAX_BOUNCE_COUNT;
+    uint32_t samplesPerPixel = SAMPLES_PER_PIXEL;
+    uint32_t frameIndex = 0;
+
+    // viewing matrix of the previous frame (std140 aligned mat4)
+    float previousViewMatrix[16] = {1, 0, 0, 0, 0, 1, 0, 0,
+                                    0, 0, 1, 0, 0, 0, 0, 1};
+
+    uint32_t environmentResolution = 0;
+    float environmentSelectionProbability = ENVIRONMENT_SELECTION_PROBABILITY;
+    float shadowCacheCellSize = 0;
+  } uniformStructure;
+
+  uniformStructure.lightCount = lightList.size();
+#ifdef ENVIRONMENT_SAMPLING_ENABLED
+  uniformStructure.environmentResolution = ENVIRONMENT_SAMPLING_RESOLUTION;
+#endif
+  if (isShadowRayBatchingEnabled) {
+    uniformStructure.shadowCacheCellSize = SHADOW_CACHE_CELL_SIZE;
+  }
+
+  // =========================================================================
+  // Frame Upload Ring
+  // (one slot per frame in flight in persistently mapped, coherent memory
+  //  for everything the host rewrites every frame; a slot is written only
+  //  after the fence of its frame has signaled)
+  //   uniforms        - binding 1, dynamic offset
+  //   instance motion - binding 13, dynamic offset
+  //   TLAS instances  - read by the acceleration structure update
+
+  VkDeviceSize frameUploadAlignment = std::max(
+      {(VkDeviceSize)16,
+       physicalDeviceProperties2.properties.limits
+           .minUniformBufferOffsetAlignment,
+       physicalDeviceProperties2.properties.limits
+           .minStorageBufferOffsetAlignment});
+
+  VkDeviceSize uniformUploadOffset = 0;
+  VkDeviceSize instanceMotionUploadOffset =
+      uniformUploadOffset +
+      alignUp(sizeof(UniformStructure), frameUploadAlignment);
+  VkDeviceSize topLevelInstanceUploadOffset =
+      instanceMotionUploadOffset +
+      alignUp(sizeof(glm::mat4) * instanceCount, frameUploadAlignment);
+  VkDeviceSize frameUploadStride =
+      topLevelInstanceUploadOffset +
+      alignUp(sizeof(VkAccelerationStructureInstanceKHR) *
+                  topLevelInstanceCount,
+              frameUploadAlignment);
+
+  VkBuffer frameUploadBufferHandle = VK_NULL_HANDLE;
+  createBuffer(frameUploadBufferHandle,
+    frameUploadStride * framesInFlightCount,
+      VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT |
+      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+      VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR |
+      VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT |
+      VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+    queueFamilyIndex);
+
+  VkDeviceMemory frameUploadDeviceMemoryHandle = VK_NULL_HANDLE;
+  allocAndBind(frameUploadDeviceMemoryHandle,
+    &memoryAllocateFlagsInfo,
+    frameUploadBufferHandle,
+    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+  VkBufferDeviceAddressInfo frameUploadBufferDeviceAddressInfo = {
+      .sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO,
+      .pNext = NULL,
+      .buffer = frameUploadBufferHandle};
+
+  VkDeviceAddress frameUploadBufferDeviceAddress =
+      pvkGetBufferDeviceAddressKHR(deviceHandle,
+                                   &frameUploadBufferDeviceAddressInfo);
+
+  // stays mapped until the memory is freed
+  void *frameUploadHostPointer = NULL;
+  result = vkMapMemory(deviceHandle, frameUploadDeviceMemoryHandle, 0,
+                       VK_WHOLE_SIZE, 0, &frameUploadHostPointer);
+
+  if (result != VK_SUCCESS) {
+    throwExceptionVulkanAPI(result, "vkMapMemory");
+  }
+
+  // every slot starts out valid for the passes run before the main loop
+  for (uint32_t i = 0; i < framesInFlightCount; i++) {
+    char *frameUploadSlotPointer =
+        (char *)frameUploadHostPointer + frameUploadStride * i;
+
+    memcpy(frameUploadSlotPointer + uniformUploadOffset, &uniformStructure,
+           sizeof(UniformStructure));
+    memcpy(frameUploadSlotPointer + instanceMotionUploadOffset,
+           instanceMotionList.data(), sizeof(glm::mat4) * instanceCount);
+  }
+
+  // =========================================================================
+  // Render Resolution
+  // (the images traced into are allocated for the largest render scale,
+  //  smaller scales use their top left corner)
+
+  std::vector<float> renderScaleList;
+#ifdef DYNAMIC_RESOLUTION_ENABLED
+  for (uint32_t i = 0; i < RENDER_SCALE_LEVEL_COUNT; i++) {
+    renderScaleList.push_back(RENDER_SCALE_MIN + (1.0f - RENDER_SCALE_MIN) * i /
+                              (RENDER_SCALE_LEVEL_COUNT - 1));
+  }
+#else
+  renderScaleList.push_back(RENDER_SCALE);
+#endif
+  uint32_t renderScaleLevelCount = renderScaleList.size();
+
+  std::vector<VkExtent2D> renderExtentList(renderScaleLevelCount);
+  for (uint32_t i = 0; i < renderScaleLevelCount; i++) {
+    renderExtentList[i] = {
+        .width = std::max(1u, (uint32_t)ceilf(renderScaleList[i] *
+                              surfaceCapabilities.currentExtent.width)),
+        .height = std::max(1u, (uint32_t)ceilf(renderScaleList[i] *
+                               surfaceCapabilities.currentExtent.height))};
+  }
+  VkExtent2D maxRenderExtent = renderExtentList.back();
+
+  // start at the level closest to RENDER_SCALE
+  uint32_t renderScaleLevel = 0;
+  for (uint32_t i = 0; i < renderScaleLevelCount; i++) {
+    if (fabsf(renderScaleList[i] - RENDER_SCALE) <
+        fabsf(renderScaleList[renderScaleLevel] - RENDER_SCALE)) {
+      renderScaleLevel = i;
+    }
+  }
+
+  // size of the images below, they are kept when the window shrinks and only
+  // grow when a resize needs more pixels than they hold
+  VkExtent2D renderTargetExtent = maxRenderExtent;
+
+  // =========================================================================
+  // Ray Trace Image
+
+  // linear HDR radiance, tonemapped into the swapchain image
+  VkImage rayTraceImageHandle = VK_NULL_HANDLE;
+  VkDeviceMemory rayTraceImageDeviceMemoryHandle = VK_NULL_HANDLE;
+  VkImageView rayTraceImageViewHandle = VK_NULL_HANDLE;
+
+  createStorageImage(rayTraceImageHandle,
+    rayTraceImageDeviceMemoryHandle,
+    rayTraceImageViewHandle,
+    VK_FORMAT_R16G16B16A16_SFLOAT,
+    maxRenderExtent.width,
+    maxRenderExtent.height,
+    queueFamilyIndex);
+
+  // =========================================================================
+  // G-Buffer Images
+  // (first hit of each pixel, written by the ray generation shader to guide
+  //  the denoiser)
+  //   0 - normal and hit distance
+  //   1 - albedo
+  //   2 - object index + 1, 0 on a miss
+  //   3 - motion vector to the previous frame and previous hit distance
+
+  std::vector<VkFormat> gBufferFormatList = {VK_FORMAT_R16G16B16A16_SFLOAT,
+                                             VK_FORMAT_R8G8B8A8_UNORM,
+                                             VK_FORMAT_R32_UINT,
+                                             VK_FORMAT_R16G16B16A16_SFLOAT};
+  uint32_t gBufferImageCount = gBufferFormatList.size();
+
+  std::vector<VkImage> gBufferImageHandleList(gBufferImageCount);
+  std::vector<VkDeviceMemory> gBufferImageDeviceMemoryHandleList(gBufferImageCount);
+  std::vector<VkImageView> gBufferImageViewHandleList(gBufferImageCount);
+
+  for (uint32_t i = 0; i < gBufferImageCount; i++) {
+    createStorageImage(gBufferImageHandleList[i],
+      gBufferImageDeviceMemoryHandleList[i],
+      gBufferImageViewHandleList[i],
+      gBufferFormatList[i],
+      maxRenderExtent.width,
+      maxRenderExtent.height,
+      queueFamilyIndex);
+  }
+
+  // =========================================================================
+  // Denoise Images
+  // (ping-pong targets of the a-trous filter iterations)
+
+  std::vector<VkImage> denoiseImageHandleList(2);
+  std::vector<VkDeviceMemory> denoiseImageDeviceMemoryHandleList(2);
+  std::vector<VkImageView> denoiseImageViewHandleList(2);
+
+  for (uint32_t i = 0; i < 2; i++) {
+    createStorageImage(denoiseImageHandleList[i],
+      denoiseImageDeviceMemoryHandleList[i],
+      denoiseImageViewHandleList[i],
+      VK_FORMAT_R16G16B16A16_SFLOAT,
+      maxRenderExtent.width,
+      maxRenderExtent.height,
+      queueFamilyIndex);
+  }
+
+  // =========================================================================
+  // Temporal Accumulation Images
+  // (the command buffers are recorded once per swapchain image, so instead of
+  //  swapping history images every frame the accumulated radiance and the
+  //  G-buffer are copied into the history at the end of the temporal pass)
+  //   0 - accumulated radiance
+  //   1 - radiance history, alpha is the history length in frames
+  //   2 - normal and hit distance history
+  //   3 - object index history
+
+  std::vector<VkFormat> temporalFormatList = {VK_FORMAT_R16G16B16A16_SFLOAT,
+                                              VK_FORMAT_R16G16B16A16_SFLOAT,
+                                              VK_FORMAT_R16G16B16A16_SFLOAT,
+                                              VK_FORMAT_R32_UINT};
+  uint32_t temporalImageCount = temporalFormatList.size();
+
+  std::vector<VkImage> temporalImageHandleList(temporalImageCount);
+  std::vector<VkDeviceMemory> temporalImageDeviceMemoryHandleList(temporalImageCount);
+  std::vector<VkImageView> temporalImageViewHandleList(temporalImageCount);
+
+  for (uint32_t i = 0; i < temporalImageCount; i++) {
+    createStorageImage(temporalImageHandleList[i],
+      temporalImageDeviceMemoryHandleList[i],
+      temporalImageViewHandleList[i],
+      temporalFormatList[i],
+      maxRenderExtent.width,
+      maxRenderExtent.height,
+      queueFamilyIndex);
+  }
+
+  std::vector<VkImage> historySourceImageHandleList = {
+      temporalImageHandleList[0], gBufferImageHandleList[0],
+      gBufferImageHandleList[2]};
+  std::vector<VkImage> historyDestinationImageHandleList = {
+      temporalImageHandleList[1], temporalImageHandleList[2],
+      temporalImageHandleList[3]};
+
+  // =========================================================================
+  // Path Queue Buffers
+  // (wavefront backend, see src/path_tracing.glsl; with the megakernel the
+  //  bindings only hold a single entry)
+  //   state  - queue counts, indirect trace and dispatch sizes, bin counts
+  //            and offsets (PathQueueState in shader_bin.comp)
+  //   queue  - rays appended by the generate and shade kernels (32 bytes)
+  //   sorted - the rays of the wave in bin order
+  //   rank   - position of every ray within its bin
+  //   hits   - closest hit of every sorted ray (64 bytes)
+  //   shadow - shadow rays appended by the shade kernel (64 bytes)
+
+  VkDeviceSize pathQueueStateBufferSize = 64 + 2 * 64 * sizeof(uint32_t);
+  VkDeviceSize pathQueueTraceSizeOffset = 16;
+  VkDeviceSize pathQueueDispatchSizeOffset = 32;
+  VkDeviceSize shadowQueueTraceSizeOffset = 48;
+
+  // at most one path in flight per pixel and wave
+  VkDeviceSize pathQueueCapacity =
+      isWavefrontEnabled
+          ? (VkDeviceSize)maxRenderExtent.width * maxRenderExtent.height
+          : 1;
+
+  VkBuffer pathQueueStateBufferHandle = VK_NULL_HANDLE;
+  createBuffer(pathQueueStateBufferHandle,
+    pathQueueStateBufferSize,
+      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+      VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+      VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT |
+      VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+    queueFamilyIndex);
+
+  VkDeviceMemory pathQueueStateDeviceMemoryHandle = VK_NULL_HANDLE;
+  allocAndBind(pathQueueStateDeviceMemoryHandle,
+    &memoryAllocateFlagsInfo,
+    pathQueueStateBufferHandle,
+    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+  VkBufferDeviceAddressInfo pathQueueStateBufferDeviceAddressInfo = {
+      .sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO,
+      .pNext = NULL,
+      .buffer = pathQueueStateBufferHandle};
+
+  VkDeviceAddress pathQueueStateBufferDeviceAddress =
+      pvkGetBufferDeviceAddressKHR(deviceHandle,
+                                   &pathQueueStateBufferDeviceAddressInfo);
+
+  std::vector<VkDeviceSize> pathQueueBufferSizeList = {
+      32 * pathQueueCapacity, 32 * pathQueueCapacity,
+      sizeof(uint32_t) * pathQueueCapacity, 64 * pathQueueCapacity,
+      64 * pathQueueCapacity};
+  uint32_t pathQueueBufferCount = pathQueueBufferSizeList.size();
+
+  std::vector<VkBuffer> pathQueueBufferHandleList(pathQueueBufferCount,
+                                                  VK_NULL_HANDLE);
+  std::vector<VkDeviceMemory> pathQueueDeviceMemoryHandleList(
+      pathQueueBufferCount, VK_NULL_HANDLE);
+
+  for (uint32_t i = 0; i < pathQueueBufferCount; i++) {
+    createBuffer(pathQueueBufferHandleList[i],
+      pathQueueBufferSizeList[i],
+      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+      queueFamilyIndex);
+
+    allocAndBind(pathQueueDeviceMemoryHandleList[i],
+      &memoryAllocateFlagsInfo,
+      pathQueueBufferHandleList[i],
+      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  }
+
+  // =========================================================================
+  // Shadow Batch Buffers
+  // (megakernel with SHADOW_RAY_BATCHING_ENABLED, see src/path_tracing.glsl;
+  //  otherwise the bindings only hold a single entry)
+  //   batch - shadow ray of every pixel and sample (64 bytes)
+  //   cache - shadow cache key and static visibility of every batch entry
+
+  VkDeviceSize shadowBatchCapacity =
+      isShadowRayBatchingEnabled
+          ? (VkDeviceSize)maxRenderExtent.width * maxRenderExtent.height *
+                SAMPLES_PER_PIXEL
+          : 1;
+
+  std::vector<VkDeviceSize> shadowBatchBufferSizeList = {
+      64 * shadowBatchCapacity, sizeof(uint32_t) * shadowBatchCapacity};
+  uint32_t shadowBatchBufferCount = shadowBatchBufferSizeList.size();
+
+  std::vector<VkBuffer> shadowBatchBufferHandleList(shadowBatchBufferCount,
+                                                    VK_NULL_HANDLE);
+  std::vector<VkDeviceMemory> shadowBatchDeviceMemoryHandleList(
+      shadowBatchBufferCount, VK_NULL_HANDLE);
+
+  for (uint32_t i = 0; i < shadowBatchBufferCount; i++) {
+    createBuffer(shadowBatchBufferHandleList[i],
+      shadowBatchBufferSizeList[i],
+      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+      VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+      queueFamilyIndex);
+
+    allocAndBind(shadowBatchDeviceMemoryHandleList[i],
+      &memoryAllocateFlagsInfo,
+      shadowBatchBufferHandleList[i],
+      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  }
+
+  // =========================================================================
+  // Ray Trace Image Barrier
+  // (VK_IMAGE_LAYOUT_UNDEFINED -> VK_IMAGE_LAYOUT_GENERAL for all storage
+  //  images)
+
+  VkCommandBufferBeginInfo rayTraceImageBarrierCommandBufferBeginInfo = {
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+      .pNext = NULL,
+      .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+      .pInheritanceInfo = NULL};
+
+  result = vkBeginCommandBuffer(commandBufferHandleList.back(),
+                                &rayTraceImageBarrierCommandBufferBeginInfo);
+
+  if (result != VK_SUCCESS) {
+    throwExceptionVulkanAPI(result, "vkBeginCommandBuffer");
+  }
+
+  std::vector<VkImage> storageImageHandleList = {rayTraceImageHandle};
+  storageImageHandleList.insert(storageImageHandleList.end(),
+                                gBufferImageHandleList.begin(),
+                                gBufferImageHandleList.end());
+  storageImageHandleList.insert(storageImageHandleList.end(),
+                                denoiseImageHandleList.begin(),
+                                denoiseImageHandleList.end());
+  storageImageHandleList.insert(storageImageHandleList.end(),
+                                temporalImageHandleList.begin(),
+                                temporalImageHandleList.end());
+
+  // the path queue starts empty, every frame leaves it empty again
+  vkCmdFillBuffer(commandBufferHandleList.back(), pathQueueStateBufferHandle,
+                  0, VK_WHOLE_SIZE, 0);
+
+  // no key is 0, so the shadow cache starts without entries
+  vkCmdFillBuffer(commandBufferHandleList.back(),
+                  shadowBatchBufferHandleList[1], 0, VK_WHOLE_SIZE, 0);
+
+  recordStorageImageInitialization(commandBufferHandleList.back(),
+    storageImageHandleList,
+    historyDestinationImageHandleList,
+    queueFamilyIndex);
+
+  result = vkEndCommandBuffer(commandBufferHandleList.back());
+
+  if (result != VK_SUCCESS) {
+    throwExceptionVulkanAPI(result, "vkEndCommandBuffer");
+  }
+
+  VkSubmitInfo rayTraceImageBarrierAccelerationStructureBuildSubmitInfo = {
+      .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+      .pNext = NULL,
+      .waitSemaphoreCount = 0,
+      .pWaitSemaphores = NULL,
+      .pWaitDstStageMask = NULL,
+      .commandBufferCount = 1,
+      .pCommandBuffers = &commandBufferHandleList.back(),
+      .signalSemaphoreCount = 0,
+      .pSignalSemaphores = NULL};
+
+  VkFenceCreateInfo
+      rayTraceImageBarrierAccelerationStructureBuildFenceCreateInfo = {
+          .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+          .pNext = NULL,
+          .flags = 0};
+
+  VkFence rayTraceImageBarrierAccelerationStructureBuildFenceHandle =
+      VK_NULL_HANDLE;
+  result = vkCreateFence(
+      deviceHandle,
+      &rayTraceImageBarrierAccelerationStructureBuildFenceCreateInfo, NULL,
+      &rayTraceImageBarrierAccelerationStructureBuildFenceHandle);
+
+  if (result != VK_SUCCESS) {
+    throwExceptionVulkanAPI(result, "vkCreateFence");
+  }
+
+  result = vkQueueSubmit(
+      queueHandle, 1, &rayTraceImageBarrierAccelerationStructureBuildSubmitInfo,
+      rayTraceImageBarrierAccelerationStructureBuildFenceHandle);
+
+  if (result != VK_SUCCESS) {
+    throwExceptionVulkanAPI(result, "vkQueueSubmit");
+  }
+
+  result = vkWaitForFences(
+      deviceHandle, 1,
+      &rayTraceImageBarrierAccelerationStructureBuildFenceHandle, true,
+      UINT32_MAX);
+
+  if (result != VK_SUCCESS && result != VK_TIMEOUT) {
+    throwExceptionVulkanAPI(result, "vkWaitForFences");
+  }
+
+  // =========================================================================
+  // Create Skybox Texture
+
+  const char *image_files[] = {
+    SKYBOX_TEXTURE_DIR "/right.jpg",
+    SKYBOX_TEXTURE_DIR "/left.jpg",
+    SKYBOX_TEXTURE_DIR "/top.jpg",
+    SKYBOX_TEXTURE_DIR "/bottom.jpg",
+    SKYBOX_TEXTURE_DIR "/front.jpg",
+    SKYBOX_TEXTURE_DIR "/back.jpg",
+  };
+
+  std::vector<unsigned char *> image_data(6);
+  int width, height, nrChannels;
+  for (int i = 0; i < 6; ++i)
+  {
+    unsigned char *data = stbi_load(image_files[i], &width, &height, &nrChannels, STBI_rgb_alpha);
+    image_data[i] = data;
+  } 
+  size_t image_size = width * height * 4;
+
+  // Create Staging Buffer
+
+  VkBuffer stagingBufferHandle = VK_NULL_HANDLE;
+  VkDeviceSize stagingBufferSize = image_size * 6;
+  createBuffer(stagingBufferHandle, stagingBufferSize, 
+      VK_BUFFER_USAGE_TRANSFER_SRC_BIT, queueFamilyIndex);
+
+  VkDeviceMemory stagingDeviceMemoryHandle = VK_NULL_HANDLE;
+
+  allocAndBind(stagingDeviceMemoryHandle, NULL, stagingBufferHandle, 
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+  void *hostStagingMemoryBuffer;
+  result = vkMapMemory(deviceHandle, stagingDeviceMemoryHandle, 0,
+                       stagingBufferSize, 0,
+                       &hostStagingMemoryBuffer);
+
+  if (result != VK_SUCCESS) {
+    throwExceptionVulkanAPI(result, "vkMapMemory");
+  }
+
+  for (int i = 0; i < 6; ++i)
+  {
+    memcpy(static_cast<char *>(hostStagingMemoryBuffer) + i * image_size, image_data[i], image_size);
+  } 
+
+  vkUnmapMemory(deviceHandle, stagingDeviceMemoryHandle);
+
+  // importance sampling distribution of the skybox (read by the shaders
+  // only with ENVIRONMENT_SAMPLING_ENABLED)
+  std::vector<float> environmentDistribution = buildEnvironmentDistribution(
+      image_data, width, height, ENVIRONMENT_SAMPLING_RESOLUTION);
+
+  VkBuffer environmentDistributionBufferHandle = VK_NULL_HANDLE;
+  VkDeviceMemory environmentDistributionDeviceMemoryHandle = VK_NULL_HANDLE;
+  VkDeviceAddress environmentDistributionBufferDeviceAddress;
+
+  buildBuffer(environmentDistributionBufferHandle,
+    sizeof(float) * environmentDistribution.size(),
+    queueFamilyIndex,
+    (void *) environmentDistribution.data(),
+      VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT |
+      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+    &memoryAllocateFlagsInfo,
+    environmentDistributionDeviceMemoryHandle,
+    environmentDistributionBufferDeviceAddress);
+
+  for (int i = 0; i < 6; ++i)
+  {
+    stbi_image_free(image_data[i]);
+  } 
+
+  // Create Skybox Image
+  VkImageCreateInfo skyboxImageInfo{};
+  skyboxImageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+  skyboxImageInfo.imageType = VK_IMAGE_TYPE_2D;
+  skyboxImageInfo.extent.width = width;
+  skyboxImageInfo.extent.height = height;
+  skyboxImageInfo.extent.depth = 1;
+  skyboxImageInfo.mipLevels = 1;
+  skyboxImageInfo.arrayLayers = 6;
+  skyboxImageInfo.format = VK_FORMAT_R8G8B8A8_SRGB;
+  skyboxImageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+  skyboxImageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  skyboxImageInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+  skyboxImageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+  skyboxImageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  skyboxImageInfo.flags = VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT;
+
+  VkImage skyboxImageHandle = VK_NULL_HANDLE;
+  result = vkCreateImage(deviceHandle, &skyboxImageInfo, nullptr, &skyboxImageHandle); 
+  if (result != VK_SUCCESS) 
+  {
+    throwExceptionVulkanAPI(result, "vkCreateImage");
+  }
+
+  VkMemoryRequirements memoryRequirements;
+  vkGetImageMemoryRequirements(deviceHandle, skyboxImageHandle,
+                                &memoryRequirements);
+
+  uint32_t memoryTypeIndex = getMemoryIndex(memoryRequirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  
+  VkMemoryAllocateInfo memoryAllocateInfo = {
+      .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+      .pNext = NULL,
+      .allocationSize = memoryRequirements.size,
+      .memoryTypeIndex = memoryTypeIndex};
+
+
+  VkDeviceMemory skyboxImageDeviceMemoryHandle = VK_NULL_HANDLE;
+  result = vkAllocateMemory(deviceHandle, &memoryAllocateInfo, NULL,
+                            &skyboxImageDeviceMemoryHandle);
+  if (result != VK_SUCCESS) {
+    throwExceptionVulkanAPI(result, "vkAllocateMemory");
+  }
+
+  result = vkBindImageMemory(deviceHandle, skyboxImageHandle,
+                              skyboxImageDeviceMemoryHandle, 0);
+  if (result != VK_SUCCESS) {
+    throwExceptionVulkanAPI(result, "vkBindImageMemory");
+  }
+
+  // Copy image data from buffer
+
+  uploadImage(skyboxImageHandle,
+    stagingBufferHandle,
+    width,
+    height,
+    6,
+    transferQueueFamilyIndex,
+    transferCommandBufferHandle,
+    transferQueueHandle,
+    queueFamilyIndex,
+    commandBufferHandleList.back(),
+    queueHandle);
+
+  vkDestroyBuffer(deviceHandle, stagingBufferHandle, NULL);
+  vkFreeMemory(deviceHandle, stagingDeviceMemoryHandle, NULL);
+
+  // Create image view for skybox
+
+  VkImageViewCreateInfo skyboxImageViewInfo{};
+  skyboxImageViewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+  skyboxImageViewInfo.image = skyboxImageHandle;
+  skyboxImageViewInfo.viewType = VK_IMAGE_VIEW_TYPE_CUBE;
+  skyboxImageViewInfo.format = VK_FORMAT_R8G8B8A8_SRGB;
+  skyboxImageViewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  skyboxImageViewInfo.subresourceRange.baseMipLevel = 0;
+  skyboxImageViewInfo.subresourceRange.levelCount = 1;
+  skyboxImageViewInfo.subresourceRange.baseArrayLayer = 0;
+  skyboxImageViewInfo.subresourceRange.layerCount = 6;
+
+  VkImageView skyboxImageViewHandle = VK_NULL_HANDLE;
+  result = vkCreateImageView(deviceHandle, &skyboxImageViewInfo, nullptr, &skyboxImageViewHandle);
+  if (result != VK_SUCCESS) {
+      throwExceptionVulkanAPI(result, "vkCreateImageView");
+  }
+
+  VkSamplerCreateInfo samplerInfo{};
+  samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+  samplerInfo.magFilter = VK_FILTER_LINEAR;
+  samplerInfo.minFilter = VK_FILTER_LINEAR;
+  samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerInfo.anisotropyEnable = VK_FALSE;
+  samplerInfo.maxAnisotropy = 0;
+  samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+  samplerInfo.unnormalizedCoordinates = VK_FALSE;
+  samplerInfo.compareEnable = VK_FALSE;
+  samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
+  samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
 
-  VkRayTracingPipelineCreateInfoKHR rayTracingPipelineCreateInfo = {
-      .sType = VK_STRUCTURE_TYPE_RAY_TRACING_PIPELINE_CREATE_INFO_KHR,
+  VkSampler skyboxSamplerHandle = VK_NULL_HANDLE;
+  result = vkCreateSampler(deviceHandle, &samplerInfo, nullptr, &skyboxSamplerHandle);
+  if (result != VK_SUCCESS) {
+    throwExceptionVulkanAPI(result, "vkCreateSampler");
+  }
+
+  // =========================================================================
+  // Material Textures
+
+  const std::vector<std::string>& texturePathList = materialLibrary.getTexturePaths();
+  uint32_t textureCount = texturePathList.size();
+
+  if (textureCount > MAX_TEXTURE_COUNT) {
+    throwExceptionMessage("Texture count exceeds MAX_TEXTURE_COUNT");
+  }
+
+  std::vector<VkImage> textureImageHandleList(textureCount, VK_NULL_HANDLE);
+  std::vector<VkDeviceMemory> textureImageDeviceMemoryHandleList(textureCount, VK_NULL_HANDLE);
+  std::vector<VkImageView> textureImageViewHandleList(textureCount, VK_NULL_HANDLE);
+
+  for (uint32_t i = 0; i < textureCount; i++) {
+    const unsigned char whitePixel[4] = {255, 255, 255, 255};
+
+    int textureWidth = 1, textureHeight = 1, textureChannels;
+    unsigned char *textureData = NULL;
+
+    if (!texturePathList[i].empty()) {
+      textureData = stbi_load(texturePathList[i].c_str(), &textureWidth,
+                              &textureHeight, &textureChannels, STBI_rgb_alpha);
+
+      if (textureData == NULL) {
+        std::cerr << "Failed to load texture " << texturePathList[i] << std::endl;
+        textureWidth = textureHeight = 1;
+      }
+    }
+
+    createTexture(textureImageHandleList[i],
+      textureImageDeviceMemoryHandleList[i],
+      textureImageViewHandleList[i],
+      textureData != NULL ? textureData : whitePixel,
+      textureWidth,
+      textureHeight,
+      transferQueueFamilyIndex,
+      transferCommandBufferHandle,
+      transferQueueHandle,
+      queueFamilyIndex,
+      commandBufferHandleList.back(),
+      queueHandle);
+
+    if (textureData != NULL) {
+      stbi_image_free(textureData);
+    }
+  }
+
+  VkSamplerCreateInfo textureSamplerCreateInfo = {
+      .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
       .pNext = NULL,
       .flags = 0,
-      .stageCount = 4,
-      .pStages = pipelineShaderStageCreateInfoList.data(),
-      .groupCount = 4,
-      .pGroups = rayTracingShaderGroupCreateInfoList.data(),
-      .maxPipelineRayRecursionDepth = 1,
-      .pLibraryInfo = NULL,
-      .pLibraryInterface = NULL,
-      .pDynamicState = NULL,
-      .layout = pipelineLayoutHandle,
-      .basePipelineHandle = VK_NULL_HANDLE,
-      .basePipelineIndex = 0};
+      .magFilter = VK_FILTER_LINEAR,
+      .minFilter = VK_FILTER_LINEAR,
+      .mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR,
+      .addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT,
+      .addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT,
+      .addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT,
+      .mipLodBias = 0,
+      .anisotropyEnable = VK_FALSE,
+      .maxAnisotropy = 0,
+      .compareEnable = VK_FALSE,
+      .compareOp = VK_COMPARE_OP_ALWAYS,
+      .minLod = 0,
+      .maxLod = 0,
+      .borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK,
+      .unnormalizedCoordinates = VK_FALSE};
+
+  VkSampler textureSamplerHandle = VK_NULL_HANDLE;
+  result = vkCreateSampler(deviceHandle, &textureSamplerCreateInfo, NULL,
+                           &textureSamplerHandle);
+  if (result != VK_SUCCESS) {
+    throwExceptionVulkanAPI(result, "vkCreateSampler");
+  }
+
+  // =========================================================================
+  // Update Descriptor Set
+
+  VkWriteDescriptorSetAccelerationStructureKHR
+      accelerationStructureDescriptorInfo = {
+          .sType =
+              VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET_ACCELERATION_STRUCTURE_KHR,
+          .pNext = NULL,
+          .accelerationStructureCount = 1,
+          .pAccelerationStructures = &topLevelAccelerationStructureHandle};
+
+  // the dynamic offset selects the frame upload ring slot
+  VkDescriptorBufferInfo uniformDescriptorInfo = {
+      .buffer = frameUploadBufferHandle,
+      .offset = uniformUploadOffset,
+      .range = sizeof(UniformStructure)};
+
+  VkDescriptorBufferInfo indexDescriptorInfo = {
+      .buffer = indexBufferHandle, .offset = 0, .range = VK_WHOLE_SIZE};
+
+  VkDescriptorBufferInfo vertexDescriptorInfo = {
+      .buffer = vertexBufferHandle, .offset = 0, .range = VK_WHOLE_SIZE};
+
+  VkDescriptorBufferInfo instanceDescriptorInfo = {
+      .buffer = instanceBufferHandle, .offset = 0, .range = VK_WHOLE_SIZE};
+
+  VkDescriptorBufferInfo materialDescriptorInfo = {
+      .buffer = materialBufferHandle, .offset = 0, .range = VK_WHOLE_SIZE};
+
+  VkDescriptorBufferInfo lightDescriptorInfo = {
+      .buffer = lightBufferHandle, .offset = 0, .range = VK_WHOLE_SIZE};
+
+  VkDescriptorBufferInfo environmentDistributionDescriptorInfo = {
+      .buffer = environmentDistributionBufferHandle,
+      .offset = 0,
+      .range = VK_WHOLE_SIZE};
+
+  VkDescriptorBufferInfo instanceMotionDescriptorInfo = {
+      .buffer = frameUploadBufferHandle,
+      .offset = instanceMotionUploadOffset,
+      .range = sizeof(glm::mat4) * instanceCount};
+
+  VkDescriptorBufferInfo instanceTransformDescriptorInfo = {
+      .buffer = instanceTransformBufferHandle, .offset = 0, .range = VK_WHOLE_SIZE};
+
+  VkDescriptorBufferInfo pathQueueStateDescriptorInfo = {
+      .buffer = pathQueueStateBufferHandle, .offset = 0, .range = VK_WHOLE_SIZE};
+
+  std::vector<VkDescriptorBufferInfo> pathQueueDescriptorInfoList;
+  for (uint32_t i = 0; i < pathQueueBufferCount; i++) {
+    pathQueueDescriptorInfoList.push_back(
+        {.buffer = pathQueueBufferHandleList[i],
+         .offset = 0,
+         .range = VK_WHOLE_SIZE});
+  }
+
+  std::vector<VkDescriptorBufferInfo> shadowBatchDescriptorInfoList;
+  for (uint32_t i = 0; i < shadowBatchBufferCount; i++) {
+    shadowBatchDescriptorInfoList.push_back(
+        {.buffer = shadowBatchBufferHandleList[i],
+         .offset = 0,
+         .range = VK_WHOLE_SIZE});
+  }
+
+  std::vector<VkDescriptorImageInfo> textureDescriptorInfoList(textureCount);
+  for (uint32_t i = 0; i < textureCount; i++) {
+    textureDescriptorInfoList[i] = {
+        .sampler = textureSamplerHandle,
+        .imageView = textureImageViewHandleList[i],
+        .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+  }
+
+  VkDescriptorImageInfo rayTraceImageDescriptorInfo = {
+      .sampler = VK_NULL_HANDLE,
+      .imageView = rayTraceImageViewHandle,
+      .imageLayout = VK_IMAGE_LAYOUT_GENERAL};
+
+  std::vector<VkDescriptorImageInfo> gBufferDescriptorInfoList(gBufferImageCount);
+  for (uint32_t i = 0; i < gBufferImageCount; i++) {
+    gBufferDescriptorInfoList[i] = {
+        .sampler = VK_NULL_HANDLE,
+        .imageView = gBufferImageViewHandleList[i],
+        .imageLayout = VK_IMAGE_LAYOUT_GENERAL};
+  }
+
+  VkDescriptorImageInfo skyboxSamplerDescriptorInfo = {
+      .sampler = skyboxSamplerHandle,
+      .imageView = skyboxImageViewHandle,
+      .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+
+  std::vector<VkWriteDescriptorSet> writeDescriptorSetList = {
+      {.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+       .pNext = &accelerationStructureDescriptorInfo,
+       .dstSet = descriptorSetHandleList[0],
+       .dstBinding = 0,
+       .dstArrayElement = 0,
+       .descriptorCount = 1,
+       .descriptorType = VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR,
+       .pImageInfo = NULL,
+       .pBufferInfo = NULL,
+       .pTexelBufferView = NULL},
+      {.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+       .pNext = NULL,
+       .dstSet = descriptorSetHandleList[0],
+       .dstBinding = 1,
+       .dstArrayElement = 0,
+       .descriptorCount = 1,
+       .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+       .pImageInfo = NULL,
+       .pBufferInfo = &uniformDescriptorInfo,
+       .pTexelBufferView = NULL},
+      {.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+       .pNext = NULL,
+       .dstSet = descriptorSetHandleList[0],
+       .dstBinding = 2,
+       .dstArrayElement = 0,
+       .descriptorCount = 1,
+       .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+       .pImageInfo = NULL,
+       .pBufferInfo = &indexDescriptorInfo,
+       .pTexelBufferView = NULL},
+      {.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+       .pNext = NULL,
+       .dstSet = descriptorSetHandleList[0],
+       .dstBinding = 3,
+       .dstArrayElement = 0,
+       .descriptorCount = 1,
+       .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+       .pImageInfo = NULL,
+       .pBufferInfo = &vertexDescriptorInfo,
+       .pTexelBufferView = NULL},
+      {.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+       .pNext = NULL,
+       .dstSet = descriptorSetHandleList[0],
+       .dstBinding = 4,
+       .dstArrayElement = 0,
+       .descriptorCount = 1,
+       .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+       .pImageInfo = &rayTraceImageDescriptorInfo,
+       .pBufferInfo = NULL,
+       .pTexelBufferView = NULL},
+      {.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+       .pNext = NULL,
+       .dstSet = descriptorSetHandleList[0],
+       .dstBinding = 5,
+       .dstArrayElement = 0,
+       .descriptorCount = 1,
+       .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+       .pImageInfo = &skyboxSamplerDescriptorInfo,
+       .pBufferInfo = NULL,
+       .pTexelBufferView = NULL},
+      {.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+       .pNext = NULL,
+       .dstSet = descriptorSetHandleList[0],
+       .dstBinding = 6,
+       .dstArrayElement = 0,
+       .descriptorCount = 1,
+       .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+       .pImageInfo = NULL,
+       .pBufferInfo = &instanceDescriptorInfo,
+       .pTexelBufferView = NULL},
+      {.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+       .pNext = NULL,
+       .dstSet = descriptorSetHandleList[0],
+       .dstBinding = 7,
+       .dstArrayElement = 0,
+       .descriptorCount = 1,
+       .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+       .pImageInfo = NULL,
+       .pBufferInfo = &materialDescriptorInfo,
+       .pTexelBufferView = NULL},
+      {.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+       .pNext = NULL,
+       .dstSet = descriptorSetHandleList[0],
+       .dstBinding = 8,
+       .dstArrayElement = 0,
+       .descriptorCount = textureCount,
+       .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+       .pImageInfo = textureDescriptorInfoList.data(),
+       .pBufferInfo = NULL,
+       .pTexelBufferView = NULL},
+      {.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+       .pNext = NULL,
+       .dstSet = descriptorSetHandleList[0],
+       .dstBinding = 13,
+       .dstArrayElement = 0,
+       .descriptorCount = 1,
+       .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC,
+       .pImageInfo = NULL,
+       .pBufferInfo = &instanceMotionDescriptorInfo,
+       .pTexelBufferView = NULL},
+      {.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+       .pNext = NULL,
+       .dstSet = descriptorSetHandleList[0],
+       .dstBinding = 14,
+       .dstArrayElement = 0,
+       .descriptorCount = 1,
+       .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+       .pImageInfo = NULL,
+       .pBufferInfo = &pathQueueStateDescriptorInfo,
+       .pTexelBufferView = NULL}};
+
+  // queue, sorted queue, hits and shadow queue (bindings 15 to 18), the
+  // rank buffer is only used by the bin pass
+  std::vector<uint32_t> pathQueueBindingBufferIndexList = {0, 1, 3, 4};
+  for (uint32_t i = 0; i < pathQueueBindingBufferIndexList.size(); i++) {
+    writeDescriptorSetList.push_back(
+        {.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+         .pNext = NULL,
+         .dstSet = descriptorSetHandleList[0],
+         .dstBinding = 15 + i,
+         .dstArrayElement = 0,
+         .descriptorCount = 1,
+         .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+         .pImageInfo = NULL,
+         .pBufferInfo =
+             &pathQueueDescriptorInfoList[pathQueueBindingBufferIndexList[i]],
+         .pTexelBufferView = NULL});
+  }
+
+  writeDescriptorSetList.push_back(
+      {.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+       .pNext = NULL,
+       .dstSet = descriptorSetHandleList[0],
+       .dstBinding = 19,
+       .dstArrayElement = 0,
+       .descriptorCount = 1,
+       .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+       .pImageInfo = NULL,
+       .pBufferInfo = &instanceTransformDescriptorInfo,
+       .pTexelBufferView = NULL});
+
+  writeDescriptorSetList.push_back(
+      {.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+       .pNext = NULL,
+       .dstSet = descriptorSetHandleList[0],
+       .dstBinding = 20,
+       .dstArrayElement = 0,
+       .descriptorCount = 1,
+       .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+       .pImageInfo = NULL,
+       .pBufferInfo = &lightDescriptorInfo,
+       .pTexelBufferView = NULL});
+
+  writeDescriptorSetList.push_back(
+      {.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+       .pNext = NULL,
+       .dstSet = descriptorSetHandleList[0],
+       .dstBinding = 21,
+       .dstArrayElement = 0,
+       .descriptorCount = 1,
+       .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+       .pImageInfo = NULL,
+       .pBufferInfo = &environmentDistributionDescriptorInfo,
+       .pTexelBufferView = NULL});
+
+  // shadow batch and cache (bindings 22 and 23)
+  for (uint32_t i = 0; i < shadowBatchBufferCount; i++) {
+    writeDescriptorSetList.push_back(
+        {.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+         .pNext = NULL,
+         .dstSet = descriptorSetHandleList[0],
+         .dstBinding = 22 + i,
+         .dstArrayElement = 0,
+         .descriptorCount = 1,
+         .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+         .pImageInfo = NULL,
+         .pBufferInfo = &shadowBatchDescriptorInfoList[i],
+         .pTexelBufferView = NULL});
+  }
+
+  for (uint32_t i = 0; i < gBufferImageCount; i++) {
+    writeDescriptorSetList.push_back(
+        {.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+         .pNext = NULL,
+         .dstSet = descriptorSetHandleList[0],
+         .dstBinding = 9 + i,
+         .dstArrayElement = 0,
+         .descriptorCount = 1,
+         .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+         .pImageInfo = &gBufferDescriptorInfoList[i],
+         .pBufferInfo = NULL,
+         .pTexelBufferView = NULL});
+  }
+
+  vkUpdateDescriptorSets(deviceHandle, writeDescriptorSetList.size(),
+                         writeDescriptorSetList.data(), 0, NULL);
+
+  // =========================================================================
+  // Shader Binding Table
+
+  VkBuffer shaderBindingTableBufferHandle = VK_NULL_HANDLE;
+  VkDeviceMemory shaderBindingTableDeviceMemoryHandle = VK_NULL_HANDLE;
+  char *shaderHandleBuffer = NULL;
+  VkDeviceAddress shaderBindingTableBufferDeviceAddress = 0;
+
+  if (isRayTracingPipelineNeeded) {
+    // one record per shader group, each aligned to the group base alignment
+    uint32_t shaderGroupCount =
+        (uint32_t)rayTracingShaderGroupCreateInfoList.size();
+
+    VkDeviceSize shaderGroupHandleDataSize =
+        physicalDeviceRayTracingPipelineProperties.shaderGroupHandleSize *
+        shaderGroupCount;
+
+    VkDeviceSize shaderBindingTableSize =
+        physicalDeviceRayTracingPipelineProperties.shaderGroupBaseAlignment *
+        shaderGroupCount;
+
+    createBuffer(shaderBindingTableBufferHandle,
+      shaderBindingTableSize,
+        VK_BUFFER_USAGE_SHADER_BINDING_TABLE_BIT_KHR |
+        VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+      queueFamilyIndex);
+
+    allocAndBind(shaderBindingTableDeviceMemoryHandle,
+      &memoryAllocateFlagsInfo,
+      shaderBindingTableBufferHandle,
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+
+    shaderHandleBuffer = new char[shaderGroupHandleDataSize];
+    result = pvkGetRayTracingShaderGroupHandlesKHR(
+        deviceHandle, rayTracingPipelineHandle, 0, shaderGroupCount,
+        shaderGroupHandleDataSize, shaderHandleBuffer);
+
+    if (result != VK_SUCCESS) {
+      throwExceptionVulkanAPI(result, "vkGetRayTracingShaderGroupHandlesKHR");
+    }
+
+    void *hostShaderBindingTableMemoryBuffer;
+    result = vkMapMemory(deviceHandle, shaderBindingTableDeviceMemoryHandle, 0,
+                         shaderBindingTableSize, 0,
+                         &hostShaderBindingTableMemoryBuffer);
+
+    for (uint32_t x = 0; x < shaderGroupCount; x++) {
+      memcpy(hostShaderBindingTableMemoryBuffer,
+             shaderHandleBuffer + x * physicalDeviceRayTracingPipelineProperties
+                                          .shaderGroupHandleSize,
+             physicalDeviceRayTracingPipelineProperties.shaderGroupHandleSize);
+      hostShaderBindingTableMemoryBuffer =
+          (char *)hostShaderBindingTableMemoryBuffer +
+          physicalDeviceRayTracingPipelineProperties.shaderGroupBaseAlignment;
+    }
+
+    if (result != VK_SUCCESS) {
+      throwExceptionVulkanAPI(result, "vkMapMemory");
+    }
+
+    vkUnmapMemory(deviceHandle, shaderBindingTableDeviceMemoryHandle);
+
+    VkBufferDeviceAddressInfo shaderBindingTableBufferDeviceAddressInfo = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO,
+        .pNext = NULL,
+        .buffer = shaderBindingTableBufferHandle};
+
+    shaderBindingTableBufferDeviceAddress =
+        pvkGetBufferDeviceAddressKHR(deviceHandle,
+                                     &shaderBindingTableBufferDeviceAddressInfo);
+  }
+
+  VkDeviceSize progSize =
+      physicalDeviceRayTracingPipelineProperties.shaderGroupBaseAlignment;
+
+  VkDeviceSize sbtSize = progSize * (VkDeviceSize)4;
+  VkDeviceSize hitGroupOffset = 0u * progSize;
+  VkDeviceSize rayGenOffset = 1u * progSize;
+  VkDeviceSize missOffset = 2u * progSize;
+
+  const VkStridedDeviceAddressRegionKHR rchitShaderBindingTable = {
+      .deviceAddress = shaderBindingTableBufferDeviceAddress + 0u * progSize,
+      .stride = progSize,
+      .size = sbtSize * 1};
+
+  const VkStridedDeviceAddressRegionKHR rgenShaderBindingTable = {
+      .deviceAddress = shaderBindingTableBufferDeviceAddress + 1u * progSize,
+      .stride = sbtSize,
+      .size = sbtSize * 1};
 
-  VkPipeline rayTracingPipelineHandle = VK_NULL_HANDLE;
-  result = pvkCreateRayTracingPipelinesKHR(
-      deviceHandle, VK_NULL_HANDLE, VK_NULL_HANDLE, 1,
-      &rayTracingPipelineCreateInfo, NULL, &rayTracingPipelineHandle);
+  const VkStridedDeviceAddressRegionKHR rmissShaderBindingTable = {
+      .deviceAddress = shaderBindingTableBufferDeviceAddress + 2u * progSize,
+      .stride = progSize,
+      .size = sbtSize * 2};
 
-  if (result != VK_SUCCESS) {
-    throwExceptionVulkanAPI(result, "vkCreateRayTracingPipelinesKHR");
-  }
+  // wavefront extension and shadow kernels
+  const VkStridedDeviceAddressRegionKHR extendShaderBindingTable = {
+      .deviceAddress = shaderBindingTableBufferDeviceAddress + 4u * progSize,
+      .stride = progSize,
+      .size = progSize};
 
-  // =========================================================================
-  // OBJ Model
+  const VkStridedDeviceAddressRegionKHR shadowShaderBindingTable = {
+      .deviceAddress = shaderBindingTableBufferDeviceAddress + 5u * progSize,
+      .stride = progSize,
+      .size = progSize};
 
-  tinyobj::ObjReaderConfig reader_config;
-  tinyobj::ObjReader reader;
+  const VkStridedDeviceAddressRegionKHR callableShaderBindingTable = {};
 
-  std::vector<tinyobj::attrib_t> attrib;
-  std::vector<std::vector<tinyobj::shape_t>> shapes;
- 
-  std::vector<const char*> fileNames = {
-    CENTER_MESH_OBJ_PATH,
-    ORBITING_MESH_OBJ_PATH,
-  };
+  // =========================================================================
+  // Shadow Batch Pipeline
+  // (megakernel with SHADOW_RAY_BATCHING_ENABLED: traces the shadow rays
+  //  written by the megakernel in one launch without a closest hit shader,
+  //  see shader_shadow_batch.rgen)
+
+  VkShaderModule rayShadowBatchShaderModuleHandle = VK_NULL_HANDLE;
+  VkPipeline shadowBatchPipelineHandle = VK_NULL_HANDLE;
+  VkBuffer shadowBatchShaderBindingTableBufferHandle = VK_NULL_HANDLE;
+  VkDeviceMemory shadowBatchShaderBindingTableDeviceMemoryHandle =
+      VK_NULL_HANDLE;
+  VkDeviceAddress shadowBatchShaderBindingTableBufferDeviceAddress = 0;
+
+  if (isShadowRayBatchingEnabled) {
+    std::ifstream rayShadowBatchFile("shaders/shader_shadow_batch.rgen.spv",
+                                     std::ios::binary | std::ios::ate);
+    std::streamsize rayShadowBatchFileSize = rayShadowBatchFile.tellg();
+    rayShadowBatchFile.seekg(0, std::ios::beg);
+    std::vector<uint32_t> rayShadowBatchShaderSource(rayShadowBatchFileSize /
+                                                     sizeof(uint32_t));
+    rayShadowBatchFile.read((char *)rayShadowBatchShaderSource.data(),
+                            rayShadowBatchFileSize);
+    rayShadowBatchFile.close();
+
+    VkShaderModuleCreateInfo rayShadowBatchShaderModuleCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .codeSize =
+            (uint32_t)rayShadowBatchShaderSource.size() * sizeof(uint32_t),
+        .pCode = rayShadowBatchShaderSource.data()};
 
-  uint32_t objectCount = fileNames.size();
+    result =
+        vkCreateShaderModule(deviceHandle, &rayShadowBatchShaderModuleCreateInfo,
+                             NULL, &rayShadowBatchShaderModuleHandle);
 
-  for(const char* fileName: fileNames){
-    parseFile(reader_config, reader, fileName);
+    if (result != VK_SUCCESS) {
+      throwExceptionVulkanAPI(result, "vkCreateShaderModule");
+    }
 
-    attrib.push_back(reader.GetAttrib());
+    std::vector<VkPipelineShaderStageCreateInfo>
+        shadowBatchShaderStageCreateInfoList = {
+            {.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+             .pNext = NULL,
+             .flags = 0,
+             .stage = VK_SHADER_STAGE_RAYGEN_BIT_KHR,
+             .module = rayShadowBatchShaderModuleHandle,
+             .pName = "main",
+             .pSpecializationInfo = NULL},
+            {.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+             .pNext = NULL,
+             .flags = 0,
+             .stage = VK_SHADER_STAGE_MISS_BIT_KHR,
+             .module = rayMissShadowShaderModuleHandle,
+             .pName = "main",
+             .pSpecializationInfo = NULL}};
+
+    std::vector<VkRayTracingShaderGroupCreateInfoKHR>
+        shadowBatchShaderGroupCreateInfoList = {
+            {.sType = VK_STRUCTURE_TYPE_RAY_TRACING_SHADER_GROUP_CREATE_INFO_KHR,
+             .pNext = NULL,
+             .type = VK_RAY_TRACING_SHADER_GROUP_TYPE_GENERAL_KHR,
+             .generalShader = 0,
+             .closestHitShader = VK_SHADER_UNUSED_KHR,
+             .anyHitShader = VK_SHADER_UNUSED_KHR,
+             .intersectionShader = VK_SHADER_UNUSED_KHR,
+             .pShaderGroupCaptureReplayHandle = NULL},
+            {.sType = VK_STRUCTURE_TYPE_RAY_TRACING_SHADER_GROUP_CREATE_INFO_KHR,
+             .pNext = NULL,
+             .type = VK_RAY_TRACING_SHADER_GROUP_TYPE_GENERAL_KHR,
+             .generalShader = 1,
+             .closestHitShader = VK_SHADER_UNUSED_KHR,
+             .anyHitShader = VK_SHADER_UNUSED_KHR,
+             .intersectionShader = VK_SHADER_UNUSED_KHR,
+             .pShaderGroupCaptureReplayHandle = NULL}};
+
+    VkRayTracingPipelineCreateInfoKHR shadowBatchPipelineCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_RAY_TRACING_PIPELINE_CREATE_INFO_KHR,
+        .pNext = NULL,
+        .flags = VK_PIPELINE_CREATE_RAY_TRACING_SKIP_CLOSEST_HIT_SHADERS_BIT_KHR,
+        .stageCount = (uint32_t)shadowBatchShaderStageCreateInfoList.size(),
+        .pStages = shadowBatchShaderStageCreateInfoList.data(),
+        .groupCount = (uint32_t)shadowBatchShaderGroupCreateInfoList.size(),
+        .pGroups = shadowBatchShaderGroupCreateInfoList.data(),
+        .maxPipelineRayRecursionDepth = 1,
+        .pLibraryInfo = NULL,
+        .pLibraryInterface = NULL,
+        .pDynamicState = NULL,
+        .layout = pipelineLayoutHandle,
+        .basePipelineHandle = VK_NULL_HANDLE,
+        .basePipelineIndex = 0};
+
+    result = pvkCreateRayTracingPipelinesKHR(
+        deviceHandle, VK_NULL_HANDLE, VK_NULL_HANDLE, 1,
+        &shadowBatchPipelineCreateInfo, NULL, &shadowBatchPipelineHandle);
 
-    const std::vector<tinyobj::shape_t>& readShapes = reader.GetShapes();
-    shapes.push_back(readShapes);
-  }
+    if (result != VK_SUCCESS) {
+      throwExceptionVulkanAPI(result, "vkCreateRayTracingPipelinesKHR");
+    }
 
-  assert(attrib.size() == objectCount);
-  assert(shapes.size() == objectCount);
+    // raygen record followed by the shadow miss record
+    uint32_t shadowBatchShaderGroupCount =
+        (uint32_t)shadowBatchShaderGroupCreateInfoList.size();
 
-  size_t totalVertexBufferSize = 0;
-  for(int i = 0; i < objectCount; i++){
-    totalVertexBufferSize += sizeof(tinyobj::real_t) * 2 * attrib[i].vertices.size();
-  }
+    VkDeviceSize shadowBatchShaderGroupHandleDataSize =
+        physicalDeviceRayTracingPipelineProperties.shaderGroupHandleSize *
+        shadowBatchShaderGroupCount;
 
-  size_t totalIndexBufferSize = 0;
+    VkDeviceSize shadowBatchShaderBindingTableSize =
+        progSize * shadowBatchShaderGroupCount;
 
-  std::vector<uint32_t> primitiveCount(objectCount, 0);
+    createBuffer(shadowBatchShaderBindingTableBufferHandle,
+      shadowBatchShaderBindingTableSize,
+        VK_BUFFER_USAGE_SHADER_BINDING_TABLE_BIT_KHR |
+        VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+      queueFamilyIndex);
 
-  std::vector<std::vector<uint32_t>> indexList;
-  for(int i = 0; i < objectCount; i++){
-    std::vector<uint32_t> currIndexList;
+    allocAndBind(shadowBatchShaderBindingTableDeviceMemoryHandle,
+      &memoryAllocateFlagsInfo,
+      shadowBatchShaderBindingTableBufferHandle,
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
 
-    for (tinyobj::shape_t shape : shapes[i]) {
-      primitiveCount[i] += shape.mesh.num_face_vertices.size();
-      
-      for (tinyobj::index_t index : shape.mesh.indices) {
-        currIndexList.push_back(index.vertex_index);
-      }
-    }
-    
-    indexList.push_back(currIndexList);
-    totalIndexBufferSize += sizeof(uint32_t) * currIndexList.size();
-  }
- 
+    std::vector<char> shadowBatchShaderHandleBuffer(
+        shadowBatchShaderGroupHandleDataSize);
+    result = pvkGetRayTracingShaderGroupHandlesKHR(
+        deviceHandle, shadowBatchPipelineHandle, 0, shadowBatchShaderGroupCount,
+        shadowBatchShaderGroupHandleDataSize,
+        shadowBatchShaderHandleBuffer.data());
 
-  // =========================================================================
-  // Vertex Buffer
+    if (result != VK_SUCCESS) {
+      throwExceptionVulkanAPI(result, "vkGetRayTracingShaderGroupHandlesKHR");
+    }
 
-  std::vector<VkDeviceAddress> vertexBufferDeviceAddress(objectCount);
-  VkBuffer vertexBufferHandle = VK_NULL_HANDLE;
-  VkDeviceMemory vertexDeviceMemoryHandle = VK_NULL_HANDLE;
-  
-  VkDeviceSize currentVertexBufferOffset = 0;
-  for(int i = 0; i < objectCount; i++){
-    auto vertices = attrib[i].vertices;
-    auto normals = attrib[i].normals;
+    void *hostShadowBatchShaderBindingTableMemoryBuffer;
+    result = vkMapMemory(deviceHandle,
+                         shadowBatchShaderBindingTableDeviceMemoryHandle, 0,
+                         shadowBatchShaderBindingTableSize, 0,
+                         &hostShadowBatchShaderBindingTableMemoryBuffer);
 
-    size_t vertexCount = vertices.size();
-    size_t vertexBufferSize = sizeof(tinyobj::real_t) * 2 * vertexCount;
-    std::vector<tinyobj::real_t> tmpBuffer(2 * vertexCount);
+    if (result != VK_SUCCESS) {
+      throwExceptionVulkanAPI(result, "vkMapMemory");
+    }
 
-    for (size_t i = 0; i < vertexCount; i += 3)
-    {
-      size_t offset = 2 * i, attribOffset = i;
-      tmpBuffer[offset] = vertices[attribOffset];
-      tmpBuffer[offset + 1] = vertices[attribOffset + 1];
-      tmpBuffer[offset + 2] = vertices[attribOffset + 2];
-      tmpBuffer[offset + 3] = normals[attribOffset];
-      tmpBuffer[offset + 4] = normals[attribOffset + 1];
-      tmpBuffer[offset + 5] = normals[attribOffset + 2];
+    for (uint32_t x = 0; x < shadowBatchShaderGroupCount; x++) {
+      memcpy((char *)hostShadowBatchShaderBindingTableMemoryBuffer +
+                 x * progSize,
+             shadowBatchShaderHandleBuffer.data() +
+                 x * physicalDeviceRayTracingPipelineProperties
+                         .shaderGroupHandleSize,
+             physicalDeviceRayTracingPipelineProperties.shaderGroupHandleSize);
     }
 
-    buildBuffer(vertexBufferHandle,
-      totalVertexBufferSize,
-      queueFamilyIndex,
-      (void *) tmpBuffer.data(),
-        VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT |
-        VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR |
-        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
-      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
-      &memoryAllocateFlagsInfo,
-      vertexDeviceMemoryHandle,
-      vertexBufferDeviceAddress[i],
-      currentVertexBufferOffset,
-      vertexBufferSize
-      );
-    
-    currentVertexBufferOffset += vertexBufferSize;
+    vkUnmapMemory(deviceHandle, shadowBatchShaderBindingTableDeviceMemoryHandle);
+
+    VkBufferDeviceAddressInfo shadowBatchShaderBindingTableBufferDeviceAddressInfo = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO,
+        .pNext = NULL,
+        .buffer = shadowBatchShaderBindingTableBufferHandle};
+
+    shadowBatchShaderBindingTableBufferDeviceAddress =
+        pvkGetBufferDeviceAddressKHR(
+            deviceHandle, &shadowBatchShaderBindingTableBufferDeviceAddressInfo);
   }
 
+  const VkStridedDeviceAddressRegionKHR shadowBatchRgenShaderBindingTable = {
+      .deviceAddress = shadowBatchShaderBindingTableBufferDeviceAddress,
+      .stride = progSize,
+      .size = progSize};
+
+  const VkStridedDeviceAddressRegionKHR shadowBatchRmissShaderBindingTable = {
+      .deviceAddress =
+          shadowBatchShaderBindingTableBufferDeviceAddress + progSize,
+      .stride = progSize,
+      .size = progSize};
+
+  const VkStridedDeviceAddressRegionKHR shadowBatchRchitShaderBindingTable = {};
 
   // =========================================================================
-  // Index Buffer
+  // Path Bin Pass
+  // (compute, wavefront backend: counting sort of the path queue by
+  //  direction octant and material ahead of every wave, see shader_bin.comp)
 
-  std::vector<VkDeviceAddress> indexBufferDeviceAddress(objectCount);
-  VkBuffer indexBufferHandle = VK_NULL_HANDLE;
-  VkDeviceMemory indexDeviceMemoryHandle = VK_NULL_HANDLE;
+  struct BinPushConstants {
+    uint32_t stage;
+    uint32_t isSortingEnabled;
+  };
 
-  VkDeviceSize currentIndexBufferOffset = 0;
-  for(int i = 0; i < objectCount; i++){
-    size_t currentIndexBufferSize = sizeof(uint32_t) * indexList[i].size();
-    buildBuffer(indexBufferHandle,
-      totalIndexBufferSize,
-      queueFamilyIndex,
-      (void *) indexList[i].data(),
-        VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT |
-        VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR |
-        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
-      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
-      &memoryAllocateFlagsInfo,
-      indexDeviceMemoryHandle,
-      indexBufferDeviceAddress[i],
-      currentIndexBufferOffset,
-      currentIndexBufferSize
-      );
+#ifdef WAVEFRONT_SORTING_ENABLED
+  const uint32_t isWavefrontSortingEnabled = 1;
+#else
+  const uint32_t isWavefrontSortingEnabled = 0;
+#endif
 
-      currentIndexBufferOffset += currentIndexBufferSize;
-  }
+  // binding order of shader_bin.comp
+  std::vector<VkDescriptorBufferInfo> binDescriptorInfoList = {
+      pathQueueStateDescriptorInfo, pathQueueDescriptorInfoList[0],
+      pathQueueDescriptorInfoList[1], pathQueueDescriptorInfoList[2]};
 
-  // =========================================================================
-  // Bottom Level Acceleration Structure
-  
-  std::vector<VkAccelerationStructureGeometryKHR> bottomLevelAccelerationStructureGeometry(objectCount);
+  VkDescriptorPoolSize binDescriptorPoolSize = {
+      .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+      .descriptorCount = (uint32_t)binDescriptorInfoList.size()};
 
-  for(int i = 0; i < objectCount; i++){
-    createBLASGeometry(bottomLevelAccelerationStructureGeometry[i],
-      vertexBufferDeviceAddress[i],
-      indexBufferDeviceAddress[i],
-      attrib[i]);
+  VkDescriptorPoolCreateInfo binDescriptorPoolCreateInfo = {
+      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+      .pNext = NULL,
+      .flags = 0,
+      .maxSets = 1,
+      .poolSizeCount = 1,
+      .pPoolSizes = &binDescriptorPoolSize};
+
+  VkDescriptorPool binDescriptorPoolHandle = VK_NULL_HANDLE;
+  result = vkCreateDescriptorPool(deviceHandle, &binDescriptorPoolCreateInfo,
+                                  NULL, &binDescriptorPoolHandle);
+
+  if (result != VK_SUCCESS) {
+    throwExceptionVulkanAPI(result, "vkCreateDescriptorPool");
   }
 
-  //Create offset info
-  std::vector<VkAccelerationStructureBuildRangeInfoKHR> bottomLevelAccelerationStructureBuildRangeInfo(objectCount);
+  std::vector<VkDescriptorSetLayoutBinding> binDescriptorSetLayoutBindingList(
+      binDescriptorInfoList.size());
+  for (uint32_t i = 0; i < binDescriptorSetLayoutBindingList.size(); i++) {
+    binDescriptorSetLayoutBindingList[i] = {
+        .binding = i,
+        .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        .descriptorCount = 1,
+        .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+        .pImmutableSamplers = NULL};
+  }
 
-  for(int i = 0; i < objectCount; i++){
-    bottomLevelAccelerationStructureBuildRangeInfo[i] =  {.primitiveCount =
-                                                         primitiveCount[i], 
-                                                        .primitiveOffset = 0,
-                                                        .firstVertex = 0,
-                                                        .transformOffset = 0};
+  VkDescriptorSetLayoutCreateInfo binDescriptorSetLayoutCreateInfo = {
+      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+      .pNext = NULL,
+      .flags = 0,
+      .bindingCount = (uint32_t)binDescriptorSetLayoutBindingList.size(),
+      .pBindings = binDescriptorSetLayoutBindingList.data()};
+
+  VkDescriptorSetLayout binDescriptorSetLayoutHandle = VK_NULL_HANDLE;
+  result = vkCreateDescriptorSetLayout(deviceHandle,
+                                       &binDescriptorSetLayoutCreateInfo,
+                                       NULL, &binDescriptorSetLayoutHandle);
+
+  if (result != VK_SUCCESS) {
+    throwExceptionVulkanAPI(result, "vkCreateDescriptorSetLayout");
   }
 
-  std::vector<VkAccelerationStructureKHR> bottomLevelAccelerationStructureHandle(objectCount);
-  std::vector<VkBuffer> bottomLevelAccelerationStructureBufferHandle(objectCount);
-  std::vector<VkDeviceMemory> bottomLevelAccelerationStructureDeviceMemoryHandle(objectCount);
-  std::vector<VkAccelerationStructureBuildSizesInfoKHR> bottomLevelAccelerationStructureBuildSizesInfo(objectCount);
-  std::vector<VkAccelerationStructureBuildGeometryInfoKHR>  bottomLevelAccelerationStructureBuildGeometryInfo(objectCount);
+  VkDescriptorSetAllocateInfo binDescriptorSetAllocateInfo = {
+      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+      .pNext = NULL,
+      .descriptorPool = binDescriptorPoolHandle,
+      .descriptorSetCount = 1,
+      .pSetLayouts = &binDescriptorSetLayoutHandle};
 
+  VkDescriptorSet binDescriptorSetHandle = VK_NULL_HANDLE;
+  result = vkAllocateDescriptorSets(deviceHandle, &binDescriptorSetAllocateInfo,
+                                    &binDescriptorSetHandle);
 
-  for(int i = 0; i < objectCount; i++){
-    createBLAS(bottomLevelAccelerationStructureHandle[i],
-      bottomLevelAccelerationStructureGeometry[i],
-      primitiveCount[i],
-      queueFamilyIndex,
-      bottomLevelAccelerationStructureBufferHandle[i],
-      bottomLevelAccelerationStructureDeviceMemoryHandle[i],
-      bottomLevelAccelerationStructureBuildSizesInfo[i],
-      bottomLevelAccelerationStructureBuildGeometryInfo[i]);
+  if (result != VK_SUCCESS) {
+    throwExceptionVulkanAPI(result, "vkAllocateDescriptorSets");
   }
- 
-  // =========================================================================
-  // Build Bottom Level Acceleration Structure
-  std::vector<VkBuffer> bottomLevelAccelerationStructureScratchBufferHandle(objectCount);
-  std::vector<VkDeviceAddress> bottomLevelAccelerationStructureDeviceAddress(objectCount);
-  std::vector<VkDeviceMemory> bottomLevelAccelerationStructureDeviceScratchMemoryHandle(objectCount);
 
-  for(int i = 0; i < objectCount; i++){
-    createBLASScratchBuffer(bottomLevelAccelerationStructureScratchBufferHandle[i],
-      bottomLevelAccelerationStructureHandle[i],
-      bottomLevelAccelerationStructureDeviceAddress[i],
-      bottomLevelAccelerationStructureBuildSizesInfo[i],
-      queueFamilyIndex,
-      memoryAllocateFlagsInfo,
-      bottomLevelAccelerationStructureDeviceScratchMemoryHandle[i],
-      bottomLevelAccelerationStructureBuildGeometryInfo[i]);
+  std::vector<VkWriteDescriptorSet> binWriteDescriptorSetList;
+  for (uint32_t i = 0; i < binDescriptorInfoList.size(); i++) {
+    binWriteDescriptorSetList.push_back(
+        {.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+         .pNext = NULL,
+         .dstSet = binDescriptorSetHandle,
+         .dstBinding = i,
+         .dstArrayElement = 0,
+         .descriptorCount = 1,
+         .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+         .pImageInfo = NULL,
+         .pBufferInfo = &binDescriptorInfoList[i],
+         .pTexelBufferView = NULL});
   }
-  
-  if (result != VK_SUCCESS) {
-    throwExceptionVulkanAPI(result, "vkCreateFence");
+
+  vkUpdateDescriptorSets(deviceHandle,
+                         (uint32_t)binWriteDescriptorSetList.size(),
+                         binWriteDescriptorSetList.data(), 0, NULL);
+
+  VkPipeline binPipelineHandle = VK_NULL_HANDLE;
+  VkPipelineLayout binPipelineLayoutHandle = VK_NULL_HANDLE;
+  VkShaderModule binShaderModuleHandle = VK_NULL_HANDLE;
+
+  if (isWavefrontEnabled) {
+    createComputePipeline(binPipelineHandle,
+      binPipelineLayoutHandle,
+      binShaderModuleHandle,
+      "shaders/shader_bin.comp.spv",
+      binDescriptorSetLayoutHandle,
+      sizeof(BinPushConstants));
   }
 
-  for(int i = 0; i < objectCount; i++){
-    buildBLAS(commandBufferHandleList.back(),
-      bottomLevelAccelerationStructureBuildRangeInfo[i],
-      bottomLevelAccelerationStructureBuildGeometryInfo[i],
-      deviceHandle,
-      queueHandle);
+  // =========================================================================
+  // Wavefront Kernels
+  // (compute, the generate and shade kernels use the ray tracing descriptor
+  //  set and TracePushConstants; extension and shadow are ray generation
+  //  shaders of the ray tracing pipeline)
+
+  VkPipeline generatePipelineHandle = VK_NULL_HANDLE;
+  VkPipelineLayout generatePipelineLayoutHandle = VK_NULL_HANDLE;
+  VkShaderModule generateShaderModuleHandle = VK_NULL_HANDLE;
+
+  VkPipeline shadePipelineHandle = VK_NULL_HANDLE;
+  VkPipelineLayout shadePipelineLayoutHandle = VK_NULL_HANDLE;
+  VkShaderModule shadeShaderModuleHandle = VK_NULL_HANDLE;
+
+  if (isWavefrontEnabled) {
+    createComputePipeline(generatePipelineHandle,
+      generatePipelineLayoutHandle,
+      generateShaderModuleHandle,
+      "shaders/shader_generate.comp.spv",
+      descriptorSetLayoutHandle,
+      sizeof(TracePushConstants));
+
+    createComputePipeline(shadePipelineHandle,
+      shadePipelineLayoutHandle,
+      shadeShaderModuleHandle,
+      "shaders/shader_shade.comp.spv",
+      descriptorSetLayoutHandle,
+      sizeof(TracePushConstants));
   }
 
   // =========================================================================
-  // Top Level Acceleration Structure
+  // Ray Query Kernel
+  // (compute, the megakernel path loop traced inline with VK_KHR_ray_query;
+  //  uses the ray tracing descriptor set and TracePushConstants)
+
+  VkPipeline rayQueryPipelineHandle = VK_NULL_HANDLE;
+  VkPipelineLayout rayQueryPipelineLayoutHandle = VK_NULL_HANDLE;
+  VkShaderModule rayQueryShaderModuleHandle = VK_NULL_HANDLE;
+
+  if (isRayQueryPipelineNeeded) {
+    createComputePipeline(rayQueryPipelineHandle,
+      rayQueryPipelineLayoutHandle,
+      rayQueryShaderModuleHandle,
+      "shaders/shader_ray_query.comp.spv",
+      descriptorSetLayoutHandle,
+      sizeof(TracePushConstants),
+      &rayClosestHitSpecializationInfo);
+  }
 
-   //TODO add matrix vector for each instance
-  std::vector<glm::mat4> glmMatrices = {
-    glm::mat4(1),
-    glm::translate(glm::mat4(1), glm::vec3(0, 0, 5))
+  // =========================================================================
+  // Temporal Accumulation Pass
+  // (compute, blends the ray trace image with the reprojected history; the
+  //  denoiser filters the accumulated radiance)
+
+  struct TemporalPushConstants {
+    float maxHistoryLength;
+    float clampGamma;
+    float depthThreshold;
+    float normalThreshold;
+    int32_t renderWidth;
+    int32_t renderHeight;
   };
-  assert(glmMatrices.size() == objectCount);
-  
-  VkTransformMatrixKHR transformMatrix;
 
-  std::vector<VkAccelerationStructureInstanceKHR> bottomLevelAccelerationStructureInstance(objectCount);
-  VkAccelerationStructureKHR topLevelAccelerationStructureHandle;
-  VkBuffer topLevelAccelerationStructureBufferHandle;
-  VkDeviceMemory topLevelAccelerationStructureDeviceMemoryHandle;
+  TemporalPushConstants temporalPushConstants = {
+      .maxHistoryLength = TEMPORAL_MAX_HISTORY_LENGTH,
+      .clampGamma = TEMPORAL_CLAMP_GAMMA,
+      .depthThreshold = TEMPORAL_DEPTH_THRESHOLD,
+      .normalThreshold = TEMPORAL_NORMAL_THRESHOLD,
+      .renderWidth = (int32_t)maxRenderExtent.width,
+      .renderHeight = (int32_t)maxRenderExtent.height};
+
+  // binding order of shader_temporal.comp
+  std::vector<VkImageView> temporalImageViewBindingList = {
+      rayTraceImageViewHandle,        gBufferImageViewHandleList[0],
+      gBufferImageViewHandleList[2],  gBufferImageViewHandleList[3],
+      temporalImageViewHandleList[1], temporalImageViewHandleList[2],
+      temporalImageViewHandleList[3], temporalImageViewHandleList[0]};
+
+  VkDescriptorPoolSize temporalDescriptorPoolSize = {
+      .type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+      .descriptorCount = (uint32_t)temporalImageViewBindingList.size()};
+
+  VkDescriptorPoolCreateInfo temporalDescriptorPoolCreateInfo = {
+      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+      .pNext = NULL,
+      .flags = 0,
+      .maxSets = 1,
+      .poolSizeCount = 1,
+      .pPoolSizes = &temporalDescriptorPoolSize};
 
-  for(int i = 0; i < objectCount; i++){
-    glmToVulkan(glmMatrices[i], transformMatrix);
+  VkDescriptorPool temporalDescriptorPoolHandle = VK_NULL_HANDLE;
+  result = vkCreateDescriptorPool(deviceHandle, &temporalDescriptorPoolCreateInfo,
+                                  NULL, &temporalDescriptorPoolHandle);
 
-    createInstance(bottomLevelAccelerationStructureInstance[i],
-      bottomLevelAccelerationStructureDeviceAddress[i],
-      transformMatrix,
-      i);
+  if (result != VK_SUCCESS) {
+    throwExceptionVulkanAPI(result, "vkCreateDescriptorPool");
   }
 
-  createTLAS(topLevelAccelerationStructureHandle,
-    bottomLevelAccelerationStructureInstance,
-    queueFamilyIndex,
-    memoryAllocateFlagsInfo,
-    topLevelAccelerationStructureBufferHandle,
-    topLevelAccelerationStructureDeviceMemoryHandle,
-    commandBufferHandleList.back(),
-    queueHandle,
-    false);
-    
-  // =========================================================================
-  // Build Top Level Acceleration Structure
+  std::vector<VkDescriptorSetLayoutBinding> temporalDescriptorSetLayoutBindingList(
+      temporalImageViewBindingList.size());
+  for (uint32_t i = 0; i < temporalDescriptorSetLayoutBindingList.size(); i++) {
+    temporalDescriptorSetLayoutBindingList[i] = {
+        .binding = i,
+        .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+        .descriptorCount = 1,
+        .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+        .pImmutableSamplers = NULL};
+  }
 
-  // Multiple TLAS (one TLAS multiple instances in NV)
+  VkDescriptorSetLayoutCreateInfo temporalDescriptorSetLayoutCreateInfo = {
+      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+      .pNext = NULL,
+      .flags = 0,
+      .bindingCount = (uint32_t)temporalDescriptorSetLayoutBindingList.size(),
+      .pBindings = temporalDescriptorSetLayoutBindingList.data()};
 
-  //create and build in the same function
-  
-  // =========================================================================
-  // Uniform Buffer
+  VkDescriptorSetLayout temporalDescriptorSetLayoutHandle = VK_NULL_HANDLE;
+  result = vkCreateDescriptorSetLayout(deviceHandle,
+                                       &temporalDescriptorSetLayoutCreateInfo,
+                                       NULL, &temporalDescriptorSetLayoutHandle);
 
-  struct UniformStructure {
-    float cameraPosition[4] = {0, 0, 20, 1};
-    float cameraRight[4] = {1, 0, 0, 1};
-    float cameraUp[4] = {0, 1, 0, 1};
-    float cameraForward[4] = {0, 0, -1, 1};
+  if (result != VK_SUCCESS) {
+    throwExceptionVulkanAPI(result, "vkCreateDescriptorSetLayout");
+  }
 
-    float lightPosition[3] = {5, 5, 5};
-    float lightIntensity = 1.0f;
+  VkDescriptorSetAllocateInfo temporalDescriptorSetAllocateInfo = {
+      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+      .pNext = NULL,
+      .descriptorPool = temporalDescriptorPoolHandle,
+      .descriptorSetCount = 1,
+      .pSetLayouts = &temporalDescriptorSetLayoutHandle};
 
-    uint32_t maxBounceCount = MAX_BOUNCE_COUNT;
-    uint32_t samplesPerPixel = SAMPLES_PER_PIXEL;
+  VkDescriptorSet temporalDescriptorSetHandle = VK_NULL_HANDLE;
+  result = vkAllocateDescriptorSets(deviceHandle,
+                                    &temporalDescriptorSetAllocateInfo,
+                                    &temporalDescriptorSetHandle);
 
-    /*
-      Object types:
-      0 - diffuse
-      1 - mirror
-      2 - refractive
-     */
-    uint32_t centerObjectType = CENTER_MESH_TYPE;
-    uint32_t orbitingObjectType = ORBITING_MESH_TYPE;
-
-    uint32_t orbitingObjectPrimitiveOffset;
-    uint32_t orbitingObjectVertexOffset;
-  } uniformStructure;
+  if (result != VK_SUCCESS) {
+    throwExceptionVulkanAPI(result, "vkAllocateDescriptorSets");
+  }
 
-  uniformStructure.orbitingObjectPrimitiveOffset = indexList[0].size() / 3;
-  uniformStructure.orbitingObjectVertexOffset = attrib[0].vertices.size() * 2;
+  writeStorageImageDescriptorSet(temporalDescriptorSetHandle,
+    temporalImageViewBindingList);
+
+  VkPipeline temporalPipelineHandle = VK_NULL_HANDLE;
+  VkPipelineLayout temporalPipelineLayoutHandle = VK_NULL_HANDLE;
+  VkShaderModule temporalShaderModuleHandle = VK_NULL_HANDLE;
+
+  createComputePipeline(temporalPipelineHandle,
+    temporalPipelineLayoutHandle,
+    temporalShaderModuleHandle,
+    "shaders/shader_temporal.comp.spv",
+    temporalDescriptorSetLayoutHandle,
+    sizeof(TemporalPushConstants));
+
+  VkImageCopy historyImageCopy = {
+      .srcSubresource = {.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                         .mipLevel = 0,
+                         .baseArrayLayer = 0,
+                         .layerCount = 1},
+      .srcOffset = {0, 0, 0},
+      .dstSubresource = {.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                         .mipLevel = 0,
+                         .baseArrayLayer = 0,
+                         .layerCount = 1},
+      .dstOffset = {0, 0, 0},
+      .extent = {.width = maxRenderExtent.width,
+                 .height = maxRenderExtent.height,
+                 .depth = 1}};
 
-  VkBuffer uniformBufferHandle = VK_NULL_HANDLE;
-  createBuffer(uniformBufferHandle,
-    sizeof(UniformStructure),
-    VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-    queueFamilyIndex);
+  // =========================================================================
+  // Denoise Pass
+  // (compute, a-trous iterations ping-pong between the two denoise images;
+  //  descriptor set 0 reads the accumulated radiance, 1 and 2 alternate)
+
+  struct DenoisePushConstants {
+    int32_t stepSize;
+    uint32_t isFirstIteration;
+    uint32_t isLastIteration;
+    float normalPhi;
+    float depthPhi;
+    float luminancePhi;
+    int32_t renderWidth;
+    int32_t renderHeight;
+  };
 
-  VkDeviceMemory uniformDeviceMemoryHandle = VK_NULL_HANDLE;
-  allocAndBind(uniformDeviceMemoryHandle,
-    &memoryAllocateFlagsInfo,
-    uniformBufferHandle,
-    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
-  
-  copyData(uniformDeviceMemoryHandle,
-    (void *) &uniformStructure,
-    sizeof(UniformStructure));
+  const uint32_t denoiseIterationCount = DENOISER_ITERATION_COUNT;
+  const uint32_t denoiseDescriptorSetCount = 3;
 
-  // =========================================================================
-  // Ray Trace Image
+  // input, output and the G-buffer images
+  const uint32_t denoiseBindingCount = 2 + gBufferImageCount;
 
-  VkImageCreateInfo rayTraceImageCreateInfo = {
-      .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+  VkDescriptorPoolSize denoiseDescriptorPoolSize = {
+      .type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+      .descriptorCount = denoiseBindingCount * denoiseDescriptorSetCount};
+
+  VkDescriptorPoolCreateInfo denoiseDescriptorPoolCreateInfo = {
+      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
       .pNext = NULL,
       .flags = 0,
-      .imageType = VK_IMAGE_TYPE_2D,
-      .format = surfaceFormatList[0].format,
-      .extent = {.width = surfaceCapabilities.currentExtent.width,
-                 .height = surfaceCapabilities.currentExtent.height,
-                 .depth = 1},
-      .mipLevels = 1,
-      .arrayLayers = 1,
-      .samples = VK_SAMPLE_COUNT_1_BIT,
-      .tiling = VK_IMAGE_TILING_OPTIMAL,
-      .usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
-      .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
-      .queueFamilyIndexCount = 1,
-      .pQueueFamilyIndices = &queueFamilyIndex,
-      .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED};
+      .maxSets = denoiseDescriptorSetCount,
+      .poolSizeCount = 1,
+      .pPoolSizes = &denoiseDescriptorPoolSize};
 
-  VkImage rayTraceImageHandle = VK_NULL_HANDLE;
-  result = vkCreateImage(deviceHandle, &rayTraceImageCreateInfo, NULL,
-                         &rayTraceImageHandle);
+  VkDescriptorPool denoiseDescriptorPoolHandle = VK_NULL_HANDLE;
+  result = vkCreateDescriptorPool(deviceHandle, &denoiseDescriptorPoolCreateInfo,
+                                  NULL, &denoiseDescriptorPoolHandle);
 
   if (result != VK_SUCCESS) {
-    throwExceptionVulkanAPI(result, "vkCreateImage");
+    throwExceptionVulkanAPI(result, "vkCreateDescriptorPool");
   }
 
-  VkMemoryRequirements rayTraceImageMemoryRequirements;
-  vkGetImageMemoryRequirements(deviceHandle, rayTraceImageHandle,
-                               &rayTraceImageMemoryRequirements);
+  std::vector<VkDescriptorSetLayoutBinding> denoiseDescriptorSetLayoutBindingList(
+      denoiseBindingCount);
+  for (uint32_t i = 0; i < denoiseDescriptorSetLayoutBindingList.size(); i++) {
+    denoiseDescriptorSetLayoutBindingList[i] = {
+        .binding = i,
+        .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+        .descriptorCount = 1,
+        .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+        .pImmutableSamplers = NULL};
+  }
 
-  uint32_t rayTraceImageMemoryTypeIndex = getMemoryIndex(rayTraceImageMemoryRequirements,
-    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-  
-  VkMemoryAllocateInfo rayTraceImageMemoryAllocateInfo = {
-      .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+  VkDescriptorSetLayoutCreateInfo denoiseDescriptorSetLayoutCreateInfo = {
+      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
       .pNext = NULL,
-      .allocationSize = rayTraceImageMemoryRequirements.size,
-      .memoryTypeIndex = rayTraceImageMemoryTypeIndex};
+      .flags = 0,
+      .bindingCount = (uint32_t)denoiseDescriptorSetLayoutBindingList.size(),
+      .pBindings = denoiseDescriptorSetLayoutBindingList.data()};
 
-  VkDeviceMemory rayTraceImageDeviceMemoryHandle = VK_NULL_HANDLE;
-  result = vkAllocateMemory(deviceHandle, &rayTraceImageMemoryAllocateInfo,
-                            NULL, &rayTraceImageDeviceMemoryHandle);
-  if (result != VK_SUCCESS) {
-    throwExceptionVulkanAPI(result, "vkAllocateMemory");
-  }
+  VkDescriptorSetLayout denoiseDescriptorSetLayoutHandle = VK_NULL_HANDLE;
+  result = vkCreateDescriptorSetLayout(deviceHandle,
+                                       &denoiseDescriptorSetLayoutCreateInfo,
+                                       NULL, &denoiseDescriptorSetLayoutHandle);
 
-  result = vkBindImageMemory(deviceHandle, rayTraceImageHandle,
-                             rayTraceImageDeviceMemoryHandle, 0);
   if (result != VK_SUCCESS) {
-    throwExceptionVulkanAPI(result, "vkBindImageMemory");
+    throwExceptionVulkanAPI(result, "vkCreateDescriptorSetLayout");
   }
 
-  VkImageViewCreateInfo rayTraceImageViewCreateInfo = {
-      .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+  std::vector<VkDescriptorSetLayout> denoiseDescriptorSetLayoutHandleList(
+      denoiseDescriptorSetCount, denoiseDescriptorSetLayoutHandle);
+
+  VkDescriptorSetAllocateInfo denoiseDescriptorSetAllocateInfo = {
+      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
       .pNext = NULL,
-      .flags = 0,
-      .image = rayTraceImageHandle,
-      .viewType = VK_IMAGE_VIEW_TYPE_2D,
-      .format = surfaceFormatList[0].format,
-      .components = {.r = VK_COMPONENT_SWIZZLE_IDENTITY,
-                     .g = VK_COMPONENT_SWIZZLE_IDENTITY,
-                     .b = VK_COMPONENT_SWIZZLE_IDENTITY,
-                     .a = VK_COMPONENT_SWIZZLE_IDENTITY},
-      .subresourceRange = {.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-                           .baseMipLevel = 0,
-                           .levelCount = 1,
-                           .baseArrayLayer = 0,
-                           .layerCount = 1}};
+      .descriptorPool = denoiseDescriptorPoolHandle,
+      .descriptorSetCount = denoiseDescriptorSetCount,
+      .pSetLayouts = denoiseDescriptorSetLayoutHandleList.data()};
 
-  VkImageView rayTraceImageViewHandle = VK_NULL_HANDLE;
-  result = vkCreateImageView(deviceHandle, &rayTraceImageViewCreateInfo, NULL,
-                             &rayTraceImageViewHandle);
+  std::vector<VkDescriptorSet> denoiseDescriptorSetHandleList(
+      denoiseDescriptorSetCount, VK_NULL_HANDLE);
+  result = vkAllocateDescriptorSets(deviceHandle,
+                                    &denoiseDescriptorSetAllocateInfo,
+                                    denoiseDescriptorSetHandleList.data());
+
+  if (result != VK_SUCCESS) {
+    throwExceptionVulkanAPI(result, "vkAllocateDescriptorSets");
+  }
 
-  if (result != VK_SUCCESS) {
-    throwExceptionVulkanAPI(result, "vkCreateImageView");
+  std::vector<VkImageView> denoiseInputImageViewHandleList = {
+      temporalImageViewHandleList[0], denoiseImageViewHandleList[0],
+      denoiseImageViewHandleList[1]};
+  std::vector<VkImageView> denoiseOutputImageViewHandleList = {
+      denoiseImageViewHandleList[0], denoiseImageViewHandleList[1],
+      denoiseImageViewHandleList[0]};
+
+  for (uint32_t x = 0; x < denoiseDescriptorSetCount; x++) {
+    std::vector<VkImageView> imageViewHandleList = {
+        denoiseInputImageViewHandleList[x], denoiseOutputImageViewHandleList[x]};
+    imageViewHandleList.insert(imageViewHandleList.end(),
+                               gBufferImageViewHandleList.begin(),
+                               gBufferImageViewHandleList.end());
+
+    writeStorageImageDescriptorSet(denoiseDescriptorSetHandleList[x],
+      imageViewHandleList);
   }
 
+  VkPipeline denoisePipelineHandle = VK_NULL_HANDLE;
+  VkPipelineLayout denoisePipelineLayoutHandle = VK_NULL_HANDLE;
+  VkShaderModule denoiseShaderModuleHandle = VK_NULL_HANDLE;
+
+  createComputePipeline(denoisePipelineHandle,
+    denoisePipelineLayoutHandle,
+    denoiseShaderModuleHandle,
+    "shaders/shader_denoise.comp.spv",
+    denoiseDescriptorSetLayoutHandle,
+    sizeof(DenoisePushConstants));
+
+  // the tonemap pass reads the output of the last iteration
+  VkImageView radianceImageViewHandle =
+      denoiseIterationCount > 0
+          ? denoiseImageViewHandleList[(denoiseIterationCount - 1) % 2]
+          : temporalImageViewHandleList[0];
+
   // =========================================================================
-  // Ray Trace Image Barrier
-  // (VK_IMAGE_LAYOUT_UNDEFINED -> VK_IMAGE_LAYOUT_GENERAL)
+  // Tonemap Pass
+  // (compute, radiance image -> swapchain image, one descriptor set per
+  //  swapchain image)
+
+  struct TonemapPushConstants {
+    float exposure;
+    uint32_t tonemapOperator;
+    int32_t renderWidth;
+    int32_t renderHeight;
+  };
 
-  VkCommandBufferBeginInfo rayTraceImageBarrierCommandBufferBeginInfo = {
-      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+  TonemapPushConstants tonemapPushConstants = {
+      .exposure = TONEMAP_EXPOSURE,
+      .tonemapOperator = TONEMAP_OPERATOR,
+      .renderWidth = (int32_t)maxRenderExtent.width,
+      .renderHeight = (int32_t)maxRenderExtent.height};
+
+  VkDescriptorPoolSize tonemapDescriptorPoolSize = {
+      .type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+      .descriptorCount = 2 * swapchainImageCount};
+
+  VkDescriptorPoolCreateInfo tonemapDescriptorPoolCreateInfo = {
+      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
       .pNext = NULL,
-      .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
-      .pInheritanceInfo = NULL};
+      .flags = 0,
+      .maxSets = swapchainImageCount,
+      .poolSizeCount = 1,
+      .pPoolSizes = &tonemapDescriptorPoolSize};
 
-  result = vkBeginCommandBuffer(commandBufferHandleList.back(),
-                                &rayTraceImageBarrierCommandBufferBeginInfo);
+  VkDescriptorPool tonemapDescriptorPoolHandle = VK_NULL_HANDLE;
+  result = vkCreateDescriptorPool(deviceHandle, &tonemapDescriptorPoolCreateInfo,
+                                  NULL, &tonemapDescriptorPoolHandle);
 
   if (result != VK_SUCCESS) {
-    throwExceptionVulkanAPI(result, "vkBeginCommandBuffer");
+    throwExceptionVulkanAPI(result, "vkCreateDescriptorPool");
   }
 
-  VkImageMemoryBarrier rayTraceGeneralMemoryBarrier = {
-      .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
-      .pNext = NULL,
-      .srcAccessMask = 0,
-      .dstAccessMask = 0,
-      .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-      .newLayout = VK_IMAGE_LAYOUT_GENERAL,
-      .srcQueueFamilyIndex = queueFamilyIndex,
-      .dstQueueFamilyIndex = queueFamilyIndex,
-      .image = rayTraceImageHandle,
-      .subresourceRange = {.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-                           .baseMipLevel = 0,
-                           .levelCount = 1,
-                           .baseArrayLayer = 0,
-                           .layerCount = 1}};
+  std::vector<VkDescriptorSetLayoutBinding> tonemapDescriptorSetLayoutBindingList = {
+      {.binding = 0,
+       .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+       .descriptorCount = 1,
+       .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+       .pImmutableSamplers = NULL},
+      {.binding = 1,
+       .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+       .descriptorCount = 1,
+       .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+       .pImmutableSamplers = NULL}};
 
-  vkCmdPipelineBarrier(commandBufferHandleList.back(),
-                       VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
-                       VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, NULL, 0, NULL,
-                       1, &rayTraceGeneralMemoryBarrier);
+  VkDescriptorSetLayoutCreateInfo tonemapDescriptorSetLayoutCreateInfo = {
+      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+      .pNext = NULL,
+      .flags = 0,
+      .bindingCount = (uint32_t)tonemapDescriptorSetLayoutBindingList.size(),
+      .pBindings = tonemapDescriptorSetLayoutBindingList.data()};
 
-  result = vkEndCommandBuffer(commandBufferHandleList.back());
+  VkDescriptorSetLayout tonemapDescriptorSetLayoutHandle = VK_NULL_HANDLE;
+  result = vkCreateDescriptorSetLayout(deviceHandle,
+                                       &tonemapDescriptorSetLayoutCreateInfo,
+                                       NULL, &tonemapDescriptorSetLayoutHandle);
 
   if (result != VK_SUCCESS) {
-    throwExceptionVulkanAPI(result, "vkEndCommandBuffer");
+    throwExceptionVulkanAPI(result, "vkCreateDescriptorSetLayout");
   }
 
-  VkSubmitInfo rayTraceImageBarrierAccelerationStructureBuildSubmitInfo = {
-      .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-      .pNext = NULL,
-      .waitSemaphoreCount = 0,
-      .pWaitSemaphores = NULL,
-      .pWaitDstStageMask = NULL,
-      .commandBufferCount = 1,
-      .pCommandBuffers = &commandBufferHandleList.back(),
-      .signalSemaphoreCount = 0,
-      .pSignalSemaphores = NULL};
+  std::vector<VkDescriptorSetLayout> tonemapDescriptorSetLayoutHandleList(
+      swapchainImageCount, tonemapDescriptorSetLayoutHandle);
 
-  VkFenceCreateInfo
-      rayTraceImageBarrierAccelerationStructureBuildFenceCreateInfo = {
-          .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
-          .pNext = NULL,
-          .flags = 0};
+  VkDescriptorSetAllocateInfo tonemapDescriptorSetAllocateInfo = {
+      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+      .pNext = NULL,
+      .descriptorPool = tonemapDescriptorPoolHandle,
+      .descriptorSetCount = swapchainImageCount,
+      .pSetLayouts = tonemapDescriptorSetLayoutHandleList.data()};
 
-  VkFence rayTraceImageBarrierAccelerationStructureBuildFenceHandle =
-      VK_NULL_HANDLE;
-  result = vkCreateFence(
-      deviceHandle,
-      &rayTraceImageBarrierAccelerationStructureBuildFenceCreateInfo, NULL,
-      &rayTraceImageBarrierAccelerationStructureBuildFenceHandle);
+  std::vector<VkDescriptorSet> tonemapDescriptorSetHandleList(swapchainImageCount,
+                                                              VK_NULL_HANDLE);
+  result = vkAllocateDescriptorSets(deviceHandle,
+                                    &tonemapDescriptorSetAllocateInfo,
+                                    tonemapDescriptorSetHandleList.data());
 
   if (result != VK_SUCCESS) {
-    throwExceptionVulkanAPI(result, "vkCreateFence");
+    throwExceptionVulkanAPI(result, "vkAllocateDescriptorSets");
   }
 
-  result = vkQueueSubmit(
-      queueHandle, 1, &rayTraceImageBarrierAccelerationStructureBuildSubmitInfo,
-      rayTraceImageBarrierAccelerationStructureBuildFenceHandle);
+  for (uint32_t x = 0; x < swapchainImageCount; x++) {
+    std::vector<VkImageView> imageViewHandleList = {
+        radianceImageViewHandle, swapchainImageViewHandleList[x]};
 
-  if (result != VK_SUCCESS) {
-    throwExceptionVulkanAPI(result, "vkQueueSubmit");
+    writeStorageImageDescriptorSet(tonemapDescriptorSetHandleList[x],
+      imageViewHandleList);
   }
 
-  result = vkWaitForFences(
-      deviceHandle, 1,
-      &rayTraceImageBarrierAccelerationStructureBuildFenceHandle, true,
-      UINT32_MAX);
+  VkPipeline tonemapPipelineHandle = VK_NULL_HANDLE;
+  VkPipelineLayout tonemapPipelineLayoutHandle = VK_NULL_HANDLE;
+  VkShaderModule tonemapShaderModuleHandle = VK_NULL_HANDLE;
 
-  if (result != VK_SUCCESS && result != VK_TIMEOUT) {
-    throwExceptionVulkanAPI(result, "vkWaitForFences");
-  }
+  createComputePipeline(tonemapPipelineHandle,
+    tonemapPipelineLayoutHandle,
+    tonemapShaderModuleHandle,
+    "shaders/shader_tonemap.comp.spv",
+    tonemapDescriptorSetLayoutHandle,
+    sizeof(TonemapPushConstants));
 
   // =========================================================================
-  // Create Skybox Texture
-
-  const char *image_files[] = {
-    SKYBOX_TEXTURE_DIR "/right.jpg",
-    SKYBOX_TEXTURE_DIR "/left.jpg",
-    SKYBOX_TEXTURE_DIR "/top.jpg",
-    SKYBOX_TEXTURE_DIR "/bottom.jpg",
-    SKYBOX_TEXTURE_DIR "/front.jpg",
-    SKYBOX_TEXTURE_DIR "/back.jpg",
-  };
+  // Frame Command Pools
+  // (one per frame in flight, reset when the frame slot is reused; its
+  //  command buffer updates the acceleration structure and executes the
+  //  render command buffer, one submission per frame)
 
-  std::vector<unsigned char *> image_data(6);
-  int width, height, nrChannels;
-  for (int i = 0; i < 6; ++i)
-  {
-    unsigned char *data = stbi_load(image_files[i], &width, &height, &nrChannels, STBI_rgb_alpha);
-    image_data[i] = data;
-  } 
-  size_t image_size = width * height * 4;
+  std::vector<VkCommandPool> frameCommandPoolHandleList(framesInFlightCount,
+                                                        VK_NULL_HANDLE);
+  std::vector<VkCommandBuffer> frameCommandBufferHandleList(framesInFlightCount,
+                                                            VK_NULL_HANDLE);
 
-  // Create Staging Buffer
+  for (uint32_t i = 0; i < framesInFlightCount; i++) {
+    VkCommandPoolCreateInfo frameCommandPoolCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .pNext = NULL,
+        .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+        .queueFamilyIndex = queueFamilyIndex};
 
-  VkBuffer stagingBufferHandle = VK_NULL_HANDLE;
-  VkDeviceSize stagingBufferSize = image_size * 6;
-  createBuffer(stagingBufferHandle, stagingBufferSize, 
-      VK_BUFFER_USAGE_TRANSFER_SRC_BIT, queueFamilyIndex);
+    result = vkCreateCommandPool(deviceHandle, &frameCommandPoolCreateInfo,
+                                 NULL, &frameCommandPoolHandleList[i]);
 
-  VkDeviceMemory stagingDeviceMemoryHandle = VK_NULL_HANDLE;
+    if (result != VK_SUCCESS) {
+      throwExceptionVulkanAPI(result, "vkCreateCommandPool");
+    }
 
-  allocAndBind(stagingDeviceMemoryHandle, NULL, stagingBufferHandle, 
-      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    VkCommandBufferAllocateInfo frameCommandBufferAllocateInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .pNext = NULL,
+        .commandPool = frameCommandPoolHandleList[i],
+        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .commandBufferCount = 1};
 
-  void *hostStagingMemoryBuffer;
-  result = vkMapMemory(deviceHandle, stagingDeviceMemoryHandle, 0,
-                       stagingBufferSize, 0,
-                       &hostStagingMemoryBuffer);
+    result = vkAllocateCommandBuffers(deviceHandle,
+                                      &frameCommandBufferAllocateInfo,
+                                      &frameCommandBufferHandleList[i]);
 
-  if (result != VK_SUCCESS) {
-    throwExceptionVulkanAPI(result, "vkMapMemory");
+    if (result != VK_SUCCESS) {
+      throwExceptionVulkanAPI(result, "vkAllocateCommandBuffers");
+    }
   }
 
-  for (int i = 0; i < 6; ++i)
-  {
-    memcpy(static_cast<char *>(hostStagingMemoryBuffer) + i * image_size, image_data[i], image_size);
-  } 
+  // =========================================================================
+  // Render Command Buffers
+  // (secondary, the static trace and post passes of every frame slot,
+  //  render scale level and swapchain image, indexed by
+  //  (slot * level count + level) * swapchainImageCount + image index, as
+  //  the frame slot selects the dynamic offsets into the frame upload ring;
+  //  recorded again only when the swapchain changes)
 
-  vkUnmapMemory(deviceHandle, stagingDeviceMemoryHandle);
+  uint32_t renderCommandBufferCount =
+      framesInFlightCount * renderScaleLevelCount * swapchainImageCount;
 
-  for (int i = 0; i < 6; ++i)
-  {
-    stbi_image_free(image_data[i]);
-  } 
+  VkCommandBufferAllocateInfo renderCommandBufferAllocateInfo = {
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+      .pNext = NULL,
+      .commandPool = commandPoolHandle,
+      .level = VK_COMMAND_BUFFER_LEVEL_SECONDARY,
+      .commandBufferCount = renderCommandBufferCount};
 
-  // Create Skybox Image
-  VkImageCreateInfo skyboxImageInfo{};
-  skyboxImageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-  skyboxImageInfo.imageType = VK_IMAGE_TYPE_2D;
-  skyboxImageInfo.extent.width = width;
-  skyboxImageInfo.extent.height = height;
-  skyboxImageInfo.extent.depth = 1;
-  skyboxImageInfo.mipLevels = 1;
-  skyboxImageInfo.arrayLayers = 6;
-  skyboxImageInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
-  skyboxImageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-  skyboxImageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-  skyboxImageInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
-  skyboxImageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
-  skyboxImageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-  skyboxImageInfo.flags = VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT;
+  std::vector<VkCommandBuffer> renderCommandBufferHandleList(
+      renderCommandBufferCount, VK_NULL_HANDLE);
 
-  VkImage skyboxImageHandle = VK_NULL_HANDLE;
-  result = vkCreateImage(deviceHandle, &skyboxImageInfo, nullptr, &skyboxImageHandle); 
-  if (result != VK_SUCCESS) 
-  {
-    throwExceptionVulkanAPI(result, "vkCreateImage");
+  result = vkAllocateCommandBuffers(deviceHandle,
+                                    &renderCommandBufferAllocateInfo,
+                                    renderCommandBufferHandleList.data());
+
+  if (result != VK_SUCCESS) {
+    throwExceptionVulkanAPI(result, "vkAllocateCommandBuffers");
   }
 
-  VkMemoryRequirements memoryRequirements;
-  vkGetImageMemoryRequirements(deviceHandle, skyboxImageHandle,
-                                &memoryRequirements);
+  // =========================================================================
+  // Trace Timestamp Queries
+  // (per render command buffer: frame start, after tracing and frame end,
+  //  followed by a start and end pair per trace launch for the trace time
+  //  breakdown)
+
+  bool isTimestampSupported =
+    queueFamilyPropertiesList[queueFamilyIndex].timestampValidBits > 0;
+#if defined(TEST_FPS) || defined(DYNAMIC_RESOLUTION_ENABLED) || \
+    defined(RENDER_BACKEND_BENCHMARK)
+  double timestampPeriod =
+    physicalDeviceProperties2.properties.limits.timestampPeriod;
+#endif
 
-  uint32_t memoryTypeIndex = getMemoryIndex(memoryRequirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-  
-  VkMemoryAllocateInfo memoryAllocateInfo = {
-      .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+  // wavefront: an extension and a shadow launch per wave and sample;
+  // megakernel: the paths and the shadow batch
+  uint32_t maxTraceLaunchCount =
+      isWavefrontEnabled ? 2 * WAVEFRONT_WAVE_COUNT * SAMPLES_PER_PIXEL : 2;
+  uint32_t traceTimestampStride = 3 + 2 * maxTraceLaunchCount;
+
+  // category of every trace launch, in recording order
+  std::vector<std::vector<uint32_t>> traceLaunchCategoryList(
+      renderCommandBufferCount);
+
+  VkQueryPoolCreateInfo traceTimestampQueryPoolCreateInfo = {
+      .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
       .pNext = NULL,
-      .allocationSize = memoryRequirements.size,
-      .memoryTypeIndex = memoryTypeIndex};
+      .flags = 0,
+      .queryType = VK_QUERY_TYPE_TIMESTAMP,
+      .queryCount = traceTimestampStride * renderCommandBufferCount,
+      .pipelineStatistics = 0};
 
+  VkQueryPool traceTimestampQueryPoolHandle = VK_NULL_HANDLE;
+  result = vkCreateQueryPool(deviceHandle, &traceTimestampQueryPoolCreateInfo,
+                             NULL, &traceTimestampQueryPoolHandle);
 
-  VkDeviceMemory skyboxImageDeviceMemoryHandle = VK_NULL_HANDLE;
-  result = vkAllocateMemory(deviceHandle, &memoryAllocateInfo, NULL,
-                            &skyboxImageDeviceMemoryHandle);
   if (result != VK_SUCCESS) {
-    throwExceptionVulkanAPI(result, "vkAllocateMemory");
+    throwExceptionVulkanAPI(result, "vkCreateQueryPool");
   }
 
-  result = vkBindImageMemory(deviceHandle, skyboxImageHandle,
-                              skyboxImageDeviceMemoryHandle, 0);
-  if (result != VK_SUCCESS) {
-    throwExceptionVulkanAPI(result, "vkBindImageMemory");
-  }
+  std::vector<bool> isTraceTimestampWrittenList(renderCommandBufferCount, false);
+#ifdef TEST_FPS
+  double traceTime = 0;
+  std::vector<double> traceTimeBreakdown(TRACE_CATEGORY_COUNT, 0);
+#endif
+#ifdef DYNAMIC_RESOLUTION_ENABLED
+  double frameTime = 0;
+#endif
 
-  // Copy image data from buffer
+  // =========================================================================
+  // Fences, Semaphores
 
-  VkCommandBuffer commandBufferHandle = commandBufferHandleList.back();
+  std::vector<VkFence> imageAvailableFenceHandleList(swapchainImageCount,
+                                                     VK_NULL_HANDLE);
 
-  VkCommandBufferBeginInfo commandBufferBeginInfo = {
-    .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-    .pNext = NULL,
-    .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
-    .pInheritanceInfo = NULL};
+  std::vector<VkSemaphore> acquireImageSemaphoreHandleList(swapchainImageCount,
+                                                           VK_NULL_HANDLE);
 
-  result = vkBeginCommandBuffer(commandBufferHandle,
-                              &commandBufferBeginInfo);
+  std::vector<VkSemaphore> writeImageSemaphoreHandleList(swapchainImageCount,
+                                                         VK_NULL_HANDLE);
 
-  if (result != VK_SUCCESS) {
-    throwExceptionVulkanAPI(result, "vkBeginCommandBuffer");
-  }
+  for (uint32_t x = 0; x < swapchainImageCount; x++) {
+    VkFenceCreateInfo imageAvailableFenceCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+        .pNext = NULL,
+        .flags = VK_FENCE_CREATE_SIGNALED_BIT};
 
-  VkImageMemoryBarrier barrier{};
-  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-  barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-  barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-  barrier.image = skyboxImageHandle;
-  barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-  barrier.subresourceRange.baseMipLevel = 0;
-  barrier.subresourceRange.levelCount = 1;
-  barrier.subresourceRange.baseArrayLayer = 0;
-  barrier.subresourceRange.layerCount = 6;
-  barrier.srcAccessMask = 0;
-  barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-
-  VkPipelineStageFlags sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-  VkPipelineStageFlags destinationStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-
-  vkCmdPipelineBarrier(
-      commandBufferHandle,
-      sourceStage, destinationStage,
-      0,
-      0, nullptr,
-      0, nullptr,
-      1, &barrier
-  );
+    result = vkCreateFence(deviceHandle, &imageAvailableFenceCreateInfo, NULL,
+                           &imageAvailableFenceHandleList[x]);
 
-  result = vkEndCommandBuffer(commandBufferHandle);
+    if (result != VK_SUCCESS) {
+      throwExceptionVulkanAPI(result, "vkCreateFence");
+    }
 
-  if (result != VK_SUCCESS) {
-    throwExceptionVulkanAPI(result, "vkEndCommandBuffer");
-  }
+    VkSemaphoreCreateInfo acquireImageSemaphoreCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0};
 
-  VkSubmitInfo imageLayoutTransitionSubmitInfo = {
-      .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-      .pNext = NULL,
-      .waitSemaphoreCount = 0,
-      .pWaitSemaphores = NULL,
-      .pWaitDstStageMask = NULL,
-      .commandBufferCount = 1,
-      .pCommandBuffers = &commandBufferHandle,
-      .signalSemaphoreCount = 0,
-      .pSignalSemaphores = NULL};
+    result = vkCreateSemaphore(deviceHandle, &acquireImageSemaphoreCreateInfo,
+                               NULL, &acquireImageSemaphoreHandleList[x]);
 
-  VkFenceCreateInfo imageLayoutTransitionFenceCreateInfo = {
-    .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO, .pNext = NULL, .flags = 0};
-  
-  VkFence imageLayoutTransitionFenceHandle = VK_NULL_HANDLE;
-  result = vkCreateFence(deviceHandle,
-                          &imageLayoutTransitionFenceCreateInfo,
-                          NULL, &imageLayoutTransitionFenceHandle);
+    if (result != VK_SUCCESS) {
+      throwExceptionVulkanAPI(result, "vkCreateSemaphore");
+    }
 
-  if (result != VK_SUCCESS) {
-    throwExceptionVulkanAPI(result, "vkCreateFence");
-  }
+    VkSemaphoreCreateInfo writeImageSemaphoreCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0};
 
-  result = vkQueueSubmit(queueHandle, 1,
-                         &imageLayoutTransitionSubmitInfo,
-                         imageLayoutTransitionFenceHandle);
+    result = vkCreateSemaphore(deviceHandle, &writeImageSemaphoreCreateInfo,
+                               NULL, &writeImageSemaphoreHandleList[x]);
 
-  if (result != VK_SUCCESS) {
-    throwExceptionVulkanAPI(result, "vkQueueSubmit");
+    if (result != VK_SUCCESS) {
+      throwExceptionVulkanAPI(result, "vkCreateSemaphore");
+    }
   }
 
-  result = vkWaitForFences(deviceHandle, 1,
-                           &imageLayoutTransitionFenceHandle,
-                           true, UINT32_MAX);
-
-  if (result != VK_SUCCESS && result != VK_TIMEOUT) {
-    throwExceptionVulkanAPI(result, "vkWaitForFences");
+#ifdef RENDER_BACKEND_BENCHMARK
+  // =========================================================================
+  // Render Backend Benchmark
+  // (GPU time of RENDER_BACKEND_BENCHMARK_FRAME_COUNT traces at the largest
+  //  render scale with the ray tracing pipeline and with ray queries, the
+  //  same path loop and scene)
+
+  std::vector<uint32_t> benchmarkRenderBackendList;
+  if (isRayTracingPipelineNeeded) {
+    benchmarkRenderBackendList.push_back(0);
+  }
+  if (isRayQuerySupported) {
+    benchmarkRenderBackendList.push_back(2);
   }
 
-  result = vkResetFences(deviceHandle, 1,
-                          &imageLayoutTransitionFenceHandle);
-
-  if (result != VK_SUCCESS) {
-    throwExceptionVulkanAPI(result, "vkResetFences");
+  if (isTimestampSupported) {
+    std::cout << "Render backend benchmark, "
+              << RENDER_BACKEND_BENCHMARK_FRAME_COUNT << " frames at "
+              << maxRenderExtent.width << "x" << maxRenderExtent.height
+              << ":" << std::endl;
   }
 
-  // -------
+  // uniforms and instance motion of the first frame upload ring slot
+  std::vector<uint32_t> benchmarkDynamicOffsetList = {0, 0};
 
-  result = vkBeginCommandBuffer(commandBufferHandle,
-                              &commandBufferBeginInfo);
+  for (uint32_t i = 0; isTimestampSupported &&
+                       i < benchmarkRenderBackendList.size(); i++) {
+    bool isRayQueryBenchmark = benchmarkRenderBackendList[i] == 2;
+    VkCommandBuffer benchmarkCommandBufferHandle = commandBufferHandleList.back();
 
-  if (result != VK_SUCCESS) {
-    throwExceptionVulkanAPI(result, "vkBeginCommandBuffer");
-  }
+    TracePushConstants benchmarkPushConstants = {
+        .firstSampleIndex = 0,
+        .sampleCount = SAMPLES_PER_PIXEL,
+        .renderWidth = maxRenderExtent.width,
+        .renderHeight = maxRenderExtent.height};
 
-  VkBufferImageCopy region{};
-        region.bufferOffset = 0;
-        region.bufferRowLength = 0;
-        region.bufferImageHeight = 0;
-        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        region.imageSubresource.mipLevel = 0;
-        region.imageSubresource.baseArrayLayer = 0;
-        region.imageSubresource.layerCount = 6;
-        region.imageOffset = {0, 0, 0};
-        region.imageExtent = {
-            static_cast<uint32_t>(width),
-            static_cast<uint32_t>(height),
-            1
-        };
+    VkCommandBufferBeginInfo benchmarkCommandBufferBeginInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .pNext = NULL,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+        .pInheritanceInfo = NULL};
 
-  vkCmdCopyBufferToImage(commandBufferHandle, stagingBufferHandle, skyboxImageHandle, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+    result = vkBeginCommandBuffer(benchmarkCommandBufferHandle,
+                                  &benchmarkCommandBufferBeginInfo);
 
-  result = vkEndCommandBuffer(commandBufferHandle);
+    if (result != VK_SUCCESS) {
+      throwExceptionVulkanAPI(result, "vkBeginCommandBuffer");
+    }
 
-  if (result != VK_SUCCESS) {
-    throwExceptionVulkanAPI(result, "vkEndCommandBuffer");
-  }
-  result = vkQueueSubmit(queueHandle, 1,
-                         &imageLayoutTransitionSubmitInfo,
-                         imageLayoutTransitionFenceHandle);
+    // the instance transforms are otherwise only copied by the TLAS update
+    VkBufferCopy benchmarkInstanceTransformBufferCopy = {
+        .srcOffset = 0,
+        .dstOffset = 0,
+        .size = sizeof(VkAccelerationStructureInstanceKHR) * instanceCount};
 
-  if (result != VK_SUCCESS) {
-    throwExceptionVulkanAPI(result, "vkQueueSubmit");
-  }
+    vkCmdCopyBuffer(benchmarkCommandBufferHandle,
+                    topLevelAccelerationStructureInstanceBufferHandle,
+                    instanceTransformBufferHandle, 1,
+                    &benchmarkInstanceTransformBufferCopy);
 
-  result = vkWaitForFences(deviceHandle, 1,
-                           &imageLayoutTransitionFenceHandle,
-                           true, UINT32_MAX);
+    VkMemoryBarrier benchmarkTransferMemoryBarrier = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .pNext = NULL,
+        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_SHADER_READ_BIT};
 
-  if (result != VK_SUCCESS && result != VK_TIMEOUT) {
-    throwExceptionVulkanAPI(result, "vkWaitForFences");
-  }
+    VkPipelineStageFlags benchmarkStageFlags =
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT |
+        rayTracingShaderStageMask;
 
-  result = vkResetFences(deviceHandle, 1,
-                          &imageLayoutTransitionFenceHandle);
+    vkCmdPipelineBarrier(benchmarkCommandBufferHandle,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT, benchmarkStageFlags,
+                         0, 1, &benchmarkTransferMemoryBarrier, 0, NULL, 0,
+                         NULL);
 
-  if (result != VK_SUCCESS) {
-    throwExceptionVulkanAPI(result, "vkResetFences");
-  }
+    VkMemoryBarrier benchmarkMemoryBarrier = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .pNext = NULL,
+        .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT};
+
+    if (isRayQueryBenchmark) {
+      vkCmdBindPipeline(benchmarkCommandBufferHandle,
+                        VK_PIPELINE_BIND_POINT_COMPUTE, rayQueryPipelineHandle);
+
+      vkCmdBindDescriptorSets(benchmarkCommandBufferHandle,
+                              VK_PIPELINE_BIND_POINT_COMPUTE,
+                              rayQueryPipelineLayoutHandle, 0, 1,
+                              &descriptorSetHandleList[0],
+                              (uint32_t)benchmarkDynamicOffsetList.size(),
+                              benchmarkDynamicOffsetList.data());
+
+      vkCmdPushConstants(benchmarkCommandBufferHandle,
+                         rayQueryPipelineLayoutHandle,
+                         VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                         sizeof(TracePushConstants), &benchmarkPushConstants);
+    } else {
+      vkCmdBindPipeline(benchmarkCommandBufferHandle,
+                        VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR,
+                        rayTracingPipelineHandle);
+
+      vkCmdBindDescriptorSets(
+          benchmarkCommandBufferHandle, VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR,
+          pipelineLayoutHandle, 0, (uint32_t)descriptorSetHandleList.size(),
+          descriptorSetHandleList.data(),
+          (uint32_t)benchmarkDynamicOffsetList.size(),
+          benchmarkDynamicOffsetList.data());
+
+      vkCmdPushConstants(benchmarkCommandBufferHandle, pipelineLayoutHandle,
+                         VK_SHADER_STAGE_RAYGEN_BIT_KHR, 0,
+                         sizeof(TracePushConstants), &benchmarkPushConstants);
+    }
 
-  // ------
+    vkCmdResetQueryPool(benchmarkCommandBufferHandle,
+                        traceTimestampQueryPoolHandle, 0, 2);
+
+    vkCmdWriteTimestamp(benchmarkCommandBufferHandle,
+                        VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                        traceTimestampQueryPoolHandle, 0);
+
+    // every frame writes the same pixels
+    for (uint32_t frame = 0; frame < RENDER_BACKEND_BENCHMARK_FRAME_COUNT;
+         frame++) {
+      if (isRayQueryBenchmark) {
+        vkCmdDispatch(benchmarkCommandBufferHandle,
+                      (maxRenderExtent.width + 7) / 8,
+                      (maxRenderExtent.height + 7) / 8, 1);
+      } else {
+        pvkCmdTraceRaysKHR(benchmarkCommandBufferHandle, &rgenShaderBindingTable,
+                           &rmissShaderBindingTable, &rchitShaderBindingTable,
+                           &callableShaderBindingTable,
+                           maxRenderExtent.width, maxRenderExtent.height, 1);
+      }
 
-  result = vkBeginCommandBuffer(commandBufferHandle,
-                              &commandBufferBeginInfo);
+      vkCmdPipelineBarrier(benchmarkCommandBufferHandle, benchmarkStageFlags,
+                           benchmarkStageFlags, 0, 1, &benchmarkMemoryBarrier,
+                           0, NULL, 0, NULL);
+    }
 
-  if (result != VK_SUCCESS) {
-    throwExceptionVulkanAPI(result, "vkBeginCommandBuffer");
-  }
+    vkCmdWriteTimestamp(benchmarkCommandBufferHandle,
+                        VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                        traceTimestampQueryPoolHandle, 1);
 
-  barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-  barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    result = vkEndCommandBuffer(benchmarkCommandBufferHandle);
 
-  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-  barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    if (result != VK_SUCCESS) {
+      throwExceptionVulkanAPI(result, "vkEndCommandBuffer");
+    }
 
-  sourceStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-  destinationStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    submitAndWait(benchmarkCommandBufferHandle, queueHandle);
 
-  vkCmdPipelineBarrier(
-      commandBufferHandle,
-      sourceStage, destinationStage,
-      0,
-      0, nullptr,
-      0, nullptr,
-      1, &barrier
-  );
+    uint64_t benchmarkTimestampList[2];
+    result = vkGetQueryPoolResults(
+        deviceHandle, traceTimestampQueryPoolHandle, 0, 2,
+        sizeof(benchmarkTimestampList), benchmarkTimestampList,
+        sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
 
-  result = vkEndCommandBuffer(commandBufferHandle);
+    if (result != VK_SUCCESS) {
+      throwExceptionVulkanAPI(result, "vkGetQueryPoolResults");
+    }
 
-  if (result != VK_SUCCESS) {
-    throwExceptionVulkanAPI(result, "vkEndCommandBuffer");
-  }
-  result = vkQueueSubmit(queueHandle, 1,
-                         &imageLayoutTransitionSubmitInfo,
-                         imageLayoutTransitionFenceHandle);
+    double benchmarkTraceTime =
+        (benchmarkTimestampList[1] - benchmarkTimestampList[0]) *
+        timestampPeriod * 1e-6 / RENDER_BACKEND_BENCHMARK_FRAME_COUNT;
 
-  if (result != VK_SUCCESS) {
-    throwExceptionVulkanAPI(result, "vkQueueSubmit");
+    std::cout << "  " << renderBackendNameList[benchmarkRenderBackendList[i]]
+              << ": " << benchmarkTraceTime << " ms per frame" << std::endl;
   }
 
-  result = vkWaitForFences(deviceHandle, 1,
-                           &imageLayoutTransitionFenceHandle,
-                           true, UINT32_MAX);
-
-  if (result != VK_SUCCESS && result != VK_TIMEOUT) {
-    throwExceptionVulkanAPI(result, "vkWaitForFences");
+  if (isTimestampSupported && !isRayTracingPipelineNeeded) {
+    std::cout << "  megakernel: VK_KHR_ray_tracing_pipeline is not supported"
+              << std::endl;
   }
-
-  result = vkResetFences(deviceHandle, 1,
-                          &imageLayoutTransitionFenceHandle);
-
-  if (result != VK_SUCCESS) {
-    throwExceptionVulkanAPI(result, "vkResetFences");
+  if (isTimestampSupported && !isRayQuerySupported) {
+    std::cout << "  rayquery: VK_KHR_ray_query is not supported" << std::endl;
   }
+#endif
 
-  vkDestroyFence(deviceHandle, imageLayoutTransitionFenceHandle, NULL);
-  vkDestroyBuffer(deviceHandle, stagingBufferHandle, NULL);
-  vkFreeMemory(deviceHandle, stagingDeviceMemoryHandle, NULL);
-
-  // Create image view for skybox
-
-  VkImageViewCreateInfo skyboxImageViewInfo{};
-  skyboxImageViewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-  skyboxImageViewInfo.image = skyboxImageHandle;
-  skyboxImageViewInfo.viewType = VK_IMAGE_VIEW_TYPE_CUBE;
-  skyboxImageViewInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
-  skyboxImageViewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-  skyboxImageViewInfo.subresourceRange.baseMipLevel = 0;
-  skyboxImageViewInfo.subresourceRange.levelCount = 1;
-  skyboxImageViewInfo.subresourceRange.baseArrayLayer = 0;
-  skyboxImageViewInfo.subresourceRange.layerCount = 6;
+  // =========================================================================
+  // Main Loop
 
-  VkImageView skyboxImageViewHandle = VK_NULL_HANDLE;
-  result = vkCreateImageView(deviceHandle, &skyboxImageViewInfo, nullptr, &skyboxImageViewHandle);
-  if (result != VK_SUCCESS) {
-      throwExceptionVulkanAPI(result, "vkCreateImageView");
-  }
+  uint32_t currentFrame = 0;
+  uint32_t currentImageIndex = 0;
+#ifdef DYNAMIC_RESOLUTION_ENABLED
+  uint32_t framesSinceRenderScaleChange = 0;
+#endif
+  float timeParam = 0, lastTime = 0;
 
-  VkSamplerCreateInfo samplerInfo{};
-  samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
-  samplerInfo.magFilter = VK_FILTER_LINEAR;
-  samplerInfo.minFilter = VK_FILTER_LINEAR;
-  samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
-  samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
-  samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
-  samplerInfo.anisotropyEnable = VK_FALSE;
-  samplerInfo.maxAnisotropy = 0;
-  samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
-  samplerInfo.unnormalizedCoordinates = VK_FALSE;
-  samplerInfo.compareEnable = VK_FALSE;
-  samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
-  samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+  std::cout << "Present mode: " << getPresentModeName(swapchainPresentMode)
+            << ", frames in flight: " << framesInFlightCount << std::endl;
 
-  VkSampler skyboxSamplerHandle = VK_NULL_HANDLE;
-  result = vkCreateSampler(deviceHandle, &samplerInfo, nullptr, &skyboxSamplerHandle);
-  if (result != VK_SUCCESS) {
-    throwExceptionVulkanAPI(result, "vkCreateSampler");
-  }
+  std::chrono::steady_clock::duration targetFrameDuration =
+      std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+          std::chrono::duration<double>(TARGET_FPS > 0 ? 1.0 / TARGET_FPS
+                                                       : 0.0));
+  std::chrono::steady_clock::time_point frameStartTime =
+      std::chrono::steady_clock::now();
 
-  // =========================================================================
-  // Update Descriptor Set
+#ifdef TEST_FPS
+  // input time of the frame submitted in each slot, until its fence signals
+  std::vector<std::chrono::steady_clock::time_point> inputTimeList(
+      framesInFlightCount);
+  std::vector<bool> isFrameLatencyPendingList(framesInFlightCount, false);
+  double frameLatency = 0;
+#endif
 
-  VkWriteDescriptorSetAccelerationStructureKHR
-      accelerationStructureDescriptorInfo = {
-          .sType =
-              VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET_ACCELERATION_STRUCTURE_KHR,
-          .pNext = NULL,
-          .accelerationStructureCount = 1,
-          .pAccelerationStructures = &topLevelAccelerationStructureHandle};
+  bool isRenderCommandBufferRecordNeeded = true;
+  bool isSwapchainRecreateNeeded = false;
+  VkSwapchainKHR retiredSwapchainHandle = VK_NULL_HANDLE;
+  auto start = std::chrono::system_clock::now();
 
-  // Hardcoded as 2 objects
-  //TODO loop
-  VkDescriptorBufferInfo uniformDescriptorInfo = {
-      .buffer = uniformBufferHandle, .offset = 0, .range = VK_WHOLE_SIZE};
+  while (!glfwWindowShouldClose(windowPtr)) {
+    // the cap delays the start of the frame rather than its present, so the
+    // input is sampled as late as possible; a late frame does not shorten
+    // the next one
+    if (TARGET_FPS > 0) {
+      frameStartTime = std::max(frameStartTime + targetFrameDuration,
+                                std::chrono::steady_clock::now());
+      std::this_thread::sleep_until(frameStartTime);
+    }
 
-  VkDescriptorBufferInfo indexDescriptorInfo = {
-      .buffer = indexBufferHandle, .offset = 0, .range = VK_WHOLE_SIZE};
+    // waiting for the frame slot before polling keeps the wait out of the
+    // input latency
+    result = vkWaitForFences(deviceHandle, 1,
+                             &imageAvailableFenceHandleList[currentFrame], true,
+                             UINT32_MAX);
 
-  VkDescriptorBufferInfo vertexDescriptorInfo = {
-      .buffer = vertexBufferHandle, .offset = 0, .range = VK_WHOLE_SIZE};
+    if (result != VK_SUCCESS && result != VK_TIMEOUT) {
+      throwExceptionVulkanAPI(result, "vkWaitForFences");
+    }
 
-  VkDescriptorImageInfo rayTraceImageDescriptorInfo = {
-      .sampler = VK_NULL_HANDLE,
-      .imageView = rayTraceImageViewHandle,
-      .imageLayout = VK_IMAGE_LAYOUT_GENERAL};
+#ifdef TEST_FPS
+    // input to GPU completion of the frames finished since the last check;
+    // the presentation queue and scan-out come on top
+    for (uint32_t i = 0; i < framesInFlightCount; i++) {
+      if (isFrameLatencyPendingList[i] &&
+          vkGetFenceStatus(deviceHandle, imageAvailableFenceHandleList[i]) ==
+              VK_SUCCESS) {
+        frameLatency = std::chrono::duration<double, std::milli>(
+                           std::chrono::steady_clock::now() - inputTimeList[i])
+                           .count();
+        isFrameLatencyPendingList[i] = false;
+      }
+    }
+#endif
 
-  VkDescriptorImageInfo skyboxSamplerDescriptorInfo = {
-      .sampler = skyboxSamplerHandle,
-      .imageView = skyboxImageViewHandle,
-      .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+    glfwPollEvents();
+#ifdef TEST_FPS
+    std::chrono::steady_clock::time_point inputTime =
+        std::chrono::steady_clock::now();
+#endif
 
-  std::vector<VkWriteDescriptorSet> writeDescriptorSetList = {
-      {.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-       .pNext = &accelerationStructureDescriptorInfo,
-       .dstSet = descriptorSetHandleList[0],
-       .dstBinding = 0,
-       .dstArrayElement = 0,
-       .descriptorCount = 1,
-       .descriptorType = VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR,
-       .pImageInfo = NULL,
-       .pBufferInfo = NULL,
-       .pTexelBufferView = NULL},
-      {.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-       .pNext = NULL,
-       .dstSet = descriptorSetHandleList[0],
-       .dstBinding = 1,
-       .dstArrayElement = 0,
-       .descriptorCount = 1,
-       .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-       .pImageInfo = NULL,
-       .pBufferInfo = &uniformDescriptorInfo,
-       .pTexelBufferView = NULL},
-      {.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-       .pNext = NULL,
-       .dstSet = descriptorSetHandleList[0],
-       .dstBinding = 2,
-       .dstArrayElement = 0,
-       .descriptorCount = 1,
-       .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
-       .pImageInfo = NULL,
-       .pBufferInfo = &indexDescriptorInfo,
-       .pTexelBufferView = NULL},
-      {.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-       .pNext = NULL,
-       .dstSet = descriptorSetHandleList[0],
-       .dstBinding = 3,
-       .dstArrayElement = 0,
-       .descriptorCount = 1,
-       .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
-       .pImageInfo = NULL,
-       .pBufferInfo = &vertexDescriptorInfo,
-       .pTexelBufferView = NULL},
-      {.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-       .pNext = NULL,
-       .dstSet = descriptorSetHandleList[0],
-       .dstBinding = 4,
-       .dstArrayElement = 0,
-       .descriptorCount = 1,
-       .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
-       .pImageInfo = &rayTraceImageDescriptorInfo,
-       .pBufferInfo = NULL,
-       .pTexelBufferView = NULL},
-      {.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-       .pNext = NULL,
-       .dstSet = descriptorSetHandleList[0],
-       .dstBinding = 5,
-       .dstArrayElement = 0,
-       .descriptorCount = 1,
-       .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-       .pImageInfo = &skyboxSamplerDescriptorInfo,
-       .pBufferInfo = NULL,
-       .pTexelBufferView = NULL}};
+    // the render targets, descriptor sets and command buffers of the old
+    // swapchain are kept where they still fit
+    if (isSwapchainRecreateNeeded || isFramebufferResized) {
+      // the frames in flight have finished with the swapchain images, the
+      // storage images and the render command buffers
+      result = vkWaitForFences(deviceHandle,
+                               (uint32_t)imageAvailableFenceHandleList.size(),
+                               imageAvailableFenceHandleList.data(), true,
+                               UINT32_MAX);
+
+      if (result != VK_SUCCESS && result != VK_TIMEOUT) {
+        throwExceptionVulkanAPI(result, "vkWaitForFences");
+      }
 
-  vkUpdateDescriptorSets(deviceHandle, writeDescriptorSetList.size(),
-                         writeDescriptorSetList.data(), 0, NULL);
+      result = vkGetPhysicalDeviceSurfaceCapabilitiesKHR(
+          activePhysicalDeviceHandle, surfaceHandle, &surfaceCapabilities);
 
-  // =========================================================================
-  // Shader Binding Table
+      if (result != VK_SUCCESS) {
+        throwExceptionVulkanAPI(result,
+                                "vkGetPhysicalDeviceSurfaceCapabilitiesKHR");
+      }
 
-  VkDeviceSize shaderBindingTableSize =
-      physicalDeviceRayTracingPipelineProperties.shaderGroupHandleSize * 4;
+      // a minimized window has no extent to render at
+      while ((surfaceCapabilities.currentExtent.width == 0 ||
+              surfaceCapabilities.currentExtent.height == 0) &&
+             !glfwWindowShouldClose(windowPtr)) {
+        glfwWaitEvents();
 
-  VkBuffer shaderBindingTableBufferHandle = VK_NULL_HANDLE;
-  createBuffer(shaderBindingTableBufferHandle,
-    shaderBindingTableSize,
-      VK_BUFFER_USAGE_SHADER_BINDING_TABLE_BIT_KHR |
-      VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
-    queueFamilyIndex);
+        result = vkGetPhysicalDeviceSurfaceCapabilitiesKHR(
+            activePhysicalDeviceHandle, surfaceHandle, &surfaceCapabilities);
 
-  VkDeviceMemory shaderBindingTableDeviceMemoryHandle = VK_NULL_HANDLE;
-  allocAndBind(shaderBindingTableDeviceMemoryHandle,
-    &memoryAllocateFlagsInfo,
-    shaderBindingTableBufferHandle,
-    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+        if (result != VK_SUCCESS) {
+          throwExceptionVulkanAPI(result,
+                                  "vkGetPhysicalDeviceSurfaceCapabilitiesKHR");
+        }
+      }
 
-  char *shaderHandleBuffer = new char[shaderBindingTableSize];
-  result = pvkGetRayTracingShaderGroupHandlesKHR(
-      deviceHandle, rayTracingPipelineHandle, 0, 4, shaderBindingTableSize,
-      shaderHandleBuffer);
+      if (glfwWindowShouldClose(windowPtr)) {
+        break;
+      }
 
-  if (result != VK_SUCCESS) {
-    throwExceptionVulkanAPI(result, "vkGetRayTracingShaderGroupHandlesKHR");
-  }
+      isSwapchainRecreateNeeded = false;
+      isFramebufferResized = false;
 
-  void *hostShaderBindingTableMemoryBuffer;
-  result = vkMapMemory(deviceHandle, shaderBindingTableDeviceMemoryHandle, 0,
-                       shaderBindingTableSize, 0,
-                       &hostShaderBindingTableMemoryBuffer);
+      // the retired swapchain may still be presenting, it is destroyed at the
+      // next recreation (or at cleanup)
+      if (retiredSwapchainHandle != VK_NULL_HANDLE) {
+        vkDestroySwapchainKHR(deviceHandle, retiredSwapchainHandle, NULL);
+      }
+      retiredSwapchainHandle = swapchainHandle;
 
-  for (uint32_t x = 0; x < 4; x++) {
-    memcpy(hostShaderBindingTableMemoryBuffer,
-           shaderHandleBuffer + x * physicalDeviceRayTracingPipelineProperties
-                                        .shaderGroupHandleSize,
-           physicalDeviceRayTracingPipelineProperties.shaderGroupHandleSize);
-    hostShaderBindingTableMemoryBuffer =
-        (char *)hostShaderBindingTableMemoryBuffer +
-        physicalDeviceRayTracingPipelineProperties.shaderGroupBaseAlignment;
-  }
+      swapchainCreateInfo.imageExtent = surfaceCapabilities.currentExtent;
+      swapchainCreateInfo.preTransform = surfaceCapabilities.currentTransform;
+      swapchainCreateInfo.oldSwapchain = retiredSwapchainHandle;
 
-  if (result != VK_SUCCESS) {
-    throwExceptionVulkanAPI(result, "vkMapMemory");
-  }
+      result = vkCreateSwapchainKHR(deviceHandle, &swapchainCreateInfo, NULL,
+                                    &swapchainHandle);
 
-  vkUnmapMemory(deviceHandle, shaderBindingTableDeviceMemoryHandle);
+      if (result != VK_SUCCESS) {
+        throwExceptionVulkanAPI(result, "vkCreateSwapchainKHR");
+      }
 
-  VkBufferDeviceAddressInfo shaderBindingTableBufferDeviceAddressInfo = {
-      .sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO,
-      .pNext = NULL,
-      .buffer = shaderBindingTableBufferHandle};
+      uint32_t recreatedSwapchainImageCount = 0;
+      result = vkGetSwapchainImagesKHR(deviceHandle, swapchainHandle,
+                                       &recreatedSwapchainImageCount, NULL);
 
-  VkDeviceAddress shaderBindingTableBufferDeviceAddress =
-      pvkGetBufferDeviceAddressKHR(deviceHandle,
-                                   &shaderBindingTableBufferDeviceAddressInfo);
+      if (result != VK_SUCCESS) {
+        throwExceptionVulkanAPI(result, "vkGetSwapchainImagesKHR");
+      }
 
-  VkDeviceSize progSize =
-      physicalDeviceRayTracingPipelineProperties.shaderGroupBaseAlignment;
+      for (uint32_t x = 0; x < swapchainImageViewHandleList.size(); x++) {
+        vkDestroyImageView(deviceHandle, swapchainImageViewHandleList[x], NULL);
+      }
 
-  VkDeviceSize sbtSize = progSize * (VkDeviceSize)4;
-  VkDeviceSize hitGroupOffset = 0u * progSize;
-  VkDeviceSize rayGenOffset = 1u * progSize;
-  VkDeviceSize missOffset = 2u * progSize;
+      // the driver may pick another image count for the new swapchain (a
+      // present mode change, for one); the write semaphores, tonemap
+      // descriptor sets, render command buffers and their timestamp slots
+      // are per swapchain image and follow it, the fences and acquire
+      // semaphores are per frame slot
+      if (recreatedSwapchainImageCount != swapchainImageCount) {
+        // presents of the retired swapchain may still wait on the write
+        // semaphores
+        result = vkDeviceWaitIdle(deviceHandle);
+
+        if (result != VK_SUCCESS) {
+          throwExceptionVulkanAPI(result, "vkDeviceWaitIdle");
+        }
+
+        for (uint32_t x = recreatedSwapchainImageCount;
+             x < swapchainImageCount; x++) {
+          vkDestroySemaphore(deviceHandle, writeImageSemaphoreHandleList[x],
+                             NULL);
+        }
+
+        writeImageSemaphoreHandleList.resize(recreatedSwapchainImageCount,
+                                             VK_NULL_HANDLE);
+
+        for (uint32_t x = swapchainImageCount;
+             x < recreatedSwapchainImageCount; x++) {
+          VkSemaphoreCreateInfo writeImageSemaphoreCreateInfo = {
+              .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+              .pNext = NULL,
+              .flags = 0};
+
+          result = vkCreateSemaphore(deviceHandle,
+                                     &writeImageSemaphoreCreateInfo, NULL,
+                                     &writeImageSemaphoreHandleList[x]);
+
+          if (result != VK_SUCCESS) {
+            throwExceptionVulkanAPI(result, "vkCreateSemaphore");
+          }
+        }
+
+        swapchainImageCount = recreatedSwapchainImageCount;
+        swapchainImageHandleList.resize(swapchainImageCount);
+
+        // the sets are written below with the new image views
+        vkDestroyDescriptorPool(deviceHandle, tonemapDescriptorPoolHandle,
+                                NULL);
+
+        tonemapDescriptorPoolSize.descriptorCount = 2 * swapchainImageCount;
+        tonemapDescriptorPoolCreateInfo.maxSets = swapchainImageCount;
+
+        result = vkCreateDescriptorPool(deviceHandle,
+                                        &tonemapDescriptorPoolCreateInfo, NULL,
+                                        &tonemapDescriptorPoolHandle);
+
+        if (result != VK_SUCCESS) {
+          throwExceptionVulkanAPI(result, "vkCreateDescriptorPool");
+        }
+
+        tonemapDescriptorSetLayoutHandleList.assign(
+            swapchainImageCount, tonemapDescriptorSetLayoutHandle);
+        tonemapDescriptorSetAllocateInfo.descriptorPool =
+            tonemapDescriptorPoolHandle;
+        tonemapDescriptorSetAllocateInfo.descriptorSetCount =
+            swapchainImageCount;
+        tonemapDescriptorSetAllocateInfo.pSetLayouts =
+            tonemapDescriptorSetLayoutHandleList.data();
+        tonemapDescriptorSetHandleList.assign(swapchainImageCount,
+                                              VK_NULL_HANDLE);
+
+        result = vkAllocateDescriptorSets(deviceHandle,
+                                          &tonemapDescriptorSetAllocateInfo,
+                                          tonemapDescriptorSetHandleList.data());
+
+        if (result != VK_SUCCESS) {
+          throwExceptionVulkanAPI(result, "vkAllocateDescriptorSets");
+        }
+
+        // recorded below like after any recreation
+        vkFreeCommandBuffers(deviceHandle, commandPoolHandle,
+                             renderCommandBufferCount,
+                             renderCommandBufferHandleList.data());
+
+        renderCommandBufferCount =
+            framesInFlightCount * renderScaleLevelCount * swapchainImageCount;
+        renderCommandBufferAllocateInfo.commandBufferCount =
+            renderCommandBufferCount;
+        renderCommandBufferHandleList.assign(renderCommandBufferCount,
+                                             VK_NULL_HANDLE);
+
+        result = vkAllocateCommandBuffers(deviceHandle,
+                                          &renderCommandBufferAllocateInfo,
+                                          renderCommandBufferHandleList.data());
+
+        if (result != VK_SUCCESS) {
+          throwExceptionVulkanAPI(result, "vkAllocateCommandBuffers");
+        }
+
+        traceLaunchCategoryList.assign(renderCommandBufferCount, {});
+        isTraceTimestampWrittenList.assign(renderCommandBufferCount, false);
+
+        vkDestroyQueryPool(deviceHandle, traceTimestampQueryPoolHandle, NULL);
+
+        traceTimestampQueryPoolCreateInfo.queryCount =
+            traceTimestampStride * renderCommandBufferCount;
+
+        result = vkCreateQueryPool(deviceHandle,
+                                   &traceTimestampQueryPoolCreateInfo, NULL,
+                                   &traceTimestampQueryPoolHandle);
+
+        if (result != VK_SUCCESS) {
+          throwExceptionVulkanAPI(result, "vkCreateQueryPool");
+        }
+      }
 
-  const VkStridedDeviceAddressRegionKHR rchitShaderBindingTable = {
-      .deviceAddress = shaderBindingTableBufferDeviceAddress + 0u * progSize,
-      .stride = progSize,
-      .size = sbtSize * 1};
+      result = vkGetSwapchainImagesKHR(deviceHandle, swapchainHandle,
+                                       &swapchainImageCount,
+                                       swapchainImageHandleList.data());
 
-  const VkStridedDeviceAddressRegionKHR rgenShaderBindingTable = {
-      .deviceAddress = shaderBindingTableBufferDeviceAddress + 1u * progSize,
-      .stride = sbtSize,
-      .size = sbtSize * 1};
+      if (result != VK_SUCCESS) {
+        throwExceptionVulkanAPI(result, "vkGetSwapchainImagesKHR");
+      }
 
-  const VkStridedDeviceAddressRegionKHR rmissShaderBindingTable = {
-      .deviceAddress = shaderBindingTableBufferDeviceAddress + 2u * progSize,
-      .stride = progSize,
-      .size = sbtSize * 2};
+      createSwapchainImageViews(swapchainImageViewHandleList,
+        swapchainImageHandleList,
+        swapchainSurfaceFormat.format);
 
-  const VkStridedDeviceAddressRegionKHR callableShaderBindingTable = {};
+      for (uint32_t i = 0; i < renderScaleLevelCount; i++) {
+        renderExtentList[i] = {
+            .width = std::max(1u, (uint32_t)ceilf(renderScaleList[i] *
+                                  surfaceCapabilities.currentExtent.width)),
+            .height = std::max(1u, (uint32_t)ceilf(renderScaleList[i] *
+                                   surfaceCapabilities.currentExtent.height))};
+      }
+      maxRenderExtent = renderExtentList.back();
+
+      if (maxRenderExtent.width > renderTargetExtent.width ||
+          maxRenderExtent.height > renderTargetExtent.height) {
+        renderTargetExtent = {
+            .width = std::max(renderTargetExtent.width, maxRenderExtent.width),
+            .height =
+                std::max(renderTargetExtent.height, maxRenderExtent.height)};
+
+        destroyStorageImage(rayTraceImageHandle,
+          rayTraceImageDeviceMemoryHandle,
+          rayTraceImageViewHandle);
+
+        createStorageImage(rayTraceImageHandle,
+          rayTraceImageDeviceMemoryHandle,
+          rayTraceImageViewHandle,
+          VK_FORMAT_R16G16B16A16_SFLOAT,
+          renderTargetExtent.width,
+          renderTargetExtent.height,
+          queueFamilyIndex);
+
+        for (uint32_t i = 0; i < gBufferImageCount; i++) {
+          destroyStorageImage(gBufferImageHandleList[i],
+            gBufferImageDeviceMemoryHandleList[i],
+            gBufferImageViewHandleList[i]);
+
+          createStorageImage(gBufferImageHandleList[i],
+            gBufferImageDeviceMemoryHandleList[i],
+            gBufferImageViewHandleList[i],
+            gBufferFormatList[i],
+            renderTargetExtent.width,
+            renderTargetExtent.height,
+            queueFamilyIndex);
+        }
+
+        for (uint32_t i = 0; i < 2; i++) {
+          destroyStorageImage(denoiseImageHandleList[i],
+            denoiseImageDeviceMemoryHandleList[i],
+            denoiseImageViewHandleList[i]);
+
+          createStorageImage(denoiseImageHandleList[i],
+            denoiseImageDeviceMemoryHandleList[i],
+            denoiseImageViewHandleList[i],
+            VK_FORMAT_R16G16B16A16_SFLOAT,
+            renderTargetExtent.width,
+            renderTargetExtent.height,
+            queueFamilyIndex);
+        }
+
+        for (uint32_t i = 0; i < temporalImageCount; i++) {
+          destroyStorageImage(temporalImageHandleList[i],
+            temporalImageDeviceMemoryHandleList[i],
+            temporalImageViewHandleList[i]);
+
+          createStorageImage(temporalImageHandleList[i],
+            temporalImageDeviceMemoryHandleList[i],
+            temporalImageViewHandleList[i],
+            temporalFormatList[i],
+            renderTargetExtent.width,
+            renderTargetExtent.height,
+            queueFamilyIndex);
+        }
+
+        historySourceImageHandleList = {
+            temporalImageHandleList[0], gBufferImageHandleList[0],
+            gBufferImageHandleList[2]};
+        historyDestinationImageHandleList = {
+            temporalImageHandleList[1], temporalImageHandleList[2],
+            temporalImageHandleList[3]};
+
+        // one path in flight per pixel and wave, the queue state keeps its
+        // size
+        if (isWavefrontEnabled) {
+          pathQueueCapacity =
+              (VkDeviceSize)renderTargetExtent.width * renderTargetExtent.height;
+
+          pathQueueBufferSizeList = {
+              32 * pathQueueCapacity, 32 * pathQueueCapacity,
+              sizeof(uint32_t) * pathQueueCapacity, 64 * pathQueueCapacity,
+              64 * pathQueueCapacity};
+
+          for (uint32_t i = 0; i < pathQueueBufferCount; i++) {
+            vkFreeMemory(deviceHandle, pathQueueDeviceMemoryHandleList[i], NULL);
+            vkDestroyBuffer(deviceHandle, pathQueueBufferHandleList[i], NULL);
+
+            createBuffer(pathQueueBufferHandleList[i],
+              pathQueueBufferSizeList[i],
+              VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+              queueFamilyIndex);
+
+            allocAndBind(pathQueueDeviceMemoryHandleList[i],
+              &memoryAllocateFlagsInfo,
+              pathQueueBufferHandleList[i],
+              VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+            pathQueueDescriptorInfoList[i].buffer = pathQueueBufferHandleList[i];
+          }
+
+          for (uint32_t i = 1; i < binDescriptorInfoList.size(); i++) {
+            binDescriptorInfoList[i] = pathQueueDescriptorInfoList[i - 1];
+          }
+
+          vkUpdateDescriptorSets(deviceHandle,
+                                 (uint32_t)binWriteDescriptorSetList.size(),
+                                 binWriteDescriptorSetList.data(), 0, NULL);
+        }
+
+        if (isShadowRayBatchingEnabled) {
+          shadowBatchCapacity = (VkDeviceSize)renderTargetExtent.width *
+                                renderTargetExtent.height * SAMPLES_PER_PIXEL;
+
+          shadowBatchBufferSizeList = {64 * shadowBatchCapacity,
+                                       sizeof(uint32_t) * shadowBatchCapacity};
+
+          for (uint32_t i = 0; i < shadowBatchBufferCount; i++) {
+            vkFreeMemory(deviceHandle, shadowBatchDeviceMemoryHandleList[i], NULL);
+            vkDestroyBuffer(deviceHandle, shadowBatchBufferHandleList[i], NULL);
+
+            createBuffer(shadowBatchBufferHandleList[i],
+              shadowBatchBufferSizeList[i],
+              VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+              VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+              queueFamilyIndex);
+
+            allocAndBind(shadowBatchDeviceMemoryHandleList[i],
+              &memoryAllocateFlagsInfo,
+              shadowBatchBufferHandleList[i],
+              VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+            shadowBatchDescriptorInfoList[i].buffer =
+                shadowBatchBufferHandleList[i];
+          }
+        }
+
+        rayTraceImageDescriptorInfo.imageView = rayTraceImageViewHandle;
+        for (uint32_t i = 0; i < gBufferImageCount; i++) {
+          gBufferDescriptorInfoList[i].imageView = gBufferImageViewHandleList[i];
+        }
+
+        vkUpdateDescriptorSets(deviceHandle, writeDescriptorSetList.size(),
+                               writeDescriptorSetList.data(), 0, NULL);
+
+        temporalImageViewBindingList = {
+            rayTraceImageViewHandle,        gBufferImageViewHandleList[0],
+            gBufferImageViewHandleList[2],  gBufferImageViewHandleList[3],
+            temporalImageViewHandleList[1], temporalImageViewHandleList[2],
+            temporalImageViewHandleList[3], temporalImageViewHandleList[0]};
+
+        writeStorageImageDescriptorSet(temporalDescriptorSetHandle,
+          temporalImageViewBindingList);
+
+        denoiseInputImageViewHandleList = {
+            temporalImageViewHandleList[0], denoiseImageViewHandleList[0],
+            denoiseImageViewHandleList[1]};
+        denoiseOutputImageViewHandleList = {
+            denoiseImageViewHandleList[0], denoiseImageViewHandleList[1],
+            denoiseImageViewHandleList[0]};
+
+        for (uint32_t x = 0; x < denoiseDescriptorSetCount; x++) {
+          std::vector<VkImageView> imageViewHandleList = {
+              denoiseInputImageViewHandleList[x],
+              denoiseOutputImageViewHandleList[x]};
+          imageViewHandleList.insert(imageViewHandleList.end(),
+                                     gBufferImageViewHandleList.begin(),
+                                     gBufferImageViewHandleList.end());
+
+          writeStorageImageDescriptorSet(denoiseDescriptorSetHandleList[x],
+            imageViewHandleList);
+        }
+
+        radianceImageViewHandle =
+            denoiseIterationCount > 0
+                ? denoiseImageViewHandleList[(denoiseIterationCount - 1) % 2]
+                : temporalImageViewHandleList[0];
+      }
 
-  // =========================================================================
-  // Record Render Pass Command Buffers
+      for (uint32_t x = 0; x < swapchainImageCount; x++) {
+        std::vector<VkImageView> imageViewHandleList = {
+            radianceImageViewHandle, swapchainImageViewHandleList[x]};
 
-  for (uint32_t x = 0; x < swapchainImageCount; x++) {
-    VkCommandBufferBeginInfo renderCommandBufferBeginInfo = {
-        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-        .pNext = NULL,
-        .flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT,
-        .pInheritanceInfo = NULL};
+        writeStorageImageDescriptorSet(tonemapDescriptorSetHandleList[x],
+          imageViewHandleList);
+      }
 
-    result = vkBeginCommandBuffer(commandBufferHandleList[x],
-                                  &renderCommandBufferBeginInfo);
+      // the history of the old extent no longer lines up with the pixels
+      storageImageHandleList = {rayTraceImageHandle};
+      storageImageHandleList.insert(storageImageHandleList.end(),
+                                    gBufferImageHandleList.begin(),
+                                    gBufferImageHandleList.end());
+      storageImageHandleList.insert(storageImageHandleList.end(),
+                                    denoiseImageHandleList.begin(),
+                                    denoiseImageHandleList.end());
+      storageImageHandleList.insert(storageImageHandleList.end(),
+                                    temporalImageHandleList.begin(),
+                                    temporalImageHandleList.end());
+
+      result = vkBeginCommandBuffer(commandBufferHandleList.back(),
+                                    &rayTraceImageBarrierCommandBufferBeginInfo);
 
-    if (result != VK_SUCCESS) {
-      throwExceptionVulkanAPI(result, "vkBeginCommandBuffer");
-    }
+      if (result != VK_SUCCESS) {
+        throwExceptionVulkanAPI(result, "vkBeginCommandBuffer");
+      }
 
-    vkCmdBindPipeline(commandBufferHandleList[x],
-                      VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR,
-                      rayTracingPipelineHandle);
+      // the batch entries of the old extent belong to other pixels
+      vkCmdFillBuffer(commandBufferHandleList.back(),
+                      shadowBatchBufferHandleList[1], 0, VK_WHOLE_SIZE, 0);
 
-    vkCmdBindDescriptorSets(
-        commandBufferHandleList[x], VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR,
-        pipelineLayoutHandle, 0, (uint32_t)descriptorSetHandleList.size(),
-        descriptorSetHandleList.data(), 0, NULL);
+      recordStorageImageInitialization(commandBufferHandleList.back(),
+        storageImageHandleList,
+        historyDestinationImageHandleList,
+        queueFamilyIndex);
 
-    pvkCmdTraceRaysKHR(commandBufferHandleList[x], &rgenShaderBindingTable,
-                       &rmissShaderBindingTable, &rchitShaderBindingTable,
-                       &callableShaderBindingTable,
-                       surfaceCapabilities.currentExtent.width,
-                       surfaceCapabilities.currentExtent.height, 1);
+      result = vkEndCommandBuffer(commandBufferHandleList.back());
 
-    VkImageMemoryBarrier swapchainCopyMemoryBarrier = {
-        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
-        .pNext = NULL,
-        .srcAccessMask = 0,
-        .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
-        .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-        .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-        .srcQueueFamilyIndex = queueFamilyIndex,
-        .dstQueueFamilyIndex = queueFamilyIndex,
-        .image = swapchainImageHandleList[x],
-        .subresourceRange = {.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-                             .baseMipLevel = 0,
-                             .levelCount = 1,
-                             .baseArrayLayer = 0,
-                             .layerCount = 1}};
+      if (result != VK_SUCCESS) {
+        throwExceptionVulkanAPI(result, "vkEndCommandBuffer");
+      }
 
-    vkCmdPipelineBarrier(commandBufferHandleList[x],
-                         VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
-                         VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, NULL, 0,
-                         NULL, 1, &swapchainCopyMemoryBarrier);
+      submitAndWait(commandBufferHandleList.back(), queueHandle);
 
-    VkImageMemoryBarrier rayTraceCopyMemoryBarrier = {
-        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
-        .pNext = NULL,
-        .srcAccessMask = 0,
-        .dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
-        .oldLayout = VK_IMAGE_LAYOUT_GENERAL,
-        .newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-        .srcQueueFamilyIndex = queueFamilyIndex,
-        .dstQueueFamilyIndex = queueFamilyIndex,
-        .image = rayTraceImageHandle,
-        .subresourceRange = {.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-                             .baseMipLevel = 0,
-                             .levelCount = 1,
-                             .baseArrayLayer = 0,
-                             .layerCount = 1}};
+      isRenderCommandBufferRecordNeeded = true;
 
-    vkCmdPipelineBarrier(commandBufferHandleList[x],
-                         VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
-                         VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, NULL, 0,
-                         NULL, 1, &rayTraceCopyMemoryBarrier);
+      // timestamps of the old command buffers are out of date
+      std::fill(isTraceTimestampWrittenList.begin(),
+                isTraceTimestampWrittenList.end(), false);
+    }
 
-    VkImageCopy imageCopy = {
-        .srcSubresource = {.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-                           .mipLevel = 0,
-                           .baseArrayLayer = 0,
-                           .layerCount = 1},
-        .srcOffset = {.x = 0, .y = 0, .z = 0},
-        .dstSubresource = {.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-                           .mipLevel = 0,
-                           .baseArrayLayer = 0,
-                           .layerCount = 1},
-        .dstOffset = {.x = 0, .y = 0, .z = 0},
-        .extent = {.width = surfaceCapabilities.currentExtent.width,
-                   .height = surfaceCapabilities.currentExtent.height,
-                   .depth = 1}};
-
-    vkCmdCopyImage(commandBufferHandleList[x], rayTraceImageHandle,
-                   VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-                   swapchainImageHandleList[x],
-                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &imageCopy);
-
-    VkImageMemoryBarrier swapchainPresentMemoryBarrier = {
-        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
-        .pNext = NULL,
-        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
-        .dstAccessMask = 0,
-        .oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-        .newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
-        .srcQueueFamilyIndex = queueFamilyIndex,
-        .dstQueueFamilyIndex = queueFamilyIndex,
-        .image = swapchainImageHandleList[x],
-        .subresourceRange = {.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-                             .baseMipLevel = 0,
-                             .levelCount = 1,
-                             .baseArrayLayer = 0,
-                             .layerCount = 1}};
+    // (re-)record the render command buffers against the current swapchain
+    // images and render extents
+    for (uint32_t y = 0;
+         isRenderCommandBufferRecordNeeded && y < renderCommandBufferCount;
+         y++) {
+      uint32_t x = y % swapchainImageCount;
+      uint32_t frameSlot = y / (swapchainImageCount * renderScaleLevelCount);
+      VkCommandBuffer commandBufferHandle = renderCommandBufferHandleList[y];
+      VkExtent2D renderExtent =
+          renderExtentList[(y / swapchainImageCount) % renderScaleLevelCount];
+
+      // uniforms and instance motion of the frame slot (bindings 1 and 13)
+      std::vector<uint32_t> frameDynamicOffsetList(
+          2, (uint32_t)(frameUploadStride * frameSlot));
+
+      temporalPushConstants.renderWidth = renderExtent.width;
+      temporalPushConstants.renderHeight = renderExtent.height;
+      tonemapPushConstants.renderWidth = renderExtent.width;
+      tonemapPushConstants.renderHeight = renderExtent.height;
+      historyImageCopy.extent = {.width = renderExtent.width,
+                                 .height = renderExtent.height,
+                                 .depth = 1};
+
+      // no render pass to inherit
+      VkCommandBufferInheritanceInfo renderCommandBufferInheritanceInfo = {
+          .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+          .pNext = NULL,
+          .renderPass = VK_NULL_HANDLE,
+          .subpass = 0,
+          .framebuffer = VK_NULL_HANDLE,
+          .occlusionQueryEnable = VK_FALSE,
+          .queryFlags = 0,
+          .pipelineStatistics = 0};
+
+      VkCommandBufferBeginInfo renderCommandBufferBeginInfo = {
+          .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+          .pNext = NULL,
+          .flags = 0,
+          .pInheritanceInfo = &renderCommandBufferInheritanceInfo};
 
-    vkCmdPipelineBarrier(commandBufferHandleList[x],
-                         VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
-                         VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, NULL, 0,
-                         NULL, 1, &swapchainPresentMemoryBarrier);
+      result = vkBeginCommandBuffer(commandBufferHandle,
+                                    &renderCommandBufferBeginInfo);
 
-    VkImageMemoryBarrier rayTraceWriteMemoryBarrier = {
-        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
-        .pNext = NULL,
-        .srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
-        .dstAccessMask = 0,
-        .oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-        .newLayout = VK_IMAGE_LAYOUT_GENERAL,
-        .srcQueueFamilyIndex = queueFamilyIndex,
-        .dstQueueFamilyIndex = queueFamilyIndex,
-        .image = rayTraceImageHandle,
-        .subresourceRange = {.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-                             .baseMipLevel = 0,
-                             .levelCount = 1,
-                             .baseArrayLayer = 0,
-                             .layerCount = 1}};
+      if (result != VK_SUCCESS) {
+        throwExceptionVulkanAPI(result, "vkBeginCommandBuffer");
+      }
 
-    vkCmdPipelineBarrier(commandBufferHandleList[x],
-                         VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
-                         VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, NULL, 0,
-                         NULL, 1, &rayTraceWriteMemoryBarrier);
+      // the previous frame's compute passes and history copies have finished
+      // reading the ray trace and G-buffer images, and the path queue counts
+      // reset by the bin pass are visible
+      VkMemoryBarrier frameStartMemoryBarrier = {
+          .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+          .pNext = NULL,
+          .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+          .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT};
+
+      vkCmdPipelineBarrier(commandBufferHandle,
+                           VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT |
+                               VK_PIPELINE_STAGE_TRANSFER_BIT,
+                           rayTracingShaderStageMask |
+                               VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                           0, 1, &frameStartMemoryBarrier, 0, NULL, 0, NULL);
+
+      vkCmdBindPipeline(commandBufferHandle,
+                        VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR,
+                        rayTracingPipelineHandle);
+
+      vkCmdBindDescriptorSets(
+          commandBufferHandle, VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR,
+          pipelineLayoutHandle, 0, (uint32_t)descriptorSetHandleList.size(),
+          descriptorSetHandleList.data(),
+          (uint32_t)frameDynamicOffsetList.size(),
+          frameDynamicOffsetList.data());
+
+      if (isTimestampSupported) {
+        vkCmdResetQueryPool(commandBufferHandle,
+                            traceTimestampQueryPoolHandle,
+                            traceTimestampStride * y, traceTimestampStride);
+
+        vkCmdWriteTimestamp(commandBufferHandle,
+                            VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                            traceTimestampQueryPoolHandle,
+                            traceTimestampStride * y);
+      }
 
-    result = vkEndCommandBuffer(commandBufferHandleList[x]);
+      traceLaunchCategoryList[y].clear();
+
+      TracePushConstants tracePushConstants = {
+          .firstSampleIndex = 0,
+          .sampleCount = SAMPLES_PER_PIXEL,
+          .renderWidth = renderExtent.width,
+          .renderHeight = renderExtent.height,
+          .isShadowRayBatched = isShadowRayBatchingEnabled};
+
+      if (isRayQueryEnabled) {
+        vkCmdBindPipeline(commandBufferHandle, VK_PIPELINE_BIND_POINT_COMPUTE,
+                          rayQueryPipelineHandle);
+
+        vkCmdBindDescriptorSets(commandBufferHandle,
+                                VK_PIPELINE_BIND_POINT_COMPUTE,
+                                rayQueryPipelineLayoutHandle, 0, 1,
+                                &descriptorSetHandleList[0],
+                                (uint32_t)frameDynamicOffsetList.size(),
+                                frameDynamicOffsetList.data());
+
+        vkCmdPushConstants(commandBufferHandle, rayQueryPipelineLayoutHandle,
+                           VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                           sizeof(TracePushConstants), &tracePushConstants);
+
+        if (isTimestampSupported) {
+          writeTraceLaunchTimestamp(commandBufferHandle,
+                                    traceTimestampQueryPoolHandle,
+                                    traceTimestampStride * y,
+                                    traceLaunchCategoryList[y],
+                                    TRACE_CATEGORY_PATHS, false);
+        }
+
+        vkCmdDispatch(commandBufferHandle,
+                      (renderExtent.width + 7) / 8,
+                      (renderExtent.height + 7) / 8, 1);
+
+        if (isTimestampSupported) {
+          writeTraceLaunchTimestamp(commandBufferHandle,
+                                    traceTimestampQueryPoolHandle,
+                                    traceTimestampStride * y,
+                                    traceLaunchCategoryList[y],
+                                    TRACE_CATEGORY_PATHS, true);
+        }
+      } else if (!isWavefrontEnabled) {
+        vkCmdPushConstants(commandBufferHandle, pipelineLayoutHandle,
+                           VK_SHADER_STAGE_RAYGEN_BIT_KHR, 0,
+                           sizeof(TracePushConstants), &tracePushConstants);
+
+        if (isTimestampSupported) {
+          writeTraceLaunchTimestamp(commandBufferHandle,
+                                    traceTimestampQueryPoolHandle,
+                                    traceTimestampStride * y,
+                                    traceLaunchCategoryList[y],
+                                    TRACE_CATEGORY_PATHS, false);
+        }
+
+        pvkCmdTraceRaysKHR(commandBufferHandle, &rgenShaderBindingTable,
+                           &rmissShaderBindingTable, &rchitShaderBindingTable,
+                           &callableShaderBindingTable,
+                           renderExtent.width, renderExtent.height, 1);
+
+        if (isTimestampSupported) {
+          writeTraceLaunchTimestamp(commandBufferHandle,
+                                    traceTimestampQueryPoolHandle,
+                                    traceTimestampStride * y,
+                                    traceLaunchCategoryList[y],
+                                    TRACE_CATEGORY_PATHS, true);
+        }
+      }
 
-    if (result != VK_SUCCESS) {
-      throwExceptionVulkanAPI(result, "vkEndCommandBuffer");
-    }
-  }
+      // shadow batch: the megakernel wrote one shadow ray per pixel and
+      // sample, traced here by a pipeline without closest hit shaders
+      if (isShadowRayBatchingEnabled) {
+        VkMemoryBarrier shadowBatchMemoryBarrier = {
+            .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+            .pNext = NULL,
+            .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+            .dstAccessMask =
+                VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT};
+
+        vkCmdPipelineBarrier(commandBufferHandle,
+                             rayTracingShaderStageMask,
+                             rayTracingShaderStageMask, 0, 1,
+                             &shadowBatchMemoryBarrier, 0, NULL, 0, NULL);
+
+        vkCmdBindPipeline(commandBufferHandle,
+                          VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR,
+                          shadowBatchPipelineHandle);
+
+        if (isTimestampSupported) {
+          writeTraceLaunchTimestamp(commandBufferHandle,
+                                    traceTimestampQueryPoolHandle,
+                                    traceTimestampStride * y,
+                                    traceLaunchCategoryList[y],
+                                    TRACE_CATEGORY_SHADOW, false);
+        }
+
+        pvkCmdTraceRaysKHR(commandBufferHandle,
+                           &shadowBatchRgenShaderBindingTable,
+                           &shadowBatchRmissShaderBindingTable,
+                           &shadowBatchRchitShaderBindingTable,
+                           &callableShaderBindingTable,
+                           renderExtent.width, renderExtent.height, 1);
+
+        if (isTimestampSupported) {
+          writeTraceLaunchTimestamp(commandBufferHandle,
+                                    traceTimestampQueryPoolHandle,
+                                    traceTimestampStride * y,
+                                    traceLaunchCategoryList[y],
+                                    TRACE_CATEGORY_SHADOW, true);
+        }
+      }
 
-  // =========================================================================
-  // Fences, Semaphores
+      // wavefront: per sample, the camera rays are generated and every wave
+      // bins, traces and shades one bounce of the queued paths and traces
+      // their shadow rays; the kernels alternate between the compute and ray
+      // tracing stages, so one barrier covers all queues, counts and indirect
+      // sizes
+      VkMemoryBarrier pathQueueMemoryBarrier = {
+          .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+          .pNext = NULL,
+          .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+          .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT |
+                           VK_ACCESS_INDIRECT_COMMAND_READ_BIT};
+
+      VkPipelineStageFlags wavefrontStageFlags =
+          VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT |
+          VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT |
+          rayTracingShaderStageMask;
+
+      for (uint32_t s = 0; isWavefrontEnabled && s < SAMPLES_PER_PIXEL; s++) {
+        tracePushConstants.firstSampleIndex = s;
+        tracePushConstants.sampleCount = 1;
+
+        if (s > 0) {
+          vkCmdPipelineBarrier(commandBufferHandle, wavefrontStageFlags,
+                               wavefrontStageFlags, 0, 1,
+                               &pathQueueMemoryBarrier, 0, NULL, 0, NULL);
+        }
+
+        vkCmdBindPipeline(commandBufferHandle, VK_PIPELINE_BIND_POINT_COMPUTE,
+                          generatePipelineHandle);
+
+        vkCmdBindDescriptorSets(commandBufferHandle,
+                                VK_PIPELINE_BIND_POINT_COMPUTE,
+                                generatePipelineLayoutHandle, 0, 1,
+                                &descriptorSetHandleList[0],
+                                (uint32_t)frameDynamicOffsetList.size(),
+                                frameDynamicOffsetList.data());
+
+        vkCmdPushConstants(commandBufferHandle, generatePipelineLayoutHandle,
+                           VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                           sizeof(TracePushConstants), &tracePushConstants);
+
+        vkCmdDispatch(commandBufferHandle,
+                      (renderExtent.width + 7) / 8,
+                      (renderExtent.height + 7) / 8, 1);
+
+        for (uint32_t w = 0; w < WAVEFRONT_WAVE_COUNT; w++) {
+          vkCmdPipelineBarrier(commandBufferHandle, wavefrontStageFlags,
+                               wavefrontStageFlags, 0, 1,
+                               &pathQueueMemoryBarrier, 0, NULL, 0, NULL);
+
+          vkCmdBindPipeline(commandBufferHandle,
+                            VK_PIPELINE_BIND_POINT_COMPUTE, binPipelineHandle);
+
+          vkCmdBindDescriptorSets(commandBufferHandle,
+                                  VK_PIPELINE_BIND_POINT_COMPUTE,
+                                  binPipelineLayoutHandle, 0, 1,
+                                  &binDescriptorSetHandle, 0, NULL);
+
+          // prepare, count and scan, scatter; the count and scatter sizes are
+          // written by the prepare stage
+          for (uint32_t stage = 0; stage < 4; stage++) {
+            BinPushConstants binPushConstants = {
+                .stage = stage,
+                .isSortingEnabled = isWavefrontSortingEnabled};
+
+            vkCmdPushConstants(commandBufferHandle, binPipelineLayoutHandle,
+                               VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                               sizeof(BinPushConstants), &binPushConstants);
+
+            if (stage % 2 == 0) {
+              vkCmdDispatch(commandBufferHandle, 1, 1, 1);
+            } else {
+              vkCmdDispatchIndirect(commandBufferHandle,
+                                    pathQueueStateBufferHandle,
+                                    pathQueueDispatchSizeOffset);
+            }
+
+            vkCmdPipelineBarrier(commandBufferHandle, wavefrontStageFlags,
+                                 wavefrontStageFlags, 0, 1,
+                                 &pathQueueMemoryBarrier, 0, NULL, 0, NULL);
+          }
+
+          // extension: closest hits of the sorted rays, the first wave
+          // holds the camera rays
+          vkCmdPushConstants(commandBufferHandle, pipelineLayoutHandle,
+                             VK_SHADER_STAGE_RAYGEN_BIT_KHR, 0,
+                             sizeof(TracePushConstants), &tracePushConstants);
+
+          uint32_t extendTraceCategory = w == 0 ? TRACE_CATEGORY_PRIMARY
+                                                : TRACE_CATEGORY_SECONDARY;
+
+          if (isTimestampSupported) {
+            writeTraceLaunchTimestamp(commandBufferHandle,
+                                      traceTimestampQueryPoolHandle,
+                                      traceTimestampStride * y,
+                                      traceLaunchCategoryList[y],
+                                      extendTraceCategory, false);
+          }
+
+          pvkCmdTraceRaysIndirectKHR(commandBufferHandle,
+                                     &extendShaderBindingTable,
+                                     &rmissShaderBindingTable,
+                                     &rchitShaderBindingTable,
+                                     &callableShaderBindingTable,
+                                     pathQueueStateBufferDeviceAddress +
+                                         pathQueueTraceSizeOffset);
+
+          if (isTimestampSupported) {
+            writeTraceLaunchTimestamp(commandBufferHandle,
+                                      traceTimestampQueryPoolHandle,
+                                      traceTimestampStride * y,
+                                      traceLaunchCategoryList[y],
+                                      extendTraceCategory, true);
+          }
+
+          vkCmdPipelineBarrier(commandBufferHandle, wavefrontStageFlags,
+                               wavefrontStageFlags, 0, 1,
+                               &pathQueueMemoryBarrier, 0, NULL, 0, NULL);
+
+          // shade: queues the next bounce and the shadow rays
+          vkCmdBindPipeline(commandBufferHandle,
+                            VK_PIPELINE_BIND_POINT_COMPUTE, shadePipelineHandle);
+
+          vkCmdBindDescriptorSets(commandBufferHandle,
+                                  VK_PIPELINE_BIND_POINT_COMPUTE,
+                                  shadePipelineLayoutHandle, 0, 1,
+                                  &descriptorSetHandleList[0],
+                                  (uint32_t)frameDynamicOffsetList.size(),
+                                  frameDynamicOffsetList.data());
+
+          vkCmdPushConstants(commandBufferHandle, shadePipelineLayoutHandle,
+                             VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                             sizeof(TracePushConstants), &tracePushConstants);
+
+          vkCmdDispatchIndirect(commandBufferHandle, pathQueueStateBufferHandle,
+                                pathQueueDispatchSizeOffset);
+
+          vkCmdPipelineBarrier(commandBufferHandle, wavefrontStageFlags,
+                               wavefrontStageFlags, 0, 1,
+                               &pathQueueMemoryBarrier, 0, NULL, 0, NULL);
+
+          vkCmdBindPipeline(commandBufferHandle,
+                            VK_PIPELINE_BIND_POINT_COMPUTE, binPipelineHandle);
+
+          vkCmdBindDescriptorSets(commandBufferHandle,
+                                  VK_PIPELINE_BIND_POINT_COMPUTE,
+                                  binPipelineLayoutHandle, 0, 1,
+                                  &binDescriptorSetHandle, 0, NULL);
+
+          BinPushConstants shadowBinPushConstants = {
+              .stage = 4, .isSortingEnabled = isWavefrontSortingEnabled};
+
+          vkCmdPushConstants(commandBufferHandle, binPipelineLayoutHandle,
+                             VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                             sizeof(BinPushConstants), &shadowBinPushConstants);
+
+          vkCmdDispatch(commandBufferHandle, 1, 1, 1);
+
+          vkCmdPipelineBarrier(commandBufferHandle, wavefrontStageFlags,
+                               wavefrontStageFlags, 0, 1,
+                               &pathQueueMemoryBarrier, 0, NULL, 0, NULL);
+
+          if (isTimestampSupported) {
+            writeTraceLaunchTimestamp(commandBufferHandle,
+                                      traceTimestampQueryPoolHandle,
+                                      traceTimestampStride * y,
+                                      traceLaunchCategoryList[y],
+                                      TRACE_CATEGORY_SHADOW, false);
+          }
+
+          pvkCmdTraceRaysIndirectKHR(commandBufferHandle,
+                                     &shadowShaderBindingTable,
+                                     &rmissShaderBindingTable,
+                                     &rchitShaderBindingTable,
+                                     &callableShaderBindingTable,
+                                     pathQueueStateBufferDeviceAddress +
+                                         shadowQueueTraceSizeOffset);
+
+          if (isTimestampSupported) {
+            writeTraceLaunchTimestamp(commandBufferHandle,
+                                      traceTimestampQueryPoolHandle,
+                                      traceTimestampStride * y,
+                                      traceLaunchCategoryList[y],
+                                      TRACE_CATEGORY_SHADOW, true);
+          }
+        }
+      }
 
-  std::vector<VkFence> imageAvailableFenceHandleList(swapchainImageCount,
-                                                     VK_NULL_HANDLE);
+      if (isTimestampSupported) {
+        vkCmdWriteTimestamp(commandBufferHandle,
+                            isRayQueryEnabled
+                                ? VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT
+                                : VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR,
+                            traceTimestampQueryPoolHandle,
+                            traceTimestampStride * y + 1);
+      }
 
-  std::vector<VkSemaphore> acquireImageSemaphoreHandleList(swapchainImageCount,
-                                                           VK_NULL_HANDLE);
+      VkMemoryBarrier rayTraceWriteMemoryBarrier = {
+          .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+          .pNext = NULL,
+          .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+          .dstAccessMask = VK_ACCESS_SHADER_READ_BIT};
+
+      // the wavefront generate and shade kernels write the ray trace image
+      // and the G-buffer from the compute stage
+      vkCmdPipelineBarrier(commandBufferHandle,
+                           rayTracingShaderStageMask |
+                               VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                           VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1,
+                           &rayTraceWriteMemoryBarrier, 0, NULL, 0, NULL);
+
+      vkCmdBindPipeline(commandBufferHandle,
+                        VK_PIPELINE_BIND_POINT_COMPUTE, temporalPipelineHandle);
+
+      vkCmdBindDescriptorSets(commandBufferHandle,
+                              VK_PIPELINE_BIND_POINT_COMPUTE,
+                              temporalPipelineLayoutHandle, 0, 1,
+                              &temporalDescriptorSetHandle, 0, NULL);
+
+      vkCmdPushConstants(commandBufferHandle, temporalPipelineLayoutHandle,
+                         VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                         sizeof(TemporalPushConstants), &temporalPushConstants);
+
+      vkCmdDispatch(commandBufferHandle,
+                    (renderExtent.width + 7) / 8,
+                    (renderExtent.height + 7) / 8, 1);
+
+      VkMemoryBarrier temporalWriteMemoryBarrier = {
+          .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+          .pNext = NULL,
+          .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+          .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT |
+                           VK_ACCESS_TRANSFER_READ_BIT |
+                           VK_ACCESS_TRANSFER_WRITE_BIT};
+
+      vkCmdPipelineBarrier(commandBufferHandle,
+                           VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                           VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT |
+                               VK_PIPELINE_STAGE_TRANSFER_BIT,
+                           0, 1, &temporalWriteMemoryBarrier, 0, NULL, 0, NULL);
+
+      // the history of the next frame
+      for (uint32_t i = 0; i < historySourceImageHandleList.size(); i++) {
+        vkCmdCopyImage(commandBufferHandle, historySourceImageHandleList[i],
+                       VK_IMAGE_LAYOUT_GENERAL,
+                       historyDestinationImageHandleList[i],
+                       VK_IMAGE_LAYOUT_GENERAL, 1, &historyImageCopy);
+      }
 
-  std::vector<VkSemaphore> writeImageSemaphoreHandleList(swapchainImageCount,
-                                                         VK_NULL_HANDLE);
+      VkMemoryBarrier historyCopyMemoryBarrier = {
+          .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+          .pNext = NULL,
+          .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+          .dstAccessMask = VK_ACCESS_SHADER_READ_BIT};
 
-  for (uint32_t x = 0; x < swapchainImageCount; x++) {
-    VkFenceCreateInfo imageAvailableFenceCreateInfo = {
-        .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
-        .pNext = NULL,
-        .flags = VK_FENCE_CREATE_SIGNALED_BIT};
+      vkCmdPipelineBarrier(commandBufferHandle,
+                           VK_PIPELINE_STAGE_TRANSFER_BIT,
+                           VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1,
+                           &historyCopyMemoryBarrier, 0, NULL, 0, NULL);
 
-    result = vkCreateFence(deviceHandle, &imageAvailableFenceCreateInfo, NULL,
-                           &imageAvailableFenceHandleList[x]);
+      if (denoiseIterationCount > 0) {
+        vkCmdBindPipeline(commandBufferHandle,
+                          VK_PIPELINE_BIND_POINT_COMPUTE, denoisePipelineHandle);
+      }
 
-    if (result != VK_SUCCESS) {
-      throwExceptionVulkanAPI(result, "vkCreateFence");
-    }
+      for (uint32_t i = 0; i < denoiseIterationCount; i++) {
+        uint32_t denoiseDescriptorSetIndex = i == 0 ? 0 : (i % 2 == 1 ? 1 : 2);
+
+        DenoisePushConstants denoisePushConstants = {
+            .stepSize = 1 << i,
+            .isFirstIteration = i == 0,
+            .isLastIteration = i == denoiseIterationCount - 1,
+            .normalPhi = DENOISER_NORMAL_PHI,
+            .depthPhi = DENOISER_DEPTH_PHI,
+            .luminancePhi = DENOISER_LUMINANCE_PHI,
+            .renderWidth = (int32_t)renderExtent.width,
+            .renderHeight = (int32_t)renderExtent.height};
+
+        vkCmdBindDescriptorSets(
+            commandBufferHandle, VK_PIPELINE_BIND_POINT_COMPUTE,
+            denoisePipelineLayoutHandle, 0, 1,
+            &denoiseDescriptorSetHandleList[denoiseDescriptorSetIndex], 0, NULL);
+
+        vkCmdPushConstants(commandBufferHandle, denoisePipelineLayoutHandle,
+                           VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                           sizeof(DenoisePushConstants), &denoisePushConstants);
+
+        vkCmdDispatch(commandBufferHandle,
+                      (renderExtent.width + 7) / 8,
+                      (renderExtent.height + 7) / 8, 1);
+
+        VkMemoryBarrier denoiseWriteMemoryBarrier = {
+            .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+            .pNext = NULL,
+            .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT};
+
+        vkCmdPipelineBarrier(commandBufferHandle,
+                             VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                             VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1,
+                             &denoiseWriteMemoryBarrier, 0, NULL, 0, NULL);
+      }
 
-    VkSemaphoreCreateInfo acquireImageSemaphoreCreateInfo = {
-        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
-        .pNext = NULL,
-        .flags = 0};
+      VkImageMemoryBarrier swapchainWriteMemoryBarrier = {
+          .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+          .pNext = NULL,
+          .srcAccessMask = 0,
+          .dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+          .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+          .newLayout = VK_IMAGE_LAYOUT_GENERAL,
+          .srcQueueFamilyIndex = queueFamilyIndex,
+          .dstQueueFamilyIndex = queueFamilyIndex,
+          .image = swapchainImageHandleList[x],
+          .subresourceRange = {.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                               .baseMipLevel = 0,
+                               .levelCount = 1,
+                               .baseArrayLayer = 0,
+                               .layerCount = 1}};
+
+      vkCmdPipelineBarrier(commandBufferHandle,
+                           VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                           VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, NULL, 0,
+                           NULL, 1, &swapchainWriteMemoryBarrier);
+
+      vkCmdBindPipeline(commandBufferHandle,
+                        VK_PIPELINE_BIND_POINT_COMPUTE, tonemapPipelineHandle);
+
+      vkCmdBindDescriptorSets(commandBufferHandle,
+                              VK_PIPELINE_BIND_POINT_COMPUTE,
+                              tonemapPipelineLayoutHandle, 0, 1,
+                              &tonemapDescriptorSetHandleList[x], 0, NULL);
+
+      vkCmdPushConstants(commandBufferHandle, tonemapPipelineLayoutHandle,
+                         VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                         sizeof(TonemapPushConstants), &tonemapPushConstants);
+
+      vkCmdDispatch(commandBufferHandle,
+                    (surfaceCapabilities.currentExtent.width + 7) / 8,
+                    (surfaceCapabilities.currentExtent.height + 7) / 8, 1);
+
+      VkImageMemoryBarrier swapchainPresentMemoryBarrier = {
+          .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+          .pNext = NULL,
+          .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+          .dstAccessMask = 0,
+          .oldLayout = VK_IMAGE_LAYOUT_GENERAL,
+          .newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+          .srcQueueFamilyIndex = queueFamilyIndex,
+          .dstQueueFamilyIndex = queueFamilyIndex,
+          .image = swapchainImageHandleList[x],
+          .subresourceRange = {.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                               .baseMipLevel = 0,
+                               .levelCount = 1,
+                               .baseArrayLayer = 0,
+                               .layerCount = 1}};
+
+      vkCmdPipelineBarrier(commandBufferHandle,
+                           VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                           VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, NULL, 0,
+                           NULL, 1, &swapchainPresentMemoryBarrier);
+
+      if (isTimestampSupported) {
+        vkCmdWriteTimestamp(commandBufferHandle,
+                            VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                            traceTimestampQueryPoolHandle,
+                            traceTimestampStride * y + 2);
+      }
 
-    result = vkCreateSemaphore(deviceHandle, &acquireImageSemaphoreCreateInfo,
-                               NULL, &acquireImageSemaphoreHandleList[x]);
+      result = vkEndCommandBuffer(commandBufferHandle);
 
-    if (result != VK_SUCCESS) {
-      throwExceptionVulkanAPI(result, "vkCreateSemaphore");
+      if (result != VK_SUCCESS) {
+        throwExceptionVulkanAPI(result, "vkEndCommandBuffer");
+      }
     }
+    isRenderCommandBufferRecordNeeded = false;
 
-    VkSemaphoreCreateInfo writeImageSemaphoreCreateInfo = {
-        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
-        .pNext = NULL,
-        .flags = 0};
-
-    result = vkCreateSemaphore(deviceHandle, &writeImageSemaphoreCreateInfo,
-                               NULL, &writeImageSemaphoreHandleList[x]);
+    // acquired before the acceleration structure update, so a frame skipped
+    // for an out of date swapchain leaves no semaphore signaled
+    uint32_t currentImageIndex = -1;
+    result =
+        vkAcquireNextImageKHR(deviceHandle, swapchainHandle, UINT32_MAX,
+                              acquireImageSemaphoreHandleList[currentFrame],
+                              VK_NULL_HANDLE, &currentImageIndex);
 
-    if (result != VK_SUCCESS) {
-      throwExceptionVulkanAPI(result, "vkCreateSemaphore");
+    if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+      isSwapchainRecreateNeeded = true;
+      continue;
+    }
+    else if (result == VK_SUBOPTIMAL_KHR) {
+      // the image is acquired and still presentable, recreate after this frame
+      isSwapchainRecreateNeeded = true;
+    }
+    else if (result != VK_SUCCESS) {
+      throwExceptionVulkanAPI(result, "vkAcquireNextImageKHR");
     }
-  }
 
-  // =========================================================================
-  // Main Loop
+    result = vkResetFences(deviceHandle, 1,
+                           &imageAvailableFenceHandleList[currentFrame]);
 
-  uint32_t currentFrame = 0;
-  uint32_t currentImageIndex = 0;
-  float timeParam = 0, lastTime = 0;
-  auto start = std::chrono::system_clock::now();
+    if (result != VK_SUCCESS) {
+      throwExceptionVulkanAPI(result, "vkResetFences");
+    }
 
-  while (!glfwWindowShouldClose(windowPtr)) {
-    glfwPollEvents();
+    // the camera of the frame that produced the history
+    glm::mat4 previousViewMatrix = camera.getViewingMatrix();
 
     std::chrono::duration<float> diff = std::chrono::system_clock::now() - start;
     timeParam = diff.count() * 0.1;
@@ -2833,32 +7681,231 @@ int main() {
   //timeParam += 0.0001;
   lastTime = timeParam;
 
-  glmMatrices[0] = glmMatrices[0] * glm::rotate(glm::mat4(1),
+  for(int i = 0; i < instanceCount; i++){
+    previousInstanceTransformList[i] = meshInstanceList[i].transform;
+  }
+
+  meshInstanceList[0].transform = meshInstanceList[0].transform * glm::rotate(glm::mat4(1),
     float(timeParam *M_PI * 0.0001), 
     glm::vec3(0, 1.0f, 0));
-  glmMatrices[1] = glm::translate(
-    glm::rotate(
-        glm::translate(glm::mat4(1), glm::vec3(0, 0, -5)), 
-        float(timeParam *M_PI), 
-        glm::vec3(0, 1.0f, 0)), 
-    glm::vec3(0.0f, 0.0f, 10.0f));  
 
-  assert(glmMatrices.size() == objectCount);
+  for(int i = 0; i < ORBITING_MESH_INSTANCE_COUNT; i++){
+    meshInstanceList[firstOrbitingInstanceIndex + i].transform =
+      getOrbitingTransform(timeParam, i);
+  }
 
-  for(int i = 0; i < objectCount; i++){
-    glmToVulkan(glmMatrices[i], transformMatrix);
+  for(int i = 0; i < instanceCount; i++){
+    glmToVulkan(meshInstanceList[i].transform, transformMatrix);
     bottomLevelAccelerationStructureInstance[i].transform = transformMatrix;
+    if (isMeshLodEnabled) {
+      bottomLevelAccelerationStructureInstance[instanceCount + i].transform =
+          transformMatrix;
+    }
+
+    instanceMotionList[i] = previousInstanceTransformList[i] *
+      glm::inverse(meshInstanceList[i].transform);
   }
 
-  createTLAS(topLevelAccelerationStructureHandle,
-    bottomLevelAccelerationStructureInstance,
-    queueFamilyIndex,
-    memoryAllocateFlagsInfo,
-    topLevelAccelerationStructureBufferHandle,
-    topLevelAccelerationStructureDeviceMemoryHandle,
-    commandBufferHandleList.back(),
-    queueHandle,
-    true);
+  // an instance that changes LOD changes BLAS, which the TLAS cannot be
+  // refitted to; a static one also changes the occluders the shadow cache
+  // remembers
+  bool isTopLevelRebuildNeeded = false;
+  bool isShadowCacheReset = false;
+  for (uint32_t i = 0; isMeshLodEnabled && i < instanceCount; i++) {
+    uint32_t meshIndex = meshInstanceList[i].meshIndex;
+    uint32_t lod = getMeshLod(meshInstanceList[i].transform,
+      instanceBoundingSphereList[i], camera.getPosition(),
+      meshRegistry.getLodCount(meshIndex));
+
+    if (lod == instanceLodList[i]) {
+      continue;
+    }
+
+    instanceLodList[i] = lod;
+    setTopLevelInstanceLod(bottomLevelAccelerationStructureInstance, i,
+      meshIndex, lod, meshRegistry,
+      bottomLevelAccelerationStructureDeviceAddress,
+      i < firstOrbitingInstanceIndex ? STATIC_INSTANCE_MASK
+                                     : MOVING_INSTANCE_MASK);
+
+    isTopLevelRebuildNeeded = true;
+    if (i < firstOrbitingInstanceIndex) {
+      isShadowCacheReset = true;
+    }
+  }
+
+  // the fence of the frame slot has signaled, nothing reads its part of the
+  // upload ring any more
+  VkDeviceSize frameUploadSlotOffset = frameUploadStride * currentFrame;
+  char *frameUploadSlotPointer =
+      (char *)frameUploadHostPointer + frameUploadSlotOffset;
+
+  memcpy(frameUploadSlotPointer + instanceMotionUploadOffset,
+         instanceMotionList.data(), sizeof(glm::mat4) * instanceCount);
+
+  memcpy(frameUploadSlotPointer + topLevelInstanceUploadOffset,
+         bottomLevelAccelerationStructureInstance.data(),
+         sizeof(VkAccelerationStructureInstanceKHR) * topLevelInstanceCount);
+
+  VkCommandBuffer frameCommandBufferHandle =
+      frameCommandBufferHandleList[currentFrame];
+
+  result = vkResetCommandPool(deviceHandle,
+                              frameCommandPoolHandleList[currentFrame], 0);
+
+  if (result != VK_SUCCESS) {
+    throwExceptionVulkanAPI(result, "vkResetCommandPool");
+  }
+
+  VkCommandBufferBeginInfo frameCommandBufferBeginInfo = {
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+      .pNext = NULL,
+      .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+      .pInheritanceInfo = NULL};
+
+  result = vkBeginCommandBuffer(frameCommandBufferHandle,
+                                &frameCommandBufferBeginInfo);
+
+  if (result != VK_SUCCESS) {
+    throwExceptionVulkanAPI(result, "vkBeginCommandBuffer");
+  }
+
+  // the TLAS and the deformed vertices are updated in place: the previous
+  // frame's trace and post passes (earlier on the same queue) have finished
+  // reading them, and its update has finished writing them
+  VkMemoryBarrier topLevelUpdateStartMemoryBarrier = {
+      .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+      .pNext = NULL,
+      .srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR |
+                       VK_ACCESS_SHADER_WRITE_BIT |
+                       VK_ACCESS_TRANSFER_WRITE_BIT,
+      .dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR |
+                       VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR |
+                       VK_ACCESS_SHADER_READ_BIT |
+                       VK_ACCESS_SHADER_WRITE_BIT |
+                       VK_ACCESS_TRANSFER_WRITE_BIT};
+
+  vkCmdPipelineBarrier(frameCommandBufferHandle,
+                       rayTracingShaderStageMask |
+                           VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT |
+                           VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR |
+                           VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT |
+                           VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR |
+                           VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       0, 1, &topLevelUpdateStartMemoryBarrier, 0, NULL, 0, NULL);
+
+  if (isMeshDeformationEnabled) {
+    DeformationPushConstants deformationPushConstants = {
+        .twistAngle = MESH_DEFORMATION_TWIST_ANGLE * sinf(2 * M_PI * timeParam),
+        .baseHeight = deformingMeshBaseHeight,
+        .inverseHeight = deformingMeshInverseHeight,
+        .vertexCount = meshRegistry.getMesh(deformingMeshIndex).vertexCount,
+        .vertexOffset = meshVertexOffset[deformingMeshIndex]};
+
+    vkCmdBindPipeline(frameCommandBufferHandle,
+                      VK_PIPELINE_BIND_POINT_COMPUTE, deformationPipelineHandle);
+
+    vkCmdBindDescriptorSets(frameCommandBufferHandle,
+                            VK_PIPELINE_BIND_POINT_COMPUTE,
+                            deformationPipelineLayoutHandle, 0, 1,
+                            &deformationDescriptorSetHandle, 0, NULL);
+
+    vkCmdPushConstants(frameCommandBufferHandle,
+                       deformationPipelineLayoutHandle,
+                       VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                       sizeof(DeformationPushConstants),
+                       &deformationPushConstants);
+
+    vkCmdDispatch(frameCommandBufferHandle,
+                  (deformationPushConstants.vertexCount + 63) / 64, 1, 1);
+
+    VkMemoryBarrier deformationMemoryBarrier = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .pNext = NULL,
+        .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_SHADER_READ_BIT |
+                         VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR};
+
+    vkCmdPipelineBarrier(frameCommandBufferHandle,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+                         0, 1, &deformationMemoryBarrier, 0, NULL, 0, NULL);
+
+    // a refit keeps the tree of the last full build, whose bounds loosen as
+    // the vertices move away from where they were at that build; the twist
+    // moves no vertex further than the angle difference times the radius
+    float deformationSinceBuild =
+      fabsf(deformationPushConstants.twistAngle - deformingMeshBuildTwistAngle) *
+      deformingMeshMaxRadius * deformingMeshInverseHeight;
+
+    bool isBottomLevelRebuildNeeded =
+      deformationSinceBuild > BLAS_REBUILD_DEFORMATION_THRESHOLD;
+
+    if (isBottomLevelRebuildNeeded) {
+      deformingMeshBuildTwistAngle = deformationPushConstants.twistAngle;
+    }
+
+    recordBLASBuild(frameCommandBufferHandle,
+      bottomLevelAccelerationStructureBuildRangeInfo[deformingMeshIndex],
+      bottomLevelAccelerationStructureBuildGeometryInfo[deformingMeshIndex],
+      !isBottomLevelRebuildNeeded);
+
+    VkMemoryBarrier bottomLevelBuildMemoryBarrier = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .pNext = NULL,
+        .srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR,
+        .dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR};
+
+    vkCmdPipelineBarrier(frameCommandBufferHandle,
+                         VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+                         VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+                         0, 1, &bottomLevelBuildMemoryBarrier, 0, NULL, 0, NULL);
+  }
+
+  recordTLASBuild(frameCommandBufferHandle,
+    topLevelAccelerationStructureHandle,
+    frameUploadBufferDeviceAddress + frameUploadSlotOffset +
+        topLevelInstanceUploadOffset,
+    topLevelAccelerationStructureScratchDeviceAddress,
+    topLevelInstanceCount,
+    !isTopLevelRebuildNeeded);
+
+  // the compact payload hits are transformed with the instances of this
+  // update; the ring slot is rewritten every frame slot, so the trace reads a
+  // device copy made in the same submission
+  VkBufferCopy instanceTransformBufferCopy = {
+      .srcOffset = frameUploadSlotOffset + topLevelInstanceUploadOffset,
+      .dstOffset = 0,
+      .size = sizeof(VkAccelerationStructureInstanceKHR) * instanceCount};
+
+  vkCmdCopyBuffer(frameCommandBufferHandle,
+                  frameUploadBufferHandle,
+                  instanceTransformBufferHandle, 1,
+                  &instanceTransformBufferCopy);
+
+  if (isShadowRayBatchingEnabled && isShadowCacheReset) {
+    vkCmdFillBuffer(frameCommandBufferHandle, shadowBatchBufferHandleList[1],
+                    0, VK_WHOLE_SIZE, 0);
+  }
+
+  VkMemoryBarrier topLevelUpdateMemoryBarrier = {
+      .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+      .pNext = NULL,
+      .srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR |
+                       VK_ACCESS_SHADER_WRITE_BIT |
+                       VK_ACCESS_TRANSFER_WRITE_BIT,
+      .dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR |
+                       VK_ACCESS_SHADER_READ_BIT |
+                       VK_ACCESS_SHADER_WRITE_BIT};
+
+  vkCmdPipelineBarrier(frameCommandBufferHandle,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT |
+                           VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR |
+                           VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       rayTracingShaderStageMask |
+                           VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       0, 1, &topLevelUpdateMemoryBarrier, 0, NULL, 0, NULL);
 
     double xPos, yPos;
     glfwGetCursorPos(windowPtr, &xPos, &yPos);
@@ -2898,46 +7945,121 @@ int main() {
       uniformStructure.cameraUp[2] = cameraUp.z;
     } 
 
-    copyData(uniformDeviceMemoryHandle,
-      (void *) &uniformStructure,
-      sizeof(UniformStructure));
+    memcpy(uniformStructure.previousViewMatrix, &previousViewMatrix,
+           sizeof(uniformStructure.previousViewMatrix));
+    uniformStructure.frameIndex++;
 
-    result = vkWaitForFences(deviceHandle, 1,
-                             &imageAvailableFenceHandleList[currentFrame], true,
-                             UINT32_MAX);
+    memcpy(frameUploadSlotPointer + uniformUploadOffset, &uniformStructure,
+           sizeof(UniformStructure));
 
-    if (result != VK_SUCCESS && result != VK_TIMEOUT) {
-      throwExceptionVulkanAPI(result, "vkWaitForFences");
+    uint32_t renderCommandBufferIndex =
+        (currentFrame * renderScaleLevelCount + renderScaleLevel) *
+            swapchainImageCount +
+        currentImageIndex;
+
+    // the previous submission of this command buffer has finished
+#ifdef DYNAMIC_RESOLUTION_ENABLED
+    bool isFrameTimeMeasured = false;
+#endif
+#if defined(TEST_FPS) || defined(DYNAMIC_RESOLUTION_ENABLED)
+    if (isTimestampSupported &&
+        isTraceTimestampWrittenList[renderCommandBufferIndex]) {
+      const std::vector<uint32_t> &launchCategoryList =
+          traceLaunchCategoryList[renderCommandBufferIndex];
+
+      std::vector<uint64_t> traceTimestampList(3 +
+                                               2 * launchCategoryList.size());
+      result = vkGetQueryPoolResults(
+          deviceHandle, traceTimestampQueryPoolHandle,
+          traceTimestampStride * renderCommandBufferIndex,
+          (uint32_t)traceTimestampList.size(),
+          traceTimestampList.size() * sizeof(uint64_t),
+          traceTimestampList.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+
+      if (result == VK_SUCCESS) {
+#ifdef TEST_FPS
+        traceTime = (traceTimestampList[1] - traceTimestampList[0]) *
+                    timestampPeriod * 1e-6;
+
+        std::fill(traceTimeBreakdown.begin(), traceTimeBreakdown.end(), 0);
+        for (uint32_t i = 0; i < launchCategoryList.size(); i++) {
+          traceTimeBreakdown[launchCategoryList[i]] +=
+              (traceTimestampList[3 + 2 * i + 1] -
+               traceTimestampList[3 + 2 * i]) *
+              timestampPeriod * 1e-6;
+        }
+#endif
+
+#ifdef DYNAMIC_RESOLUTION_ENABLED
+        frameTime = (traceTimestampList[2] - traceTimestampList[0]) *
+                    timestampPeriod * 1e-6;
+        isFrameTimeMeasured = true;
+#endif
+      }
+      else if (result != VK_NOT_READY) {
+        throwExceptionVulkanAPI(result, "vkGetQueryPoolResults");
+      }
     }
+#endif
 
-    result = vkResetFences(deviceHandle, 1,
-                           &imageAvailableFenceHandleList[currentFrame]);
+#ifdef DYNAMIC_RESOLUTION_ENABLED
+    // one level at a time, then wait for the history to settle and for
+    // measurements of the new level
+    framesSinceRenderScaleChange++;
+    if (isFrameTimeMeasured &&
+        framesSinceRenderScaleChange > DYNAMIC_RESOLUTION_SETTLE_FRAME_COUNT) {
+      uint32_t previousRenderScaleLevel = renderScaleLevel;
+
+      if (frameTime > DYNAMIC_RESOLUTION_FRAME_TIME_BUDGET &&
+          renderScaleLevel > 0) {
+        renderScaleLevel--;
+      }
+      else if (frameTime < DYNAMIC_RESOLUTION_RAISE_FRACTION *
+                               DYNAMIC_RESOLUTION_FRAME_TIME_BUDGET &&
+               renderScaleLevel < renderScaleLevelCount - 1) {
+        renderScaleLevel++;
+      }
 
-    if (result != VK_SUCCESS) {
-      throwExceptionVulkanAPI(result, "vkResetFences");
+      if (renderScaleLevel != previousRenderScaleLevel) {
+        framesSinceRenderScaleChange = 0;
+        renderCommandBufferIndex =
+            (currentFrame * renderScaleLevelCount + renderScaleLevel) *
+                swapchainImageCount +
+            currentImageIndex;
+
+        // timestamps of the other levels are out of date
+        std::fill(isTraceTimestampWrittenList.begin(),
+                  isTraceTimestampWrittenList.end(), false);
+
+        // the history was written on the pixel grid of the old level,
+        // where the motion vectors of the new one do not point
+        recordHistoryClear(frameCommandBufferHandle,
+                           historyDestinationImageHandleList);
+      }
     }
+#endif
 
-    uint32_t currentImageIndex = -1;
-    result =
-        vkAcquireNextImageKHR(deviceHandle, swapchainHandle, UINT32_MAX,
-                              acquireImageSemaphoreHandleList[currentFrame],
-                              VK_NULL_HANDLE, &currentImageIndex);
+    vkCmdExecuteCommands(frameCommandBufferHandle, 1,
+                         &renderCommandBufferHandleList[renderCommandBufferIndex]);
+
+    result = vkEndCommandBuffer(frameCommandBufferHandle);
 
     if (result != VK_SUCCESS) {
-      throwExceptionVulkanAPI(result, "vkAcquireNextImageKHR");
+      throwExceptionVulkanAPI(result, "vkEndCommandBuffer");
     }
 
-    VkPipelineStageFlags pipelineStageFlags =
-        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    // the swapchain image is first written by the tonemap pass
+    VkPipelineStageFlags acquireImageWaitStageFlags =
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
 
     VkSubmitInfo submitInfo = {
         .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
         .pNext = NULL,
         .waitSemaphoreCount = 1,
         .pWaitSemaphores = &acquireImageSemaphoreHandleList[currentFrame],
-        .pWaitDstStageMask = &pipelineStageFlags,
+        .pWaitDstStageMask = &acquireImageWaitStageFlags,
         .commandBufferCount = 1,
-        .pCommandBuffers = &commandBufferHandleList[currentImageIndex],
+        .pCommandBuffers = &frameCommandBufferHandle,
         .signalSemaphoreCount = 1,
         .pSignalSemaphores = &writeImageSemaphoreHandleList[currentImageIndex]};
 
@@ -2948,6 +8070,13 @@ int main() {
       throwExceptionVulkanAPI(result, "vkQueueSubmit");
     }
 
+    isTraceTimestampWrittenList[renderCommandBufferIndex] = true;
+
+#ifdef TEST_FPS
+    inputTimeList[currentFrame] = inputTime;
+    isFrameLatencyPendingList[currentFrame] = true;
+#endif
+
     VkPresentInfoKHR presentInfo = {
         .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
         .pNext = NULL,
@@ -2960,14 +8089,17 @@ int main() {
 
     result = vkQueuePresentKHR(queueHandle, &presentInfo);
 
-    if (result != VK_SUCCESS) {
+    if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) {
+      isSwapchainRecreateNeeded = true;
+    }
+    else if (result != VK_SUCCESS) {
       throwExceptionVulkanAPI(result, "vkQueuePresentKHR");
     }
 
-    currentFrame = (currentFrame + 1) % swapchainImageCount;
+    currentFrame = (currentFrame + 1) % framesInFlightCount;
 
 #ifdef TEST_FPS
-    printFps();
+    printFps(traceTime, traceTimeBreakdown, frameLatency);
 #endif
   }
 
@@ -2980,13 +8112,29 @@ int main() {
     throwExceptionVulkanAPI(result, "vkDeviceWaitIdle");
   }
 
+  vkDestroyQueryPool(deviceHandle, traceTimestampQueryPoolHandle, NULL);
+
+  for (uint32_t i = 0; i < framesInFlightCount; i++) {
+    vkDestroyCommandPool(deviceHandle, frameCommandPoolHandleList[i], NULL);
+  }
+
+  vkDestroySampler(deviceHandle, textureSamplerHandle, NULL);
+  for (uint32_t i = 0; i < textureCount; i++) {
+    vkDestroyImageView(deviceHandle, textureImageViewHandleList[i], NULL);
+    vkFreeMemory(deviceHandle, textureImageDeviceMemoryHandleList[i], NULL);
+    vkDestroyImage(deviceHandle, textureImageHandleList[i], NULL);
+  }
+
   vkDestroySampler(deviceHandle, skyboxSamplerHandle, NULL);
   vkDestroyImageView(deviceHandle, skyboxImageViewHandle, NULL);
   vkFreeMemory(deviceHandle, skyboxImageDeviceMemoryHandle, NULL);
   vkDestroyImage(deviceHandle, skyboxImageHandle, NULL);
 
-  for (uint32_t x; x < swapchainImageCount; x++) {
+  for (uint32_t x = 0; x < writeImageSemaphoreHandleList.size(); x++) {
     vkDestroySemaphore(deviceHandle, writeImageSemaphoreHandleList[x], NULL);
+  }
+
+  for (uint32_t x = 0; x < imageAvailableFenceHandleList.size(); x++) {
     vkDestroySemaphore(deviceHandle, acquireImageSemaphoreHandleList[x], NULL);
     vkDestroyFence(deviceHandle, imageAvailableFenceHandleList[x], NULL);
   }
@@ -2995,15 +8143,38 @@ int main() {
   vkFreeMemory(deviceHandle, shaderBindingTableDeviceMemoryHandle, NULL);
   vkDestroyBuffer(deviceHandle, shaderBindingTableBufferHandle, NULL);
 
+  vkFreeMemory(deviceHandle, shadowBatchShaderBindingTableDeviceMemoryHandle,
+               NULL);
+  vkDestroyBuffer(deviceHandle, shadowBatchShaderBindingTableBufferHandle,
+                  NULL);
+
   vkDestroyFence(deviceHandle,
                  rayTraceImageBarrierAccelerationStructureBuildFenceHandle,
                  NULL);
 
-  vkDestroyImageView(deviceHandle, rayTraceImageViewHandle, NULL);
-  vkFreeMemory(deviceHandle, rayTraceImageDeviceMemoryHandle, NULL);
-  vkDestroyImage(deviceHandle, rayTraceImageHandle, NULL);
-  vkFreeMemory(deviceHandle, uniformDeviceMemoryHandle, NULL);
-  vkDestroyBuffer(deviceHandle, uniformBufferHandle, NULL);
+  for (uint32_t i = 0; i < temporalImageCount; i++) {
+    destroyStorageImage(temporalImageHandleList[i],
+      temporalImageDeviceMemoryHandleList[i],
+      temporalImageViewHandleList[i]);
+  }
+
+  for (uint32_t i = 0; i < 2; i++) {
+    destroyStorageImage(denoiseImageHandleList[i],
+      denoiseImageDeviceMemoryHandleList[i],
+      denoiseImageViewHandleList[i]);
+  }
+
+  for (uint32_t i = 0; i < gBufferImageCount; i++) {
+    destroyStorageImage(gBufferImageHandleList[i],
+      gBufferImageDeviceMemoryHandleList[i],
+      gBufferImageViewHandleList[i]);
+  }
+
+  destroyStorageImage(rayTraceImageHandle,
+    rayTraceImageDeviceMemoryHandle,
+    rayTraceImageViewHandle);
+  vkFreeMemory(deviceHandle, frameUploadDeviceMemoryHandle, NULL);
+  vkDestroyBuffer(deviceHandle, frameUploadBufferHandle, NULL);
 
 
   pvkDestroyAccelerationStructureKHR(deviceHandle,
@@ -3015,8 +8186,29 @@ int main() {
   vkDestroyBuffer(deviceHandle, topLevelAccelerationStructureBufferHandle,
                   NULL);
 
+  vkFreeMemory(deviceHandle,
+               topLevelAccelerationStructureScratchDeviceMemoryHandle, NULL);
+  vkDestroyBuffer(deviceHandle,
+                  topLevelAccelerationStructureScratchBufferHandle, NULL);
+  vkFreeMemory(deviceHandle,
+               topLevelAccelerationStructureInstanceDeviceMemoryHandle, NULL);
+  vkDestroyBuffer(deviceHandle,
+                  topLevelAccelerationStructureInstanceBufferHandle, NULL);
+
+
+  vkFreeMemory(deviceHandle, environmentDistributionDeviceMemoryHandle, NULL);
+  vkDestroyBuffer(deviceHandle, environmentDistributionBufferHandle, NULL);
+  vkFreeMemory(deviceHandle, lightDeviceMemoryHandle, NULL);
+  vkDestroyBuffer(deviceHandle, lightBufferHandle, NULL);
+  vkFreeMemory(deviceHandle, materialDeviceMemoryHandle, NULL);
+  vkDestroyBuffer(deviceHandle, materialBufferHandle, NULL);
+  vkFreeMemory(deviceHandle, instanceDeviceMemoryHandle, NULL);
+  vkDestroyBuffer(deviceHandle, instanceBufferHandle, NULL);
+
+  vkFreeMemory(deviceHandle, instanceTransformDeviceMemoryHandle, NULL);
+  vkDestroyBuffer(deviceHandle, instanceTransformBufferHandle, NULL);
 
-  for(int i = 0; i < objectCount; i++){
+  for(int i = 0; i < meshCount; i++){
 
     vkFreeMemory(deviceHandle,
                 bottomLevelAccelerationStructureDeviceScratchMemoryHandle[i], NULL);
@@ -3036,12 +8228,80 @@ int main() {
 
   vkFreeMemory(deviceHandle, indexDeviceMemoryHandle, NULL);
   vkDestroyBuffer(deviceHandle, indexBufferHandle, NULL);
+  vkFreeMemory(deviceHandle, dequantizationTransformDeviceMemoryHandle, NULL);
+  vkDestroyBuffer(deviceHandle, dequantizationTransformBufferHandle, NULL);
   vkFreeMemory(deviceHandle, vertexDeviceMemoryHandle, NULL);
   vkDestroyBuffer(deviceHandle, vertexBufferHandle, NULL);
 
+  if (isWavefrontEnabled) {
+    vkDestroyPipeline(deviceHandle, shadePipelineHandle, NULL);
+    vkDestroyShaderModule(deviceHandle, shadeShaderModuleHandle, NULL);
+    vkDestroyPipelineLayout(deviceHandle, shadePipelineLayoutHandle, NULL);
+    vkDestroyPipeline(deviceHandle, generatePipelineHandle, NULL);
+    vkDestroyShaderModule(deviceHandle, generateShaderModuleHandle, NULL);
+    vkDestroyPipelineLayout(deviceHandle, generatePipelineLayoutHandle, NULL);
+    vkDestroyPipeline(deviceHandle, binPipelineHandle, NULL);
+    vkDestroyShaderModule(deviceHandle, binShaderModuleHandle, NULL);
+    vkDestroyPipelineLayout(deviceHandle, binPipelineLayoutHandle, NULL);
+  }
+  if (isRayQueryPipelineNeeded) {
+    vkDestroyPipeline(deviceHandle, rayQueryPipelineHandle, NULL);
+    vkDestroyShaderModule(deviceHandle, rayQueryShaderModuleHandle, NULL);
+    vkDestroyPipelineLayout(deviceHandle, rayQueryPipelineLayoutHandle, NULL);
+  }
+  vkDestroyDescriptorSetLayout(deviceHandle, binDescriptorSetLayoutHandle,
+                               NULL);
+  vkDestroyDescriptorPool(deviceHandle, binDescriptorPoolHandle, NULL);
+
+  for (uint32_t i = 0; i < pathQueueBufferCount; i++) {
+    vkFreeMemory(deviceHandle, pathQueueDeviceMemoryHandleList[i], NULL);
+    vkDestroyBuffer(deviceHandle, pathQueueBufferHandleList[i], NULL);
+  }
+  vkFreeMemory(deviceHandle, pathQueueStateDeviceMemoryHandle, NULL);
+  vkDestroyBuffer(deviceHandle, pathQueueStateBufferHandle, NULL);
+
+  for (uint32_t i = 0; i < shadowBatchBufferCount; i++) {
+    vkFreeMemory(deviceHandle, shadowBatchDeviceMemoryHandleList[i], NULL);
+    vkDestroyBuffer(deviceHandle, shadowBatchBufferHandleList[i], NULL);
+  }
+
+  vkDestroyPipeline(deviceHandle, temporalPipelineHandle, NULL);
+  vkDestroyShaderModule(deviceHandle, temporalShaderModuleHandle, NULL);
+  vkDestroyPipelineLayout(deviceHandle, temporalPipelineLayoutHandle, NULL);
+  vkDestroyDescriptorSetLayout(deviceHandle, temporalDescriptorSetLayoutHandle,
+                               NULL);
+  vkDestroyDescriptorPool(deviceHandle, temporalDescriptorPoolHandle, NULL);
+
+  vkDestroyPipeline(deviceHandle, denoisePipelineHandle, NULL);
+  vkDestroyShaderModule(deviceHandle, denoiseShaderModuleHandle, NULL);
+  vkDestroyPipelineLayout(deviceHandle, denoisePipelineLayoutHandle, NULL);
+  vkDestroyDescriptorSetLayout(deviceHandle, denoiseDescriptorSetLayoutHandle,
+                               NULL);
+  vkDestroyDescriptorPool(deviceHandle, denoiseDescriptorPoolHandle, NULL);
+
+  vkDestroyPipeline(deviceHandle, tonemapPipelineHandle, NULL);
+  vkDestroyShaderModule(deviceHandle, tonemapShaderModuleHandle, NULL);
+  vkDestroyPipelineLayout(deviceHandle, tonemapPipelineLayoutHandle, NULL);
+  vkDestroyDescriptorSetLayout(deviceHandle, tonemapDescriptorSetLayoutHandle,
+                               NULL);
+  vkDestroyDescriptorPool(deviceHandle, tonemapDescriptorPoolHandle, NULL);
+
+  vkDestroyPipeline(deviceHandle, deformationPipelineHandle, NULL);
+  vkDestroyShaderModule(deviceHandle, deformationShaderModuleHandle, NULL);
+  vkDestroyPipelineLayout(deviceHandle, deformationPipelineLayoutHandle, NULL);
+  vkDestroyDescriptorSetLayout(deviceHandle,
+                               deformationDescriptorSetLayoutHandle, NULL);
+  vkDestroyDescriptorPool(deviceHandle, deformationDescriptorPoolHandle, NULL);
+  vkFreeMemory(deviceHandle, restVertexDeviceMemoryHandle, NULL);
+  vkDestroyBuffer(deviceHandle, restVertexBufferHandle, NULL);
+
+  vkDestroyPipeline(deviceHandle, shadowBatchPipelineHandle, NULL);
+  vkDestroyShaderModule(deviceHandle, rayShadowBatchShaderModuleHandle, NULL);
   vkDestroyPipeline(deviceHandle, rayTracingPipelineHandle, NULL);
   vkDestroyShaderModule(deviceHandle, rayMissShadowShaderModuleHandle, NULL);
   vkDestroyShaderModule(deviceHandle, rayMissShaderModuleHandle, NULL);
+  vkDestroyShaderModule(deviceHandle, rayShadowShaderModuleHandle, NULL);
+  vkDestroyShaderModule(deviceHandle, rayExtendShaderModuleHandle, NULL);
   vkDestroyShaderModule(deviceHandle, rayGenerateShaderModuleHandle, NULL);
   vkDestroyShaderModule(deviceHandle, rayClosestHitShaderModuleHandle, NULL);
   vkDestroyPipelineLayout(deviceHandle, pipelineLayoutHandle, NULL);
@@ -3053,7 +8313,11 @@ int main() {
     vkDestroyImageView(deviceHandle, swapchainImageViewHandleList[x], NULL);
   }
 
+  if (retiredSwapchainHandle != VK_NULL_HANDLE) {
+    vkDestroySwapchainKHR(deviceHandle, retiredSwapchainHandle, NULL);
+  }
   vkDestroySwapchainKHR(deviceHandle, swapchainHandle, NULL);
+  vkDestroyCommandPool(deviceHandle, transferCommandPoolHandle, NULL);
   vkDestroyCommandPool(deviceHandle, commandPoolHandle, NULL);
   vkDestroyDevice(deviceHandle, NULL);
   vkDestroySurfaceKHR(instanceHandle, surfaceHandle, NULL);
@@ -0,0 +1,94 @@
+#include <math.h>
+
+#include "material.h"
+
+MaterialLibrary::MaterialLibrary()
+{
+    // default white texture
+    texturePaths.push_back("");
+    texturePathToIndex[""] = 0;
+}
+
+Material MaterialLibrary::getDefaultMaterial(uint32_t type)
+{
+    Material material = {};
+
+    material.albedo[0] = 0.2f;
+    material.albedo[1] = 1.0f;
+    material.albedo[2] = 0.2f;
+
+    material.specular[0] = 0.8f;
+    material.specular[1] = 0.8f;
+    material.specular[2] = 0.8f;
+
+    // Blinn-Phong exponent of 100
+    material.roughness = sqrtf(2.0f / 102.0f);
+    material.indexOfRefraction = 1.52f;
+    material.type = type;
+    material.albedoTextureIndex = 0;
+
+    return material;
+}
+
+uint32_t MaterialLibrary::addMaterial(const Material &material)
+{
+    materials.push_back(material);
+    return (uint32_t)materials.size() - 1;
+}
+
+uint32_t MaterialLibrary::addMeshMaterial(const Mesh &mesh, uint32_t type)
+{
+    if (mesh.materials.empty())
+    {
+        return addMaterial(getDefaultMaterial(type));
+    }
+
+    const tinyobj::material_t &objMaterial = mesh.materials[0];
+    Material material = getDefaultMaterial(type);
+
+    for (int i = 0; i < 3; i++)
+    {
+        material.albedo[i] = objMaterial.diffuse[i];
+        material.specular[i] = objMaterial.specular[i];
+        material.emission[i] = objMaterial.emission[i];
+    }
+
+    // Blinn-Phong exponent to roughness
+    material.roughness = sqrtf(2.0f / (objMaterial.shininess + 2.0f));
+
+    if (objMaterial.ior > 0.0f)
+    {
+        material.indexOfRefraction = objMaterial.ior;
+    }
+
+    if (!objMaterial.diffuse_texname.empty())
+    {
+        // textures are relative to the directory of the OBJ file
+        std::string baseDirectory;
+        size_t separator = mesh.path.find_last_of("/\\");
+        if (separator != std::string::npos)
+        {
+            baseDirectory = mesh.path.substr(0, separator + 1);
+        }
+
+        material.albedoTextureIndex =
+            addTexture(baseDirectory + objMaterial.diffuse_texname);
+    }
+
+    return addMaterial(material);
+}
+
+uint32_t MaterialLibrary::addTexture(const std::string &path)
+{
+    auto iterator = texturePathToIndex.find(path);
+    if (iterator != texturePathToIndex.end())
+    {
+        return iterator->second;
+    }
+
+    uint32_t textureIndex = (uint32_t)texturePaths.size();
+    texturePaths.push_back(path);
+    texturePathToIndex[path] = textureIndex;
+
+    return textureIndex;
+}
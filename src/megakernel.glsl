@@ -0,0 +1,81 @@
+// Megakernel path loop, shared by the ray tracing pipeline (shader.rgen) and
+// the ray query (shader_ray_query.comp) backends so both render the same
+// image. The includer provides traceClosestHit() and traceShadowRay()
+// (ray_tracing.glsl or ray_query.glsl), included after path_tracing.glsl.
+//
+// Included by the shaders, the name must not start with "shader" so the
+// Makefile does not compile it on its own.
+
+// traces and shades every path of the pixel
+void tracePixel(uvec2 pixel, uvec2 size) {
+  uint samples = uniforms.samplesPerPixel;
+
+  vec4 color = vec4(0.0f, 0.0f, 0.0f, 0.0f);
+
+  vec4 gBufferNormalDepth = vec4(0.0, 0.0, 0.0, 10000.0);
+  vec3 gBufferAlbedo = vec3(1.0);
+  uint gBufferObjectId = 0;
+  vec4 motion = vec4(0.0);
+
+  uint lastSampleIndex = constants.firstSampleIndex + constants.sampleCount;
+  for (uint i = constants.firstSampleIndex; i < lastSampleIndex; i++) 
+  {
+    vec3 rayOrigin;
+    vec3 rayDirection;
+    getCameraRay(pixel, size, i, rayOrigin, rayDirection);
+
+    vec3 tmpColor = vec3(0.0f);
+
+    ShadowRay batchedShadowRay;
+    batchedShadowRay.distance = 0.0;
+
+    uint maxBounceCount = uniforms.maxBounceCount;
+    for (uint j = 0; j <= maxBounceCount; j++) 
+    {
+      PathVertex vertex = traceClosestHit(rayOrigin, rayDirection, getLodInstanceMask(j));
+      bool isGBufferHit = i == 0 && j == 0 && vertex.objectIndex != -1;
+      if (isGBufferHit)
+      {
+        gBufferNormalDepth = vec4(vertex.normal, length(vertex.position - rayOrigin));
+        gBufferObjectId = getInstanceIndex(vertex.objectIndex) + 1;
+        motion = getHitMotion(vertex, pixel, size);
+      }
+      else if (i == 0 && j == 0)
+      {
+        motion = getSkyMotion(rayDirection, pixel, size);
+      }
+
+      vec3 albedo;
+      ShadowRay shadowRay;
+      bool isContinued = shadePathVertex(vertex, rayOrigin, rayDirection, pixel, i, j,
+                                         tmpColor, albedo, shadowRay);
+      if (isGBufferHit)
+        gBufferAlbedo = albedo;
+
+      if (!isContinued)
+      {
+        if (constants.isShadowRayBatched != 0)
+          batchedShadowRay = shadowRay;
+        else if (shadowRay.distance > 0.0 && traceShadowRay(shadowRay))
+          tmpColor += shadowRay.radiance;
+        break;
+      }
+    }
+
+    // traced after the launch by shader_shadow_batch.rgen, which adds the
+    // radiance to the averaged samples
+    if (constants.isShadowRayBatched != 0)
+    {
+      batchedShadowRay.radiance /= samples;
+      shadowBatch.data[getShadowBatchIndex(pixel, i)] = batchedShadowRay;
+    }
+
+    color += vec4(tmpColor, 1);
+  }
+
+  color /= samples;
+
+  imageStore(image, ivec2(pixel), color);
+
+  storeGBuffer(pixel, gBufferNormalDepth, gBufferAlbedo, gBufferObjectId, motion);
+}
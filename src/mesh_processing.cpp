@@ -0,0 +1,295 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <thread>
+
+#include "mesh_processing.h"
+
+/*
+    Open-addressing (linear probing) set of interleaved vertices. Slots
+    hold indices into the vertex array that is being built.
+*/
+class VertexHashTable
+{
+private:
+    static constexpr uint32_t emptySlot = UINT32_MAX;
+
+    std::vector<uint32_t> slots;
+    uint32_t mask;
+
+    static uint64_t hashVertex(const float *vertex)
+    {
+        // FNV-1a over the bit patterns
+        uint64_t hash = 14695981039346656037ull;
+        for (int i = 0; i < MESH_VERTEX_STRIDE; i++)
+        {
+            uint32_t bits;
+            std::memcpy(&bits, &vertex[i], sizeof(bits));
+            hash ^= bits;
+            hash *= 1099511628211ull;
+        }
+        return hash ^ (hash >> 32);
+    }
+
+public:
+    VertexHashTable(size_t maxVertexCount)
+    {
+        // at most half full
+        size_t capacity = 16;
+        while (capacity < 2 * maxVertexCount)
+        {
+            capacity *= 2;
+        }
+
+        slots.assign(capacity, emptySlot);
+        mask = (uint32_t)(capacity - 1);
+    }
+
+    // returns the index of an equal vertex, appending it if there is none
+    uint32_t insert(const float *vertex, std::vector<float> &vertices)
+    {
+        uint32_t slot = (uint32_t)hashVertex(vertex) & mask;
+
+        while (slots[slot] != emptySlot)
+        {
+            const float *candidate = &vertices[MESH_VERTEX_STRIDE * slots[slot]];
+            if (std::memcmp(candidate, vertex, sizeof(float) * MESH_VERTEX_STRIDE) == 0)
+            {
+                return slots[slot];
+            }
+            slot = (slot + 1) & mask;
+        }
+
+        uint32_t vertexIndex = (uint32_t)(vertices.size() / MESH_VERTEX_STRIDE);
+        vertices.insert(vertices.end(), vertex, vertex + MESH_VERTEX_STRIDE);
+        slots[slot] = vertexIndex;
+
+        return vertexIndex;
+    }
+};
+
+struct WeldedShape
+{
+    std::vector<float> vertices;
+    std::vector<uint32_t> indices;
+};
+
+static void weldShape(const tinyobj::attrib_t &attrib,
+                      const tinyobj::shape_t &shape, WeldedShape &weldedShape)
+{
+    VertexHashTable hashTable(shape.mesh.indices.size());
+    weldedShape.indices.reserve(shape.mesh.indices.size());
+
+    for (const tinyobj::index_t &index : shape.mesh.indices)
+    {
+        float vertex[MESH_VERTEX_STRIDE] = {};
+
+        vertex[0] = attrib.vertices[3 * index.vertex_index + 0];
+        vertex[1] = attrib.vertices[3 * index.vertex_index + 1];
+        vertex[2] = attrib.vertices[3 * index.vertex_index + 2];
+
+        if (index.normal_index >= 0)
+        {
+            vertex[3] = attrib.normals[3 * index.normal_index + 0];
+            vertex[4] = attrib.normals[3 * index.normal_index + 1];
+            vertex[5] = attrib.normals[3 * index.normal_index + 2];
+        }
+
+        if (index.texcoord_index >= 0)
+        {
+            vertex[6] = attrib.texcoords[2 * index.texcoord_index + 0];
+            vertex[7] = attrib.texcoords[2 * index.texcoord_index + 1];
+        }
+
+        weldedShape.indices.push_back(
+            hashTable.insert(vertex, weldedShape.vertices));
+    }
+}
+
+void weldVertices(Mesh &mesh)
+{
+    size_t shapeCount = mesh.shapes.size();
+    std::vector<WeldedShape> weldedShapes(shapeCount);
+
+    size_t threadCount = std::min<size_t>(
+        std::max(1u, std::thread::hardware_concurrency()), shapeCount);
+
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < threadCount; t++)
+    {
+        threads.emplace_back([&mesh, &weldedShapes, t, threadCount, shapeCount]()
+                             {
+            for (size_t i = t; i < shapeCount; i += threadCount)
+            {
+                weldShape(mesh.attrib, mesh.shapes[i], weldedShapes[i]);
+            } });
+    }
+
+    for (std::thread &thread : threads)
+    {
+        thread.join();
+    }
+
+    // shapes may share vertices along their borders
+    size_t maxVertexCount = 0;
+    size_t indexCount = 0;
+    for (const WeldedShape &weldedShape : weldedShapes)
+    {
+        maxVertexCount += weldedShape.vertices.size() / MESH_VERTEX_STRIDE;
+        indexCount += weldedShape.indices.size();
+    }
+
+    VertexHashTable hashTable(maxVertexCount);
+    mesh.vertices.clear();
+    mesh.indices.clear();
+    mesh.indices.reserve(indexCount);
+
+    for (const WeldedShape &weldedShape : weldedShapes)
+    {
+        size_t shapeVertexCount = weldedShape.vertices.size() / MESH_VERTEX_STRIDE;
+        std::vector<uint32_t> remap(shapeVertexCount);
+
+        for (size_t i = 0; i < shapeVertexCount; i++)
+        {
+            remap[i] = hashTable.insert(
+                &weldedShape.vertices[MESH_VERTEX_STRIDE * i], mesh.vertices);
+        }
+
+        for (uint32_t index : weldedShape.indices)
+        {
+            mesh.indices.push_back(remap[index]);
+        }
+    }
+
+    mesh.vertexCount = (uint32_t)(mesh.vertices.size() / MESH_VERTEX_STRIDE);
+}
+
+// spreads the lower 10 bits of value so that there are two zero bits
+// between each of them
+static uint32_t expandBits(uint32_t value)
+{
+    value = (value * 0x00010001u) & 0xFF0000FFu;
+    value = (value * 0x00000101u) & 0x0F00F00Fu;
+    value = (value * 0x00000011u) & 0xC30C30C3u;
+    value = (value * 0x00000005u) & 0x49249249u;
+    return value;
+}
+
+static uint32_t getMortonCode(float x, float y, float z)
+{
+    x = std::min(std::max(x * 1024.0f, 0.0f), 1023.0f);
+    y = std::min(std::max(y * 1024.0f, 0.0f), 1023.0f);
+    z = std::min(std::max(z * 1024.0f, 0.0f), 1023.0f);
+
+    return (expandBits((uint32_t)x) << 2) | (expandBits((uint32_t)y) << 1) |
+           expandBits((uint32_t)z);
+}
+
+void reorderTrianglesMorton(Mesh &mesh)
+{
+    uint32_t triangleCount = (uint32_t)(mesh.indices.size() / 3);
+    if (triangleCount == 0)
+    {
+        return;
+    }
+
+    float minimum[3] = {INFINITY, INFINITY, INFINITY};
+    float maximum[3] = {-INFINITY, -INFINITY, -INFINITY};
+
+    for (uint32_t index : mesh.indices)
+    {
+        for (int j = 0; j < 3; j++)
+        {
+            float value = mesh.vertices[MESH_VERTEX_STRIDE * index + j];
+            minimum[j] = std::min(minimum[j], value);
+            maximum[j] = std::max(maximum[j], value);
+        }
+    }
+
+    float inverseExtent[3];
+    for (int j = 0; j < 3; j++)
+    {
+        float extent = maximum[j] - minimum[j];
+        inverseExtent[j] = extent > 0.0f ? 1.0f / extent : 0.0f;
+    }
+
+    std::vector<std::pair<uint32_t, uint32_t>> mortonCodeList(triangleCount);
+
+    for (uint32_t i = 0; i < triangleCount; i++)
+    {
+        float centroid[3] = {0.0f, 0.0f, 0.0f};
+        for (int k = 0; k < 3; k++)
+        {
+            const float *vertex =
+                &mesh.vertices[MESH_VERTEX_STRIDE * mesh.indices[3 * i + k]];
+            for (int j = 0; j < 3; j++)
+            {
+                centroid[j] += vertex[j] / 3.0f;
+            }
+        }
+
+        mortonCodeList[i] = {
+            getMortonCode((centroid[0] - minimum[0]) * inverseExtent[0],
+                          (centroid[1] - minimum[1]) * inverseExtent[1],
+                          (centroid[2] - minimum[2]) * inverseExtent[2]),
+            i};
+    }
+
+    // stable so that equal codes keep their authored order
+    std::stable_sort(mortonCodeList.begin(), mortonCodeList.end(),
+                     [](const std::pair<uint32_t, uint32_t> &a,
+                        const std::pair<uint32_t, uint32_t> &b)
+                     { return a.first < b.first; });
+
+    std::vector<uint32_t> indices(mesh.indices.size());
+    for (uint32_t i = 0; i < triangleCount; i++)
+    {
+        uint32_t triangle = mortonCodeList[i].second;
+        indices[3 * i + 0] = mesh.indices[3 * triangle + 0];
+        indices[3 * i + 1] = mesh.indices[3 * triangle + 1];
+        indices[3 * i + 2] = mesh.indices[3 * triangle + 2];
+    }
+
+    mesh.indices.swap(indices);
+}
+
+void reorderVerticesFirstUse(Mesh &mesh)
+{
+    const uint32_t unassigned = UINT32_MAX;
+    std::vector<uint32_t> remap(mesh.vertexCount, unassigned);
+
+    uint32_t vertexCount = 0;
+    for (uint32_t &index : mesh.indices)
+    {
+        if (remap[index] == unassigned)
+        {
+            remap[index] = vertexCount++;
+        }
+        index = remap[index];
+    }
+
+    // vertices not referenced by any triangle are dropped
+    std::vector<float> vertices(MESH_VERTEX_STRIDE * vertexCount);
+    for (uint32_t i = 0; i < mesh.vertexCount; i++)
+    {
+        if (remap[i] != unassigned)
+        {
+            std::copy(&mesh.vertices[MESH_VERTEX_STRIDE * i],
+                      &mesh.vertices[MESH_VERTEX_STRIDE * (i + 1)],
+                      &vertices[MESH_VERTEX_STRIDE * remap[i]]);
+        }
+    }
+
+    mesh.vertices.swap(vertices);
+    mesh.vertexCount = vertexCount;
+}
+
+bool fitsShortIndices(const Mesh &mesh)
+{
+    return mesh.vertexCount <= 65536;
+}
+
+std::vector<uint16_t> getShortIndices(const Mesh &mesh)
+{
+    return std::vector<uint16_t>(mesh.indices.begin(), mesh.indices.end());
+}
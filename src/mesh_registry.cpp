@@ -0,0 +1,290 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+#define TINYOBJLOADER_IMPLEMENTATION
+#include "mesh_registry.h"
+#include "mesh_processing.h"
+#include "mesh_simplification.h"
+
+static uint64_t hashFileContent(const std::string &content)
+{
+    // FNV-1a
+    uint64_t hash = 14695981039346656037ull;
+    for (unsigned char c : content)
+    {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+static uint32_t packSnorm16(float value)
+{
+    value = std::min(std::max(value, -1.0f), 1.0f);
+    return (uint32_t)(uint16_t)(int16_t)std::round(value * 32767.0f);
+}
+
+static uint32_t packHalf(float value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+
+    uint32_t sign = (bits >> 16) & 0x8000;
+    int32_t exponent = (int32_t)((bits >> 23) & 0xff) - 127 + 15;
+    uint32_t mantissa = bits & 0x7fffff;
+
+    // flush denormals to zero, clamp overflow to infinity
+    if (exponent <= 0)
+    {
+        return sign;
+    }
+    if (exponent >= 31)
+    {
+        return sign | 0x7c00;
+    }
+
+    // rounding may carry into the exponent
+    return sign | (((uint32_t)exponent << 10) + ((mantissa + 0x1000) >> 13));
+}
+
+// octahedral mapping of a unit vector to two snorm16 values
+static uint32_t packOctahedral(float x, float y, float z)
+{
+    float length = std::fabs(x) + std::fabs(y) + std::fabs(z);
+    if (length == 0.0f)
+    {
+        return 0;
+    }
+
+    float u = x / length;
+    float v = y / length;
+
+    if (z < 0.0f)
+    {
+        float foldedU = (1.0f - std::fabs(v)) * (u >= 0.0f ? 1.0f : -1.0f);
+        float foldedV = (1.0f - std::fabs(u)) * (v >= 0.0f ? 1.0f : -1.0f);
+        u = foldedU;
+        v = foldedV;
+    }
+
+    return packSnorm16(u) | (packSnorm16(v) << 16);
+}
+
+MeshRegistry::MeshRegistry(bool compactVertexFormat, bool optimizeMeshLayout)
+    : compactVertexFormat(compactVertexFormat),
+      optimizeMeshLayout(optimizeMeshLayout)
+{
+}
+
+uint32_t MeshRegistry::load(const char *fileName)
+{
+    std::string path(fileName);
+
+    auto pathIterator = pathToMeshIndex.find(path);
+    if (pathIterator != pathToMeshIndex.end())
+    {
+        return pathIterator->second;
+    }
+
+    std::ifstream file(fileName, std::ios::binary);
+    std::string content((std::istreambuf_iterator<char>(file)),
+                        std::istreambuf_iterator<char>());
+    uint64_t contentHash = hashFileContent(content);
+
+    tinyobj::ObjReaderConfig readerConfig;
+    tinyobj::ObjReader reader;
+
+    if (!reader.ParseFromFile(path, readerConfig))
+    {
+        if (!reader.Error().empty())
+        {
+            std::cerr << "TinyObjReader: " << reader.Error();
+        }
+        exit(1);
+    }
+
+    if (!reader.Warning().empty())
+    {
+        std::cout << "TinyObjReader: " << reader.Warning();
+    }
+
+    Mesh mesh;
+    mesh.path = path;
+    mesh.contentHash = contentHash;
+    mesh.attrib = reader.GetAttrib();
+    mesh.shapes = reader.GetShapes();
+    mesh.materials = reader.GetMaterials();
+
+    buildGeometry(mesh);
+    processMesh(mesh);
+
+    // same content under a different path still shares one mesh; the hash
+    // only picks the candidate, the geometry has to match as well
+    auto hashIterator = hashToMeshIndex.find(contentHash);
+    if (hashIterator != hashToMeshIndex.end() &&
+        isSameGeometry(meshes[hashIterator->second], mesh))
+    {
+        pathToMeshIndex[path] = hashIterator->second;
+        return hashIterator->second;
+    }
+
+    uint32_t meshIndex = pushMesh(mesh);
+    pathToMeshIndex[path] = meshIndex;
+    if (hashIterator == hashToMeshIndex.end())
+    {
+        hashToMeshIndex[contentHash] = meshIndex;
+    }
+
+    return meshIndex;
+}
+
+// the load-time passes shared by loaded and simplified meshes
+void MeshRegistry::processMesh(Mesh &mesh)
+{
+    if (optimizeMeshLayout)
+    {
+        reorderTrianglesMorton(mesh);
+        reorderVerticesFirstUse(mesh);
+    }
+
+    if (compactVertexFormat)
+    {
+        buildCompactGeometry(mesh);
+    }
+}
+
+bool MeshRegistry::isSameGeometry(const Mesh &mesh, const Mesh &otherMesh)
+{
+    return mesh.vertices.size() == otherMesh.vertices.size() &&
+           mesh.indices.size() == otherMesh.indices.size() &&
+           std::memcmp(mesh.vertices.data(), otherMesh.vertices.data(),
+                       mesh.vertices.size() * sizeof(float)) == 0 &&
+           std::memcmp(mesh.indices.data(), otherMesh.indices.data(),
+                       mesh.indices.size() * sizeof(uint32_t)) == 0;
+}
+
+uint32_t MeshRegistry::addMesh(Mesh &mesh)
+{
+    processMesh(mesh);
+    return pushMesh(mesh);
+}
+
+uint32_t MeshRegistry::pushMesh(Mesh &mesh)
+{
+    uint32_t meshIndex = (uint32_t)meshes.size();
+    meshes.push_back(std::move(mesh));
+    lodMeshIndices.push_back({meshIndex});
+
+    return meshIndex;
+}
+
+void MeshRegistry::buildLevelsOfDetail(uint32_t meshIndex, uint32_t lodCount,
+                                       float reduction)
+{
+    std::vector<uint32_t> targetPrimitiveCounts;
+    float primitiveCount = (float)meshes[meshIndex].primitiveCount;
+    for (uint32_t lod = 1; lod < lodCount; lod++)
+    {
+        primitiveCount *= reduction;
+        targetPrimitiveCounts.push_back((uint32_t)primitiveCount);
+    }
+
+    std::vector<Mesh> simplifiedMeshes;
+    simplifyMesh(meshes[meshIndex], targetPrimitiveCounts, simplifiedMeshes);
+
+    for (uint32_t lod = 1; lod < lodCount; lod++)
+    {
+        Mesh &simplifiedMesh = simplifiedMeshes[lod - 1];
+        const Mesh &previousMesh =
+            meshes[lodMeshIndices[meshIndex].back()];
+
+        // nothing left to collapse, or the level ran out of triangles
+        if (simplifiedMesh.primitiveCount == 0 ||
+            simplifiedMesh.primitiveCount >= previousMesh.primitiveCount)
+        {
+            break;
+        }
+
+        simplifiedMesh.path += "#lod" + std::to_string(lod);
+        uint32_t lodMeshIndex = addMesh(simplifiedMesh);
+        lodMeshIndices[meshIndex].push_back(lodMeshIndex);
+    }
+}
+
+uint32_t MeshRegistry::getLodMeshIndex(uint32_t meshIndex, uint32_t lod) const
+{
+    const std::vector<uint32_t> &lodMeshIndexList = lodMeshIndices[meshIndex];
+    return lodMeshIndexList[std::min<size_t>(lod, lodMeshIndexList.size() - 1)];
+}
+
+void MeshRegistry::buildGeometry(Mesh &mesh)
+{
+    weldVertices(mesh);
+    mesh.simplificationError = 0.0f;
+
+    for (int j = 0; j < 3; j++)
+    {
+        mesh.positionOffset[j] = 0.0f;
+        mesh.positionScale[j] = 1.0f;
+    }
+
+    mesh.primitiveCount = 0;
+    for (const tinyobj::shape_t &shape : mesh.shapes)
+    {
+        mesh.primitiveCount += shape.mesh.num_face_vertices.size();
+    }
+}
+
+void MeshRegistry::buildCompactGeometry(Mesh &mesh)
+{
+    float minimum[3] = {INFINITY, INFINITY, INFINITY};
+    float maximum[3] = {-INFINITY, -INFINITY, -INFINITY};
+
+    for (size_t i = 0; i < mesh.vertexCount; i++)
+    {
+        for (int j = 0; j < 3; j++)
+        {
+            minimum[j] = std::min(minimum[j], mesh.vertices[MESH_VERTEX_STRIDE * i + j]);
+            maximum[j] = std::max(maximum[j], mesh.vertices[MESH_VERTEX_STRIDE * i + j]);
+        }
+    }
+
+    for (int j = 0; j < 3; j++)
+    {
+        mesh.positionOffset[j] =
+            mesh.vertexCount > 0 ? 0.5f * (minimum[j] + maximum[j]) : 0.0f;
+        mesh.positionScale[j] =
+            mesh.vertexCount > 0 ? 0.5f * (maximum[j] - minimum[j]) : 1.0f;
+
+        // flat axis, any scale will do
+        if (mesh.positionScale[j] <= 0.0f)
+        {
+            mesh.positionScale[j] = 1.0f;
+        }
+    }
+
+    mesh.compactVertices.resize(MESH_COMPACT_VERTEX_STRIDE * mesh.vertexCount);
+
+    for (size_t i = 0; i < mesh.vertexCount; i++)
+    {
+        const float *vertex = &mesh.vertices[MESH_VERTEX_STRIDE * i];
+        uint32_t *compactVertex =
+            &mesh.compactVertices[MESH_COMPACT_VERTEX_STRIDE * i];
+
+        float position[3];
+        for (int j = 0; j < 3; j++)
+        {
+            position[j] =
+                (vertex[j] - mesh.positionOffset[j]) / mesh.positionScale[j];
+        }
+
+        compactVertex[0] = packSnorm16(position[0]) | (packSnorm16(position[1]) << 16);
+        compactVertex[1] = packSnorm16(position[2]);
+        compactVertex[2] = packOctahedral(vertex[3], vertex[4], vertex[5]);
+        compactVertex[3] = packHalf(vertex[6]) | (packHalf(vertex[7]) << 16);
+    }
+}
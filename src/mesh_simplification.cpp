@@ -0,0 +1,582 @@
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <iterator>
+#include <queue>
+#include <unordered_map>
+
+#include "mesh_simplification.h"
+
+// borders are kept this much stiffer than the surface
+static const double borderPlaneWeight = 10.0;
+
+/*
+    Sum of the squared distances to a set of planes, as the symmetric 4x4
+    matrix of their equations (upper triangle by rows).
+*/
+struct Quadric
+{
+    double values[10] = {};
+
+    void addPlane(const double plane[4], double weight)
+    {
+        int k = 0;
+        for (int i = 0; i < 4; i++)
+        {
+            for (int j = i; j < 4; j++)
+            {
+                values[k++] += weight * plane[i] * plane[j];
+            }
+        }
+    }
+
+    void add(const Quadric &quadric)
+    {
+        for (int k = 0; k < 10; k++)
+        {
+            values[k] += quadric.values[k];
+        }
+    }
+
+    double evaluate(const float *position) const
+    {
+        double point[4] = {position[0], position[1], position[2], 1.0};
+
+        double error = 0.0;
+        int k = 0;
+        for (int i = 0; i < 4; i++)
+        {
+            for (int j = i; j < 4; j++)
+            {
+                error += (i == j ? 1.0 : 2.0) * values[k++] * point[i] * point[j];
+            }
+        }
+        return std::max(error, 0.0);
+    }
+};
+
+// source is merged into target; stale when either vertex has collapsed
+// since the collapse was queued
+struct Collapse
+{
+    double cost;
+    uint32_t source;
+    uint32_t target;
+    uint32_t sourceVersion;
+    uint32_t targetVersion;
+
+    bool operator>(const Collapse &other) const { return cost > other.cost; }
+};
+
+static void subtract(const float *a, const float *b, double result[3])
+{
+    for (int j = 0; j < 3; j++)
+    {
+        result[j] = (double)a[j] - (double)b[j];
+    }
+}
+
+static void cross(const double a[3], const double b[3], double result[3])
+{
+    result[0] = a[1] * b[2] - a[2] * b[1];
+    result[1] = a[2] * b[0] - a[0] * b[2];
+    result[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+static double dot(const double a[3], const double b[3])
+{
+    return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+static void getTriangleNormal(const float *p0, const float *p1, const float *p2,
+                              double normal[3])
+{
+    double edge0[3];
+    double edge1[3];
+    subtract(p1, p0, edge0);
+    subtract(p2, p0, edge1);
+    cross(edge0, edge1, normal);
+}
+
+static uint64_t getEdgeKey(uint32_t a, uint32_t b)
+{
+    return ((uint64_t)std::min(a, b) << 32) | std::max(a, b);
+}
+
+class MeshSimplifier
+{
+private:
+    const Mesh &mesh;
+
+    // mesh vertex -> vertex joined by position, and one mesh vertex per
+    // joined vertex to read the position from
+    std::vector<uint32_t> positionVertices;
+    std::vector<uint32_t> representativeVertices;
+
+    std::vector<uint32_t> indices;
+    std::vector<bool> isTriangleRemoved;
+    uint32_t triangleCount;
+
+    // per joined vertex
+    std::vector<std::vector<uint32_t>> vertexTriangles;
+    std::vector<Quadric> quadrics;
+    std::vector<uint32_t> versions;
+
+    std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>>
+        collapses;
+    double maxError;
+
+    const float *getPosition(uint32_t positionVertex) const
+    {
+        return &mesh.vertices[MESH_VERTEX_STRIDE *
+                              representativeVertices[positionVertex]];
+    }
+
+    void joinPositions()
+    {
+        std::vector<uint32_t> order(mesh.vertexCount);
+        for (uint32_t i = 0; i < mesh.vertexCount; i++)
+        {
+            order[i] = i;
+        }
+
+        const std::vector<float> &vertices = mesh.vertices;
+        std::sort(order.begin(), order.end(),
+                  [&vertices](uint32_t a, uint32_t b)
+                  {
+                      return std::lexicographical_compare(
+                          &vertices[MESH_VERTEX_STRIDE * a],
+                          &vertices[MESH_VERTEX_STRIDE * a + 3],
+                          &vertices[MESH_VERTEX_STRIDE * b],
+                          &vertices[MESH_VERTEX_STRIDE * b + 3]);
+                  });
+
+        positionVertices.resize(mesh.vertexCount);
+        for (uint32_t i = 0; i < mesh.vertexCount; i++)
+        {
+            bool isSamePosition =
+                i > 0 && std::equal(&vertices[MESH_VERTEX_STRIDE * order[i]],
+                                    &vertices[MESH_VERTEX_STRIDE * order[i] + 3],
+                                    &vertices[MESH_VERTEX_STRIDE * order[i - 1]]);
+            if (!isSamePosition)
+            {
+                representativeVertices.push_back(order[i]);
+            }
+            positionVertices[order[i]] =
+                (uint32_t)representativeVertices.size() - 1;
+        }
+    }
+
+    // plane of every triangle at its corners, and a plane through every
+    // border edge perpendicular to its triangle at the edge's ends
+    void buildQuadrics(std::unordered_map<uint64_t, uint32_t> &edgeTriangles)
+    {
+        uint32_t positionVertexCount = (uint32_t)representativeVertices.size();
+        quadrics.resize(positionVertexCount);
+        vertexTriangles.resize(positionVertexCount);
+        versions.assign(positionVertexCount, 0);
+
+        for (uint32_t i = 0; i < triangleCount; i++)
+        {
+            for (int k = 0; k < 3; k++)
+            {
+                uint32_t a = positionVertices[indices[3 * i + k]];
+                uint32_t b = positionVertices[indices[3 * i + (k + 1) % 3]];
+                vertexTriangles[a].push_back(i);
+                edgeTriangles[getEdgeKey(a, b)]++;
+            }
+        }
+
+        for (uint32_t i = 0; i < triangleCount; i++)
+        {
+            const float *p[3];
+            for (int k = 0; k < 3; k++)
+            {
+                p[k] = getPosition(positionVertices[indices[3 * i + k]]);
+            }
+
+            double normal[3];
+            getTriangleNormal(p[0], p[1], p[2], normal);
+            double length = std::sqrt(dot(normal, normal));
+            if (length == 0.0)
+            {
+                continue;
+            }
+            for (int j = 0; j < 3; j++)
+            {
+                normal[j] /= length;
+            }
+
+            double plane[4] = {normal[0], normal[1], normal[2],
+                               -(normal[0] * p[0][0] + normal[1] * p[0][1] +
+                                 normal[2] * p[0][2])};
+            for (int k = 0; k < 3; k++)
+            {
+                quadrics[positionVertices[indices[3 * i + k]]].addPlane(plane, 1.0);
+            }
+
+            for (int k = 0; k < 3; k++)
+            {
+                uint32_t a = positionVertices[indices[3 * i + k]];
+                uint32_t b = positionVertices[indices[3 * i + (k + 1) % 3]];
+                if (edgeTriangles[getEdgeKey(a, b)] != 1)
+                {
+                    continue;
+                }
+
+                double edge[3];
+                subtract(p[(k + 1) % 3], p[k], edge);
+                double borderNormal[3];
+                cross(edge, normal, borderNormal);
+                double borderLength = std::sqrt(dot(borderNormal, borderNormal));
+                if (borderLength == 0.0)
+                {
+                    continue;
+                }
+                for (int j = 0; j < 3; j++)
+                {
+                    borderNormal[j] /= borderLength;
+                }
+
+                double borderPlane[4] = {
+                    borderNormal[0], borderNormal[1], borderNormal[2],
+                    -(borderNormal[0] * p[k][0] + borderNormal[1] * p[k][1] +
+                      borderNormal[2] * p[k][2])};
+                quadrics[a].addPlane(borderPlane, borderPlaneWeight);
+                quadrics[b].addPlane(borderPlane, borderPlaneWeight);
+            }
+        }
+    }
+
+    // joined vertices sharing a remaining triangle with the vertex, sorted
+    void getNeighbors(uint32_t positionVertex, std::vector<uint32_t> &neighbors) const
+    {
+        neighbors.clear();
+        for (uint32_t triangle : vertexTriangles[positionVertex])
+        {
+            for (int k = 0; !isTriangleRemoved[triangle] && k < 3; k++)
+            {
+                uint32_t neighbor = positionVertices[indices[3 * triangle + k]];
+                if (neighbor != positionVertex)
+                {
+                    neighbors.push_back(neighbor);
+                }
+            }
+        }
+        std::sort(neighbors.begin(), neighbors.end());
+        neighbors.erase(std::unique(neighbors.begin(), neighbors.end()),
+                        neighbors.end());
+    }
+
+    // the target vertex that takes over the triangles of a source vertex:
+    // one on the same side of a seam, sharing a triangle with it
+    uint32_t getTargetVertex(uint32_t sourceVertex, uint32_t target) const
+    {
+        for (uint32_t triangle : vertexTriangles[positionVertices[sourceVertex]])
+        {
+            if (isTriangleRemoved[triangle])
+            {
+                continue;
+            }
+
+            const uint32_t *corners = &indices[3 * triangle];
+            if (corners[0] != sourceVertex && corners[1] != sourceVertex &&
+                corners[2] != sourceVertex)
+            {
+                continue;
+            }
+
+            for (int k = 0; k < 3; k++)
+            {
+                if (positionVertices[corners[k]] == target)
+                {
+                    return corners[k];
+                }
+            }
+        }
+        return UINT32_MAX;
+    }
+
+    // false when a seam would tear, a remaining triangle would flip or the
+    // surface would pinch (the ends share a neighbor that is not on one of
+    // the edge's triangles)
+    bool evaluateCollapse(uint32_t source, uint32_t target, double &cost) const
+    {
+        const float *targetPosition = getPosition(target);
+
+        std::vector<uint32_t> sourceNeighbors;
+        std::vector<uint32_t> targetNeighbors;
+        getNeighbors(source, sourceNeighbors);
+        getNeighbors(target, targetNeighbors);
+
+        std::vector<uint32_t> sharedNeighbors;
+        std::set_intersection(sourceNeighbors.begin(), sourceNeighbors.end(),
+                              targetNeighbors.begin(), targetNeighbors.end(),
+                              std::back_inserter(sharedNeighbors));
+
+        uint32_t edgeTriangleCount = 0;
+        for (uint32_t triangle : vertexTriangles[source])
+        {
+            for (int k = 0; !isTriangleRemoved[triangle] && k < 3; k++)
+            {
+                if (positionVertices[indices[3 * triangle + k]] == target)
+                {
+                    edgeTriangleCount++;
+                }
+            }
+        }
+
+        if (edgeTriangleCount == 0 || sharedNeighbors.size() > edgeTriangleCount)
+        {
+            return false;
+        }
+
+        for (uint32_t triangle : vertexTriangles[source])
+        {
+            if (isTriangleRemoved[triangle])
+            {
+                continue;
+            }
+
+            const uint32_t *corners = &indices[3 * triangle];
+            int sourceCorner = -1;
+            bool hasTarget = false;
+            for (int k = 0; k < 3; k++)
+            {
+                uint32_t positionVertex = positionVertices[corners[k]];
+                if (positionVertex == source)
+                {
+                    sourceCorner = k;
+                }
+                hasTarget = hasTarget || positionVertex == target;
+            }
+
+            // collapses away with the edge
+            if (hasTarget)
+            {
+                continue;
+            }
+
+            if (getTargetVertex(corners[sourceCorner], target) == UINT32_MAX)
+            {
+                return false;
+            }
+
+            const float *p[3];
+            for (int k = 0; k < 3; k++)
+            {
+                p[k] = getPosition(positionVertices[corners[k]]);
+            }
+
+            double oldNormal[3];
+            getTriangleNormal(p[0], p[1], p[2], oldNormal);
+            p[sourceCorner] = targetPosition;
+            double newNormal[3];
+            getTriangleNormal(p[0], p[1], p[2], newNormal);
+
+            if (dot(oldNormal, oldNormal) > 0.0 && dot(oldNormal, newNormal) <= 0.0)
+            {
+                return false;
+            }
+        }
+
+        Quadric quadric = quadrics[source];
+        quadric.add(quadrics[target]);
+        cost = quadric.evaluate(targetPosition);
+        return true;
+    }
+
+    void queueCollapse(uint32_t source, uint32_t target)
+    {
+        double cost;
+        if (evaluateCollapse(source, target, cost))
+        {
+            collapses.push({cost, source, target, versions[source], versions[target]});
+        }
+    }
+
+    void collapse(const Collapse &edgeCollapse)
+    {
+        uint32_t source = edgeCollapse.source;
+        uint32_t target = edgeCollapse.target;
+
+        // resolved before any triangle changes
+        std::vector<std::pair<uint32_t, uint32_t>> vertexRemap;
+        for (uint32_t triangle : vertexTriangles[source])
+        {
+            for (int k = 0; !isTriangleRemoved[triangle] && k < 3; k++)
+            {
+                uint32_t vertex = indices[3 * triangle + k];
+                if (positionVertices[vertex] == source)
+                {
+                    vertexRemap.push_back({vertex, getTargetVertex(vertex, target)});
+                }
+            }
+        }
+
+        for (uint32_t triangle : vertexTriangles[source])
+        {
+            if (isTriangleRemoved[triangle])
+            {
+                continue;
+            }
+
+            uint32_t *corners = &indices[3 * triangle];
+            bool hasTarget = false;
+            for (int k = 0; k < 3; k++)
+            {
+                hasTarget = hasTarget || positionVertices[corners[k]] == target;
+            }
+
+            if (hasTarget)
+            {
+                isTriangleRemoved[triangle] = true;
+                triangleCount--;
+                continue;
+            }
+
+            for (int k = 0; k < 3; k++)
+            {
+                for (const std::pair<uint32_t, uint32_t> &remap : vertexRemap)
+                {
+                    if (corners[k] == remap.first)
+                    {
+                        corners[k] = remap.second;
+                        break;
+                    }
+                }
+            }
+            vertexTriangles[target].push_back(triangle);
+        }
+
+        vertexTriangles[source].clear();
+        quadrics[target].add(quadrics[source]);
+        versions[source]++;
+        versions[target]++;
+        maxError = std::max(maxError, std::sqrt(edgeCollapse.cost));
+
+        // drop the removed triangles and requeue the edges of the target,
+        // both ways
+        std::vector<uint32_t> &targetTriangles = vertexTriangles[target];
+        targetTriangles.erase(
+            std::remove_if(targetTriangles.begin(), targetTriangles.end(),
+                           [this](uint32_t triangle)
+                           { return (bool)isTriangleRemoved[triangle]; }),
+            targetTriangles.end());
+
+        std::vector<uint32_t> neighbors;
+        getNeighbors(target, neighbors);
+
+        for (uint32_t neighbor : neighbors)
+        {
+            queueCollapse(target, neighbor);
+            queueCollapse(neighbor, target);
+        }
+    }
+
+    // the remaining triangles with their vertices in order of first use
+    Mesh getMesh() const
+    {
+        Mesh simplifiedMesh;
+        simplifiedMesh.path = mesh.path;
+        simplifiedMesh.contentHash = mesh.contentHash;
+
+        const uint32_t unassigned = UINT32_MAX;
+        std::vector<uint32_t> remap(mesh.vertexCount, unassigned);
+
+        uint32_t vertexCount = 0;
+        for (uint32_t i = 0; i < isTriangleRemoved.size(); i++)
+        {
+            if (isTriangleRemoved[i])
+            {
+                continue;
+            }
+
+            for (int k = 0; k < 3; k++)
+            {
+                uint32_t vertex = indices[3 * i + k];
+                if (remap[vertex] == unassigned)
+                {
+                    remap[vertex] = vertexCount++;
+                    simplifiedMesh.vertices.insert(
+                        simplifiedMesh.vertices.end(),
+                        &mesh.vertices[MESH_VERTEX_STRIDE * vertex],
+                        &mesh.vertices[MESH_VERTEX_STRIDE * (vertex + 1)]);
+                }
+                simplifiedMesh.indices.push_back(remap[vertex]);
+            }
+        }
+
+        for (int j = 0; j < 3; j++)
+        {
+            simplifiedMesh.positionOffset[j] = 0.0f;
+            simplifiedMesh.positionScale[j] = 1.0f;
+        }
+
+        simplifiedMesh.vertexCount = vertexCount;
+        simplifiedMesh.primitiveCount = triangleCount;
+        simplifiedMesh.simplificationError = (float)maxError;
+        return simplifiedMesh;
+    }
+
+public:
+    MeshSimplifier(const Mesh &mesh)
+        : mesh(mesh), indices(mesh.indices),
+          isTriangleRemoved(mesh.indices.size() / 3, false),
+          triangleCount((uint32_t)(mesh.indices.size() / 3)), maxError(0.0)
+    {
+        joinPositions();
+
+        std::unordered_map<uint64_t, uint32_t> edgeTriangles;
+        buildQuadrics(edgeTriangles);
+
+        for (const std::pair<const uint64_t, uint32_t> &edge : edgeTriangles)
+        {
+            uint32_t a = (uint32_t)(edge.first >> 32);
+            uint32_t b = (uint32_t)edge.first;
+            if (a != b)
+            {
+                queueCollapse(a, b);
+                queueCollapse(b, a);
+            }
+        }
+    }
+
+    Mesh simplify(uint32_t targetPrimitiveCount)
+    {
+        while (triangleCount > targetPrimitiveCount && !collapses.empty())
+        {
+            Collapse edgeCollapse = collapses.top();
+            collapses.pop();
+
+            if (edgeCollapse.sourceVersion != versions[edgeCollapse.source] ||
+                edgeCollapse.targetVersion != versions[edgeCollapse.target])
+            {
+                continue;
+            }
+
+            // the neighborhood may have changed since it was queued
+            double cost;
+            if (!evaluateCollapse(edgeCollapse.source, edgeCollapse.target, cost))
+            {
+                continue;
+            }
+
+            collapse(edgeCollapse);
+        }
+
+        return getMesh();
+    }
+};
+
+void simplifyMesh(const Mesh &mesh,
+                  const std::vector<uint32_t> &targetPrimitiveCounts,
+                  std::vector<Mesh> &simplifiedMeshes)
+{
+    MeshSimplifier simplifier(mesh);
+
+    for (uint32_t targetPrimitiveCount : targetPrimitiveCounts)
+    {
+        simplifiedMeshes.push_back(simplifier.simplify(targetPrimitiveCount));
+    }
+}
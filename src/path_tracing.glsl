@@ -0,0 +1,508 @@
+// Scene bindings, path queues and shading shared by the megakernel
+// (shader.rgen) and the wavefront kernels (shader_generate.comp,
+// shader_extend.rgen, shader_shade.comp, shader_shadow.rgen). Free of ray
+// tracing types so that the compute kernels can include it, ray_tracing.glsl
+// adds the acceleration structure and the payloads.
+//
+// Included by the shaders, the name must not start with "shader" so the
+// Makefile does not compile it on its own.
+
+#include "sampler.glsl"
+
+#define M_PI 3.1415926535897932384626433832795
+
+layout(binding = 1, set = 0) uniform UniformStructure {
+  vec4 position;
+  vec4 right;
+  vec4 up;
+  vec4 forward;
+
+  // lights in the light buffer (binding 20)
+  uint lightCount;
+  uint maxBounceCount;
+  uint samplesPerPixel;
+  uint frameIndex;
+
+  // camera of the previous frame, for motion vectors
+  mat4 previousView;
+
+  // cells per cubemap face edge of the skybox sampling distribution, 0 when
+  // the skybox only lights through the ambient term
+  uint environmentResolution;
+  // chance of sampling the skybox rather than the light buffer
+  float environmentSelectionProbability;
+  // receiver cell size of the shadow cache, 0 disables it
+  float shadowCacheCellSize;
+}
+uniforms;
+
+layout(binding = 4, set = 0, rgba16f) uniform image2D image;
+layout(binding = 5, set = 0) uniform samplerCube skyboxSampler;
+
+struct InstanceInfo {
+  // in elements of the mesh's index type
+  uint indexOffset;
+  uint vertexOffset;
+  uint materialIndex;
+  uint meshIndex;
+
+  // dequantization of compact vertex positions
+  vec3 positionOffset;
+  uint shortIndices;
+  vec3 positionScale;
+  // world space distance the rays leaving this LOD at the first bounce
+  // skip, past the coarser LOD of the instance that the rays after it
+  // trace; scaled by the instance transform when the buffer is filled
+  float secondaryRayOffset;
+};
+
+layout(binding = 6, set = 0) buffer InstanceBuffer { InstanceInfo data[]; }
+instanceBuffer;
+
+struct Material {
+  vec3 albedo;
+  float roughness;
+  vec3 specular;
+  float indexOfRefraction;
+  vec3 emission;
+
+  /*
+    Material types:
+    0 - diffuse
+    1 - mirror
+    2 - refractive
+    */
+  uint type;
+  uint albedoTextureIndex;
+};
+
+layout(binding = 7, set = 0) buffer MaterialBuffer { Material data[]; }
+materialBuffer;
+
+layout(binding = 8, set = 0) uniform sampler2D textures[];
+
+// G-buffer of the first hit of the first sample, guides the denoiser
+layout(binding = 9, set = 0, rgba16f) uniform writeonly image2D normalDepthImage;
+layout(binding = 10, set = 0, rgba8) uniform writeonly image2D albedoImage;
+layout(binding = 11, set = 0, r32ui) uniform writeonly uimage2D objectIdImage;
+
+// xy - pixel offset to where the first hit was seen in the previous frame
+// z  - its expected distance from the previous camera
+layout(binding = 12, set = 0, rgba16f) uniform writeonly image2D motionImage;
+
+// object transform of the previous frame times the inverse of the current
+layout(binding = 13, set = 0) buffer InstanceMotionBuffer { mat4 data[]; }
+instanceMotionBuffer;
+
+/*
+  Light types (include/light.h):
+  0 - point
+  1 - spot
+  2 - area (one-sided parallelogram)
+  3 - emissive triangle (one-sided)
+*/
+struct Light {
+  vec3 position;
+  uint type;
+  // spot axis, first edge of area and triangle lights
+  vec3 direction;
+  float cosOuterAngle;
+  vec3 edge;
+  float cosInnerAngle;
+  // intensity of point and spot lights, radiance of the others
+  vec3 emission;
+  float selectionPdf;
+  // alias table bucket of the same index
+  float aliasProbability;
+  uint aliasIndex;
+  uvec2 padding;
+};
+
+layout(binding = 20, set = 0) buffer LightBuffer { Light data[]; }
+lightBuffer;
+
+#include "environment.glsl"
+
+layout(push_constant) uniform TraceConstants {
+  // samples traced by the launch (all of them in the megakernel, one per
+  // wave in the wavefront backend)
+  uint firstSampleIndex;
+  uint sampleCount;
+
+  // the images are allocated for the largest render scale
+  uint renderWidth;
+  uint renderHeight;
+
+  // the megakernel defers its shadow rays to the shadow batch
+  uint isShadowRayBatched;
+}
+constants;
+
+// TLAS instance masks (the *_INSTANCE_MASK constants in src/main.cpp): an
+// instance is static or moving, and holds the LOD of the camera rays
+// (primary) or the coarser one of the rays after the first bounce
+// (secondary)
+const uint staticInstanceMask = 0x05;
+const uint movingInstanceMask = 0x0A;
+const uint primaryLodInstanceMask = 0x03;
+const uint secondaryLodInstanceMask = 0x0C;
+
+// the custom index of a TLAS instance is its scene instance index with the
+// LOD in the low bits (MESH_LOD_INDEX_BITS in src/main.cpp); the instance
+// buffer has an entry per LOD, the per-instance buffers one per instance
+const uint lodIndexBits = 2;
+
+uint getInstanceIndex(int objectIndex) { return uint(objectIndex) >> lodIndexBits; }
+
+// instances traced by the rays of the bounce, 0 for camera rays
+uint getLodInstanceMask(uint bounce) {
+  return bounce == 0 ? primaryLodInstanceMask : secondaryLodInstanceMask;
+}
+
+// Wavefront queues: rays waiting to be traced, appended by the generate
+// and shade kernels and binned by shader_bin.comp into the sorted queue;
+// the hits of the sorted rays (same index); shadow rays appended by the
+// shade kernel
+struct PathRay {
+  vec3 origin;
+  // x | y << 16
+  uint pixel;
+  vec3 direction;
+  // bounce | sample index << 8 | material index << 16
+  uint state;
+};
+
+struct PathHit {
+  vec3 position;
+  // instance index, -1 on miss
+  int objectIndex;
+  vec3 normal;
+  float distance;
+  vec3 direction;
+  uint pixel;
+  vec2 texCoord;
+  uint state;
+  uint padding;
+};
+
+// radiance reaches the pixel if nothing is hit within distance
+struct ShadowRay {
+  vec3 origin;
+  uint pixel;
+  vec3 direction;
+  float distance;
+  vec3 radiance;
+  // shadow cache key of point and spot light rays, 0 when not cached
+  uint cacheKey;
+  // LOD instances of the hit the ray leaves
+  uint cullMask;
+  uint padding[3];
+};
+
+layout(binding = 14, set = 0) buffer PathQueueState {
+  uint queueCount;
+  uint sortedCount;
+  uint shadowCount;
+}
+pathQueueState;
+
+layout(binding = 15, set = 0) buffer PathQueue { PathRay data[]; }
+pathQueue;
+layout(binding = 16, set = 0) buffer SortedPathQueue { PathRay data[]; }
+sortedPathQueue;
+layout(binding = 17, set = 0) buffer PathHitBuffer { PathHit data[]; }
+pathHitBuffer;
+layout(binding = 18, set = 0) buffer ShadowQueue { ShadowRay data[]; }
+shadowQueue;
+
+// Megakernel shadow batch, one ray per pixel and sample (distance 0 when the
+// path ended without one), traced by shader_shadow_batch.rgen. The shadow
+// cache keeps the key and the visibility against the static instances
+// (bit 0) of every batch entry across frames.
+layout(binding = 22, set = 0) buffer ShadowBatch { ShadowRay data[]; }
+shadowBatch;
+layout(binding = 23, set = 0) buffer ShadowCache { uint data[]; }
+shadowCache;
+
+// closest hit of a ray, filled from the payload or a hit record
+struct PathVertex {
+  vec3 position;
+  vec3 normal;
+  vec2 texCoord;
+  int objectIndex;
+};
+
+const vec3 Iamb = vec3(0.8, 0.8, 0.8); // ambient light intensity
+
+uvec2 unpackPixel(uint pixel) { return uvec2(pixel & 0xffff, pixel >> 16); }
+
+uint packPixel(uvec2 pixel) { return pixel.x | (pixel.y << 16); }
+
+// atomics compact the queues, the order is restored by shader_bin.comp
+void enqueuePathRay(vec3 origin, vec3 direction, uvec2 pixel, uint bounce,
+                    uint sampleIndex, uint materialIndex) {
+  uint index = atomicAdd(pathQueueState.queueCount, 1);
+  pathQueue.data[index] = PathRay(origin, packPixel(pixel), direction,
+                                  bounce | (sampleIndex << 8) | (materialIndex << 16));
+}
+
+void enqueueShadowRay(ShadowRay shadowRay) {
+  uint index = atomicAdd(pathQueueState.shadowCount, 1);
+  shadowQueue.data[index] = shadowRay;
+}
+
+uint getShadowBatchIndex(uvec2 pixel, uint sampleIndex) {
+  return (pixel.y * constants.renderWidth + pixel.x) * uniforms.samplesPerPixel +
+         sampleIndex;
+}
+
+// Key of a light, the receiver position snapped to the shadow cache cells
+// and the instances the ray is tested against. Never 0, bit 0 is left for
+// the cached visibility.
+uint getShadowCacheKey(uint lightIndex, vec3 position, uint cullMask) {
+  if (uniforms.shadowCacheCellSize <= 0.0)
+    return 0;
+
+  uvec3 cell = uvec3(ivec3(floor(position / uniforms.shadowCacheCellSize)));
+  uint hash = hashSampler(cullMask ^ hashSampler(lightIndex ^ hashSampler(cell.x ^ hashSampler(cell.y ^ hashSampler(cell.z)))));
+  return (hash & ~1u) | 2u;
+}
+
+// jittered camera ray through the pixel, every frame continues the
+// pixel's sequence so that the accumulated history stays stratified
+void getCameraRay(uvec2 pixel, uvec2 size, uint sampleIndex,
+                  out vec3 rayOrigin, out vec3 rayDirection) {
+  uint sampleOffset = uniforms.samplesPerPixel * uniforms.frameIndex;
+  vec2 uv = pixel + sampleOwenSobol2D(sampleOffset + sampleIndex, getPixelSeed(pixel));
+  uv /= vec2(size);
+  uv = (uv * 2.0f - 1.0f) * vec2(1.0f, -1.0f);
+
+  rayOrigin = uniforms.position.xyz;
+  rayDirection = normalize((uv.x * uniforms.right + uv.y * uniforms.up + 2.5 * uniforms.forward).xyz);
+}
+
+// projects a point in the previous camera's view space the same way camera
+// rays are generated
+vec4 getMotion(vec3 previousViewPosition, float previousDistance, uvec2 pixel,
+               uvec2 size) {
+  if (previousViewPosition.z >= 0.0)
+    return vec4(-10000.0, -10000.0, previousDistance, 0.0);
+
+  vec2 uv = 2.5 * previousViewPosition.xy / -previousViewPosition.z;
+  vec2 previousPixel = (uv * vec2(1.0, -1.0) + 1.0) * 0.5 * vec2(size);
+  return vec4(previousPixel - (vec2(pixel) + 0.5), previousDistance, 0.0);
+}
+
+// the sky only moves with the camera rotation
+vec4 getSkyMotion(vec3 rayDirection, uvec2 pixel, uvec2 size) {
+  return getMotion(mat3(uniforms.previousView) * rayDirection, 10000.0, pixel, size);
+}
+
+vec4 getHitMotion(PathVertex vertex, uvec2 pixel, uvec2 size) {
+  vec4 previousPosition = instanceMotionBuffer.data[getInstanceIndex(vertex.objectIndex)] * vec4(vertex.position, 1.0);
+  vec3 previousViewPosition = (uniforms.previousView * previousPosition).xyz;
+  return getMotion(previousViewPosition, length(previousViewPosition), pixel, size);
+}
+
+// picks a light in proportion to its power with the alias table: u selects
+// the bucket and its fraction the light or the bucket's alias
+uint pickLight(float u) {
+  float scaled = u * float(uniforms.lightCount);
+  uint index = min(uint(scaled), uniforms.lightCount - 1);
+  if (scaled - float(index) >= lightBuffer.data[index].aliasProbability)
+    index = lightBuffer.data[index].aliasIndex;
+  return index;
+}
+
+// Light arriving at the position from a point on the light (u picks it on
+// area and triangle lights), zero behind one-sided lights. The caller
+// divides by the light's selection pdf.
+vec3 sampleLight(Light light, vec3 position, vec2 u, out vec3 L,
+                 out float lightDistance) {
+  vec3 lightPosition = light.position;
+  if (light.type == 3 && u.x + u.y > 1.0)
+    u = 1.0 - u;
+  if (light.type >= 2)
+    lightPosition += u.x * light.direction + u.y * light.edge;
+
+  vec3 toLightVector = lightPosition - position;
+  float distanceSquared = dot(toLightVector, toLightVector);
+  lightDistance = sqrt(distanceSquared);
+  L = toLightVector / lightDistance;
+
+  if (light.type == 0)
+    return light.emission / distanceSquared;
+  if (light.type == 1)
+    return light.emission / distanceSquared *
+           smoothstep(light.cosOuterAngle, light.cosInnerAngle, dot(-L, light.direction));
+
+  // radiance times the solid angle the light covers per unit of the sample
+  vec3 areaNormal = cross(light.direction, light.edge);
+  float area = length(areaNormal) * (light.type == 3 ? 0.5 : 1.0);
+  float cosLight = dot(-L, areaNormal) / length(areaNormal);
+  if (cosLight <= 0.0)
+    return vec3(0.0);
+  return light.emission * cosLight * area / distanceSquared;
+}
+
+// The rays after the first bounce trace the coarser LODs: a ray leaving a
+// camera ray hit starts past the coarse surface around the one it leaves,
+// which it would hit right away otherwise. The offset is capped at ten times
+// the surface offset, so a coarse LOD with a large simplification error
+// cannot push the ray through nearby geometry; past the cap it may hit the
+// coarse surface again.
+const float maxSecondaryRayOffset = 0.1;
+
+void offsetSecondaryRay(int objectIndex, uint bounce, inout vec3 rayOrigin,
+                        vec3 rayDirection) {
+  if (bounce == 0)
+    rayOrigin += min(instanceBuffer.data[objectIndex].secondaryRayOffset,
+                     maxSecondaryRayOffset) * rayDirection;
+}
+
+// a miss keeps the sky radiance as is when the denoiser demodulates albedo
+void storeGBuffer(uvec2 pixel, vec4 normalDepth, vec3 albedo, uint objectId,
+                  vec4 motion) {
+  imageStore(normalDepthImage, ivec2(pixel), normalDepth);
+  imageStore(albedoImage, ivec2(pixel), vec4(albedo, 1.0));
+  imageStore(objectIdImage, ivec2(pixel), uvec4(objectId));
+  imageStore(motionImage, ivec2(pixel), motion);
+}
+
+// Shades the closest hit (or miss) of the ray. Returns true when the path
+// continues along the updated ray (mirror, refraction); otherwise color is
+// the radiance the path ends with, plus shadowRay.radiance when
+// shadowRay.distance > 0 and the shadow ray reaches the light, one light
+// picked per diffuse hit. albedo is the diffuse albedo of the hit, for the
+// G-buffer. bounce is the one of the ray that hit the vertex, the shadow ray
+// sees the same LODs.
+bool shadePathVertex(PathVertex vertex, inout vec3 rayOrigin,
+                     inout vec3 rayDirection, uvec2 pixel, uint sampleIndex,
+                     uint bounce, out vec3 color, out vec3 albedo,
+                     out ShadowRay shadowRay)
+{
+  color = vec3(0.0f);
+  albedo = vec3(1.0);
+  shadowRay.distance = 0.0;
+  shadowRay.cacheKey = 0;
+  shadowRay.cullMask = getLodInstanceMask(bounce);
+
+  int objectIndex = vertex.objectIndex;
+  if (objectIndex == -1)
+  {
+    color = getSkyRadiance(rayDirection);
+    return false;
+  }
+
+  Material material = materialBuffer.data[instanceBuffer.data[objectIndex].materialIndex];
+  if (material.type == 0)
+  {
+    vec3 hitPosition = vertex.position;
+    vec3 hitNormal = vertex.normal;
+
+    vec3 kd = material.albedo *
+              texture(textures[nonuniformEXT(material.albedoTextureIndex)], vertex.texCoord).rgb;
+    vec3 ka = 0.3 * kd;
+
+    albedo = kd;
+    vec3 ks = material.specular;
+    float shininess = 2.0 / (material.roughness * material.roughness) - 2.0;
+
+    color = material.emission;
+    if (uniforms.environmentResolution == 0)
+      color += Iamb * ka;
+
+    // the skybox takes every sample when there are no lights
+    float environmentProbability = 0.0;
+    if (uniforms.environmentResolution != 0)
+      environmentProbability = uniforms.lightCount == 0 ? 1.0 : uniforms.environmentSelectionProbability;
+
+    if (dot(rayDirection, hitNormal) >= 0 ||
+        (uniforms.lightCount == 0 && environmentProbability == 0.0))
+      return false;
+
+    // the path ends here, so it draws its light sample from the dimensions
+    // after the camera ray's
+    uint sampleOffset = uniforms.samplesPerPixel * uniforms.frameIndex + sampleIndex;
+    uint pixelSeed = getPixelSeed(pixel);
+    vec2 selectionSample = sampleOwenSobol2D(sampleOffset, hashSampler(pixelSeed ^ 0x2c1b3c6du));
+    vec2 lightSample = sampleOwenSobol2D(sampleOffset, hashSampler(pixelSeed ^ 0x297a2d39u));
+
+    vec3 L;
+    float lightDistance;
+    vec3 lightIntensity;
+    if (selectionSample.x < environmentProbability) {
+      lightIntensity = sampleEnvironment(hitNormal, lightSample, selectionSample.y, L) /
+                       environmentProbability;
+      lightDistance = 10000.0;
+    } else {
+      uint lightIndex = pickLight((selectionSample.x - environmentProbability) /
+                                  (1.0 - environmentProbability));
+      Light light = lightBuffer.data[lightIndex];
+      lightIntensity = sampleLight(light, hitPosition, lightSample, L, lightDistance) /
+                       (light.selectionPdf * (1.0 - environmentProbability));
+
+      // the rays to a fixed light position can reuse their visibility
+      if (light.type <= 1)
+        shadowRay.cacheKey = getShadowCacheKey(lightIndex, hitPosition, shadowRay.cullMask);
+    }
+    if (lightIntensity == vec3(0.0))
+      return false;
+
+    vec3 V = -rayDirection;
+    vec3 H = normalize(L + V);
+    vec3 N = vertex.normal;
+
+    float NdotL = dot(N, L); // for diffuse component
+    float NdotH = dot(N, H); // for specular component
+
+    vec3 diffuseColor = lightIntensity * kd * max(0, NdotL);
+    vec3 specularColor = lightIntensity * ks * pow(max(0, NdotH), shininess);
+
+    // stops short of emissive triangles, which are scene geometry
+    shadowRay.origin = hitPosition + 0.01 * hitNormal;
+    shadowRay.direction = L;
+    shadowRay.distance = max(lightDistance - 0.01, 0.0);
+    shadowRay.radiance = pow(0.9, float(sampleIndex)) * (diffuseColor + specularColor);
+    return false;
+  }
+  else if (material.type == 1)
+  {
+    vec3 hitNormal = vertex.normal;
+    rayOrigin = vertex.position + 0.01 * hitNormal;
+    rayDirection = reflect(rayDirection, hitNormal);
+    offsetSecondaryRay(objectIndex, bounce, rayOrigin, rayDirection);
+    return true;
+  }
+  else if (material.type == 2)
+  {
+    vec3 hitNormal = vertex.normal;
+    float ndoti = dot(rayDirection, hitNormal);
+    bool outwards = ndoti > 0.0f;
+    if (outwards)
+    {
+      hitNormal = -hitNormal;
+      ndoti = -ndoti;
+    }
+
+    float ratio = outwards ? material.indexOfRefraction : (1.0f/material.indexOfRefraction);
+
+    // vec3 R = refract(rayDirection, hitNormal, ratio);
+    float k = 1.0 - ratio * ratio * (1.0 - ndoti * ndoti);
+    if (k < 0.0)
+    {
+      rayDirection = reflect(rayDirection, hitNormal);
+      rayOrigin = vertex.position + 0.01 * hitNormal;
+    }
+    else
+    {
+      vec3 R = ratio * rayDirection - (ratio * ndoti + sqrt(k)) * hitNormal;
+      rayDirection = normalize(R);
+      rayOrigin = vertex.position - 0.01 * hitNormal;
+    }
+    offsetSecondaryRay(objectIndex, bounce, rayOrigin, rayDirection);
+    return true;
+  }
+
+  return false;
+}
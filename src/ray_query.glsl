@@ -0,0 +1,56 @@
+// Inline tracing for the ray query backend (shader_ray_query.comp), the
+// counterpart of ray_tracing.glsl: the committed hit is reconstructed as in
+// shader.rchit. Included after path_tracing.glsl.
+//
+// Included by the shaders, the name must not start with "shader" so the
+// Makefile does not compile it on its own.
+
+layout(binding = 0, set = 0) uniform accelerationStructureEXT topLevelAS;
+
+#include "vertex_fetch.glsl"
+
+const uint normalRayFlags = gl_RayFlagsOpaqueEXT;
+const uint shadowRayFlags = gl_RayFlagsOpaqueEXT | gl_RayFlagsTerminateOnFirstHitEXT;
+
+// closest hit in world space among the instances of the mask, objectIndex
+// -1 on miss
+PathVertex traceClosestHit(vec3 rayOrigin, vec3 rayDirection, uint cullMask) {
+  rayQueryEXT rayQuery;
+  rayQueryInitializeEXT(rayQuery, topLevelAS, normalRayFlags, cullMask,
+                        rayOrigin, 0.001, rayDirection, 10000.0);
+
+  // opaque geometry only, so traversal commits every candidate itself
+  while (rayQueryProceedEXT(rayQuery)) {
+  }
+
+  if (rayQueryGetIntersectionTypeEXT(rayQuery, true) ==
+      gl_RayQueryCommittedIntersectionNoneEXT)
+    return PathVertex(vec3(0.0), vec3(0.0), vec2(0.0), -1);
+
+  int objectIndex = rayQueryGetIntersectionInstanceCustomIndexEXT(rayQuery, true);
+  Vertex vertex = fetchHitVertex(instanceBuffer.data[objectIndex],
+                                 rayQueryGetIntersectionPrimitiveIndexEXT(rayQuery, true),
+                                 rayQueryGetIntersectionBarycentricsEXT(rayQuery, true));
+
+  mat4x3 objectToWorld = rayQueryGetIntersectionObjectToWorldEXT(rayQuery, true);
+  mat4x3 worldToObject = rayQueryGetIntersectionWorldToObjectEXT(rayQuery, true);
+
+  return PathVertex(objectToWorld * vec4(vertex.position, 1),
+                    normalize((vertex.normal * worldToObject).xyz),
+                    vertex.texCoord, objectIndex);
+}
+
+// true when no instance of the ray's mask is hit between the origin and the
+// distance
+bool traceShadowRay(ShadowRay shadowRay) {
+  rayQueryEXT rayQuery;
+  rayQueryInitializeEXT(rayQuery, topLevelAS, shadowRayFlags, shadowRay.cullMask,
+                        shadowRay.origin, 0.001, shadowRay.direction,
+                        shadowRay.distance);
+
+  while (rayQueryProceedEXT(rayQuery)) {
+  }
+
+  return rayQueryGetIntersectionTypeEXT(rayQuery, true) ==
+         gl_RayQueryCommittedIntersectionNoneEXT;
+}
@@ -0,0 +1,94 @@
+// Acceleration structure, payloads and ray flags of the ray generation
+// shaders, included after path_tracing.glsl. Built with COMPACT_PAYLOAD for
+// the compact_payload_* variants (see the Makefile).
+//
+// Included by the shaders, the name must not start with "shader" so the
+// Makefile does not compile it on its own.
+
+#ifdef COMPACT_PAYLOAD
+// the closest hit shader only returns the hit, getPayloadVertex()
+// fetches and interpolates the triangle's vertices
+layout(location = 0) rayPayloadEXT Payload {
+  // instance index, -1 on miss
+  int objectIndex;
+  uint primitiveIndex;
+  vec2 barycentrics;
+}
+payload;
+
+#include "vertex_fetch.glsl"
+
+// instances of the TLAS build (VkAccelerationStructureInstanceKHR), copied
+// with every TLAS update; the primary LOD instances come first, in scene
+// instance order
+struct TopLevelInstance {
+  // rows of the object to world transform
+  vec4 transform[3];
+  uvec4 fields;
+};
+
+layout(binding = 19, set = 0) buffer InstanceTransformBuffer { TopLevelInstance data[]; }
+instanceTransformBuffer;
+#else
+layout(location = 0) rayPayloadEXT Payload {
+  vec3 hitPosition;
+  vec3 hitNormal;
+  vec2 hitTexCoord;
+
+  // instance index, -1 on miss
+  int objectIndex;
+}
+payload;
+#endif
+
+layout(location = 1) rayPayloadEXT bool isShadow;
+
+layout(binding = 0, set = 0) uniform accelerationStructureEXT topLevelAS;
+
+const uint normalRayFlags = gl_RayFlagsOpaqueEXT;
+const uint shadowRayFlags = gl_RayFlagsOpaqueEXT | gl_RayFlagsTerminateOnFirstHitEXT | gl_RayFlagsSkipClosestHitShaderEXT;
+
+PathVertex getPayloadVertex() {
+#ifdef COMPACT_PAYLOAD
+  PathVertex pathVertex = PathVertex(vec3(0.0), vec3(0.0), vec2(0.0), payload.objectIndex);
+  if (payload.objectIndex == -1)
+    return pathVertex;
+
+  Vertex vertex = fetchHitVertex(instanceBuffer.data[payload.objectIndex],
+                                 payload.primitiveIndex, payload.barycentrics);
+
+  // normals go through the inverse transpose of the transform, whose rows
+  // are the columns of transposedObjectToWorld
+  vec4 transform[3] = instanceTransformBuffer.data[getInstanceIndex(payload.objectIndex)].transform;
+  mat3 transposedObjectToWorld = mat3(transform[0].xyz, transform[1].xyz, transform[2].xyz);
+  vec4 position = vec4(vertex.position, 1.0);
+
+  pathVertex.position = vec3(dot(transform[0], position),
+                             dot(transform[1], position),
+                             dot(transform[2], position));
+  pathVertex.normal = normalize(inverse(transposedObjectToWorld) * vertex.normal);
+  pathVertex.texCoord = vertex.texCoord;
+  return pathVertex;
+#else
+  return PathVertex(payload.hitPosition, payload.hitNormal, payload.hitTexCoord,
+                    payload.objectIndex);
+#endif
+}
+
+// closest hit in world space among the instances of the mask, objectIndex
+// -1 on miss
+PathVertex traceClosestHit(vec3 rayOrigin, vec3 rayDirection, uint cullMask) {
+  payload.objectIndex = -1;
+  traceRayEXT(topLevelAS, normalRayFlags, cullMask, 0, 0, 0,
+              rayOrigin, 0.001, rayDirection, 10000.0, 0);
+  return getPayloadVertex();
+}
+
+// true when no instance of the ray's mask is hit between the origin and the
+// distance
+bool traceShadowRay(ShadowRay shadowRay) {
+  isShadow = true;
+  traceRayEXT(topLevelAS, shadowRayFlags, shadowRay.cullMask, 0, 0, 1,
+              shadowRay.origin, 0.001, shadowRay.direction, shadowRay.distance, 1);
+  return !isShadow;
+}
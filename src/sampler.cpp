@@ -0,0 +1,71 @@
+#include "sampler.h"
+
+static uint32_t reverseBits(uint32_t x)
+{
+    x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+    x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+    x = ((x >> 4) & 0x0f0f0f0fu) | ((x & 0x0f0f0f0fu) << 4);
+    x = ((x >> 8) & 0x00ff00ffu) | ((x & 0x00ff00ffu) << 8);
+    return (x >> 16) | (x << 16);
+}
+
+uint32_t hashSampler(uint32_t x)
+{
+    // Wellons, lowbias32
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+static uint32_t laineKarrasPermutation(uint32_t x, uint32_t seed)
+{
+    x += seed;
+    x ^= x * 0x6c50b47cu;
+    x ^= x * 0xb82f1e52u;
+    x ^= x * 0xc7afe638u;
+    x ^= x * 0x8d22f6e6u;
+    return x;
+}
+
+uint32_t nestedUniformScramble(uint32_t x, uint32_t seed)
+{
+    x = reverseBits(x);
+    x = laineKarrasPermutation(x, seed);
+    return reverseBits(x);
+}
+
+void sobol2D(uint32_t index, uint32_t result[2])
+{
+    result[0] = 0;
+    result[1] = 0;
+
+    uint32_t direction = 1u << 31;
+    for (uint32_t bit = 0; index != 0; bit++, index >>= 1)
+    {
+        if (index & 1)
+        {
+            result[0] ^= 1u << (31 - bit);
+            result[1] ^= direction;
+        }
+        direction ^= direction >> 1;
+    }
+}
+
+void sampleOwenSobol2D(uint32_t index, uint32_t seed, float sample[2])
+{
+    uint32_t point[2];
+    sobol2D(nestedUniformScramble(index, seed), point);
+    point[0] = nestedUniformScramble(point[0], hashSampler(seed ^ 0xa511e9b3u));
+    point[1] = nestedUniformScramble(point[1], hashSampler(seed ^ 0x63d83595u));
+
+    sample[0] = (point[0] >> 8) * (1.0f / 16777216.0f);
+    sample[1] = (point[1] >> 8) * (1.0f / 16777216.0f);
+}
+
+uint32_t getPixelSeed(uint32_t x, uint32_t y)
+{
+    return hashSampler(x + hashSampler(y));
+}
@@ -0,0 +1,65 @@
+// Owen-scrambled Sobol sampler (Burley, "Practical Hash-based Owen
+// Scrambling", 2020). Every pixel gets its own scrambled copy of the 2D
+// Sobol sequence, so the samples of a pixel stay stratified across frames
+// while neighboring pixels are decorrelated. Mirrored bit for bit by
+// include/sampler.h on the CPU (checked with SAMPLER_SELF_TEST).
+//
+// Included by the shaders, the name must not start with "shader" so the
+// Makefile does not compile it on its own.
+
+// integer hash (Wellons, lowbias32)
+uint hashSampler(uint x) {
+  x ^= x >> 16;
+  x *= 0x7feb352du;
+  x ^= x >> 15;
+  x *= 0x846ca68bu;
+  x ^= x >> 16;
+  return x;
+}
+
+// Laine-Karras permutation: a hash where every bit only depends on the
+// bits below it
+uint laineKarrasPermutation(uint x, uint seed) {
+  x += seed;
+  x ^= x * 0x6c50b47cu;
+  x ^= x * 0xb82f1e52u;
+  x ^= x * 0xc7afe638u;
+  x ^= x * 0x8d22f6e6u;
+  return x;
+}
+
+// Owen scrambling: flips every bit depending on the bits above it
+uint nestedUniformScramble(uint x, uint seed) {
+  x = bitfieldReverse(x);
+  x = laineKarrasPermutation(x, seed);
+  return bitfieldReverse(x);
+}
+
+// first two Sobol dimensions (van der Corput and its (0,2) partner) as
+// 32-bit fixed point
+uvec2 sobol2D(uint index) {
+  uvec2 result = uvec2(0u);
+  uint direction = 1u << 31;
+  for (uint bit = 0u; index != 0u; bit++, index >>= 1) {
+    if ((index & 1u) != 0u)
+      result ^= uvec2(1u << (31u - bit), direction);
+    direction ^= direction >> 1;
+  }
+  return result;
+}
+
+// index-th point of the sequence scrambled by seed, in [0, 1)^2
+vec2 sampleOwenSobol2D(uint index, uint seed) {
+  // shuffle the order, then scramble each dimension independently
+  index = nestedUniformScramble(index, seed);
+  uvec2 point = sobol2D(index);
+  point.x = nestedUniformScramble(point.x, hashSampler(seed ^ 0xa511e9b3u));
+  point.y = nestedUniformScramble(point.y, hashSampler(seed ^ 0x63d83595u));
+
+  // 24 bits fit a float mantissa exactly
+  return vec2(point >> 8) * (1.0 / 16777216.0);
+}
+
+uint getPixelSeed(uvec2 pixel) {
+  return hashSampler(pixel.x + hashSampler(pixel.y));
+}
@@ -0,0 +1,101 @@
+// Index and vertex fetch for hit reconstruction, shared by the closest hit
+// shader and, with COMPACT_PAYLOAD, the ray generation shaders. The
+// includer declares InstanceInfo.
+//
+// Included by the shaders, the name must not start with "shader" so the
+// Makefile does not compile it on its own.
+
+// set from COMPACT_VERTEX_FORMAT in config.h
+layout(constant_id = 0) const bool compactVertexFormat = false;
+
+// 32-bit words, holding one 32-bit or two 16-bit indices
+layout(binding = 2, set = 0) buffer IndexBuffer { uint data[]; }
+indexBuffer;
+// 32-bit words, floats or packed values depending on the vertex format
+layout(binding = 3, set = 0) buffer VertexBuffer { uint data[]; }
+vertexBuffer;
+
+struct Vertex {
+  vec3 position;
+  vec3 normal;
+  vec2 texCoord;
+};
+
+vec3 decodeOctahedral(uint packedNormal) {
+  vec2 f = unpackSnorm2x16(packedNormal);
+  vec3 n = vec3(f, 1.0 - abs(f.x) - abs(f.y));
+  float t = max(-n.z, 0.0);
+  n.x += n.x >= 0.0 ? -t : t;
+  n.y += n.y >= 0.0 ? -t : t;
+  return normalize(n);
+}
+
+uint fetchIndex(InstanceInfo instanceInfo, uint index) {
+  uint element = instanceInfo.indexOffset + index;
+
+  if (instanceInfo.shortIndices != 0) {
+    uint word = indexBuffer.data[element >> 1];
+    return (element & 1) == 0 ? word & 0xFFFF : word >> 16;
+  }
+
+  return indexBuffer.data[element];
+}
+
+Vertex fetchVertex(InstanceInfo instanceInfo, uint index) {
+  Vertex vertex;
+
+  if (compactVertexFormat) {
+    // position xy, position z, octahedral normal, half texture coordinate
+    uint base = instanceInfo.vertexOffset + 4 * index;
+
+    vec3 position = vec3(unpackSnorm2x16(vertexBuffer.data[base + 0]),
+                         unpackSnorm2x16(vertexBuffer.data[base + 1]).x);
+
+    vertex.position = instanceInfo.positionOffset.xyz +
+                      position * instanceInfo.positionScale.xyz;
+    vertex.normal = decodeOctahedral(vertexBuffer.data[base + 2]);
+    vertex.texCoord = unpackHalf2x16(vertexBuffer.data[base + 3]);
+  } else {
+    // position (3), normal (3), texture coordinate (2)
+    uint base = instanceInfo.vertexOffset + 8 * index;
+
+    vertex.position = vec3(uintBitsToFloat(vertexBuffer.data[base + 0]),
+                           uintBitsToFloat(vertexBuffer.data[base + 1]),
+                           uintBitsToFloat(vertexBuffer.data[base + 2]));
+    vertex.normal = vec3(uintBitsToFloat(vertexBuffer.data[base + 3]),
+                         uintBitsToFloat(vertexBuffer.data[base + 4]),
+                         uintBitsToFloat(vertexBuffer.data[base + 5]));
+    vertex.texCoord = vec2(uintBitsToFloat(vertexBuffer.data[base + 6]),
+                           uintBitsToFloat(vertexBuffer.data[base + 7]));
+  }
+
+  return vertex;
+}
+
+// interpolated vertex of a triangle in object space
+Vertex fetchHitVertex(InstanceInfo instanceInfo, uint primitiveIndex,
+                      vec2 hitCoordinate) {
+  uint offset = 3 * primitiveIndex;
+  uvec3 indices = uvec3(fetchIndex(instanceInfo, offset + 0),
+                        fetchIndex(instanceInfo, offset + 1),
+                        fetchIndex(instanceInfo, offset + 2));
+
+  vec3 barycentric = vec3(1.0 - hitCoordinate.x - hitCoordinate.y,
+                          hitCoordinate.x, hitCoordinate.y);
+
+  Vertex vertexA = fetchVertex(instanceInfo, indices.x);
+  Vertex vertexB = fetchVertex(instanceInfo, indices.y);
+  Vertex vertexC = fetchVertex(instanceInfo, indices.z);
+
+  Vertex vertex;
+  vertex.position = vertexA.position * barycentric.x +
+                    vertexB.position * barycentric.y +
+                    vertexC.position * barycentric.z;
+  vertex.normal = vertexA.normal * barycentric.x +
+                  vertexB.normal * barycentric.y +
+                  vertexC.normal * barycentric.z;
+  vertex.texCoord = vertexA.texCoord * barycentric.x +
+                    vertexB.texCoord * barycentric.y +
+                    vertexC.texCoord * barycentric.z;
+  return vertex;
+}